@@ -138,6 +138,14 @@ typedef enum WILDDOG_EVENTTYPE_T
     WD_ET_CHILDMOVED  = 0x10,
 }Wilddog_EventType_T;
 
+typedef enum WILDDOG_SENDMODE_T
+{
+    WILDDOG_SENDMODE_CON = 0,//confirmable, retransmitted until responded.
+    WILDDOG_SENDMODE_NON = 1,//non-confirmable, sent once, no response.
+    WILDDOG_SENDMODE_COALESCE = 2,//confirmable, one set in flight per path, 
+                                  //newer sets replace the unsent one.
+}Wilddog_SendMode_T;
+
 typedef enum WILDDOG_RETURN_T
 {
 /*****************client inner error*******************/
@@ -198,6 +206,23 @@ typedef struct
     u16 port;
 } Wilddog_Address_T;
 
+typedef struct WILDDOG_METRICS_T
+{
+    u32 d_rto;//current retransmit timeout, ms.
+    u32 d_srtt;//smoothed rtt, ms, 0 if not measured yet.
+    u32 d_rttvar;//rtt variance, ms.
+    u32 d_lastRtt;//the last rtt measured, ms.
+    u32 d_rttSamples;//how many rtt measured.
+    u32 d_retransmits;//how many packets retransmitted.
+    u32 d_window;//how many requests can wait for response at once.
+    u32 d_inflight;//requests sent and waiting for response.
+    u32 d_queued;//requests not sent yet, waiting for the window or session.
+    u32 d_queuedBytes;//value bytes of the requests sent or not, not responded.
+    u32 d_oldestAge;//ms since the oldest request not responded was made.
+    u32 d_maxCount;//budget of the requests and observers kept.
+    u32 d_maxBytes;//budget of d_queuedBytes.
+}Wilddog_Metrics_T;
+
 typedef struct WILDDOG_NODE
 {
     struct WILDDOG_NODE *p_wn_next, *p_wn_prev;
@@ -235,6 +260,11 @@ typedef void (*onPushFunc)
     Wilddog_Return_T err
     );
 
+typedef void (*onQueueLowFunc)
+    (
+    void* arg
+    );
+
 typedef onSetFunc onRemoveFunc;
 typedef onSetFunc onAuthFunc;
 typedef onQueryFunc onEventFunc;
@@ -31,7 +31,9 @@ extern "C" {
  * Description: Optional, user defined time increase. Because SDK need a 
  *              time to ageing request packets, if you have a requirement
  *              in accuracy,  you should call this func, in a timer or other 
- *              methods.
+ *              methods. If the platform provides a monotonic clock (see
+ *              wilddog_getMonotonicTime in wilddog_port.h), SDK uses it 
+ *              and you needn't call this func.
  * Input:       ms: time want to increase, in mili second
  * Output:      N/A
  * Return:      N/A
@@ -171,6 +173,141 @@ extern Wilddog_Return_T wilddog_push
     onPushFunc callback, 
     void* arg
     );
+/*
+ * Function:    wilddog_update
+ * Description: Merge the children of the node into the path of the client, 
+ *              by one request, the children not in the node are kept.
+ * Input:       wilddog: Id of the client.
+ *              p_node: a point to an object node(Wilddog_Node_T structure) 
+ *                      with the children to update, can free after this 
+ *                      function.
+ *              callback: the callback function called when the server returns 
+ *                      a response or send fail.
+ *              args: the arg defined by user, if you do not need, can be NULL.
+ * Output:      N/A
+ * Return:      0 means succeed, negative number means failed.
+*/
+extern Wilddog_Return_T wilddog_update
+    (
+    Wilddog_T wilddog,
+    Wilddog_Node_T *p_node,
+    onSetFunc callback, 
+    void* arg
+    );
+/*
+ * Function:    wilddog_setValueNon
+ * Description: Post the data of the client to server once, as non-confirmable,
+ *              no retransmission and no response, for high rate telemetry.
+ * Input:       wilddog: Id of the client.
+ *              p_node: a point to node(Wilddog_Node_T structure), you can
+ *                      create a node tree by call node APIs.
+ *              callback: the callback function called only when send fail
+ *                      locally, can be NULL.
+ *              args: the arg defined by user, if you do not need, can be NULL.
+ * Output:      N/A
+ * Return:      0 means sent, negative number means failed.
+*/
+extern Wilddog_Return_T wilddog_setValueNon
+    (
+    Wilddog_T wilddog,
+    Wilddog_Node_T *p_node,
+    onSetFunc callback,
+    void* arg
+    );
+/*
+ * Function:    wilddog_pushNon
+ * Description: Push the data of the client to server once, as non-confirmable,
+ *              no retransmission and no response, so the new path is unknown.
+ * Input:       wilddog: Id of the client.
+ *              p_node: a point to node(Wilddog_Node_T structure), you can 
+ *                      create a node tree by call node APIs.
+ *              callback: the callback function called only when send fail
+ *                      locally, can be NULL.
+ *              args: the arg defined by user, if you do not need, can be NULL.
+ * Output:      N/A
+ * Return:      0 means sent, negative number means failed.
+*/
+extern Wilddog_Return_T wilddog_pushNon
+    (
+    Wilddog_T wilddog,
+    Wilddog_Node_T *p_node,
+    onPushFunc callback, 
+    void* arg
+    );
+/*
+ * Function:    wilddog_setSendMode
+ * Description: Set how wilddog_setValue and wilddog_push of the client are 
+ *              sent, WILDDOG_SENDMODE_CON by default. in WILDDOG_SENDMODE_NON
+ *              they work as wilddog_setValueNon and wilddog_pushNon. in 
+ *              WILDDOG_SENDMODE_COALESCE a wilddog_setValue waits until the
+ *              last one of the client is responded, and a newer one 
+ *              replaces it, the callbacks of both are called.
+ * Input:       wilddog: Id of the client.
+ *              mode: the send mode.
+ * Output:      N/A
+ * Return:      0 means succeed, negative number means failed.
+*/
+extern Wilddog_Return_T wilddog_setSendMode
+    (
+    Wilddog_T wilddog,
+    Wilddog_SendMode_T mode
+    );
+/*
+ * Function:    wilddog_getMetrics
+ * Description: Get the metrics of the connection the client uses, such as
+ *              the retransmit timeout adapted to the measured rtt, and
+ *              how many requests are in flight and queued.
+ * Input:       wilddog: Id of the client.
+ * Output:      p_metrics: the metrics.
+ * Return:      0 means succeed, negative number means failed.
+*/
+extern Wilddog_Return_T wilddog_getMetrics
+    (
+    Wilddog_T wilddog,
+    Wilddog_Metrics_T *p_metrics
+    );
+/*
+ * Function:    wilddog_setQueueBudget
+ * Description: Set the budget of the connection the client uses. Once the
+ *              requests and observers kept are more than maxCount, or the 
+ *              values of the requests not responded would be more than 
+ *              maxBytes, new requests fail with WILDDOG_ERR_QUEUEFULL. A
+ *              value larger than maxBytes is accepted if no value is kept.
+ * Input:       wilddog: Id of the client.
+ *              maxCount: the count budget, 0 means WILDDOG_REQ_QUEUE_NUM.
+ *              maxBytes: the byte budget, 0 means WILDDOG_REQ_QUEUE_BYTES.
+ * Output:      N/A
+ * Return:      0 means succeed, negative number means failed.
+*/
+extern Wilddog_Return_T wilddog_setQueueBudget
+    (
+    Wilddog_T wilddog,
+    u32 maxCount,
+    u32 maxBytes
+    );
+/*
+ * Function:    wilddog_setQueueLowWater
+ * Description: Set the low-water mark of the connection the client uses. 
+ *              When the requests not responded fall to lowCount and their
+ *              values to lowBytes, after they were above either, onLow is
+ *              called once by wilddog_trySync(). A producer stopped by 
+ *              WILDDOG_ERR_QUEUEFULL can go on in onLow instead of polling.
+ * Input:       wilddog: Id of the client.
+ *              lowCount: the requests, sent or not, not responded.
+ *              lowBytes: the value bytes of those requests.
+ *              onLow: the callback, NULL to remove it.
+ *              arg: the arg defined by user, if you do not need, can be NULL.
+ * Output:      N/A
+ * Return:      0 means succeed, negative number means failed.
+*/
+extern Wilddog_Return_T wilddog_setQueueLowWater
+    (
+    Wilddog_T wilddog,
+    u32 lowCount,
+    u32 lowBytes,
+    onQueueLowFunc onLow,
+    void* arg
+    );
 /*
  * Function:    wilddog_removeValue
  * Description: Remove the data of the client from server.
@@ -326,7 +463,9 @@ extern Wilddog_Return_T wilddog_goOnline(void);
  *              p_auth: the auth data
  *              len: the auth data length
  *              onAuth: the callback function called when the server returns 
- *                      a response or send fail.
+ *                      a response or send fail, or before wilddog_auth 
+ *                      returns if the saved session of the same auth data
+ *                      is reused, see WILDDOG_SESSION_PATH.
  *              args: the arg defined by user, if you do not need, can be NULL.
  * Output:      N/A
  * Return:      0 means succeed, negative number means failed.
@@ -366,6 +505,65 @@ extern Wilddog_Return_T wilddog_unauth
 */
 extern void wilddog_trySync(void);
 
+/*
+ * Function:    wilddog_getFds
+ * Description: Optional, instead of calling wilddog_trySync in a loop, an 
+ *              event loop (epoll, libuv...) waits for these sockets to be 
+ *              readable, or for wilddog_getNextTimeout, then calls 
+ *              wilddog_processFd. The sockets may change after any wilddog
+ *              call, get them again before each wait.
+ * Input:       maxNum: the size of fds.
+ * Output:      fds: the sockets SDK is waiting on.
+ * Return:      the number of sockets stored in fds.
+*/
+extern int wilddog_getFds(int *fds, int maxNum);
+
+/*
+ * Function:    wilddog_getNextTimeout
+ * Description: Optional, get how long the event loop can wait before 
+ *              calling wilddog_processFd(-1), for retransmit, timeout, 
+ *              ping and session retry.
+ * Input:       N/A
+ * Output:      N/A
+ * Return:      the time in ms, 0 means process now, -1 means no deadline.
+*/
+extern s32 wilddog_getNextTimeout(void);
+
+/*
+ * Function:    wilddog_processFd
+ * Description: Optional, handle a readable socket got from wilddog_getFds,
+ *              and everything due, it never waits.
+ * Input:       fd: the readable socket, -1 if the timeout expired.
+ * Output:      N/A
+ * Return:      0 means succeed, negative number means failed.
+*/
+extern Wilddog_Return_T wilddog_processFd(int fd);
+
+/*
+ * Function:    wilddog_startThread
+ * Description: Optional, start the threaded mode. SDK creates an i/o thread
+ *              which syncs by itself, then APIs can be called from any 
+ *              thread: requests whose result comes by callback are queued 
+ *              and return at once, others wait for the i/o thread. All 
+ *              callbacks are called in the i/o thread. Must be called 
+ *              before other threads use the SDK.
+ * Input:       N/A
+ * Output:      N/A
+ * Return:      0 means succeed, negative number means failed, such as the
+ *              platform do not support threads.
+*/
+extern Wilddog_Return_T wilddog_startThread(void);
+
+/*
+ * Function:    wilddog_stopThread
+ * Description: Stop the threaded mode, requests already queued are done 
+ *              before the i/o thread exits. Must not be called in callbacks.
+ * Input:       N/A
+ * Output:      N/A
+ * Return:      0 means succeed, negative number means failed.
+*/
+extern Wilddog_Return_T wilddog_stopThread(void);
+
 
 
 /*****************************************************************************\
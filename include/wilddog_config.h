@@ -35,17 +35,173 @@ extern "C"
 #define WILDDOG_REQ_QUEUE_NUM 100000
 #endif
 /*
+* define the maximum bytes of the values kept by the requests per connection, a value larger
+* than it is only accepted when the queue is empty. wilddog_setQueueBudget() changes both.
+*/
+#ifndef WILDDOG_REQ_QUEUE_BYTES
+#define WILDDOG_REQ_QUEUE_BYTES 4194304
+#endif
+/*
 * define the maximum transmit time, in ms
 */
 #ifndef WILDDOG_RETRANSMITE_TIME
 #define WILDDOG_RETRANSMITE_TIME 10000
 #endif
 /*
+* define the retransmit timeout before any rtt is measured, and its bounds, in ms.
+* the timeout adapts to the rtt measured from responses, per connection.
+*/
+#ifndef WILDDOG_RTO_INIT
+#define WILDDOG_RTO_INIT 2000
+#endif
+#ifndef WILDDOG_RTO_MIN
+#define WILDDOG_RTO_MIN 200
+#endif
+#ifndef WILDDOG_RTO_MAX
+#define WILDDOG_RTO_MAX 32000
+#endif
+/*
+* define how many requests can wait for response at once per connection (NSTART),
+* and how large the window can grow, the others are queued and sent as responses come.
+*/
+#ifndef WILDDOG_WINDOW_INIT
+#define WILDDOG_WINDOW_INIT 4
+#endif
+#ifndef WILDDOG_WINDOW_MAX
+#define WILDDOG_WINDOW_MAX 32
+#endif
+/*
+* define the encoded value size, in bytes, above which a set, push or update is bulk
+* traffic, it is sent after the other requests and never takes the last slot of the window.
+*/
+#ifndef WILDDOG_CONN_BULK_SIZE
+#define WILDDOG_CONN_BULK_SIZE 1024
+#endif
+/*
+* define the path prefix of the files the session is saved in, the host is appended, so
+* a restarted client reuses the session instead of waiting for auth, "" not save it.
+*/
+#ifndef WILDDOG_SESSION_PATH
+#define WILDDOG_SESSION_PATH ""
+#endif
+/*
 * define the maximum receive time per host during one wilddog_trySync() period, in ms
 */
 #ifndef WILDDOG_RECEIVE_TIMEOUT
 #define WILDDOG_RECEIVE_TIMEOUT 10
 #endif
+/*
+* define the maximum ready sockets reported by one wait during wilddog_trySync().
+*/
+#ifndef WILDDOG_SYNC_MAX_EVENTS
+#define WILDDOG_SYNC_MAX_EVENTS 64
+#endif
+/*
+* define the maximum packets handled per host during one wilddog_trySync() period.
+*/
+#ifndef WILDDOG_SYNC_RECV_BUDGET
+#define WILDDOG_SYNC_RECV_BUDGET 32
+#endif
+/*
+* define how many datagrams can be got by one batched receive, and the size of
+* each staged datagram, the part of a larger one is kept in a spill buffer of the
+* batch, only when two such datagrams come in one batch the earlier is dropped.
+*/
+#ifndef WILDDOG_RECV_BATCH_NUM
+#define WILDDOG_RECV_BATCH_NUM 16
+#endif
+#ifndef WILDDOG_RECV_BATCH_SLOTSIZE
+#define WILDDOG_RECV_BATCH_SLOTSIZE 1536
+#endif
+/*
+* define how many datagrams and bytes can be staged during one wilddog_trySync()
+* period, they are sent together at the end, larger datagrams are sent at once.
+*/
+#ifndef WILDDOG_SEND_STAGE_NUM
+#define WILDDOG_SEND_STAGE_NUM 32
+#endif
+#ifndef WILDDOG_SEND_STAGE_SIZE
+#define WILDDOG_SEND_STAGE_SIZE 32768
+#endif
+/*
+* define how long a resolved host address is reused, in ms, if the port layer 
+* do not know the record's ttl, and how long a failed resolving is remembered.
+*/
+#ifndef WILDDOG_DNS_CACHE_TTL
+#define WILDDOG_DNS_CACHE_TTL 300000
+#endif
+#ifndef WILDDOG_DNS_NEGATIVE_TTL
+#define WILDDOG_DNS_NEGATIVE_TTL 30000
+#endif
+/*
+* define how long the first connect to a host waits for its background 
+* resolving, in ms, then wilddog_gethostbyname is used, the default ip is used 
+* only if the host can not be resolved.
+*/
+#ifndef WILDDOG_DNS_INIT_WAIT
+#define WILDDOG_DNS_INIT_WAIT 2000
+#endif
+/*
+* define the maximum addresses kept for a host, IPv4 and IPv6.
+*/
+#ifndef WILDDOG_DNS_MAX_ADDR
+#define WILDDOG_DNS_MAX_ADDR 8
+#endif
+/*
+* define the Happy Eyeballs race when a host has several addresses, a coap 
+* ping is sent to the next address every WILDDOG_RACE_DELAY ms, and the first
+* one replied within WILDDOG_RACE_TIMEOUT ms is used, the first connect waits
+* for it. The pings are sent to WILDDOG_PORT, the port of the session, define
+* WILDDOG_RACE_PROBE_PORT to probe another port.
+*/
+#ifndef WILDDOG_RACE_DELAY
+#define WILDDOG_RACE_DELAY 250
+#endif
+#ifndef WILDDOG_RACE_TIMEOUT
+#define WILDDOG_RACE_TIMEOUT 1000
+#endif
+/*
+* define the path mtu and the ip/udp/dtls bytes of one datagram, coap payloads 
+* which can not fit are transferred block by block (rfc7959), blocks are the 
+* largest power of two fits, at most 1024 bytes.
+*/
+#ifndef WILDDOG_PATH_MTU
+#define WILDDOG_PATH_MTU 1280
+#endif
+#ifndef WILDDOG_PATH_OVERHEAD
+#define WILDDOG_PATH_OVERHEAD 80
+#endif
+/*
+* define how many blocks can be in flight during one blockwise transfer, 1~32,
+* 1 means one block per round trip.
+*/
+#ifndef WILDDOG_COAP_BLOCK_WINDOW
+#define WILDDOG_COAP_BLOCK_WINDOW 4
+#endif
+/*
+* define the largest datagram can be received, large values come block by 
+* block, so it can shrink to WILDDOG_PATH_MTU if the server always uses 
+* blockwise transfer. receive buffers are taken from a pool shared by all 
+* repos, sized by the datagram, so a buffer this large is malloced only when 
+* such a datagram comes, or when the platform can not tell the size.
+*/
+#ifndef WILDDOG_PROTO_RECV_SIZE
+#define WILDDOG_PROTO_RECV_SIZE WILDDOG_PROTO_MAXSIZE
+#endif
+/*
+* define how many free receive buffers of each size are kept for reuse.
+*/
+#ifndef WILDDOG_PROTO_RECV_POOL_NUM
+#define WILDDOG_PROTO_RECV_POOL_NUM 2
+#endif
+/*
+* define the largest value, in encoded bytes, kept per path after a get, the 
+* next get of the path sends its etag, and the kept value is reused if the 
+* server answers it is not changed. 0 means values are never kept.
+*/
+#ifndef WILDDOG_GET_SNAPSHOT_MAXSIZE
+#define WILDDOG_GET_SNAPSHOT_MAXSIZE 4096
+#endif
 
 #ifdef __cplusplus
 }
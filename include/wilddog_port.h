@@ -16,8 +16,72 @@ extern "C"
 #include "wilddog.h"
 
 int wilddog_gethostbyname(Wilddog_Address_T* addr,char* host);
+
+/*
+ * non-blocking host resolving. wilddog_resolveStart return a query, NULL 
+ * means the platform can not resolve in background, sdk will use 
+ * wilddog_gethostbyname instead.
+ * wilddog_resolvePoll wait the query at most timeout ms, return 0 still in
+ * progress; >0 resolved, the number of IPv4(len 4) and IPv6(len 16) 
+ * addresses stored in addrs, p_ttl is the record's ttl in second, 0 if 
+ * unknown; <0 failed. The query is freed when it do not return 0.
+ * wilddog_resolveCancel free a query in progress.
+ */
+void* wilddog_resolveStart(char* host);
+int wilddog_resolvePoll
+    (
+    void* query,
+    Wilddog_Address_T* addrs,
+    int maxNum,
+    u32* p_ttl,
+    s32 timeout
+    );
+void wilddog_resolveCancel(void* query);
+
+/*
+ * Happy Eyeballs, send the probe to addrs one by one, every delay ms, in the
+ * given order, and wait at most timeout ms for the first reply.
+ * return the index of the address replied first, <0 no one replied or the
+ * platform do not support it.
+ */
+int wilddog_raceAddress
+    (
+    Wilddog_Address_T* addrs,
+    int num,
+    void* probe,
+    s32 probeLen,
+    s32 delay,
+    s32 timeout
+    );
+
+/*
+ * wilddog_raceAddress in background. wilddog_raceStart return a race, NULL 
+ * means the platform can not race in background, sdk will use the first 
+ * address. wilddog_racePoll never wait, return 0 still in progress; 1 
+ * finished, p_winner is the index replied first or <0, the race is freed.
+ * wilddog_raceCancel free a race in progress.
+ */
+void* wilddog_raceStart
+    (
+    Wilddog_Address_T* addrs,
+    int num,
+    void* probe,
+    s32 probeLen,
+    s32 delay,
+    s32 timeout
+    );
+int wilddog_racePoll(void* race, int* p_winner);
+void wilddog_raceCancel(void* race);
 int wilddog_openSocket(int* socketId);
 int wilddog_closeSocket(int socketId);
+
+/*
+ * connect the socket to the server, so wilddog_send and wilddog_receive with
+ * this address need not build or filter it. it is called again when the
+ * server address changes.
+ * return <0 the platform do not support it, the socket is used unconnected.
+ */
+int wilddog_connectSocket(int socketId, Wilddog_Address_T* addr);
 int wilddog_send
     (
     int socketId,
@@ -39,6 +103,91 @@ int wilddog_receive
     s32 timeout
     );
 
+/*
+ * monotonic clock provider, in ms, it must never go backwards.
+ * return <0 the platform has no such clock, sdk will simulate the time by
+ * wilddog_trySync() and wilddog_increaseTime().
+ */
+int wilddog_getMonotonicTime(u32* p_ms);
+
+/*
+ * return the number of datagrams which can be got by wilddog_receive
+ * without waiting, 0 means the next wilddog_receive may block.
+ */
+int wilddog_receivePending(int socketId);
+
+/*
+ * wait for the next datagram and return its length without reading it,
+ * the next wilddog_receive gets it with a buffer of that length.
+ * return <0 nothing arrived; 0 the length is unknown (or the datagram is 
+ * empty), caller reads it with its largest buffer.
+ */
+int wilddog_receiveSize(int socketId, s32 timeout);
+
+/*
+ * send staging, datagrams sent by wilddog_send between wilddog_sendStageBegin 
+ * and wilddog_sendStageFlush may be kept and sent together when flush.
+ * wilddog_sendStageBegin return <0 means the platform do not support it,
+ * wilddog_sendStageFlush return the number of datagrams sent, and
+ * wilddog_sendStageCount return the number of datagrams still staged.
+ */
+int wilddog_sendStageBegin(void);
+int wilddog_sendStageFlush(void);
+int wilddog_sendStageCount(void);
+
+/*
+ * session persistence, the sdk saves the session got by auth, and reuses it
+ * after a restart instead of waiting for a new one.
+ * wilddog_sessionSave store len bytes of data for the host, len 0 erases
+ * it, return <0 failed or the platform do not support it.
+ * wilddog_sessionLoad return <0 nothing saved or the platform do not
+ * support it, else the length of the data copied to data.
+ */
+int wilddog_sessionSave(char* host, void* data, s32 len);
+int wilddog_sessionLoad(char* host, void* data, s32 maxLen);
+
+/*
+ * wait once for all the sockets opened by wilddog_openSocket.
+ * return <0 the platform do not support it, caller must fall back to
+ * wilddog_receive; >=0 the number of ready socket ids stored in readyIds.
+ */
+int wilddog_waitSockets
+    (
+    int* readyIds,
+    s32 maxNum,
+    s32 timeout
+    );
+
+/*
+ * make a wilddog_waitSockets in progress, or the next one, return at once,
+ * it can be called from any thread.
+ * return <0 the platform do not support it.
+ */
+int wilddog_wakeupWait(void);
+
+/*
+ * threads and semaphores for the sdk i/o thread, see wilddog_startThread().
+ * wilddog_threadCreate return <0 the platform do not support threads, then
+ * the sdk can only be used in one thread.
+ */
+typedef void (*Wilddog_Thread_Func_T)(void* arg);
+
+int wilddog_threadCreate
+    (
+    void** p_thread,
+    Wilddog_Thread_Func_T func,
+    void* arg
+    );
+int wilddog_threadJoin(void* thread);
+/*return 1 if the caller is running in the thread, else return 0.*/
+int wilddog_threadIsSelf(void* thread);
+
+/*counting semaphore, start with 0, wilddog_semCreate return NULL if failed.*/
+void* wilddog_semCreate(void);
+void wilddog_semWait(void* sem);
+void wilddog_semPost(void* sem);
+void wilddog_semDestroy(void* sem);
+
 #ifdef __cplusplus
 }
 #endif
@@ -12,6 +12,9 @@
  *
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -24,11 +27,579 @@
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <assert.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <fcntl.h>
 #include "wilddog_port.h"
 #include "wilddog_config.h"
 #include "wilddog_endian.h"
+#include "wilddog_common.h"
+#include "utlist.h"
 #include "test_lib.h"
 
+/*
+ * the largest datagram can be staged, the part of a datagram larger than a 
+ * slot is received into the spill buffer, shared by the slots of a batch.
+*/
+#if WILDDOG_PROTO_RECV_SIZE < 65536
+#define WILDDOG_RECV_BATCH_SPILLSIZE (WILDDOG_PROTO_RECV_SIZE)
+#else
+#define WILDDOG_RECV_BATCH_SPILLSIZE (65536)
+#endif
+
+/*
+ * datagrams pulled by one recvmmsg but not yet read by wilddog_receive, 
+ * and the socket's state kept to save syscalls.
+*/
+typedef struct WILDDOG_RECV_BATCH_T
+{
+    struct WILDDOG_RECV_BATCH_T *next;
+    int socketId;
+    int d_num;
+    int d_pos;
+    BOOL isFull;
+    BOOL isConnected;//connected to d_peer, the kernel filters the source
+    Wilddog_Address_T d_peer;
+    s32 d_timeout;//the SO_RCVTIMEO set, -1 if never set
+    int d_family;//AF_INET6 dual-stack or AF_INET, AF_UNSPEC if unknown
+    struct sockaddr_storage d_addr[WILDDOG_RECV_BATCH_NUM];
+    int d_len[WILDDOG_RECV_BATCH_NUM];
+    u8 d_slot[WILDDOG_RECV_BATCH_NUM][WILDDOG_RECV_BATCH_SLOTSIZE];
+    int d_spill;//the slot whose tail is in p_spill, -1 if none.
+    u8 *p_spill;
+}Wilddog_Recv_Batch_T;
+
+/*datagrams sent during a staging period, flushed by sendmmsg.*/
+typedef struct WILDDOG_SEND_STAGE_T
+{
+    BOOL isStaging;
+    int d_num;
+    u32 d_used;
+    int d_socketId[WILDDOG_SEND_STAGE_NUM];
+    struct sockaddr_storage d_addr[WILDDOG_SEND_STAGE_NUM];
+    socklen_t d_addrLen[WILDDOG_SEND_STAGE_NUM];
+    u32 d_offset[WILDDOG_SEND_STAGE_NUM];
+    u32 d_len[WILDDOG_SEND_STAGE_NUM];
+    u8 d_buf[WILDDOG_SEND_STAGE_SIZE];
+}Wilddog_Send_Stage_T;
+
+/*a host resolving in background, shared by the resolver thread and sdk.*/
+typedef struct WILDDOG_RESOLVE_T
+{
+    char *p_host;
+    int d_state;//1 in progress, 0 resolved, -1 failed
+    int d_refs;
+    int d_num;
+    Wilddog_Address_T d_addr[WILDDOG_DNS_MAX_ADDR];
+}Wilddog_Resolve_T;
+
+/*an address race in background, shared by the race thread and sdk.*/
+typedef struct WILDDOG_RACE_T
+{
+    int d_state;//1 in progress, 0 finished
+    int d_refs;
+    int d_winner;
+    int d_num;
+    Wilddog_Address_T d_addr[WILDDOG_DNS_MAX_ADDR];
+    u8 *p_probe;
+    s32 d_probeLen;
+    s32 d_delay;
+    s32 d_timeout;
+}Wilddog_Race_T;
+
+/*a thread created by wilddog_threadCreate.*/
+typedef struct WILDDOG_THREAD_T
+{
+    pthread_t d_tid;
+    Wilddog_Thread_Func_T f_func;
+    void *p_arg;
+}Wilddog_Thread_T;
+
+/*all sockets opened by wilddog_openSocket are registered in this epoll set.*/
+STATIC int l_wilddog_epollFd = -1;
+/*eventfd in the epoll set, written by wilddog_wakeupWait.*/
+STATIC int l_wilddog_wakeFd = -1;
+STATIC Wilddog_Recv_Batch_T *l_wilddog_recvBatch = NULL;
+STATIC Wilddog_Send_Stage_T l_wilddog_sendStage;
+
+/*
+ * Function:    _wilddog_socket_create
+ * Description: create a dual-stack udp socket, IPv4 addresses are reached by 
+ *              v4-mapped IPv6 addresses, if IPv6 is not supported, create 
+ *              an IPv4 socket.
+ * Input:       N/A
+ * Output:      p_family: The family of the socket.
+ * Return:      The socket, or -1 if failed.
+*/
+STATIC int _wilddog_socket_create(int *p_family)
+{
+    int fd, off = 0;
+
+    fd = socket(AF_INET6, SOCK_DGRAM, 0);
+    if(fd >= 0)
+    {
+        if(0 == setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off)))
+        {
+            *p_family = AF_INET6;
+            return fd;
+        }
+        close(fd);
+    }
+    *p_family = AF_INET;
+    return socket(AF_INET, SOCK_DGRAM, 0);
+}
+
+/*
+ * Function:    _wilddog_addr_toSock
+ * Description: convert the address to the socket's family.
+ * Input:       family: The family of the socket.
+ *              addr: The pointer of the Wilddog_Address_T.
+ * Output:      p_sa: The socket address.
+ *              p_len: The length of the socket address.
+ * Return:      If success, return 0; else return -1.
+*/
+STATIC int _wilddog_addr_toSock
+    (
+    int family,
+    Wilddog_Address_T *addr,
+    struct sockaddr_storage *p_sa,
+    socklen_t *p_len
+    )
+{
+    STATIC const u8 v4mapped[12] = {0,0,0,0,0,0,0,0,0,0,0xff,0xff};
+
+    memset(p_sa, 0, sizeof(struct sockaddr_storage));
+    if(AF_INET6 == family && (4 == addr->len || 16 == addr->len))
+    {
+        struct sockaddr_in6 *p_sin6 = (struct sockaddr_in6*)p_sa;
+        p_sin6->sin6_family = AF_INET6;
+        p_sin6->sin6_port = wilddog_htons(addr->port);
+        if(4 == addr->len)
+        {
+            memcpy(p_sin6->sin6_addr.s6_addr, v4mapped, 12);
+            memcpy(&p_sin6->sin6_addr.s6_addr[12], addr->ip, 4);
+        }
+        else
+            memcpy(p_sin6->sin6_addr.s6_addr, addr->ip, 16);
+        *p_len = sizeof(struct sockaddr_in6);
+        return 0;
+    }
+    if(AF_INET == family)
+    {
+        struct sockaddr_in *p_sin = (struct sockaddr_in*)p_sa;
+        p_sin->sin_family = AF_INET;
+        p_sin->sin_port = wilddog_htons(addr->port);
+        if(4 == addr->len)
+            memcpy(&p_sin->sin_addr.s_addr, addr->ip, 4);
+        else if(16 == addr->len && 0 == memcmp(addr->ip, v4mapped, 12))
+            memcpy(&p_sin->sin_addr.s_addr, &addr->ip[12], 4);
+        else
+            return -1;
+        *p_len = sizeof(struct sockaddr_in);
+        return 0;
+    }
+    return -1;
+}
+
+/*
+ * Function:    _wilddog_addr_fromSock
+ * Description: convert the socket address, v4-mapped address become IPv4.
+ * Input:       p_sa: The socket address.
+ * Output:      addr: The pointer of the Wilddog_Address_T.
+ * Return:      If success, return 0; else return -1.
+*/
+STATIC int _wilddog_addr_fromSock
+    (
+    const struct sockaddr_storage *p_sa,
+    Wilddog_Address_T *addr
+    )
+{
+    if(AF_INET == p_sa->ss_family)
+    {
+        const struct sockaddr_in *p_sin = (const struct sockaddr_in*)p_sa;
+        addr->len = 4;
+        memcpy(addr->ip, &p_sin->sin_addr.s_addr, 4);
+        addr->port = wilddog_ntohs(p_sin->sin_port);
+        return 0;
+    }
+    if(AF_INET6 == p_sa->ss_family)
+    {
+        const struct sockaddr_in6 *p_sin6 = (const struct sockaddr_in6*)p_sa;
+        if(IN6_IS_ADDR_V4MAPPED(&p_sin6->sin6_addr))
+        {
+            addr->len = 4;
+            memcpy(addr->ip, &p_sin6->sin6_addr.s6_addr[12], 4);
+        }
+        else
+        {
+            addr->len = 16;
+            memcpy(addr->ip, p_sin6->sin6_addr.s6_addr, 16);
+        }
+        addr->port = wilddog_ntohs(p_sin6->sin6_port);
+        return 0;
+    }
+    return -1;
+}
+
+/*
+ * Function:    _wilddog_addr_match
+ * Description: whether the datagram comes from the address.
+ * Input:       addr: The pointer of the Wilddog_Address_T.
+ *              p_sa: The source address of the datagram.
+ * Output:      N/A
+ * Return:      TRUE or FALSE.
+*/
+STATIC BOOL _wilddog_addr_match
+    (
+    const Wilddog_Address_T *addr,
+    const struct sockaddr_storage *p_sa
+    )
+{
+    Wilddog_Address_T from;
+
+    if(_wilddog_addr_fromSock(p_sa, &from) < 0)
+        return FALSE;
+    if(from.len != addr->len || from.port != addr->port || \
+       memcmp(from.ip, addr->ip, addr->len))
+        return FALSE;
+    return TRUE;
+}
+
+/*
+ * Function:    _wilddog_recvBatch_find
+ * Description: find the receive batch of the socket.
+ * Input:       socketId: The socket id.
+ * Output:      N/A
+ * Return:      The pointer of the batch, or NULL if not found.
+*/
+STATIC Wilddog_Recv_Batch_T *_wilddog_recvBatch_find(int socketId)
+{
+    Wilddog_Recv_Batch_T *p_batch = NULL;
+    
+    LL_SEARCH_SCALAR(l_wilddog_recvBatch, p_batch, socketId, socketId);
+    return p_batch;
+}
+
+/*
+ * Function:    _wilddog_recvBatch_get
+ * Description: find the receive batch of the socket, create it if not found.
+ * Input:       socketId: The socket id.
+ * Output:      N/A
+ * Return:      The pointer of the batch, or NULL if malloc failed.
+*/
+STATIC Wilddog_Recv_Batch_T *_wilddog_recvBatch_get(int socketId)
+{
+    Wilddog_Recv_Batch_T *p_batch = _wilddog_recvBatch_find(socketId);
+
+    if(p_batch)
+        return p_batch;
+    p_batch = (Wilddog_Recv_Batch_T*)wmalloc(sizeof(Wilddog_Recv_Batch_T));
+    if(!p_batch)
+        return NULL;
+    p_batch->p_spill = (u8*)wmalloc(WILDDOG_RECV_BATCH_SPILLSIZE);
+    if(!p_batch->p_spill)
+    {
+        wfree(p_batch);
+        return NULL;
+    }
+    p_batch->d_spill = -1;
+    p_batch->socketId = socketId;
+    p_batch->d_timeout = -1;
+    LL_APPEND(l_wilddog_recvBatch, p_batch);
+    return p_batch;
+}
+
+/*
+ * Function:    _wilddog_socket_family
+ * Description: get the family of the socket, stored when it is opened, a 
+ *              socket not opened by wilddog_openSocket asks the kernel once.
+ * Input:       p_batch: The pointer of the batch, can be NULL.
+ *              socketId: The socket id.
+ * Output:      N/A
+ * Return:      AF_INET6 or AF_INET.
+*/
+STATIC int _wilddog_socket_family(Wilddog_Recv_Batch_T *p_batch, int socketId)
+{
+    int family = AF_INET;
+    socklen_t optLen = sizeof(family);
+
+    if(p_batch && AF_UNSPEC != p_batch->d_family)
+        return p_batch->d_family;
+    getsockopt(socketId, SOL_SOCKET, SO_DOMAIN, &family, &optLen);
+    if(p_batch)
+        p_batch->d_family = family;
+    return family;
+}
+
+/*
+ * Function:    _wilddog_recvBatch_isPeer
+ * Description: whether the socket is connected to the address, so the 
+ *              address need not be built or checked.
+ * Input:       p_batch: The pointer of the batch, can be NULL.
+ *              addr: The pointer of the Wilddog_Address_T.
+ * Output:      N/A
+ * Return:      TRUE or FALSE.
+*/
+STATIC BOOL _wilddog_recvBatch_isPeer
+    (
+    const Wilddog_Recv_Batch_T *p_batch,
+    const Wilddog_Address_T *addr
+    )
+{
+    if(!p_batch || FALSE == p_batch->isConnected)
+        return FALSE;
+    if(addr->len != p_batch->d_peer.len || addr->port != p_batch->d_peer.port \
+       || memcmp(addr->ip, p_batch->d_peer.ip, addr->len))
+        return FALSE;
+    return TRUE;
+}
+
+/*
+ * Function:    _wilddog_recvBatch_fill
+ * Description: pull datagrams with one recvmmsg into the batch, if buf is not
+ *              NULL, the first datagram goes into it directly. A datagram 
+ *              larger than a slot goes on into the spill buffer, so only 
+ *              the last such one of the batch is kept whole.
+ * Input:       p_batch: The pointer of the batch.
+ *              buf: The pointer of the caller's buffer, can be NULL.
+ *              bufLen: The length of buf.
+ *              flags: recvmmsg flags.
+ * Output:      p_remaddr: The source address of the datagram in buf.
+ * Return:      The number of datagrams received, or -1 if failed.
+*/
+STATIC int _wilddog_recvBatch_fill
+    (
+    Wilddog_Recv_Batch_T *p_batch, 
+    void *buf, 
+    s32 bufLen, 
+    struct sockaddr_storage *p_remaddr,
+    int flags
+    )
+{
+    struct mmsghdr msgs[WILDDOG_RECV_BATCH_NUM];
+    struct iovec iovecs[WILDDOG_RECV_BATCH_NUM][2];
+    int i, num, first = buf ? 1 : 0;
+
+    memset(msgs, 0, sizeof(msgs));
+    for(i = 0; i < WILDDOG_RECV_BATCH_NUM; i++)
+    {
+        iovecs[i][0].iov_base = p_batch->d_slot[i];
+        iovecs[i][0].iov_len = WILDDOG_RECV_BATCH_SLOTSIZE;
+        iovecs[i][1].iov_base = p_batch->p_spill;
+        iovecs[i][1].iov_len = WILDDOG_RECV_BATCH_SPILLSIZE;
+        /*connected, all datagrams come from the peer.*/
+        if(FALSE == p_batch->isConnected)
+        {
+            msgs[i].msg_hdr.msg_name = &p_batch->d_addr[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+        }
+        msgs[i].msg_hdr.msg_iov = iovecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 2;
+    }
+    if(buf)
+    {
+        iovecs[0][0].iov_base = buf;
+        iovecs[0][0].iov_len = bufLen;
+        msgs[0].msg_hdr.msg_iovlen = 1;
+        if(FALSE == p_batch->isConnected)
+            msgs[0].msg_hdr.msg_name = p_remaddr;
+    }
+    p_batch->d_num = 0;
+    p_batch->d_pos = 0;
+    p_batch->d_spill = -1;
+    p_batch->isFull = FALSE;
+    
+    num = recvmmsg(p_batch->socketId, msgs, WILDDOG_RECV_BATCH_NUM, flags, NULL);
+    if(num <= 0)
+        return -1;
+    for(i = 0; i < num; i++)
+    {
+        p_batch->d_len[i] = msgs[i].msg_len;
+        if(msgs[i].msg_hdr.msg_flags & MSG_TRUNC)
+        {
+            wilddog_debug_level(WD_DEBUG_WARN, \
+                                "datagram truncated, %d bytes lost!", \
+                                (int)msgs[i].msg_len);
+            p_batch->d_len[i] = -1;
+        }
+        else if(i >= first && msgs[i].msg_len > WILDDOG_RECV_BATCH_SLOTSIZE)
+        {
+            /*the tail of the one before is overwritten.*/
+            if(p_batch->d_spill >= 0)
+            {
+                wilddog_debug_level(WD_DEBUG_WARN, \
+                                    "datagram overwritten, %d bytes lost!", \
+                                    p_batch->d_len[p_batch->d_spill]);
+                p_batch->d_len[p_batch->d_spill] = -1;
+            }
+            p_batch->d_spill = i;
+        }
+    }
+    p_batch->d_num = num;
+    p_batch->d_pos = first;
+    p_batch->isFull = (num == WILDDOG_RECV_BATCH_NUM) ? TRUE : FALSE;
+    return num;
+}
+
+/*
+ * Function:    _wilddog_recvBatch_setTimeout
+ * Description: set the socket's receive timeout, the timeout rarely changes,
+ *              so it is set only when it does.
+ * Input:       p_batch: The pointer of the batch.
+ *              timeout: The max timeout in recv process.
+ * Output:      N/A
+ * Return:      N/A
+*/
+STATIC void _wilddog_recvBatch_setTimeout
+    (
+    Wilddog_Recv_Batch_T *p_batch, 
+    s32 timeout
+    )
+{
+    struct timeval tv;
+
+    if(p_batch->d_timeout == timeout)
+        return;
+    tv.tv_sec = 0;
+    tv.tv_usec = timeout*1000;
+    setsockopt(p_batch->socketId, SOL_SOCKET, SO_RCVTIMEO, \
+               (char *)&tv,sizeof(struct timeval));
+    p_batch->d_timeout = timeout;
+}
+
+/*
+ * Function:    _wilddog_recvBatch_pop
+ * Description: read the next staged datagram which comes from addr.
+ * Input:       p_batch: The pointer of the batch.
+ *              addr: The pointer of the server address.
+ *              buf: The pointer of the receive buffer.
+ *              bufLen: The length of the receive buffer.
+ * Output:      N/A
+ * Return:      The length of the datagram, or -1 if no datagram.
+*/
+STATIC int _wilddog_recvBatch_pop
+    (
+    Wilddog_Recv_Batch_T *p_batch, 
+    Wilddog_Address_T* addr,
+    void* buf,
+    s32 bufLen
+    )
+{
+    while(p_batch->d_pos < p_batch->d_num)
+    {
+        int pos = p_batch->d_pos++;
+        int len = p_batch->d_len[pos];
+        
+        if(len < 0 || len > bufLen)
+            continue;
+        if(TRUE == p_batch->isConnected)
+        {
+            if(FALSE == _wilddog_recvBatch_isPeer(p_batch, addr))
+                continue;
+        }
+        else if(FALSE == _wilddog_addr_match(addr, &p_batch->d_addr[pos]))
+        {
+            wilddog_debug_level(WD_DEBUG_WARN,"ip or port not match!");
+            continue;
+        }
+        if(pos == p_batch->d_spill)
+        {
+            memcpy(buf, p_batch->d_slot[pos], WILDDOG_RECV_BATCH_SLOTSIZE);
+            memcpy((u8*)buf + WILDDOG_RECV_BATCH_SLOTSIZE, p_batch->p_spill, \
+                   len - WILDDOG_RECV_BATCH_SLOTSIZE);
+        }
+        else
+            memcpy(buf, p_batch->d_slot[pos], len);
+        return len;
+    }
+    return -1;
+}
+
+/*
+ * Function:    _wilddog_sendStage_flush
+ * Description: send all staged datagrams, one sendmmsg per socket.
+ * Input:       N/A
+ * Output:      N/A
+ * Return:      The number of datagrams sent.
+*/
+STATIC int _wilddog_sendStage_flush(void)
+{
+    Wilddog_Send_Stage_T *p_stage = &l_wilddog_sendStage;
+    struct mmsghdr msgs[WILDDOG_SEND_STAGE_NUM];
+    struct iovec iovecs[WILDDOG_SEND_STAGE_NUM];
+    BOOL isSent[WILDDOG_SEND_STAGE_NUM];
+    int i, j, num, pos, res, total = 0;
+
+    memset(isSent, 0, sizeof(isSent));
+    for(i = 0; i < p_stage->d_num; i++)
+    {
+        if(isSent[i])
+            continue;
+        /*collect this socket's datagrams, keep the order*/
+        num = 0;
+        memset(msgs, 0, sizeof(msgs));
+        for(j = i; j < p_stage->d_num; j++)
+        {
+            if(isSent[j] || p_stage->d_socketId[j] != p_stage->d_socketId[i])
+                continue;
+            iovecs[num].iov_base = &p_stage->d_buf[p_stage->d_offset[j]];
+            iovecs[num].iov_len = p_stage->d_len[j];
+            /*0 means the socket is connected to the address.*/
+            if(p_stage->d_addrLen[j])
+            {
+                msgs[num].msg_hdr.msg_name = &p_stage->d_addr[j];
+                msgs[num].msg_hdr.msg_namelen = p_stage->d_addrLen[j];
+            }
+            msgs[num].msg_hdr.msg_iov = &iovecs[num];
+            msgs[num].msg_hdr.msg_iovlen = 1;
+            isSent[j] = TRUE;
+            num++;
+        }
+        for(pos = 0; pos < num; pos += res)
+        {
+            res = sendmmsg(p_stage->d_socketId[i], &msgs[pos], num - pos, 0);
+            if(res <= 0)
+            {
+                wilddog_debug_level(WD_DEBUG_WARN, \
+                                    "sendmmsg failed, %d datagrams lost", \
+                                    num - pos);
+                break;
+            }
+            total += res;
+        }
+    }
+    p_stage->d_num = 0;
+    p_stage->d_used = 0;
+    return total;
+}
+
+/*
+ * Function:    _wilddog_sendStage_sync
+ * Description: flush the staged datagrams before the socket is used
+ *              directly or closed.
+ * Input:       socketId: The socket id.
+ * Output:      N/A
+ * Return:      N/A
+*/
+STATIC void _wilddog_sendStage_sync(int socketId)
+{
+    int i;
+
+    for(i = 0; i < l_wilddog_sendStage.d_num; i++)
+    {
+        if(l_wilddog_sendStage.d_socketId[i] == socketId)
+        {
+            _wilddog_sendStage_flush();
+            return;
+        }
+    }
+}
+
 /*
  * Function:    wilddog_gethostbyname
  * Description: wilddog gethostbyname function, it use the interface in posix.
@@ -51,6 +622,414 @@ int wilddog_gethostbyname(Wilddog_Address_T* addr,char* host)
     return 0;
 }
 
+/*
+ * Function:    _wilddog_resolve_release
+ * Description: drop one reference of the query, free it if it is the last.
+ * Input:       p_query: The query.
+ * Output:      N/A
+ * Return:      N/A
+*/
+STATIC void _wilddog_resolve_release(Wilddog_Resolve_T *p_query)
+{
+    if(0 == __atomic_sub_fetch(&p_query->d_refs, 1, __ATOMIC_ACQ_REL))
+    {
+        wfree(p_query->p_host);
+        wfree(p_query);
+    }
+}
+
+/*
+ * Function:    _wilddog_resolve_entry
+ * Description: resolver thread, use the reentrant getaddrinfo.
+ * Input:       arg: The query.
+ * Output:      N/A
+ * Return:      Always return NULL.
+*/
+STATIC void* _wilddog_resolve_entry(void* arg)
+{
+    Wilddog_Resolve_T *p_query = (Wilddog_Resolve_T*)arg;
+    struct addrinfo hints, *p_res = NULL, *p_curr;
+    struct sockaddr_storage sa;
+    Wilddog_Address_T *p_addr;
+    int state = -1, i;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = AI_ADDRCONFIG;
+    if(0 == getaddrinfo(p_query->p_host, NULL, &hints, &p_res))
+    {
+        for(p_curr = p_res; p_curr && p_query->d_num < WILDDOG_DNS_MAX_ADDR; \
+            p_curr = p_curr->ai_next)
+        {
+            if(p_curr->ai_addrlen > sizeof(sa))
+                continue;
+            memset(&sa, 0, sizeof(sa));
+            memcpy(&sa, p_curr->ai_addr, p_curr->ai_addrlen);
+            p_addr = &p_query->d_addr[p_query->d_num];
+            if(_wilddog_addr_fromSock(&sa, p_addr) < 0)
+                continue;
+            for(i = 0; i < p_query->d_num; i++)
+            {
+                if(p_query->d_addr[i].len == p_addr->len && \
+                   0 == memcmp(p_query->d_addr[i].ip, p_addr->ip, p_addr->len))
+                    break;
+            }
+            if(i == p_query->d_num)
+                p_query->d_num++;
+        }
+        if(p_query->d_num > 0)
+            state = 0;
+    }
+    if(p_res)
+        freeaddrinfo(p_res);
+    __atomic_store_n(&p_query->d_state, state, __ATOMIC_RELEASE);
+    _wilddog_resolve_release(p_query);
+    return NULL;
+}
+
+/*
+ * Function:    wilddog_resolveStart
+ * Description: wilddog resolveStart function, resolve the host in a 
+ *              detached thread.
+ * Input:       host: The pointer of host string.
+ * Output:      N/A
+ * Return:      The query, or NULL if failed.
+*/
+void* wilddog_resolveStart(char* host)
+{
+    Wilddog_Resolve_T *p_query;
+    pthread_attr_t attr;
+    pthread_t tid;
+    int res;
+
+    if(!host)
+        return NULL;
+    p_query = (Wilddog_Resolve_T*)wmalloc(sizeof(Wilddog_Resolve_T));
+    if(!p_query)
+        return NULL;
+    p_query->p_host = (char*)wmalloc(strlen(host) + 1);
+    if(!p_query->p_host)
+    {
+        wfree(p_query);
+        return NULL;
+    }
+    strcpy(p_query->p_host, host);
+    p_query->d_state = 1;
+    p_query->d_refs = 2;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    res = pthread_create(&tid, &attr, _wilddog_resolve_entry, p_query);
+    pthread_attr_destroy(&attr);
+    if(0 != res)
+    {
+        wfree(p_query->p_host);
+        wfree(p_query);
+        return NULL;
+    }
+    return p_query;
+}
+
+/*
+ * Function:    wilddog_resolvePoll
+ * Description: wilddog resolvePoll function, getaddrinfo do not report the
+ *              ttl, so ttl is always 0.
+ * Input:       query: The query.
+ *              maxNum: The size of addrs.
+ *              timeout: The max time to wait, in ms.
+ * Output:      addrs: The resolved addresses.
+ *              p_ttl: The record's ttl.
+ * Return:      0 in progress, >0 the number of addresses, -1 failed.
+*/
+int wilddog_resolvePoll
+    (
+    void* query,
+    Wilddog_Address_T* addrs,
+    int maxNum,
+    u32* p_ttl,
+    s32 timeout
+    )
+{
+    Wilddog_Resolve_T *p_query = (Wilddog_Resolve_T*)query;
+    int state, num = 0;
+
+    if(!p_query)
+        return -1;
+    while(1 == (state = __atomic_load_n(&p_query->d_state, __ATOMIC_ACQUIRE)) \
+          && timeout > 0)
+    {
+        usleep(5000);
+        timeout -= 5;
+    }
+    if(1 == state)
+        return 0;
+    if(0 == state && addrs)
+    {
+        for(num = 0; num < p_query->d_num && num < maxNum; num++)
+        {
+            addrs[num].len = p_query->d_addr[num].len;
+            memcpy(addrs[num].ip, p_query->d_addr[num].ip, \
+                   p_query->d_addr[num].len);
+        }
+    }
+    if(p_ttl)
+        *p_ttl = 0;
+    _wilddog_resolve_release(p_query);
+    return num > 0 ? num : -1;
+}
+
+/*
+ * Function:    wilddog_resolveCancel
+ * Description: wilddog resolveCancel function, the resolver thread frees 
+ *              the query when it finished.
+ * Input:       query: The query.
+ * Output:      N/A
+ * Return:      N/A
+*/
+void wilddog_resolveCancel(void* query)
+{
+    if(query)
+        _wilddog_resolve_release((Wilddog_Resolve_T*)query);
+}
+
+/*
+ * Function:    wilddog_raceAddress
+ * Description: wilddog raceAddress function, all probes are sent from one 
+ *              dual-stack socket, the first reply wins.
+ * Input:       addrs: The addresses, in the order to try.
+ *              num: The number of addresses.
+ *              probe: The probe datagram.
+ *              probeLen: The length of the probe.
+ *              delay: The delay between two probes, in ms.
+ *              timeout: The max time to wait, in ms.
+ * Output:      N/A
+ * Return:      The index of the address replied first, or -1.
+*/
+int wilddog_raceAddress
+    (
+    Wilddog_Address_T* addrs,
+    int num,
+    void* probe,
+    s32 probeLen,
+    s32 delay,
+    s32 timeout
+    )
+{
+    struct sockaddr_storage sa;
+    socklen_t addrLen;
+    struct pollfd pfd;
+    u32 start = 0, now, wait;
+    int fd, family, i, sent = 0, winner = -1;
+    u8 buf[64];
+
+    if(!addrs || num <= 0 || (fd = _wilddog_socket_create(&family)) < 0)
+        return -1;
+    wilddog_getMonotonicTime(&start);
+    now = start;
+    while(now - start < (u32)timeout)
+    {
+        /*start the next attempt on time, skip what the socket can not reach*/
+        while(sent < num && now - start >= (u32)(sent * delay))
+        {
+            if(0 == _wilddog_addr_toSock(family, &addrs[sent], &sa, &addrLen))
+                sendto(fd, probe, probeLen, 0, (struct sockaddr*)&sa, addrLen);
+            sent++;
+        }
+        wait = (u32)timeout - (now - start);
+        if(sent < num && (u32)(sent * delay) - (now - start) < wait)
+            wait = (u32)(sent * delay) - (now - start);
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        if(poll(&pfd, 1, wait) > 0)
+        {
+            addrLen = sizeof(sa);
+            if(recvfrom(fd, buf, sizeof(buf), 0, (struct sockaddr*)&sa, \
+                        &addrLen) >= 0)
+            {
+                for(i = 0; i < sent; i++)
+                {
+                    if(_wilddog_addr_match(&addrs[i], &sa))
+                    {
+                        winner = i;
+                        break;
+                    }
+                }
+                if(winner >= 0)
+                    break;
+            }
+        }
+        wilddog_getMonotonicTime(&now);
+    }
+    close(fd);
+    return winner;
+}
+
+/*
+ * Function:    _wilddog_race_release
+ * Description: drop one reference of the race, free it if it is the last.
+ * Input:       p_race: The race.
+ * Output:      N/A
+ * Return:      N/A
+*/
+STATIC void _wilddog_race_release(Wilddog_Race_T *p_race)
+{
+    if(0 == __atomic_sub_fetch(&p_race->d_refs, 1, __ATOMIC_ACQ_REL))
+    {
+        wfree(p_race->p_probe);
+        wfree(p_race);
+    }
+}
+
+/*
+ * Function:    _wilddog_race_entry
+ * Description: race thread, run wilddog_raceAddress on the race's copy.
+ * Input:       arg: The race.
+ * Output:      N/A
+ * Return:      Always return NULL.
+*/
+STATIC void* _wilddog_race_entry(void* arg)
+{
+    Wilddog_Race_T *p_race = (Wilddog_Race_T*)arg;
+
+    p_race->d_winner = wilddog_raceAddress(p_race->d_addr, p_race->d_num, \
+                                           p_race->p_probe, p_race->d_probeLen,\
+                                           p_race->d_delay, p_race->d_timeout);
+    __atomic_store_n(&p_race->d_state, 0, __ATOMIC_RELEASE);
+    _wilddog_race_release(p_race);
+    return NULL;
+}
+
+/*
+ * Function:    wilddog_raceStart
+ * Description: wilddog raceStart function, race the addresses in a 
+ *              detached thread.
+ * Input:       addrs: The addresses, in the order to try.
+ *              num: The number of addresses.
+ *              probe: The probe datagram.
+ *              probeLen: The length of the probe.
+ *              delay: The delay between two probes, in ms.
+ *              timeout: The max time to wait, in ms.
+ * Output:      N/A
+ * Return:      The race, or NULL if failed.
+*/
+void* wilddog_raceStart
+    (
+    Wilddog_Address_T* addrs,
+    int num,
+    void* probe,
+    s32 probeLen,
+    s32 delay,
+    s32 timeout
+    )
+{
+    Wilddog_Race_T *p_race;
+    pthread_attr_t attr;
+    pthread_t tid;
+    int res;
+
+    if(!addrs || num <= 0 || !probe || probeLen <= 0)
+        return NULL;
+    p_race = (Wilddog_Race_T*)wmalloc(sizeof(Wilddog_Race_T));
+    if(!p_race)
+        return NULL;
+    p_race->p_probe = (u8*)wmalloc(probeLen);
+    if(!p_race->p_probe)
+    {
+        wfree(p_race);
+        return NULL;
+    }
+    if(num > WILDDOG_DNS_MAX_ADDR)
+        num = WILDDOG_DNS_MAX_ADDR;
+    memcpy(p_race->d_addr, addrs, num * sizeof(Wilddog_Address_T));
+    memcpy(p_race->p_probe, probe, probeLen);
+    p_race->d_num = num;
+    p_race->d_probeLen = probeLen;
+    p_race->d_delay = delay;
+    p_race->d_timeout = timeout;
+    p_race->d_winner = -1;
+    p_race->d_state = 1;
+    p_race->d_refs = 2;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    res = pthread_create(&tid, &attr, _wilddog_race_entry, p_race);
+    pthread_attr_destroy(&attr);
+    if(0 != res)
+    {
+        wfree(p_race->p_probe);
+        wfree(p_race);
+        return NULL;
+    }
+    return p_race;
+}
+
+/*
+ * Function:    wilddog_racePoll
+ * Description: wilddog racePoll function, never wait.
+ * Input:       race: The race.
+ * Output:      p_winner: The index of the address replied first, or -1.
+ * Return:      0 in progress, 1 finished.
+*/
+int wilddog_racePoll(void* race, int* p_winner)
+{
+    Wilddog_Race_T *p_race = (Wilddog_Race_T*)race;
+
+    if(!p_race)
+    {
+        *p_winner = -1;
+        return 1;
+    }
+    if(1 == __atomic_load_n(&p_race->d_state, __ATOMIC_ACQUIRE))
+        return 0;
+    *p_winner = p_race->d_winner;
+    _wilddog_race_release(p_race);
+    return 1;
+}
+
+/*
+ * Function:    wilddog_raceCancel
+ * Description: wilddog raceCancel function, the race thread frees the race
+ *              when it finished.
+ * Input:       race: The race.
+ * Output:      N/A
+ * Return:      N/A
+*/
+void wilddog_raceCancel(void* race)
+{
+    if(race)
+        _wilddog_race_release((Wilddog_Race_T*)race);
+}
+
+/*
+ * Function:    _wilddog_epoll_init
+ * Description: create the epoll set and the wakeup eventfd in it.
+ * Input:       N/A
+ * Output:      N/A
+ * Return:      If success, return 0; else return -1.
+*/
+STATIC int _wilddog_epoll_init(void)
+{
+    struct epoll_event ev;
+
+    if(l_wilddog_epollFd >= 0)
+        return 0;
+    l_wilddog_epollFd = epoll_create(WILDDOG_SYNC_MAX_EVENTS);
+    if(l_wilddog_epollFd < 0)
+        return -1;
+    l_wilddog_wakeFd = eventfd(0, EFD_NONBLOCK);
+    if(l_wilddog_wakeFd >= 0)
+    {
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = l_wilddog_wakeFd;
+        if(epoll_ctl(l_wilddog_epollFd, EPOLL_CTL_ADD, l_wilddog_wakeFd, &ev) < 0)
+        {
+            close(l_wilddog_wakeFd);
+            l_wilddog_wakeFd = -1;
+        }
+    }
+    return 0;
+}
+
 /*
  * Function:    wilddog_openSocket
  * Description: wilddog openSocket function, it use the interface in posix.
@@ -60,11 +1039,25 @@ int wilddog_gethostbyname(Wilddog_Address_T* addr,char* host)
 */
 int wilddog_openSocket(int* socketId)
 {
-    int fd;
-    if ((fd = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+    int fd, family;
+    Wilddog_Recv_Batch_T *p_batch;
+    if ((fd = _wilddog_socket_create(&family)) < 0) {
         perror("cannot create socket");
         return -1;
     }
+    /*remember the family, sends need not ask the kernel.*/
+    p_batch = _wilddog_recvBatch_get(fd);
+    if(p_batch)
+        p_batch->d_family = family;
+    if(0 == _wilddog_epoll_init())
+    {
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if(epoll_ctl(l_wilddog_epollFd, EPOLL_CTL_ADD, fd, &ev) < 0)
+            wilddog_debug_level(WD_DEBUG_WARN, "epoll add %d failed", fd);
+    }
     *socketId = fd;
     return 0;
 }
@@ -78,10 +1071,60 @@ int wilddog_openSocket(int* socketId)
 */
 int wilddog_closeSocket(int socketId)
 {
-    
+    Wilddog_Recv_Batch_T *p_batch = _wilddog_recvBatch_find(socketId);
+
+    _wilddog_sendStage_sync(socketId);
+    if(p_batch)
+    {
+        LL_DELETE(l_wilddog_recvBatch, p_batch);
+        wfree(p_batch->p_spill);
+        wfree(p_batch);
+    }
+    if(l_wilddog_epollFd >= 0 && socketId >= 0)
+        epoll_ctl(l_wilddog_epollFd, EPOLL_CTL_DEL, socketId, NULL);
     return close(socketId);
 }
 
+/*
+ * Function:    wilddog_connectSocket
+ * Description: wilddog connectSocket function, connect the udp socket, then
+ *              datagrams to the address use send, and the kernel drops 
+ *              datagrams from other addresses. It can be called again when 
+ *              the address changes.
+ * Input:       socketId: The socket id.
+ *              addr: The pointer of Wilddog_Address_T
+ * Output:      N/A
+ * Return:      If success, return 0; else return -1.
+*/
+int wilddog_connectSocket(int socketId, Wilddog_Address_T* addr)
+{
+    struct sockaddr_storage servaddr;
+    socklen_t addrLen;
+    Wilddog_Recv_Batch_T *p_batch;
+
+    if(!addr)
+        return -1;
+    p_batch = _wilddog_recvBatch_get(socketId);
+    if(!p_batch || \
+       _wilddog_addr_toSock(_wilddog_socket_family(p_batch, socketId), addr, \
+                            &servaddr, &addrLen) < 0)
+        return -1;
+    /*staged datagrams and left ones belong to the old address.*/
+    _wilddog_sendStage_sync(socketId);
+    p_batch->d_num = 0;
+    p_batch->d_pos = 0;
+    p_batch->isFull = FALSE;
+    p_batch->isConnected = FALSE;
+    if(connect(socketId, (struct sockaddr*)&servaddr, addrLen) < 0)
+    {
+        wilddog_debug_level(WD_DEBUG_WARN, "connect socket %d failed", socketId);
+        return -1;
+    }
+    p_batch->d_peer = *addr;
+    p_batch->isConnected = TRUE;
+    return 0;
+}
+
 
 /*
  * Function:    wilddog_send
@@ -102,30 +1145,57 @@ int wilddog_send
     )
 {
     int ret;
-    struct sockaddr_in servaddr;    /* server address */
-    /* fill in the server's address and data */
-    memset((char*)&servaddr, 0, sizeof(servaddr));
-    if(addr_in->len==4){
-        servaddr.sin_family = AF_INET;
-    }
-    else{
+    struct sockaddr_storage servaddr;    /* server address */
+    socklen_t addrLen = 0;
+    Wilddog_Recv_Batch_T *p_batch = _wilddog_recvBatch_find(socketId);
+    BOOL isPeer = _wilddog_recvBatch_isPeer(p_batch, addr_in);
+
+    /* fill in the server's address and data, connected socket need not */
+    if(FALSE == isPeer && \
+       _wilddog_addr_toSock(_wilddog_socket_family(p_batch, socketId), addr_in,\
+                            &servaddr, &addrLen) < 0){
         wilddog_debug_level(WD_DEBUG_ERROR, "wilddog_send-unkown addr len!");
         return -1;
     }
-    servaddr.sin_port = wilddog_htons(addr_in->port);
-    memcpy(&servaddr.sin_addr.s_addr,addr_in->ip,addr_in->len);
 #if WILDDOG_SELFTEST
         performtest_getDtlsSendTime();
 #endif
 
     wilddog_debug_level(WD_DEBUG_LOG, \
-                        "addr_in->port = %d, ip = %u.%u.%u.%u", \
-                        addr_in->port, addr_in->ip[0], \
+                        "addr_in->port = %d, len = %d, ip = %u.%u.%u.%u...", \
+                        addr_in->port, addr_in->len, addr_in->ip[0], \
                         addr_in->ip[1], addr_in->ip[2], \
                         addr_in->ip[3]);
-    if((ret = sendto(socketId, tosend, tosendLength, 0, 
-                      (struct sockaddr *)&servaddr,
-                      sizeof(servaddr)))<0)
+    /*staging, copy it to stage and send it when flush.*/
+    if(TRUE == l_wilddog_sendStage.isStaging && \
+       tosendLength > 0 && tosendLength <= WILDDOG_SEND_STAGE_SIZE)
+    {
+        Wilddog_Send_Stage_T *p_stage = &l_wilddog_sendStage;
+        
+        if(p_stage->d_num >= WILDDOG_SEND_STAGE_NUM || \
+           p_stage->d_used + tosendLength > WILDDOG_SEND_STAGE_SIZE)
+        {
+            _wilddog_sendStage_flush();
+        }
+        p_stage->d_socketId[p_stage->d_num] = socketId;
+        if(addrLen)
+            p_stage->d_addr[p_stage->d_num] = servaddr;
+        p_stage->d_addrLen[p_stage->d_num] = addrLen;
+        p_stage->d_offset[p_stage->d_num] = p_stage->d_used;
+        p_stage->d_len[p_stage->d_num] = tosendLength;
+        memcpy(&p_stage->d_buf[p_stage->d_used], tosend, tosendLength);
+        p_stage->d_used += tosendLength;
+        p_stage->d_num++;
+        return tosendLength;
+    }
+    /*keep the order with staged datagrams.*/
+    _wilddog_sendStage_sync(socketId);
+    if(TRUE == isPeer)
+        ret = send(socketId, tosend, tosendLength, 0);
+    else
+        ret = sendto(socketId, tosend, tosendLength, 0, 
+                     (struct sockaddr *)&servaddr, addrLen);
+    if(ret < 0)
     {
         wilddog_debug_level(WD_DEBUG_WARN, "sendto failed");
         return -1;
@@ -153,24 +1223,39 @@ int wilddog_receive
     s32 timeout
     )
 {
-    struct sockaddr_in remaddr;
-    socklen_t addrlen = sizeof(remaddr);
+    struct sockaddr_storage remaddr;
     int recvlen;
-    struct timeval tv;
-    tv.tv_sec = 0;
-    tv.tv_usec = timeout*1000;
+    Wilddog_Recv_Batch_T *p_batch = _wilddog_recvBatch_find(socketId);
 
-    setsockopt(socketId, SOL_SOCKET, SO_RCVTIMEO, \
-               (char *)&tv,sizeof(struct timeval));
+    /*datagrams left by the last recvmmsg are read first, no syscall.*/
+    if(p_batch && p_batch->d_pos < p_batch->d_num)
+    {
+        recvlen = _wilddog_recvBatch_pop(p_batch, addr, buf, bufLen);
+        if(recvlen >= 0)
+            return recvlen;
+    }
+    /*the request must be out before we wait for the response.*/
+    _wilddog_sendStage_sync(socketId);
+    p_batch = _wilddog_recvBatch_get(socketId);
+    if(!p_batch)
+        return -1;
+    _wilddog_recvBatch_setTimeout(p_batch, timeout);
 
-    recvlen = recvfrom(socketId, buf, bufLen, 0, \
-                       (struct sockaddr *)&remaddr, &addrlen);
+    /*block for the first datagram, then take all the queued ones.*/
+    memset(&remaddr, 0, sizeof(remaddr));
+    if(_wilddog_recvBatch_fill(p_batch, buf, bufLen, &remaddr, \
+                               MSG_WAITFORONE) <= 0)
+    {
+        return -1;
+    }
+    recvlen = p_batch->d_len[0];
     if(recvlen < 0)
     {
         return -1;
     }
-    if(memcmp(addr->ip, &remaddr.sin_addr.s_addr, addr->len) || \
-        wilddog_ntohs(remaddr.sin_port) != addr->port)
+    if(TRUE == p_batch->isConnected ? \
+       FALSE == _wilddog_recvBatch_isPeer(p_batch, addr) : \
+       FALSE == _wilddog_addr_match(addr, &remaddr))
     {
         wilddog_debug_level(WD_DEBUG_WARN,"ip or port not match!");
         return -1;
@@ -188,3 +1273,417 @@ int wilddog_receive
     return recvlen;
 }
 
+/*
+ * Function:    wilddog_receivePending
+ * Description: wilddog receivePending function, get the number of datagrams
+ *              which can be read by wilddog_receive without waiting. if the
+ *              last batch was full, try to pull more without blocking.
+ * Input:       socketId: The socket id.
+ * Output:      N/A
+ * Return:      The number of datagrams pending.
+*/
+int wilddog_receivePending(int socketId)
+{
+    Wilddog_Recv_Batch_T *p_batch = _wilddog_recvBatch_find(socketId);
+
+    if(!p_batch)
+        return 0;
+    if(p_batch->d_pos >= p_batch->d_num && TRUE == p_batch->isFull)
+    {
+        if(_wilddog_recvBatch_fill(p_batch, NULL, 0, NULL, MSG_DONTWAIT) <= 0)
+            return 0;
+    }
+    return p_batch->d_num - p_batch->d_pos;
+}
+
+/*
+ * Function:    wilddog_receiveSize
+ * Description: wilddog receiveSize function, wait for the next datagram and
+ *              get its length without reading it, so the caller can read it
+ *              with a buffer just large enough. staged datagrams are already
+ *              read, the largest of them is returned, else the socket is 
+ *              peeked with MSG_PEEK|MSG_TRUNC.
+ * Input:       socketId: The socket id.
+ *              timeout: The max timeout in wait process.
+ * Output:      N/A
+ * Return:      The length of the next datagram, or -1 if nothing arrived.
+*/
+int wilddog_receiveSize(int socketId, s32 timeout)
+{
+    Wilddog_Recv_Batch_T *p_batch = _wilddog_recvBatch_find(socketId);
+    int i, len = -1;
+
+    if(p_batch)
+    {
+        for(i = p_batch->d_pos; i < p_batch->d_num; i++)
+        {
+            if(p_batch->d_len[i] > len)
+                len = p_batch->d_len[i];
+        }
+        if(len >= 0)
+            return len;
+    }
+    /*the request must be out before we wait for the response.*/
+    _wilddog_sendStage_sync(socketId);
+    p_batch = _wilddog_recvBatch_get(socketId);
+    if(!p_batch)
+        return -1;
+    _wilddog_recvBatch_setTimeout(p_batch, timeout);
+    len = recv(socketId, NULL, 0, MSG_PEEK | MSG_TRUNC);
+    return len < 0 ? -1 : len;
+}
+
+
+/*
+ * Function:    wilddog_waitSockets
+ * Description: wilddog waitSockets function, wait once for all the sockets 
+ *              opened by wilddog_openSocket, it use epoll.
+ * Input:       maxNum: The size of readyIds.
+ *              timeout: The max timeout in wait process.
+ * Output:      readyIds: The ready socket ids.
+ * Return:      If success, return the number of ready sockets; else return -1.
+*/
+int wilddog_waitSockets
+    (
+    int* readyIds,
+    s32 maxNum,
+    s32 timeout
+    )
+{
+    struct epoll_event events[WILDDOG_SYNC_MAX_EVENTS];
+    Wilddog_Recv_Batch_T *p_batch = NULL;
+    int num, i, j, staged = 0;
+
+    if(!readyIds || maxNum <= 0 || _wilddog_epoll_init() < 0)
+        return -1;
+    if(maxNum > WILDDOG_SYNC_MAX_EVENTS)
+        maxNum = WILDDOG_SYNC_MAX_EVENTS;
+
+    /*sockets still have staged datagrams are ready, do not wait for them.*/
+    LL_FOREACH(l_wilddog_recvBatch, p_batch)
+    {
+        if(staged < maxNum && p_batch->d_pos < p_batch->d_num)
+            readyIds[staged++] = p_batch->socketId;
+    }
+    if(staged >= maxNum)
+        return staged;
+    if(staged)
+        timeout = 0;
+    num = epoll_wait(l_wilddog_epollFd, events, maxNum - staged, timeout);
+    if(num < 0)
+    {
+        /*interrupted by signal, treat as timeout*/
+        if(EINTR == errno)
+            return staged;
+        return staged ? staged : -1;
+    }
+    for(i = 0; i < num; i++)
+    {
+        if(events[i].data.fd == l_wilddog_wakeFd)
+        {
+            eventfd_t value;
+            eventfd_read(l_wilddog_wakeFd, &value);
+            continue;
+        }
+        for(j = 0; j < staged; j++)
+        {
+            if(readyIds[j] == events[i].data.fd)
+                break;
+        }
+        if(j == staged)
+            readyIds[staged++] = events[i].data.fd;
+    }
+    return staged;
+}
+
+/*
+ * Function:    wilddog_sendStageBegin
+ * Description: wilddog sendStageBegin function, datagrams sent after it are
+ *              staged until wilddog_sendStageFlush.
+ * Input:       N/A
+ * Output:      N/A
+ * Return:      Always return 0.
+*/
+int wilddog_sendStageBegin(void)
+{
+    l_wilddog_sendStage.isStaging = TRUE;
+    return 0;
+}
+
+/*
+ * Function:    wilddog_sendStageFlush
+ * Description: wilddog sendStageFlush function, send all staged datagrams 
+ *              with sendmmsg and stop staging.
+ * Input:       N/A
+ * Output:      N/A
+ * Return:      The number of datagrams sent.
+*/
+int wilddog_sendStageFlush(void)
+{
+    l_wilddog_sendStage.isStaging = FALSE;
+    return _wilddog_sendStage_flush();
+}
+
+/*
+ * Function:    wilddog_sendStageCount
+ * Description: wilddog sendStageCount function.
+ * Input:       N/A
+ * Output:      N/A
+ * Return:      The number of datagrams staged and not sent yet.
+*/
+int wilddog_sendStageCount(void)
+{
+    return l_wilddog_sendStage.d_num;
+}
+
+/*
+ * Function:    wilddog_getMonotonicTime
+ * Description: wilddog getMonotonicTime function, it use CLOCK_MONOTONIC.
+ * Input:       N/A
+ * Output:      p_ms: The pointer of the time, in ms.
+ * Return:      If success, return 0; else return -1.
+*/
+int wilddog_getMonotonicTime(u32* p_ms)
+{
+    struct timespec ts;
+
+    if(!p_ms || clock_gettime(CLOCK_MONOTONIC, &ts) < 0)
+        return -1;
+    *p_ms = (u32)((unsigned long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+    return 0;
+}
+
+/*
+ * Function:    _wilddog_session_file
+ * Description: get the file a host's session is saved in, it is 
+ *              WILDDOG_SESSION_PATH followed by the host.
+ * Input:       host: The host.
+ *              size: The size of path.
+ * Output:      path: The file name.
+ * Return:      If success, return 0; else return -1.
+*/
+STATIC int _wilddog_session_file(char* path, int size, char* host)
+{
+    int len;
+
+    if(!host || 0 == strlen(WILDDOG_SESSION_PATH))
+        return -1;
+    len = snprintf(path, size, "%s%s", WILDDOG_SESSION_PATH, host);
+    if(len < 0 || len >= size)
+        return -1;
+    return 0;
+}
+
+/*
+ * Function:    wilddog_sessionSave
+ * Description: wilddog sessionSave function, it write a temporary file only
+ *              the user can read, and rename it to the session file, so a
+ *              restart during the write never leaves a broken one.
+ * Input:       host: The host.
+ *              data: The session data.
+ *              len: The length of data, 0 erases the saved one.
+ * Output:      N/A
+ * Return:      If success, return 0; else return -1.
+*/
+int wilddog_sessionSave(char* host, void* data, s32 len)
+{
+    char path[256], tmp[260];
+    int fd, res = -1;
+
+    if(_wilddog_session_file(path, sizeof(path), host) < 0)
+        return -1;
+    if(0 == len)
+        return (0 == unlink(path) || ENOENT == errno)?(0):(-1);
+    if(!data || len < 0)
+        return -1;
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if(fd < 0)
+        return -1;
+    if(write(fd, data, len) == len)
+        res = 0;
+    if(0 != close(fd))
+        res = -1;
+    if(0 == res && 0 != rename(tmp, path))
+        res = -1;
+    if(0 != res)
+        unlink(tmp);
+    return res;
+}
+
+/*
+ * Function:    wilddog_sessionLoad
+ * Description: wilddog sessionLoad function.
+ * Input:       host: The host.
+ *              maxLen: The size of data.
+ * Output:      data: The session data.
+ * Return:      The length of the data read, -1 if nothing saved.
+*/
+int wilddog_sessionLoad(char* host, void* data, s32 maxLen)
+{
+    char path[256];
+    int fd, len;
+
+    if(!data || _wilddog_session_file(path, sizeof(path), host) < 0)
+        return -1;
+    fd = open(path, O_RDONLY);
+    if(fd < 0)
+        return -1;
+    len = read(fd, data, maxLen);
+    close(fd);
+    return (len < 0)?(-1):(len);
+}
+
+/*
+ * Function:    wilddog_wakeupWait
+ * Description: wilddog wakeupWait function, it write the eventfd in the 
+ *              epoll set.
+ * Input:       N/A
+ * Output:      N/A
+ * Return:      If success, return 0; else return -1.
+*/
+int wilddog_wakeupWait(void)
+{
+    if(_wilddog_epoll_init() < 0 || l_wilddog_wakeFd < 0)
+        return -1;
+    return eventfd_write(l_wilddog_wakeFd, 1);
+}
+
+/*
+ * Function:    _wilddog_thread_entry
+ * Description: pthread entry, call the user's thread function.
+ * Input:       arg: The thread.
+ * Output:      N/A
+ * Return:      Always return NULL.
+*/
+STATIC void* _wilddog_thread_entry(void* arg)
+{
+    Wilddog_Thread_T *p_thread = (Wilddog_Thread_T*)arg;
+
+    (p_thread->f_func)(p_thread->p_arg);
+    return NULL;
+}
+
+/*
+ * Function:    wilddog_threadCreate
+ * Description: wilddog threadCreate function, it use pthread.
+ * Input:       func: The thread entry.
+ *              arg: The arg of the entry.
+ * Output:      p_thread: The thread handle.
+ * Return:      If success, return 0; else return -1.
+*/
+int wilddog_threadCreate
+    (
+    void** p_thread,
+    Wilddog_Thread_Func_T func,
+    void* arg
+    )
+{
+    Wilddog_Thread_T *p_new;
+
+    if(!p_thread || !func)
+        return -1;
+    p_new = (Wilddog_Thread_T*)wmalloc(sizeof(Wilddog_Thread_T));
+    if(!p_new)
+        return -1;
+    p_new->f_func = func;
+    p_new->p_arg = arg;
+    if(0 != pthread_create(&p_new->d_tid, NULL, _wilddog_thread_entry, p_new))
+    {
+        wfree(p_new);
+        return -1;
+    }
+    *p_thread = p_new;
+    return 0;
+}
+
+/*
+ * Function:    wilddog_threadJoin
+ * Description: wilddog threadJoin function, wait the thread exit and free it.
+ * Input:       thread: The thread handle.
+ * Output:      N/A
+ * Return:      If success, return 0; else return -1.
+*/
+int wilddog_threadJoin(void* thread)
+{
+    Wilddog_Thread_T *p_thread = (Wilddog_Thread_T*)thread;
+
+    if(!p_thread || 0 != pthread_join(p_thread->d_tid, NULL))
+        return -1;
+    wfree(p_thread);
+    return 0;
+}
+
+/*
+ * Function:    wilddog_threadIsSelf
+ * Description: wilddog threadIsSelf function.
+ * Input:       thread: The thread handle.
+ * Output:      N/A
+ * Return:      1 if the caller is running in the thread, else return 0.
+*/
+int wilddog_threadIsSelf(void* thread)
+{
+    if(!thread)
+        return 0;
+    return pthread_equal(pthread_self(), ((Wilddog_Thread_T*)thread)->d_tid) ? \
+           1 : 0;
+}
+
+/*
+ * Function:    wilddog_semCreate
+ * Description: wilddog semCreate function, it use posix unnamed semaphore.
+ * Input:       N/A
+ * Output:      N/A
+ * Return:      The semaphore, or NULL if failed.
+*/
+void* wilddog_semCreate(void)
+{
+    sem_t *p_sem = (sem_t*)wmalloc(sizeof(sem_t));
+
+    if(p_sem && 0 != sem_init(p_sem, 0, 0))
+    {
+        wfree(p_sem);
+        return NULL;
+    }
+    return p_sem;
+}
+
+/*
+ * Function:    wilddog_semWait
+ * Description: wilddog semWait function.
+ * Input:       sem: The semaphore.
+ * Output:      N/A
+ * Return:      N/A
+*/
+void wilddog_semWait(void* sem)
+{
+    while(0 != sem_wait((sem_t*)sem) && EINTR == errno)
+        ;
+}
+
+/*
+ * Function:    wilddog_semPost
+ * Description: wilddog semPost function.
+ * Input:       sem: The semaphore.
+ * Output:      N/A
+ * Return:      N/A
+*/
+void wilddog_semPost(void* sem)
+{
+    sem_post((sem_t*)sem);
+}
+
+/*
+ * Function:    wilddog_semDestroy
+ * Description: wilddog semDestroy function.
+ * Input:       sem: The semaphore.
+ * Output:      N/A
+ * Return:      N/A
+*/
+void wilddog_semDestroy(void* sem)
+{
+    if(!sem)
+        return;
+    sem_destroy((sem_t*)sem);
+    wfree(sem);
+}
@@ -120,6 +120,20 @@ int wilddog_closeSocket( int socketId )
     return 0;
 }
 
+/*
+ * Function:    wilddog_connectSocket
+ * Description: wilddog connectSocket function, not supported in wiced 
+ *              platform, the socket is used unconnected.
+ * Input:        socketId: The socket id.
+ *                  addr:  The pointer of Wilddog_Address_T
+ * Output:      N/A
+ * Return:      Always return -1.
+*/
+int wilddog_connectSocket( int socketId, Wilddog_Address_T* addr )
+{
+    return -1;
+}
+
 /*
  * Function:    wilddog_send
  * Description: wilddog send function, it use the interface in wiced platform.
@@ -314,3 +328,304 @@ int wilddog_receive
     return 0;
 }
 
+
+/*
+ * Function:    wilddog_receivePending
+ * Description: wilddog receivePending function, wiced platform do not batch.
+ * Input:       socketId: The socket id.
+ * Output:      N/A
+ * Return:      Always return 0.
+*/
+int wilddog_receivePending(int socketId)
+{
+    return 0;
+}
+
+/*
+ * Function:    wilddog_receiveSize
+ * Description: wilddog receiveSize function, wiced platform can not peek.
+ * Input:       socketId: The socket id.
+ *              timeout: The max timeout in wait process.
+ * Output:      N/A
+ * Return:      Always return 0, caller will use its largest buffer.
+*/
+int wilddog_receiveSize(int socketId, s32 timeout)
+{
+    return 0;
+}
+
+/*
+ * Function:    wilddog_sendStageBegin
+ * Description: wilddog sendStageBegin function, wiced platform do not stage.
+ * Input:       N/A
+ * Output:      N/A
+ * Return:      Always return -1, datagrams are sent at once.
+*/
+int wilddog_sendStageBegin(void)
+{
+    return -1;
+}
+
+/*
+ * Function:    wilddog_sendStageFlush
+ * Description: wilddog sendStageFlush function, wiced platform do not stage.
+ * Input:       N/A
+ * Output:      N/A
+ * Return:      Always return 0.
+*/
+int wilddog_sendStageFlush(void)
+{
+    return 0;
+}
+
+/*
+ * Function:    wilddog_sendStageCount
+ * Description: wilddog sendStageCount function, wiced platform do not stage.
+ * Input:       N/A
+ * Output:      N/A
+ * Return:      Always return 0.
+*/
+int wilddog_sendStageCount(void)
+{
+    return 0;
+}
+
+/*
+ * Function:    wilddog_waitSockets
+ * Description: wilddog waitSockets function, wiced platform do not support it.
+ * Input:       readyIds: The buffer to store ready socket ids.
+ *              maxNum: The size of readyIds.
+ *              timeout: The max timeout in wait process.
+ * Output:      N/A
+ * Return:      Always return -1, caller will use wilddog_receive instead.
+*/
+int wilddog_waitSockets
+    (
+    int* readyIds,
+    s32 maxNum,
+    s32 timeout
+    )
+{
+    return -1;
+}
+
+/*
+ * Function:    wilddog_getMonotonicTime
+ * Description: wilddog getMonotonicTime function, it use the system time
+ *              since boot in wiced platform.
+ * Input:       N/A
+ * Output:      p_ms: The pointer of the time, in ms.
+ * Return:      If success, return 0; else return -1.
+*/
+int wilddog_getMonotonicTime(u32* p_ms)
+{
+    wiced_time_t now;
+    
+    if(!p_ms || WICED_SUCCESS != wiced_time_get_time(&now))
+        return -1;
+    *p_ms = (u32)now;
+    return 0;
+}
+
+/*
+ * Function:    wilddog_sessionSave
+ * Description: wilddog sessionSave function, wiced platform do not support it.
+ * Input:       host: The host.
+ *              data: The session data.
+ *              len: The length of data.
+ * Output:      N/A
+ * Return:      Always return -1.
+*/
+int wilddog_sessionSave(char* host, void* data, s32 len)
+{
+    return -1;
+}
+
+/*
+ * Function:    wilddog_sessionLoad
+ * Description: wilddog sessionLoad function, wiced platform do not support it.
+ * Input:       host: The host.
+ *              maxLen: The size of data.
+ * Output:      data: The session data.
+ * Return:      Always return -1, the session is got by auth.
+*/
+int wilddog_sessionLoad(char* host, void* data, s32 maxLen)
+{
+    return -1;
+}
+
+/*
+ * Function:    wilddog_wakeupWait
+ * Description: wilddog wakeupWait function, wiced platform do not support it.
+ * Input:       N/A
+ * Output:      N/A
+ * Return:      Always return -1.
+*/
+int wilddog_wakeupWait(void)
+{
+    return -1;
+}
+
+/*
+ * Function:    wilddog_threadCreate
+ * Description: wilddog threadCreate function, wiced platform do not support
+ *              the sdk i/o thread.
+ * Input:       func: The thread entry.
+ *              arg: The arg of the entry.
+ * Output:      p_thread: The thread handle.
+ * Return:      Always return -1.
+*/
+int wilddog_threadCreate
+    (
+    void** p_thread,
+    Wilddog_Thread_Func_T func,
+    void* arg
+    )
+{
+    return -1;
+}
+
+/*
+ * Function:    wilddog_threadJoin
+ * Description: wilddog threadJoin function, wiced platform do not support it.
+ * Input:       thread: The thread handle.
+ * Output:      N/A
+ * Return:      Always return -1.
+*/
+int wilddog_threadJoin(void* thread)
+{
+    return -1;
+}
+
+/*
+ * Function:    wilddog_threadIsSelf
+ * Description: wilddog threadIsSelf function, wiced platform do not support 
+ *              it.
+ * Input:       thread: The thread handle.
+ * Output:      N/A
+ * Return:      Always return 0.
+*/
+int wilddog_threadIsSelf(void* thread)
+{
+    return 0;
+}
+
+/*
+ * Function:    wilddog_semCreate
+ * Description: wilddog semCreate function, wiced platform do not support it.
+ * Input:       N/A
+ * Output:      N/A
+ * Return:      Always return NULL.
+*/
+void* wilddog_semCreate(void)
+{
+    return NULL;
+}
+
+void wilddog_semWait(void* sem)
+{
+    return;
+}
+
+void wilddog_semPost(void* sem)
+{
+    return;
+}
+
+void wilddog_semDestroy(void* sem)
+{
+    return;
+}
+
+/*
+ * Function:    wilddog_resolveStart
+ * Description: wilddog resolveStart function, wiced platform resolve in
+ *              wilddog_gethostbyname only.
+ * Input:       host: The pointer of host string.
+ * Output:      N/A
+ * Return:      Always return NULL.
+*/
+void* wilddog_resolveStart(char* host)
+{
+    return NULL;
+}
+
+int wilddog_resolvePoll
+    (
+    void* query,
+    Wilddog_Address_T* addrs,
+    int maxNum,
+    u32* p_ttl,
+    s32 timeout
+    )
+{
+    return -1;
+}
+
+void wilddog_resolveCancel(void* query)
+{
+    return;
+}
+
+/*
+ * Function:    wilddog_raceAddress
+ * Description: wilddog raceAddress function, wiced platform do not support
+ *              it, the first address is used.
+ * Input:       addrs: The addresses.
+ *              num: The number of addresses.
+ *              probe: The probe datagram.
+ *              probeLen: The length of the probe.
+ *              delay: The delay between two probes, in ms.
+ *              timeout: The max time to wait, in ms.
+ * Output:      N/A
+ * Return:      Always return -1.
+*/
+int wilddog_raceAddress
+    (
+    Wilddog_Address_T* addrs,
+    int num,
+    void* probe,
+    s32 probeLen,
+    s32 delay,
+    s32 timeout
+    )
+{
+    return -1;
+}
+
+/*
+ * Function:    wilddog_raceStart
+ * Description: wilddog raceStart function, wiced platform do not support
+ *              it, the first address is used.
+ * Input:       addrs: The addresses.
+ *              num: The number of addresses.
+ *              probe: The probe datagram.
+ *              probeLen: The length of the probe.
+ *              delay: The delay between two probes, in ms.
+ *              timeout: The max time to wait, in ms.
+ * Output:      N/A
+ * Return:      Always return NULL.
+*/
+void* wilddog_raceStart
+    (
+    Wilddog_Address_T* addrs,
+    int num,
+    void* probe,
+    s32 probeLen,
+    s32 delay,
+    s32 timeout
+    )
+{
+    return NULL;
+}
+
+int wilddog_racePoll(void* race, int* p_winner)
+{
+    *p_winner = -1;
+    return 1;
+}
+
+void wilddog_raceCancel(void* race)
+{
+    return;
+}
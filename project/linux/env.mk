@@ -15,11 +15,7 @@ else
 QUIET = @
 MAKE += --no-print-directory
 endif
-CFLAGS+=-Wall -O2
-
-ifeq ($(APP_SEC_TYPE), tinydtls)
-CFLAGS += -pthread
-endif
+CFLAGS+=-Wall -O2 -pthread
 
 ifeq ($(COVER), 1)
 CFLAGS += -fprofile-arcs -ftest-coverage
@@ -27,6 +23,8 @@ endif
 
 ifeq ($(WILDDOG_SELFTEST), yes)
 CFLAGS+= -DWILDDOG_SELFTEST
+#tests save sessions to /tmp/wilddog_selftest_<host>
+CFLAGS+= -DWILDDOG_SESSION_PATH=\"/tmp/wilddog_selftest_\"
 endif
 
 
@@ -74,6 +74,31 @@ void WD_SYSTEM coap_delete_pdu(coap_pdu_t *pdu)
   wfree( pdu );
 }
 
+size_t WD_SYSTEM coap_encode_empty
+    (
+    unsigned char type, 
+    unsigned short id, 
+    size_t token_len, 
+    const unsigned char *token,
+    unsigned char *buf, 
+    size_t buf_len
+    ) 
+{
+  const size_t HEADERLENGTH = token_len + 4;
+
+  if (!buf || token_len > 8 || buf_len < HEADERLENGTH || (token_len && !token))
+    return 0;
+
+  /* the wire layout of coap_hdr_t, byte by byte, buf needs no alignment */
+  buf[0] = (COAP_DEFAULT_VERSION << 6) | ((type & 0x03) << 4) | token_len;
+  buf[1] = 0;
+  memcpy(&buf[2], &id, 2);
+  if (token_len)
+    memcpy(&buf[4], token, token_len);
+
+  return HEADERLENGTH;
+}
+
 int WD_SYSTEM coap_add_token
     (
     coap_pdu_t *pdu, 
@@ -261,34 +286,14 @@ STATIC size_t WD_SYSTEM next_option_safe(coap_opt_t **optp, size_t*length)
   return optsize;
 }
 
-int WD_SYSTEM coap_pdu_parse
-    (
-    unsigned char *data, 
-    size_t length, 
-    coap_pdu_t *pdu
-    ) 
+/**
+ * Checks the token and options of @p pdu, whose header already holds
+ * @p length bytes, and finds the payload. Returns @c 0 on error or @c 1.
+ */
+STATIC int WD_SYSTEM coap_pdu_check(coap_pdu_t *pdu, size_t length) 
 {
   coap_opt_t *opt;
 
-  wilddog_assert(data, 0);
-  wilddog_assert(pdu, 0);
-
-  if (pdu->max_size < length) 
-  {
-    wilddog_debug_level(WD_DEBUG_ERROR, \
-                        "pdu:: insufficient space to store parsed PDU");
-    return 0;
-  }
-
-  if (length < sizeof(coap_hdr_t)) 
-  {
-    wilddog_debug_level(WD_DEBUG_ERROR, "pdu:: discarded invalid PDU");
-  }
-
-  pdu->hdr->version = data[0] >> 6;
-  pdu->hdr->type = (data[0] >> 4) & 0x03;
-  pdu->hdr->token_length = data[0] & 0x0f;
-  pdu->hdr->code = data[1];
   pdu->data = NULL;
   /* sanity checks */
   if (pdu->hdr->code == 0) 
@@ -308,12 +313,6 @@ int WD_SYSTEM coap_pdu_parse
     goto discard;
   }
 
-  /* Copy message id in network byte order, so we can easily write the
-   * response back to the network. */
-  memcpy(&pdu->hdr->id, data + 2, 2);
-
-  /* append data (including the Token) to pdu structure */
-  memcpy(pdu->hdr + 1, data + sizeof(coap_hdr_t), length - sizeof(coap_hdr_t));
   pdu->length = length;
   
   /* Finally calculate beginning of data block and thereby check integrity
@@ -354,6 +353,68 @@ int WD_SYSTEM coap_pdu_parse
   return 0;
 }
 
+int WD_SYSTEM coap_pdu_parse
+    (
+    unsigned char *data, 
+    size_t length, 
+    coap_pdu_t *pdu
+    ) 
+{
+  wilddog_assert(data, 0);
+  wilddog_assert(pdu, 0);
+
+  if (pdu->max_size < length) 
+  {
+    wilddog_debug_level(WD_DEBUG_ERROR, \
+                        "pdu:: insufficient space to store parsed PDU");
+    return 0;
+  }
+
+  if (length < sizeof(coap_hdr_t)) 
+  {
+    wilddog_debug_level(WD_DEBUG_ERROR, "pdu:: discarded invalid PDU");
+    return 0;
+  }
+
+  pdu->hdr->version = data[0] >> 6;
+  pdu->hdr->type = (data[0] >> 4) & 0x03;
+  pdu->hdr->token_length = data[0] & 0x0f;
+  pdu->hdr->code = data[1];
+
+  /* Copy message id in network byte order, so we can easily write the
+   * response back to the network. */
+  memcpy(&pdu->hdr->id, data + 2, 2);
+
+  /* append data (including the Token) to pdu structure */
+  memcpy(pdu->hdr + 1, data + sizeof(coap_hdr_t), length - sizeof(coap_hdr_t));
+
+  return coap_pdu_check(pdu, length);
+}
+
+int WD_SYSTEM coap_pdu_view
+    (
+    unsigned char *data, 
+    size_t length, 
+    coap_pdu_t *pdu
+    ) 
+{
+  wilddog_assert(data, 0);
+  wilddog_assert(pdu, 0);
+
+  memset(pdu, 0, sizeof(coap_pdu_t));
+  if (length < sizeof(coap_hdr_t)) 
+  {
+    wilddog_debug_level(WD_DEBUG_ERROR, "pdu:: discarded invalid PDU");
+    return 0;
+  }
+
+  /* coap_hdr_t is the wire layout, the header is used where it is */
+  pdu->hdr = (coap_hdr_t *)data;
+  pdu->max_size = length;
+
+  return coap_pdu_check(pdu, length);
+}
+
 STATIC BOOL INLINE WD_SYSTEM _isprint(char data)
 {
     return (data >=0x20 && data <=0x7e) ;
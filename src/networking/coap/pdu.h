@@ -43,6 +43,7 @@
 #define COAP_REQUEST_POST      2
 #define COAP_REQUEST_PUT       3
 #define COAP_REQUEST_DELETE    4
+#define COAP_REQUEST_PATCH     6 /* RFC 8132 */
 
 /* CoAP option types (be sure to update check_critical when adding options */
 
@@ -72,6 +73,7 @@
 
 #define COAP_OPTION_BLOCK2       23 /* C, uint, 0--3 B, (none) */
 #define COAP_OPTION_BLOCK1       27 /* C, uint, 0--3 B, (none) */
+#define COAP_OPTION_SIZE2        28 /* E, uint, 0-4 B, (none) */
 
 #define COAP_MAX_OPT             63 /**< the highest option number we know */
 
@@ -97,9 +99,12 @@
 #define COAP_RESPONSE_200      COAP_RESPONSE_CODE(200)  /* 2.00 OK */
 #define COAP_RESPONSE_201      COAP_RESPONSE_CODE(201)  /* 2.01 Created */
 #define COAP_RESPONSE_304      COAP_RESPONSE_CODE(203)  /* 2.03 Valid */
+#define COAP_RESPONSE_231      COAP_RESPONSE_CODE(231)  /* 2.31 Continue */
 #define COAP_RESPONSE_400      COAP_RESPONSE_CODE(400)  /* 4.00 Bad Request */
 #define COAP_RESPONSE_404      COAP_RESPONSE_CODE(404)  /* 4.04 Not Found */
 #define COAP_RESPONSE_405      COAP_RESPONSE_CODE(405)  /* 4.05 Method Not Allowed */
+#define COAP_RESPONSE_408      COAP_RESPONSE_CODE(408)  /* 4.08 Request Entity Incomplete */
+#define COAP_RESPONSE_413      COAP_RESPONSE_CODE(413)  /* 4.13 Request Entity Too Large */
 #define COAP_RESPONSE_415      COAP_RESPONSE_CODE(415)  /* 4.15 Unsupported Media Type */
 #define COAP_RESPONSE_500      COAP_RESPONSE_CODE(500)  /* 5.00 Internal Server Error */
 #define COAP_RESPONSE_501      COAP_RESPONSE_CODE(501)  /* 5.01 Not Implemented */
@@ -250,6 +255,27 @@ coap_pdu_t *coap_new_pdu(void);
 
 void coap_delete_pdu(coap_pdu_t *);
 
+/** The largest empty message, header and an 8 bytes token. */
+#define COAP_EMPTY_MAX_SIZE 12
+
+/**
+ * Writes an empty message (code 0.00, e.g. the ACK or RST of a received
+ * confirmable message) into @p buf, no pdu is created and no heap is used.
+ * @p id is in network byte order, as in coap_hdr_t. This function returns
+ * the number of bytes written or @c 0 on error.
+ *
+ * @param type      The type, COAP_MESSAGE_ACK or COAP_MESSAGE_RST.
+ * @param id        The message id to echo.
+ * @param token_len The length of the token to echo.
+ * @param token     The token to echo.
+ * @param buf       The buffer, COAP_EMPTY_MAX_SIZE bytes is always enough.
+ * @param buf_len   The size of @p buf.
+ * @return The length of the message, or @c 0 on error.
+ */
+size_t coap_encode_empty(unsigned char type, unsigned short id, 
+             size_t token_len, const unsigned char *token,
+             unsigned char *buf, size_t buf_len);
+
 /**
  * Parses @p data into the CoAP PDU structure given in @p result. This
  * function returns @c 0 on error or a number greater than zero on
@@ -264,6 +290,19 @@ void coap_delete_pdu(coap_pdu_t *);
  */
 int coap_pdu_parse(unsigned char *data, size_t length, coap_pdu_t *result);
 
+/**
+ * Parses @p data like coap_pdu_parse(), but nothing is copied, @p result
+ * becomes a view over @p data: its header, options and payload point into
+ * @p data, which must stay untouched while the view is used. A view must
+ * not be released with coap_delete_pdu() or grown by coap_add_*().
+ *
+ * @param data   The raw data to parse as CoAP PDU, aligned as coap_hdr_t.
+ * @param length The actual size of @p data
+ * @param result The PDU structure to fill.
+ * @return A value greater than zero on success or @c 0 on error.
+ */
+int coap_pdu_view(unsigned char *data, size_t length, coap_pdu_t *result);
+
 /**
  * Adds token of length @p len to @p pdu. Adding the token destroys
  * any following contents of the pdu. Hence options and data must be
@@ -28,6 +28,7 @@
 #include "wilddog_debug.h"
 #include "wilddog_common.h"
 #include "wilddog_sec.h"
+#include "wilddog_port.h"
 #include "test_lib.h"
 
 #include "wilddog_conn.h"
@@ -41,54 +42,180 @@ typedef struct _WILDDOG_COAP_OBSERVE_DATA{
     u32 maxage;
 }_Wilddog_Coap_Observe_Data_T;
 
+#define WILDDOG_COAP_BLOCK_MAXSZX 6 //1024 bytes, the largest block of rfc7959
+#define WILDDOG_COAP_BLOCK_SIZE(szx) (16 << (szx))
+#define WILDDOG_COAP_BLOCK_OPTLEN 4 //block option head and 3 bytes value
+#define WILDDOG_COAP_BLOCK_BITS 32 //blocks can be tracked after the done ones
+
+#if WILDDOG_COAP_BLOCK_WINDOW < 1 || WILDDOG_COAP_BLOCK_WINDOW > WILDDOG_COAP_BLOCK_BITS
+#error "WILDDOG_COAP_BLOCK_WINDOW must be 1~32!"
+#endif
+
+typedef enum{
+    WILDDOG_COAP_BLOCK_NONE = 0,
+    WILDDOG_COAP_BLOCK_SEND,//block1, the request payload
+    WILDDOG_COAP_BLOCK_RECV//block2, the response payload
+}_Wilddog_Coap_Block_Dir_T;
+
+/*
+ * proto data of get/set/push/observe packets. Conn layer frees it by one wfree,
+ * so the payload buffer follows it, and retransmit resets the observe data,
+ * so it must be the first.
+*/
+typedef struct _WILDDOG_COAP_BLOCK_DATA{
+    _Wilddog_Coap_Observe_Data_T observe;
+    Wilddog_Conn_Pkt_Data_T *p_send;//the stored request, conn layer resends it
+    u8 d_dir;
+    u8 d_szx;
+    s32 d_last;//the last block, -1 if not known yet
+    u32 d_done;//blocks before it are all acked(block1) or received(block2)
+    u32 d_next;//the next block to send(block1) or to request(block2)
+    u32 d_bits;//acked or received blocks from d_done, bit 0 is d_done
+    u32 d_stored;//block1: the block in p_send, block2: the highest received
+    u32 d_index;//block2: observe index of the transfer
+    u32 d_len;//payload length
+    u32 d_size;//buffer size
+}_Wilddog_Coap_Block_Data_T;
+
+#define WILDDOG_COAP_BLOCK_BUF(p_block) ((u8*)((p_block) + 1))
+
+/*the largest datagram, udp can not carry more than 64k.*/
+#define WILDDOG_COAP_RECV_MAXSIZE (WILDDOG_PROTO_RECV_SIZE > 65535 ? \
+                                   65535 : WILDDOG_PROTO_RECV_SIZE)
+#define WILDDOG_COAP_RECV_SMALL 256
+#define WILDDOG_COAP_RECV_CLASS_NUM 3
+
+/*
+ * a receive buffer of the pool, the data follows it. the received pdu is a
+ * view over the data, it is kept here and goes with the buffer.
+*/
+typedef struct _WILDDOG_COAP_RECV_BUF{
+    struct _WILDDOG_COAP_RECV_BUF *next;
+    u32 d_class;
+    coap_pdu_t d_pdu;
+}_Wilddog_Coap_Recv_Buf_T;
+
+#define WILDDOG_COAP_RECV_PDU(ptr) (&((_Wilddog_Coap_Recv_Buf_T*)(ptr) - 1)->d_pdu)
+
 /*
- * Function:    _wilddog_conn_mallocRecvBuffer
- * Description: conn layer malloc the buffer which used for recv
+ * receive buffers shared by all protocols, only the sdk i/o thread touches
+ * them. a datagram is read into the smallest class can hold it, acks and 
+ * small responses take the small one, blocks take the mtu one.
+*/
+typedef struct _WILDDOG_COAP_RECV_POOL{
+    _Wilddog_Coap_Recv_Buf_T *p_free[WILDDOG_COAP_RECV_CLASS_NUM];
+    u32 d_freeNum[WILDDOG_COAP_RECV_CLASS_NUM];
+    u32 d_bytes;//bytes malloced, in use and free
+    u32 d_refs;//protocols using the pool
+}_Wilddog_Coap_Recv_Pool_T;
+
+STATIC const u32 l_coap_recvClass[WILDDOG_COAP_RECV_CLASS_NUM] = 
+{
+    WILDDOG_COAP_RECV_SMALL,
+    WILDDOG_PATH_MTU,
+    WILDDOG_COAP_RECV_MAXSIZE
+};
+STATIC _Wilddog_Coap_Recv_Pool_T l_coap_recvPool;
+
+/*
+ * Function:    _wilddog_coap_mallocRecvBuffer
+ * Description: get a buffer from the receive pool.
  *   
- * Input:       N/A
- * Output:      N/A
+ * Input:       size: the datagram length, 0 if not known.
+ * Output:      p_len: the buffer length.
  * Return:      the buffer's pointer
 */
-STATIC u8* WD_SYSTEM _wilddog_coap_mallocRecvBuffer(Wilddog_Protocol_T *proto)
+STATIC u8* WD_SYSTEM _wilddog_coap_mallocRecvBuffer(u32 size, u32 *p_len)
 {   
-    int i = 0;
-    u8* buffer = NULL;  
+    int i, cls = -1;
+    _Wilddog_Coap_Recv_Buf_T *p_buf;
+
+    if(0 == size || size > WILDDOG_COAP_RECV_MAXSIZE)
+        size = WILDDOG_COAP_RECV_MAXSIZE;
+    for(i = 0; i < WILDDOG_COAP_RECV_CLASS_NUM; i++){
+        if(l_coap_recvClass[i] >= size && \
+           (cls < 0 || l_coap_recvClass[i] < l_coap_recvClass[cls]))
+            cls = i;
+    }
+    wilddog_assert(cls >= 0, NULL);
 
-    wilddog_assert(proto, NULL);
-    
-    for(i = 0; i < WILDDOG_PROTO_RECV_BUF_NUM; i++){
-        if(proto->recv_buf[i].isused == FALSE)  
-        {       
-            buffer = proto->recv_buf[i].data;       
-            proto->recv_buf[i].isused = TRUE;       
-            memset(buffer, 0, WILDDOG_PROTO_MAXSIZE);   
+    p_buf = l_coap_recvPool.p_free[cls];
+    if(p_buf){
+        l_coap_recvPool.p_free[cls] = p_buf->next;
+        l_coap_recvPool.d_freeNum[cls]--;
+    }
+    else{
+        p_buf = (_Wilddog_Coap_Recv_Buf_T*)wmalloc( \
+                sizeof(_Wilddog_Coap_Recv_Buf_T) + l_coap_recvClass[cls]);
+        if(NULL == p_buf){
+            wilddog_debug_level(WD_DEBUG_ERROR, "Malloc failed!");
+            return NULL;
         }
+        p_buf->d_class = cls;
+        l_coap_recvPool.d_bytes += l_coap_recvClass[cls];
     }
-     
-    return buffer;
+    p_buf->next = NULL;
+    *p_len = l_coap_recvClass[cls];
+    return (u8*)(p_buf + 1);
 }
 
 /*
- * Function:    _wilddog_conn_freeRecvBuffer
- * Description: conn layer free the buffer which used for recv
+ * Function:    _wilddog_coap_freeRecvBuffer
+ * Description: put the buffer back to the receive pool, it is freed if the
+ *              pool already keeps enough of its class.
  *   
  * Input:       ptr: the buffer's pointer
  * Output:      N/A
  * Return:      N/A
 */
-STATIC void WD_SYSTEM _wilddog_coap_freeRecvBuffer(Wilddog_Protocol_T *proto,u8* ptr)
+STATIC void WD_SYSTEM _wilddog_coap_freeRecvBuffer(u8* ptr)
 {
-    int i;
+    _Wilddog_Coap_Recv_Buf_T *p_buf;
+    u32 cls;
 
-    if(!ptr || !proto)
+    if(!ptr)
         return;
 
-    for(i = 0; i < WILDDOG_PROTO_RECV_BUF_NUM; i++){   
-        if(proto->recv_buf[i].data == ptr && TRUE == proto->recv_buf[i].isused){
-            proto->recv_buf[i].isused = FALSE;
-        }
+    p_buf = (_Wilddog_Coap_Recv_Buf_T*)ptr - 1;
+    cls = p_buf->d_class;
+#ifdef WILDDOG_SELFTEST
+    ramtest_caculate_protocolRam(sizeof(Wilddog_Protocol_T) + \
+            l_coap_recvPool.d_bytes / \
+            (l_coap_recvPool.d_refs ? l_coap_recvPool.d_refs : 1));
+#endif
+    if(l_coap_recvPool.d_freeNum[cls] < WILDDOG_PROTO_RECV_POOL_NUM && \
+       l_coap_recvPool.d_refs > 0){
+        p_buf->next = l_coap_recvPool.p_free[cls];
+        l_coap_recvPool.p_free[cls] = p_buf;
+        l_coap_recvPool.d_freeNum[cls]++;
+        return;
     }
+    l_coap_recvPool.d_bytes -= l_coap_recvClass[cls];
+    wfree(p_buf);
+    return;
+}
+
+/*
+ * Function:    _wilddog_coap_trimRecvBuffer
+ * Description: free all the buffers kept by the receive pool.
+ *   
+ * Input:       N/A
+ * Output:      N/A
+ * Return:      N/A
+*/
+STATIC void WD_SYSTEM _wilddog_coap_trimRecvBuffer(void)
+{
+    int i;
+    _Wilddog_Coap_Recv_Buf_T *p_buf;
 
+    for(i = 0; i < WILDDOG_COAP_RECV_CLASS_NUM; i++){
+        while(NULL != (p_buf = l_coap_recvPool.p_free[i])){
+            l_coap_recvPool.p_free[i] = p_buf->next;
+            l_coap_recvPool.d_bytes -= l_coap_recvClass[i];
+            wfree(p_buf);
+        }
+        l_coap_recvPool.d_freeNum[i] = 0;
+    }
     return;
 }
 
@@ -476,13 +603,237 @@ STATIC int WD_SYSTEM _wilddog_coap_countSize(Wilddog_Coap_Pkt_T pkt){
     }
     //may be observe option, observe 0
     size += 5 + 1;
+    //may be size2 option, no value
+    size += 5;
     
     //payload, with 0xff ahead.
     size += pkt.data_len + 1;
     return size;
 }
+/*".cs=<short token>" as an uri query option, header is 5 bytes at most.*/
+#define WILDDOG_COAP_URL_CS_MAXLEN (5 + sizeof(WILDDOG_COAP_SESSION_QUERY) + \
+                                    WILDDOG_CONN_SESSION_SHORT_LEN)
+/*
+ * url options kept in the url cache, so requests to the same url need not 
+ * split and encode it again. host, path and query options follow it as
+ * encoded in the pdu, then the strings they are built from, to find out the
+ * url is changed. the .cs query option is encoded again only when the short
+ * token changes.
+*/
+typedef struct _WILDDOG_COAP_URL_OPTS{
+    u16 d_optLen;//host, path and query options
+    u16 d_lastOpt;//the last option number in them
+    u16 d_keyLen;//the strings
+    u16 d_csLen;//.cs query option, 0 if not encoded yet
+    u8 d_sid[WILDDOG_CONN_SESSION_SHORT_LEN];//the short token in .cs
+    u8 d_cs[WILDDOG_COAP_URL_CS_MAXLEN];
+}_Wilddog_Coap_Url_Opts_T;
+
+#define WILDDOG_COAP_URL_OPTS_BUF(p_opts) ((u8*)((p_opts) + 1))
+#define WILDDOG_COAP_URL_OPTS_KEY(p_opts) \
+            (WILDDOG_COAP_URL_OPTS_BUF(p_opts) + (p_opts)->d_optLen)
+
+/*
+ * Function:    _wilddog_coap_urlOpts_key
+ * Description: write the url strings as the cache key, or only count it if
+ *              p_key is NULL. every string has a byte ahead, 0 if it is NULL.
+ * Input:       url: the url.
+ * Output:      p_key: the key.
+ * Return:      the key length.
+*/
+STATIC u32 WD_SYSTEM _wilddog_coap_urlOpts_key(Wilddog_Url_T *url, u8 *p_key)
+{
+    Wilddog_Str_T *str[3];
+    u32 i, len, total = 0;
+
+    str[0] = url->p_url_host;
+    str[1] = url->p_url_path;
+    str[2] = url->p_url_query;
+    for(i = 0; i < 3; i++){
+        len = str[i] ? strlen((const char*)str[i]) + 1 : 0;
+        if(p_key){
+            p_key[total] = str[i] ? 1 : 0;
+            if(len)
+                memcpy(&p_key[total + 1], str[i], len);
+        }
+        total += 1 + len;
+    }
+    return total;
+}
+
+/*
+ * Function:    _wilddog_coap_urlOpts_isMatch
+ * Description: check the url is the one the cached options built from.
+ * Input:       p_opts: the cached options.
+ *              url: the url.
+ * Output:      N/A
+ * Return:      TRUE or FALSE.
+*/
+STATIC BOOL WD_SYSTEM _wilddog_coap_urlOpts_isMatch
+    (
+    _Wilddog_Coap_Url_Opts_T *p_opts, 
+    Wilddog_Url_T *url
+    )
+{
+    Wilddog_Str_T *str[3];
+    u8 *p_key = WILDDOG_COAP_URL_OPTS_KEY(p_opts);
+    u32 i;
+
+    str[0] = url->p_url_host;
+    str[1] = url->p_url_path;
+    str[2] = url->p_url_query;
+    for(i = 0; i < 3; i++){
+        if(p_key[0] != (str[i] ? 1 : 0))
+            return FALSE;
+        p_key++;
+        if(str[i]){
+            if(strcmp((const char*)p_key, (const char*)str[i]))
+                return FALSE;
+            p_key += strlen((const char*)p_key) + 1;
+        }
+    }
+    return TRUE;
+}
+
+/*
+ * Function:    _wilddog_coap_urlOpts_build
+ * Description: encode the host, path and query options of the url once, 
+ *              and keep them in the url cache.
+ * Input:       url: the url.
+ * Output:      N/A
+ * Return:      the cached options, or NULL if failed.
+*/
+STATIC _Wilddog_Coap_Url_Opts_T * WD_SYSTEM _wilddog_coap_urlOpts_build
+    (
+    Wilddog_Url_T *url
+    )
+{
+    Wilddog_Coap_Pkt_T pkt;
+    coap_pdu_t *pdu;
+    _Wilddog_Coap_Url_Opts_T *p_opts;
+    u32 optLen, keyLen;
+
+    memset(&pkt, 0, sizeof(pkt));
+    pkt.url = url;
+    pdu = coap_pdu_init(0, 0, 0, _wilddog_coap_countSize(pkt));
+    if(NULL == pdu)
+        return NULL;
+    coap_add_option(pdu,COAP_OPTION_URI_HOST,strlen((const char*)url->p_url_host),url->p_url_host);
+    _wilddog_coap_addPath(pdu,(char*)url->p_url_path);
+    if(url->p_url_query)
+        _wilddog_coap_addQuery(pdu, (char*)url->p_url_query);
+
+    optLen = pdu->length - sizeof(coap_hdr_t);
+    keyLen = _wilddog_coap_urlOpts_key(url, NULL);
+    p_opts = (_Wilddog_Coap_Url_Opts_T*)wmalloc(sizeof(_Wilddog_Coap_Url_Opts_T) + \
+                                               optLen + keyLen);
+    if(NULL == p_opts){
+        coap_delete_pdu(pdu);
+        return NULL;
+    }
+    p_opts->d_optLen = optLen;
+    p_opts->d_lastOpt = pdu->max_delta;
+    p_opts->d_keyLen = keyLen;
+    memcpy(WILDDOG_COAP_URL_OPTS_BUF(p_opts), pdu->hdr + 1, optLen);
+    _wilddog_coap_urlOpts_key(url, WILDDOG_COAP_URL_OPTS_KEY(p_opts));
+    coap_delete_pdu(pdu);
+
+    if(url->p_url_cache->p_data)
+        wfree(url->p_url_cache->p_data);
+    url->p_url_cache->p_data = (u8*)p_opts;
+    url->p_url_cache->d_len = sizeof(_Wilddog_Coap_Url_Opts_T) + optLen + keyLen;
+    return p_opts;
+}
+
+/*
+ * Function:    _wilddog_coap_urlOpts_get
+ * Description: get the cached options of the url, with the .cs query option 
+ *              of the short token, build them if the url or token changed.
+ * Input:       url: the url.
+ *              p_sid: the short token.
+ * Output:      N/A
+ * Return:      the cached options, or NULL if the url can not be cached.
+*/
+STATIC _Wilddog_Coap_Url_Opts_T * WD_SYSTEM _wilddog_coap_urlOpts_get
+    (
+    Wilddog_Url_T *url,
+    u8 *p_sid
+    )
+{
+    _Wilddog_Coap_Url_Opts_T *p_opts;
+    u8 value[sizeof(WILDDOG_COAP_SESSION_QUERY) + WILDDOG_CONN_SESSION_SHORT_LEN];
+    u32 sidLen;
+
+    if(NULL == url->p_url_cache || NULL == url->p_url_host || NULL == p_sid)
+        return NULL;
+    sidLen = strlen((const char*)p_sid);
+    if(sidLen >= WILDDOG_CONN_SESSION_SHORT_LEN)
+        return NULL;
+
+    p_opts = (_Wilddog_Coap_Url_Opts_T*)url->p_url_cache->p_data;
+    if(NULL == p_opts || FALSE == _wilddog_coap_urlOpts_isMatch(p_opts, url)){
+        p_opts = _wilddog_coap_urlOpts_build(url);
+        if(NULL == p_opts)
+            return NULL;
+    }
+    //short token changed, encode .cs again.
+    if(0 == p_opts->d_csLen || memcmp(p_opts->d_sid, p_sid, sidLen) || \
+       0 != p_opts->d_sid[sidLen]){
+        sprintf((char*)value, "%s=%s",WILDDOG_COAP_SESSION_QUERY,(const char*)p_sid);
+        p_opts->d_csLen = coap_opt_encode(p_opts->d_cs, sizeof(p_opts->d_cs), \
+                                          COAP_OPTION_URI_QUERY - p_opts->d_lastOpt, \
+                                          value, strlen((const char*)value));
+        memset(p_opts->d_sid, 0, sizeof(p_opts->d_sid));
+        memcpy(p_opts->d_sid, p_sid, sidLen);
+        if(0 == p_opts->d_csLen)
+            return NULL;
+    }
+    return p_opts;
+}
+
+/*
+ * Function:    _wilddog_coap_urlOpts_add
+ * Description: copy the cached options into the pdu, after the token.
+ * Input:       pdu: the pdu, it must have room.
+ *              p_opts: the cached options.
+ * Output:      N/A
+ * Return:      N/A
+*/
+STATIC void WD_SYSTEM _wilddog_coap_urlOpts_add
+    (
+    coap_pdu_t *pdu,
+    _Wilddog_Coap_Url_Opts_T *p_opts
+    )
+{
+    u8 *p_buf = (u8*)pdu->hdr + pdu->length;
+
+    memcpy(p_buf, WILDDOG_COAP_URL_OPTS_BUF(p_opts), p_opts->d_optLen);
+    memcpy(p_buf + p_opts->d_optLen, p_opts->d_cs, p_opts->d_csLen);
+    pdu->length += p_opts->d_optLen + p_opts->d_csLen;
+    pdu->max_delta = COAP_OPTION_URI_QUERY;
+    pdu->data = NULL;
+}
+
+/*
+ * Function:    _wilddog_coap_send_makePkt
+ * Description: make a request of the url and send it if arg.isSend, the
+ *              request is stored in *arg.send_pkt.
+ * Input:       arg: the request.
+ *              isNeedCs: add the .cs query option of the short token or not.
+ *              observeStat: add the observe option or not.
+ *              p_etag/etagLen: the etag option, NULL if not needed.
+ * Output:      N/A
+ * Return:      WILDDOG_ERR_NOERR if success.
+*/
 //now we only care one packet, do not thinking about partition.
-STATIC Wilddog_Return_T WD_SYSTEM _wilddog_coap_send_sendPkt(Wilddog_Coap_Sendpkt_Arg_T arg,BOOL isNeedCs, Wilddog_Coap_Observe_Stat_T observeStat)
+STATIC Wilddog_Return_T WD_SYSTEM _wilddog_coap_send_makePkt
+    (
+    Wilddog_Coap_Sendpkt_Arg_T arg,
+    BOOL isNeedCs, 
+    Wilddog_Coap_Observe_Stat_T observeStat,
+    u8 *p_etag,
+    u8 etagLen
+    )
 {
     Wilddog_Return_T ret = WILDDOG_ERR_INVALID;
     Wilddog_Coap_Pkt_T pkt;
@@ -491,6 +842,7 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_coap_send_sendPkt(Wilddog_Coap_Sendpk
     Wilddog_Str_T *new_query = NULL;
     int query_len = 0;
     Wilddog_Str_T *tmp = NULL;
+    _Wilddog_Coap_Url_Opts_T *p_opts = NULL;
     
     wilddog_assert(arg.protocol&&arg.url&&arg.token&&arg.send_pkt, WILDDOG_ERR_NULL);
 
@@ -513,6 +865,25 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_coap_send_sendPkt(Wilddog_Coap_Sendpk
 
     pkt.url = arg.url;
 
+    //most requests go to the same urls, their options are cached, but the
+    //etag goes before them.
+    if(TRUE == isNeedCs && WILDDOG_COAP_OBSERVE_NOOBSERVE == observeStat && \
+       NULL == p_etag)
+        p_opts = _wilddog_coap_urlOpts_get(arg.url, arg.p_session_info);
+    if(p_opts){
+        //header, token, options, size2 and payload with 0xff ahead.
+        pkt.size = 4 + pkt.token_length + p_opts->d_optLen + p_opts->d_csLen + \
+                   5 + pkt.data_len + 1;
+        pdu = coap_pdu_init(pkt.type, pkt.code, pkt.mid, pkt.size);
+        if(NULL == pdu){
+            wilddog_debug_level(WD_DEBUG_ERROR, "Malloc failed!");
+            return WILDDOG_ERR_NULL;
+        }
+        coap_add_token(pdu, pkt.token_length, pkt.token);
+        _wilddog_coap_urlOpts_add(pdu, p_opts);
+        goto OPTIONS_DONE;
+    }
+
     if(TRUE == isNeedCs){
         //combine the short token with .cs query option, ".cs=<short token>", etc.
         if(NULL != arg.url->p_url_query){
@@ -537,6 +908,8 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_coap_send_sendPkt(Wilddog_Coap_Sendpk
 
     //count pkt size.
     pkt.size = _wilddog_coap_countSize(pkt);
+    if(p_etag)
+        pkt.size += 1 + etagLen;
 
     //make a coap packet
     pdu = coap_pdu_init(pkt.type, pkt.code, pkt.mid, pkt.size);
@@ -551,6 +924,9 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_coap_send_sendPkt(Wilddog_Coap_Sendpk
     coap_add_token(pdu, pkt.token_length, pkt.token);
     //add host
     coap_add_option(pdu,COAP_OPTION_URI_HOST,strlen((const char*)pkt.url->p_url_host),pkt.url->p_url_host);
+    //add etag
+    if(p_etag)
+        coap_add_option(pdu, COAP_OPTION_ETAG, etagLen, p_etag);
     if(WILDDOG_COAP_OBSERVE_NOOBSERVE != observeStat){
         u8 observe_value = (WILDDOG_COAP_OBSERVE_ON == observeStat)?0:1;
         coap_add_option(pdu,COAP_OPTION_OBSERVE,sizeof(observe_value),&observe_value);
@@ -560,6 +936,12 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_coap_send_sendPkt(Wilddog_Coap_Sendpk
     //add query
     if(pkt.url->p_url_query)
         _wilddog_coap_addQuery(pdu, (char*)pkt.url->p_url_query);
+OPTIONS_DONE:
+    //value requests ask the total size, then blocks can be asked in parallel.
+    if(COAP_REQUEST_GET == pkt.code && TRUE == isNeedCs && \
+       WILDDOG_COAP_OBSERVE_OFF != observeStat){
+        coap_add_option(pdu, COAP_OPTION_SIZE2, 0, NULL);
+    }
     //add data
     if(pkt.data)
         coap_add_data(pdu,pkt.data_len, pkt.data);
@@ -583,7 +965,7 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_coap_send_sendPkt(Wilddog_Coap_Sendpk
         out_pkt->len = (u32)(pdu->length&0xffff);
     }
 END:
-    if(isNeedCs){
+    if(isNeedCs && NULL == p_opts){
         //resume old query
         arg.url->p_url_query = tmp;
         if(new_query)
@@ -591,6 +973,570 @@ END:
     }
     return ret;
 }
+
+STATIC Wilddog_Return_T WD_SYSTEM _wilddog_coap_send_sendPkt(Wilddog_Coap_Sendpkt_Arg_T arg,BOOL isNeedCs, Wilddog_Coap_Observe_Stat_T observeStat)
+{
+    return _wilddog_coap_send_makePkt(arg, isNeedCs, observeStat, NULL, 0);
+}
+/*
++-----+---+---+---+---+--------+--------+--------+---------+
+| No. | C | U | N | R | Name   | Format | Length | Default |
++-----+---+---+---+---+--------+--------+--------+---------+
+|  23 | x | x | - | - | Block2 | uint   | 0-3 B  | (none)  |
+|  27 | x | x | - | - | Block1 | uint   | 0-3 B  | (none)  |
+|  28 |   |   | x |   | Size2  | uint   | 0-4 B  | (none)  |
++-----+---+---+---+---+--------+--------+--------+---------+
+*/
+STATIC BOOL WD_SYSTEM _wilddog_coap_getRecvUint(coap_pdu_t * pdu, u16 type, u32 *p_value)
+{
+    u16 len;
+    coap_opt_t *p_op =NULL;
+    coap_opt_iterator_t d_oi;
+    u8 *option_value = NULL;
+    
+    wilddog_assert(pdu && p_value, FALSE);
+
+    *p_value = 0;
+    p_op = coap_check_option(pdu,type,&d_oi);
+    if(NULL == p_op)
+        return FALSE;
+    len = coap_opt_length(p_op);
+    if(len > 4){
+        wilddog_debug_level(WD_DEBUG_ERROR, "Get an option %d but length is %d!",type,len);
+        return FALSE;
+    }
+    option_value = coap_opt_value(p_op);
+    //zero length means value 0, uint option is in big endian.
+    if(len && option_value)
+        _wilddog_coap_ntoh((u8*)p_value,sizeof(u32),option_value,len);
+    return TRUE;
+}
+
+/*
+ * Function:    _wilddog_coap_addBlock
+ * Description: add block1 or block2 option to coap packages.
+ * Input:       pdu: coap pdu.
+ *              type: COAP_OPTION_BLOCK1 or COAP_OPTION_BLOCK2.
+ *              num: the block number.
+ *              more: more blocks after it or not.
+ *              szx: the block size is 16 << szx.
+ * Output:      N/A
+ * Return:      the option size, 0 means failed.
+*/
+STATIC size_t WD_SYSTEM _wilddog_coap_addBlock
+    (
+    coap_pdu_t *pdu,
+    u16 type,
+    u32 num,
+    BOOL more,
+    u8 szx
+    )
+{
+    u8 value[3];
+    u32 block = (num << 4) | ((more ? 1 : 0) << 3) | (szx & 0x07);
+    int len = 0;
+
+    //big endian and no leading zero, block 0 of 16 bytes has no value.
+    if(block > 0xffff)
+        value[len++] = (u8)((block >> 16) & 0xff);
+    if(block > 0xff)
+        value[len++] = (u8)((block >> 8) & 0xff);
+    if(block)
+        value[len++] = (u8)(block & 0xff);
+    return coap_add_option(pdu, type, len, value);
+}
+
+/*
+ * Function:    _wilddog_coap_block_getSzx
+ * Description: get the largest block which can be sent in one datagram.
+ * Input:       headLen: coap header and options length, no payload.
+ * Output:      N/A
+ * Return:      the block szx, block size is 16 << szx.
+*/
+STATIC u8 WD_SYSTEM _wilddog_coap_block_getSzx(u32 headLen)
+{
+    u8 szx = WILDDOG_COAP_BLOCK_MAXSZX;
+
+    //datagram = ip/udp/dtls + coap head + block option + 0xff + payload
+    while(szx > 0 && WILDDOG_PATH_OVERHEAD + headLen + \
+          WILDDOG_COAP_BLOCK_OPTLEN + 1 + WILDDOG_COAP_BLOCK_SIZE(szx) > \
+          WILDDOG_PATH_MTU){
+        szx--;
+    }
+    return szx;
+}
+
+/*
+ * Function:    _wilddog_coap_block_alloc
+ * Description: malloc the block data, or enlarge it, the old content is kept.
+ * Input:       p_proto_data: the pointer of the proto data.
+ *              size: the payload buffer size wanted.
+ * Output:      p_proto_data: the new proto data.
+ * Return:      the block data, NULL if malloc failed, the old one is kept.
+*/
+STATIC _Wilddog_Coap_Block_Data_T* WD_SYSTEM _wilddog_coap_block_alloc
+    (
+    u8 **p_proto_data,
+    u32 size
+    )
+{
+    _Wilddog_Coap_Block_Data_T *p_old = (_Wilddog_Coap_Block_Data_T*)*p_proto_data;
+    _Wilddog_Coap_Block_Data_T *p_new = NULL;
+
+    if(p_old && p_old->d_size >= size)
+        return p_old;
+    p_new = (_Wilddog_Coap_Block_Data_T*)wmalloc(sizeof(_Wilddog_Coap_Block_Data_T) + size);
+    if(NULL == p_new){
+        wilddog_debug_level(WD_DEBUG_ERROR, "Malloc block buffer %lu failed!",(unsigned long)size);
+        return NULL;
+    }
+    if(p_old){
+        memcpy(p_new, p_old, sizeof(_Wilddog_Coap_Block_Data_T) + p_old->d_size);
+        wfree(p_old);
+    }else{
+        p_new->d_last = -1;
+    }
+    p_new->d_size = size;
+    *p_proto_data = (u8*)p_new;
+    return p_new;
+}
+
+/*
+ * Function:    _wilddog_coap_block_makePdu
+ * Description: make one block request from the stored request, it has the same
+ *              token and options but a new message id, the observe, etag, 
+ *              block and size options are replaced by the block option.
+ * Input:       src: the stored request.
+ *              type: COAP_OPTION_BLOCK1 or COAP_OPTION_BLOCK2.
+ *              num/more/szx: the block.
+ *              data/len: the block payload, block2 requests have no payload.
+ * Output:      N/A
+ * Return:      the new pdu, or NULL if failed.
+*/
+STATIC coap_pdu_t* WD_SYSTEM _wilddog_coap_block_makePdu
+    (
+    coap_pdu_t *src,
+    u16 type,
+    u32 num,
+    BOOL more,
+    u8 szx,
+    u8 *data,
+    u32 len
+    )
+{
+    coap_pdu_t *pdu = NULL;
+    coap_opt_t *opt = NULL;
+    coap_opt_iterator_t d_oi;
+    BOOL isAdded = FALSE;
+
+    wilddog_assert(src, NULL);
+
+    pdu = coap_pdu_init(COAP_MESSAGE_CON, src->hdr->code, _wilddog_coap_getMid(), \
+                        src->length + WILDDOG_COAP_BLOCK_OPTLEN + 1 + len);
+    if(NULL == pdu){
+        wilddog_debug_level(WD_DEBUG_ERROR, "Malloc failed!");
+        return NULL;
+    }
+    coap_add_token(pdu, src->hdr->token_length, src->hdr->token);
+    if(coap_option_iterator_init(src, &d_oi, COAP_OPT_ALL)){
+        while(NULL != (opt = coap_option_next(&d_oi))){
+            if(COAP_OPTION_OBSERVE == d_oi.type || \
+               COAP_OPTION_ETAG == d_oi.type || \
+               COAP_OPTION_BLOCK1 == d_oi.type || \
+               COAP_OPTION_BLOCK2 == d_oi.type || \
+               COAP_OPTION_SIZE2 == d_oi.type || \
+               COAP_OPTION_SIZE1 == d_oi.type){
+                continue;
+            }
+            //options must be in order
+            if(FALSE == isAdded && d_oi.type > type){
+                _wilddog_coap_addBlock(pdu, type, num, more, szx);
+                isAdded = TRUE;
+            }
+            coap_add_option(pdu, d_oi.type, coap_opt_length(opt), coap_opt_value(opt));
+        }
+    }
+    if(FALSE == isAdded)
+        _wilddog_coap_addBlock(pdu, type, num, more, szx);
+    if(data && len)
+        coap_add_data(pdu, len, data);
+    return pdu;
+}
+
+/*
+ * Function:    _wilddog_coap_block1_send
+ * Description: send one block of the request payload.
+ * Input:       protocol: the protocol.
+ *              p_block: the block data.
+ *              num: the block number.
+ *              isStore: store it as the request conn layer resends or not.
+ *              isSend: send it now or not.
+ * Output:      N/A
+ * Return:      WILDDOG_ERR_NOERR or error code.
+*/
+STATIC Wilddog_Return_T WD_SYSTEM _wilddog_coap_block1_send
+    (
+    Wilddog_Protocol_T *protocol,
+    _Wilddog_Coap_Block_Data_T *p_block,
+    u32 num,
+    BOOL isStore,
+    BOOL isSend
+    )
+{
+    Wilddog_Return_T ret = WILDDOG_ERR_NOERR;
+    u32 size = WILDDOG_COAP_BLOCK_SIZE(p_block->d_szx);
+    u32 offset = num * size;
+    u32 len = p_block->d_len - offset;
+    coap_pdu_t *pdu = NULL;
+
+    if(len > size)
+        len = size;
+    pdu = _wilddog_coap_block_makePdu((coap_pdu_t*)p_block->p_send->data, \
+                                      COAP_OPTION_BLOCK1, num, \
+                                      num < (u32)p_block->d_last, \
+                                      p_block->d_szx, \
+                                      WILDDOG_COAP_BLOCK_BUF(p_block) + offset, len);
+    if(NULL == pdu)
+        return WILDDOG_ERR_NULL;
+    if(TRUE == isSend){
+        if(_wilddog_sec_send(protocol, pdu->hdr, pdu->length) < 0){
+            wilddog_debug_level(WD_DEBUG_ERROR, "Send block %lu failed.",(unsigned long)num);
+            ret = WILDDOG_ERR_SENDERR;
+        }
+    }
+    if(TRUE == isStore){
+        coap_delete_pdu((coap_pdu_t*)p_block->p_send->data);
+        p_block->p_send->data = (u8*)pdu;
+        p_block->p_send->len = (u32)(pdu->length&0xffff);
+        p_block->d_stored = num;
+    }else{
+        coap_delete_pdu(pdu);
+    }
+    return ret;
+}
+
+/*
+ * Function:    _wilddog_coap_block1_fill
+ * Description: keep the window of request blocks full. The lowest unacked
+ *              block is stored, so a lost block is resent by conn layer's
+ *              retransmit, and the last block is held until all the others
+ *              are acked, because it asks server to handle the whole payload.
+ * Input:       protocol: the protocol.
+ *              p_block: the block data.
+ * Output:      N/A
+ * Return:      N/A
+*/
+STATIC void WD_SYSTEM _wilddog_coap_block1_fill
+    (
+    Wilddog_Protocol_T *protocol,
+    _Wilddog_Coap_Block_Data_T *p_block
+    )
+{
+    if(p_block->d_stored != p_block->d_done){
+        BOOL isSend = (p_block->d_next <= p_block->d_done);
+        _wilddog_coap_block1_send(protocol, p_block, p_block->d_done, TRUE, isSend);
+        if(isSend)
+            p_block->d_next = p_block->d_done + 1;
+    }
+    while(p_block->d_next < (u32)p_block->d_last && \
+          p_block->d_next < p_block->d_done + WILDDOG_COAP_BLOCK_WINDOW){
+        _wilddog_coap_block1_send(protocol, p_block, p_block->d_next, FALSE, TRUE);
+        p_block->d_next++;
+    }
+}
+
+/*
+ * Function:    _wilddog_coap_send_block1
+ * Description: send a set/push request, if the payload can not fit in one
+ *              datagram, send it block by block [rfc7959].
+ * Input:       arg: the send arg.
+ *              p_proto_data: the pointer of the proto data.
+ * Output:      p_proto_data: the block data, if blockwise.
+ * Return:      WILDDOG_ERR_NOERR or error code.
+*/
+STATIC Wilddog_Return_T WD_SYSTEM _wilddog_coap_send_block1
+    (
+    Wilddog_Coap_Sendpkt_Arg_T arg,
+    u8 **p_proto_data
+    )
+{
+    Wilddog_Return_T ret = WILDDOG_ERR_INVALID;
+    Wilddog_Coap_Sendpkt_Arg_T head_arg = arg;
+    _Wilddog_Coap_Block_Data_T *p_block = NULL;
+    coap_pdu_t *pdu = NULL;
+    u8 szx;
+
+    //a payload less than the mtu, no need to try.
+    if(NULL == p_proto_data || \
+       WILDDOG_PATH_OVERHEAD + arg.data_len + 4 + WILDDOG_COAP_TOKEN_LEN + 1 <= \
+       WILDDOG_PATH_MTU){
+        return _wilddog_coap_send_sendPkt(arg, TRUE, WILDDOG_COAP_OBSERVE_NOOBSERVE);
+    }
+    //make the request without payload, all blocks are made from it.
+    head_arg.data = NULL;
+    head_arg.data_len = 0;
+    head_arg.isSend = FALSE;
+    ret = _wilddog_coap_send_sendPkt(head_arg, TRUE, WILDDOG_COAP_OBSERVE_NOOBSERVE);
+    if(WILDDOG_ERR_NOERR != ret)
+        return ret;
+    pdu = (coap_pdu_t*)(*arg.send_pkt)->data;
+    szx = _wilddog_coap_block_getSzx(pdu->length);
+    if(WILDDOG_PATH_OVERHEAD + pdu->length + 1 + arg.data_len <= WILDDOG_PATH_MTU || \
+       NULL == (p_block = _wilddog_coap_block_alloc(p_proto_data, arg.data_len))){
+        //fits in one datagram after all, or no memory to hold the payload.
+        coap_delete_pdu(pdu);
+        (*arg.send_pkt)->data = NULL;
+        return _wilddog_coap_send_sendPkt(arg, TRUE, WILDDOG_COAP_OBSERVE_NOOBSERVE);
+    }
+    memcpy(WILDDOG_COAP_BLOCK_BUF(p_block), arg.data, arg.data_len);
+    p_block->p_send = *arg.send_pkt;
+    p_block->d_dir = WILDDOG_COAP_BLOCK_SEND;
+    p_block->d_szx = szx;
+    p_block->d_len = arg.data_len;
+    p_block->d_last = (arg.data_len - 1) / WILDDOG_COAP_BLOCK_SIZE(szx);
+    p_block->d_done = 0;
+    p_block->d_bits = 0;
+    p_block->d_next = 1;
+    //block 0 takes the place of the head, so conn layer resends it.
+    ret = _wilddog_coap_block1_send(arg.protocol, p_block, 0, TRUE, arg.isSend);
+    if(WILDDOG_ERR_NULL == ret){
+        p_block->d_dir = WILDDOG_COAP_BLOCK_NONE;
+        coap_delete_pdu(pdu);
+        (*arg.send_pkt)->data = NULL;
+        return _wilddog_coap_send_sendPkt(arg, TRUE, WILDDOG_COAP_OBSERVE_NOOBSERVE);
+    }
+    wilddog_debug_level(WD_DEBUG_LOG, "Send %lu bytes in %ld blocks of %d bytes", \
+                        (unsigned long)arg.data_len, (long)(p_block->d_last + 1), \
+                        WILDDOG_COAP_BLOCK_SIZE(szx));
+    if(TRUE == arg.isSend)
+        _wilddog_coap_block1_fill(arg.protocol, p_block);
+    return ret;
+}
+
+/*
+ * Function:    _wilddog_coap_recv_block1
+ * Description: handle the response of a request sent block by block, 2.31 
+ *              means the block is acked, send the next ones.
+ * Input:       protocol: the protocol.
+ *              p_block: the block data.
+ *              pdu: the response.
+ *              error_code: the response code.
+ * Output:      N/A
+ * Return:      WILDDOG_PROTO_ERR_CONTINUE if the transfer goes on, else the
+ *              response code of the whole request.
+*/
+STATIC Wilddog_Return_T WD_SYSTEM _wilddog_coap_recv_block1
+    (
+    Wilddog_Protocol_T *protocol,
+    _Wilddog_Coap_Block_Data_T *p_block,
+    coap_pdu_t *pdu,
+    Wilddog_Return_T error_code
+    )
+{
+    u32 block = 0, num;
+    u8 szx;
+
+    if(COAP_RESPONSE_408 == pdu->hdr->code && \
+       p_block->d_done < (u32)p_block->d_last){
+        //server missed a block, wait for the lowest unacked one resent.
+        wilddog_debug_level(WD_DEBUG_WARN, "Block %lu incomplete, wait retransmit", \
+                            (unsigned long)p_block->d_done);
+        return WILDDOG_PROTO_ERR_CONTINUE;
+    }
+    if(COAP_RESPONSE_231 != pdu->hdr->code){
+        //the whole payload is handled, or failed.
+        p_block->d_dir = WILDDOG_COAP_BLOCK_NONE;
+        return error_code;
+    }
+    if(FALSE == _wilddog_coap_getRecvUint(pdu, COAP_OPTION_BLOCK1, &block))
+        return WILDDOG_PROTO_ERR_CONTINUE;
+    num = block >> 4;
+    szx = block & 0x07;
+    if(szx < p_block->d_szx && num == p_block->d_done){
+        //server wants smaller blocks, count the next one from the acked bytes.
+        u32 acked = (num + 1) * WILDDOG_COAP_BLOCK_SIZE(p_block->d_szx);
+        p_block->d_szx = szx;
+        p_block->d_done = acked / WILDDOG_COAP_BLOCK_SIZE(szx);
+        p_block->d_next = p_block->d_done;
+        p_block->d_bits = 0;
+        p_block->d_last = (p_block->d_len - 1) / WILDDOG_COAP_BLOCK_SIZE(szx);
+        p_block->d_stored = (u32)(-1);
+    }else if(szx == p_block->d_szx && num >= p_block->d_done && \
+             num < p_block->d_done + WILDDOG_COAP_BLOCK_BITS){
+        p_block->d_bits |= (u32)1 << (num - p_block->d_done);
+        while(p_block->d_bits & 1){
+            p_block->d_bits >>= 1;
+            p_block->d_done++;
+        }
+    }
+    _wilddog_coap_block1_fill(protocol, p_block);
+    return WILDDOG_PROTO_ERR_CONTINUE;
+}
+
+/*
+ * Function:    _wilddog_coap_block2_request
+ * Description: ask server for one block of the response.
+ * Input:       protocol: the protocol.
+ *              p_block: the block data.
+ *              num: the block number.
+ * Output:      N/A
+ * Return:      N/A
+*/
+STATIC void WD_SYSTEM _wilddog_coap_block2_request
+    (
+    Wilddog_Protocol_T *protocol,
+    _Wilddog_Coap_Block_Data_T *p_block,
+    u32 num
+    )
+{
+    coap_pdu_t *pdu = NULL;
+
+    pdu = _wilddog_coap_block_makePdu((coap_pdu_t*)p_block->p_send->data, \
+                                      COAP_OPTION_BLOCK2, num, FALSE, \
+                                      p_block->d_szx, NULL, 0);
+    if(pdu){
+        if(_wilddog_sec_send(protocol, pdu->hdr, pdu->length) < 0)
+            wilddog_debug_level(WD_DEBUG_ERROR, "Request block %lu failed.",(unsigned long)num);
+        coap_delete_pdu(pdu);
+    }
+}
+
+/*
+ * Function:    _wilddog_coap_recv_block2
+ * Description: handle a response which may be one block of the value, store
+ *              it by offset and ask for the next ones, the value is given
+ *              to conn layer when all blocks received. If the requests of
+ *              blocks lost, conn layer resends the stored request, block 0
+ *              comes again and the missing blocks are asked again.
+ * Input:       arg: the handle arg.
+ *              pdu: the response.
+ *              observe_index: the observe index of the response.
+ *              error_code: the response code.
+ * Output:      p_payload/p_payload_len: the whole value if received.
+ * Return:      WILDDOG_PROTO_ERR_CONTINUE if the transfer goes on, 
+ *              WILDDOG_ERR_IGNORE if it is a stale block, else the response 
+ *              code.
+*/
+STATIC Wilddog_Return_T WD_SYSTEM _wilddog_coap_recv_block2
+    (
+    Wilddog_Proto_Cmd_Arg_T *arg,
+    coap_pdu_t *pdu,
+    u32 observe_index,
+    u8 **p_payload,
+    u32 *p_payload_len,
+    Wilddog_Return_T error_code
+    )
+{
+    _Wilddog_Coap_Block_Data_T *p_block = (_Wilddog_Coap_Block_Data_T*)*arg->p_proto_data;
+    u32 block = 0, num, size, offset, total = 0, avail;
+    BOOL more;
+    u8 szx;
+
+    if(FALSE == _wilddog_coap_getRecvUint(pdu, COAP_OPTION_BLOCK2, &block)){
+        //a whole value, it replaces the transfer.
+        p_block->d_dir = WILDDOG_COAP_BLOCK_NONE;
+        return error_code;
+    }
+    num = block >> 4;
+    more = (block >> 3) & 0x01;
+    szx = block & 0x07;
+    if(szx > WILDDOG_COAP_BLOCK_MAXSZX){
+        wilddog_debug_level(WD_DEBUG_WARN, "Reserved block size %d!",szx);
+        return WILDDOG_ERR_IGNORE;
+    }
+    size = WILDDOG_COAP_BLOCK_SIZE(szx);
+    offset = num * size;
+    if(0 == num){
+        if(FALSE == more){
+            p_block->d_dir = WILDDOG_COAP_BLOCK_NONE;
+            return error_code;
+        }
+        if(WILDDOG_COAP_BLOCK_RECV == p_block->d_dir && \
+           szx == p_block->d_szx && observe_index == p_block->d_index){
+            //the request was resent, ask the missing blocks again.
+            p_block->d_next = p_block->d_done;
+            goto REQUEST;
+        }
+        _wilddog_coap_getRecvUint(pdu, COAP_OPTION_SIZE2, &total);
+        if(total > WILDDOG_PROTO_MAXSIZE)
+            goto TOO_LARGE;
+        if(NULL == p_block->p_send || \
+           NULL == (p_block = _wilddog_coap_block_alloc(arg->p_proto_data, \
+                                    total > size ? total : 2 * size))){
+            //can not ask more, give the first block.
+            wilddog_debug_level(WD_DEBUG_ERROR, "Can not receive blocks!");
+            return error_code;
+        }
+        p_block->d_dir = WILDDOG_COAP_BLOCK_RECV;
+        p_block->d_szx = szx;
+        p_block->d_index = observe_index;
+        p_block->d_last = total ? (s32)((total - 1) / size) : -1;
+        p_block->d_done = 0;
+        p_block->d_next = 1;
+        p_block->d_bits = 0;
+        p_block->d_stored = 0;
+        p_block->d_len = 0;
+    }else if(WILDDOG_COAP_BLOCK_RECV != p_block->d_dir || szx != p_block->d_szx){
+        //block of a finished or replaced transfer.
+        return WILDDOG_ERR_IGNORE;
+    }
+    if(num < p_block->d_done || \
+       num >= p_block->d_done + WILDDOG_COAP_BLOCK_BITS || \
+       (p_block->d_last >= 0 && num > (u32)p_block->d_last) || \
+       (p_block->d_bits & ((u32)1 << (num - p_block->d_done)))){
+        return WILDDOG_ERR_IGNORE;
+    }
+    if(offset + *p_payload_len > WILDDOG_PROTO_MAXSIZE)
+        goto TOO_LARGE;
+    if(offset + *p_payload_len > p_block->d_size){
+        u32 new_size = p_block->d_size * 2;
+        if(new_size < offset + *p_payload_len)
+            new_size = offset + *p_payload_len;
+        if(new_size > WILDDOG_PROTO_MAXSIZE)
+            new_size = WILDDOG_PROTO_MAXSIZE;
+        p_block = _wilddog_coap_block_alloc(arg->p_proto_data, new_size);
+        if(NULL == p_block)
+            return WILDDOG_ERR_IGNORE;
+    }
+    if(*p_payload_len)
+        memcpy(WILDDOG_COAP_BLOCK_BUF(p_block) + offset, *p_payload, *p_payload_len);
+    if(FALSE == more){
+        p_block->d_last = num;
+        p_block->d_len = offset + *p_payload_len;
+    }
+    if(num > p_block->d_stored)
+        p_block->d_stored = num;
+    p_block->d_bits |= (u32)1 << (num - p_block->d_done);
+    while(p_block->d_bits & 1){
+        p_block->d_bits >>= 1;
+        p_block->d_done++;
+    }
+    if(p_block->d_last >= 0 && p_block->d_done > (u32)p_block->d_last){
+        //all received, the buffer lives until the next transfer.
+        p_block->d_dir = WILDDOG_COAP_BLOCK_NONE;
+        *p_payload = WILDDOG_COAP_BLOCK_BUF(p_block);
+        *p_payload_len = p_block->d_len;
+        return error_code;
+    }
+REQUEST:
+    //without size2, only the block after the highest one is known to exist.
+    avail = p_block->d_last >= 0 ? (u32)p_block->d_last : p_block->d_stored + 1;
+    while(p_block->d_next <= avail && \
+          p_block->d_next < p_block->d_done + WILDDOG_COAP_BLOCK_WINDOW){
+        if(0 == (p_block->d_bits & ((u32)1 << (p_block->d_next - p_block->d_done))))
+            _wilddog_coap_block2_request(arg->protocol, p_block, p_block->d_next);
+        p_block->d_next++;
+    }
+    return WILDDOG_PROTO_ERR_CONTINUE;
+
+TOO_LARGE:
+    wilddog_debug_level(WD_DEBUG_ERROR, "Value is larger than %d!",WILDDOG_PROTO_MAXSIZE);
+    p_block->d_dir = WILDDOG_COAP_BLOCK_NONE;
+    *p_payload = NULL;
+    *p_payload_len = 0;
+    return COAP_CODE_GET(COAP_RESPONSE_413);
+}
+
 STATIC Wilddog_Return_T WD_SYSTEM _wilddog_coap_initSession(void* data, int flag){
     Wilddog_Proto_Cmd_Arg_T * arg = (Wilddog_Proto_Cmd_Arg_T*)data;
     Wilddog_Return_T ret = WILDDOG_ERR_INVALID;
@@ -825,8 +1771,21 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_coap_send_getValue(void* data, int fl
     send_arg.isSend = flag;
     send_arg.token = arg->p_message_id;
     send_arg.send_pkt = (Wilddog_Conn_Pkt_Data_T**)arg->p_out_data;
-    ret = _wilddog_coap_send_sendPkt(send_arg, TRUE, WILDDOG_COAP_OBSERVE_NOOBSERVE);
+    //the value got before, ask the server if it is changed [rfc7252 5.10.6].
+    if(arg->p_url->p_url_cache && arg->p_url->p_url_cache->d_etag_len){
+        ret = _wilddog_coap_send_makePkt(send_arg, TRUE, WILDDOG_COAP_OBSERVE_NOOBSERVE, \
+                                         arg->p_url->p_url_cache->d_etag, \
+                                         arg->p_url->p_url_cache->d_etag_len);
+    }else{
+        ret = _wilddog_coap_send_sendPkt(send_arg, TRUE, WILDDOG_COAP_OBSERVE_NOOBSERVE);
+    }
 
+    //block data, the value may come block by block.
+    if(WILDDOG_ERR_NOERR == ret && arg->p_proto_data){
+        _Wilddog_Coap_Block_Data_T *p_block = _wilddog_coap_block_alloc(arg->p_proto_data, 0);
+        if(p_block)
+            p_block->p_send = *send_arg.send_pkt;
+    }
     return ret;
 }
 
@@ -850,7 +1809,7 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_coap_send_setValue(void* data, int fl
     send_arg.isSend = flag;
     send_arg.token = arg->p_message_id;
     send_arg.send_pkt = (Wilddog_Conn_Pkt_Data_T**)arg->p_out_data;
-    ret = _wilddog_coap_send_sendPkt(send_arg, TRUE, WILDDOG_COAP_OBSERVE_NOOBSERVE);
+    ret = _wilddog_coap_send_block1(send_arg, arg->p_proto_data);
 
     return ret;
 }
@@ -874,10 +1833,100 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_coap_send_push(void* data, int flag){
     send_arg.isSend = flag;
     send_arg.token = arg->p_message_id;
     send_arg.send_pkt = (Wilddog_Conn_Pkt_Data_T**)arg->p_out_data;
-    ret = _wilddog_coap_send_sendPkt(send_arg, TRUE, WILDDOG_COAP_OBSERVE_NOOBSERVE);
+    ret = _wilddog_coap_send_block1(send_arg, arg->p_proto_data);
+
+    return ret;
+}
+/*
+ * Function:    _wilddog_coap_send_update
+ * Description: send the children to merge into the path as one PATCH 
+ *              request, the children not in it are kept by the server.
+ * Input:       data: the protocol command arg.
+ *              flag: send it now or only make it.
+ * Output:      N/A
+ * Return:      WILDDOG_ERR_NOERR if success.
+*/
+STATIC Wilddog_Return_T WD_SYSTEM _wilddog_coap_send_update(void* data, int flag){
+    Wilddog_Proto_Cmd_Arg_T * arg = (Wilddog_Proto_Cmd_Arg_T*)data;
+    Wilddog_Return_T ret = WILDDOG_ERR_INVALID;
+    Wilddog_Coap_Sendpkt_Arg_T send_arg;
+   
+    wilddog_assert(data&&arg->protocol&& \
+                   arg->p_url&&arg->p_session_info&& \
+                   arg->d_session_len&&arg->p_out_data && \
+                   arg->p_data&&arg->d_data_len, WILDDOG_ERR_NULL);
+
+    send_arg.protocol = arg->protocol;
+    send_arg.url = arg->p_url;
+    send_arg.code = COAP_REQUEST_PATCH;
+    send_arg.p_session_info = arg->p_session_info;
+    send_arg.d_session_len = arg->d_session_len;
+    send_arg.data = arg->p_data;
+    send_arg.data_len = arg->d_data_len;
+    send_arg.isSend = flag;
+    send_arg.token = arg->p_message_id;
+    send_arg.send_pkt = (Wilddog_Conn_Pkt_Data_T**)arg->p_out_data;
+    ret = _wilddog_coap_send_block1(send_arg, arg->p_proto_data);
+
+    return ret;
+}
+/*
+ * Function:    _wilddog_coap_send_non
+ * Description: send a value once as a non-confirmable request, nothing is 
+ *              kept for it, the response, if any, is dropped as unmatched.
+ * Input:       data: the protocol command arg.
+ *              code: COAP_REQUEST_PUT or COAP_REQUEST_POST.
+ * Output:      N/A
+ * Return:      WILDDOG_ERR_NOERR if sent, or the local error.
+*/
+STATIC Wilddog_Return_T WD_SYSTEM _wilddog_coap_send_non(void* data, u8 code){
+    Wilddog_Proto_Cmd_Arg_T * arg = (Wilddog_Proto_Cmd_Arg_T*)data;
+    Wilddog_Return_T ret = WILDDOG_ERR_INVALID;
+    Wilddog_Coap_Sendpkt_Arg_T send_arg;
+    Wilddog_Conn_Pkt_Data_T send_data;
+    Wilddog_Conn_Pkt_Data_T *p_send = &send_data;
+    coap_pdu_t *pdu = NULL;
+
+    wilddog_assert(data&&arg->protocol&& \
+                   arg->p_url&&arg->p_session_info&& \
+                   arg->d_session_len&&arg->p_message_id && \
+                   arg->p_data&&arg->d_data_len, WILDDOG_ERR_NULL);
 
+    send_arg.protocol = arg->protocol;
+    send_arg.url = arg->p_url;
+    send_arg.code = code;
+    send_arg.p_session_info = arg->p_session_info;
+    send_arg.d_session_len = arg->d_session_len;
+    send_arg.data = arg->p_data;
+    send_arg.data_len = arg->d_data_len;
+    send_arg.isSend = FALSE;
+    send_arg.token = arg->p_message_id;
+    send_arg.send_pkt = &p_send;
+    ret = _wilddog_coap_send_sendPkt(send_arg, TRUE, WILDDOG_COAP_OBSERVE_NOOBSERVE);
+    if(WILDDOG_ERR_NOERR != ret)
+        return ret;
+
+    pdu = (coap_pdu_t*)send_data.data;
+    //no block transfer, a lost fragment loses the whole value.
+    if(WILDDOG_PATH_OVERHEAD + pdu->length > WILDDOG_PATH_MTU){
+        wilddog_debug_level(WD_DEBUG_ERROR, "Non packet %d bytes is too large!", \
+                            pdu->length);
+        ret = WILDDOG_ERR_INVALID;
+    }
+    else{
+        pdu->hdr->type = COAP_MESSAGE_NON;
+        if(_wilddog_sec_send(arg->protocol, pdu->hdr, pdu->length) < 0)
+            ret = WILDDOG_ERR_SENDERR;
+    }
+    coap_delete_pdu(pdu);
     return ret;
 }
+STATIC Wilddog_Return_T WD_SYSTEM _wilddog_coap_send_setValueNon(void* data, int flag){
+    return _wilddog_coap_send_non(data, COAP_REQUEST_PUT);
+}
+STATIC Wilddog_Return_T WD_SYSTEM _wilddog_coap_send_pushNon(void* data, int flag){
+    return _wilddog_coap_send_non(data, COAP_REQUEST_POST);
+}
 STATIC Wilddog_Return_T WD_SYSTEM _wilddog_coap_send_remove(void* data, int flag){
     Wilddog_Proto_Cmd_Arg_T * arg = (Wilddog_Proto_Cmd_Arg_T*)data;
     Wilddog_Return_T ret = WILDDOG_ERR_INVALID;
@@ -905,13 +1954,15 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_coap_send_addObserver(void* data, int
     Wilddog_Proto_Cmd_Arg_T * arg = (Wilddog_Proto_Cmd_Arg_T*)data;
     Wilddog_Return_T ret = WILDDOG_ERR_INVALID;
     Wilddog_Coap_Sendpkt_Arg_T send_arg;
-    _Wilddog_Coap_Observe_Data_T *observe_data = NULL;
+    _Wilddog_Coap_Block_Data_T *observe_data = NULL;
     wilddog_assert(data&&arg->protocol&& \
                    arg->p_url&&arg->p_session_info&& \
                    arg->d_session_len&&arg->p_out_data, WILDDOG_ERR_NULL);
 
-    observe_data = (_Wilddog_Coap_Observe_Data_T*)wmalloc(sizeof(_Wilddog_Coap_Observe_Data_T));
+    //observe data is the head of block data, notifications may be blockwise.
+    observe_data = (_Wilddog_Coap_Block_Data_T*)wmalloc(sizeof(_Wilddog_Coap_Block_Data_T));
     wilddog_assert(observe_data, WILDDOG_ERR_NULL);
+    observe_data->d_last = -1;
     
     send_arg.protocol = arg->protocol;
     send_arg.url = arg->p_url;
@@ -927,6 +1978,7 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_coap_send_addObserver(void* data, int
 
     //add proto_data
     if(WILDDOG_ERR_NOERR == ret){
+        observe_data->p_send = *send_arg.send_pkt;
         *arg->p_proto_data = (u8*)observe_data;
     }else{
         wfree(observe_data);
@@ -1217,6 +2269,54 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_coap_send_offline(void* data, int fla
     return ret;
 }
 
+/*
+ * Function:    _wilddog_coap_recv_etag
+ * Description: keep the etag of the value got by a get request in the url 
+ *              cache, the next get of the url sends it. Observe requests do
+ *              not keep it. A 2.03 response keeps the etag sent.
+ * Input:       arg: the handle arg, p_url is the url of the request.
+ *              pdu: the response.
+ *              error_code: the response code, after blockwise transfer.
+ * Output:      N/A
+ * Return:      N/A
+*/
+STATIC void WD_SYSTEM _wilddog_coap_recv_etag
+    (
+    Wilddog_Proto_Cmd_Arg_T *arg,
+    coap_pdu_t *pdu,
+    u32 error_code
+    )
+{
+    _Wilddog_Coap_Block_Data_T *p_block = NULL;
+    Wilddog_Url_Cache_T *p_cache = NULL;
+    coap_pdu_t *req = NULL;
+    coap_opt_t *p_op = NULL;
+    coap_opt_iterator_t d_oi;
+    u16 len = 0;
+
+    if(WILDDOG_HTTP_OK != error_code || NULL == arg->p_url || \
+       NULL == arg->p_url->p_url_cache || NULL == arg->p_proto_data || \
+       NULL == *arg->p_proto_data)
+        return;
+    p_block = (_Wilddog_Coap_Block_Data_T*)*arg->p_proto_data;
+    if(NULL == p_block->p_send || NULL == p_block->p_send->data)
+        return;
+    req = (coap_pdu_t*)p_block->p_send->data;
+    if(COAP_REQUEST_GET != req->hdr->code || \
+       NULL != coap_check_option(req, COAP_OPTION_OBSERVE, &d_oi))
+        return;
+
+    p_cache = arg->p_url->p_url_cache;
+    p_cache->d_etag_len = 0;
+    p_op = coap_check_option(pdu, COAP_OPTION_ETAG, &d_oi);
+    if(p_op)
+        len = coap_opt_length(p_op);
+    if(len > 0 && len <= WILDDOG_URL_ETAG_MAXLEN){
+        memcpy(p_cache->d_etag, coap_opt_value(p_op), len);
+        p_cache->d_etag_len = (u8)len;
+    }
+}
+
 STATIC Wilddog_Return_T WD_SYSTEM _wilddog_coap_recv_handlePkt(void* data, int flag){
     Wilddog_Proto_Cmd_Arg_T * arg = (Wilddog_Proto_Cmd_Arg_T*)data;
     u32 error_code = WILDDOG_ERR_NOTAUTH;
@@ -1237,6 +2337,7 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_coap_recv_handlePkt(void* data, int f
      * 5. path, 
      * 6. blockNum(used by block), 
      * 7. payload
+     * 8. etag(used by get)
     */
 
     //pdu stored in p_data
@@ -1255,7 +2356,7 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_coap_recv_handlePkt(void* data, int f
     //5. get path, only observer may be use path to find the root path, we assume
     //   when root firstly sended, do not send child, when child firstly sended,
     //   send root again, and remove child observe.
-    //6. get block number, FIXME: we do not support block [rfc7959]
+    //6. get block number, handled after observe check.
     //7. get payload
     coap_get_data(pdu,&payload_len,&payload);
 
@@ -1278,6 +2379,18 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_coap_recv_handlePkt(void* data, int f
             error_code = WILDDOG_ERR_IGNORE;
         }
     }
+    //blockwise transfer [rfc7959], only requests with block data.
+    if(WILDDOG_ERR_IGNORE != error_code && arg->p_proto_data && *arg->p_proto_data){
+        _Wilddog_Coap_Block_Data_T *p_block = (_Wilddog_Coap_Block_Data_T*)*arg->p_proto_data;
+        if(WILDDOG_COAP_BLOCK_SEND == p_block->d_dir){
+            error_code = _wilddog_coap_recv_block1(arg->protocol, p_block, pdu, error_code);
+        }else{
+            error_code = _wilddog_coap_recv_block2(arg, pdu, observe_index, \
+                                                   &payload, &payload_len, error_code);
+        }
+        //8. get etag, the value may be asked again.
+        _wilddog_coap_recv_etag(arg, pdu, error_code);
+    }
     //error code and payload must tell connect layer
     //send payload to connect layer.
     *(arg->p_out_data) = (u8*)payload;
@@ -1288,63 +2401,62 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_coap_recv_handlePkt(void* data, int f
 STATIC Wilddog_Return_T WD_SYSTEM _wilddog_coap_recv_freePkt(void* data, int flag){
     Wilddog_Proto_Cmd_Arg_T * arg = (Wilddog_Proto_Cmd_Arg_T*)data;
     coap_pdu_t* pdu = (coap_pdu_t*)arg->p_data;
-    coap_pdu_t  *toSend = NULL;
+    u8 toSend[COAP_EMPTY_MAX_SIZE];
+    size_t len;
     u8 type = flag?(COAP_MESSAGE_ACK):(COAP_MESSAGE_RST);
     wilddog_assert(data && pdu, WILDDOG_ERR_NULL);
 
     //1. if need, send ack to the src of recvPkt
     //2. release recvPkt
     
-    //if is con, match send ack ,other send rst
+    //if is con, match send ack ,other send rst, it is empty, no pdu needed.
     if(COAP_MESSAGE_CON == pdu->hdr->type){
-        toSend = coap_pdu_init(type,0,pdu->hdr->id,WILDDOG_PROTO_MAXSIZE);
-        if(toSend){
-            coap_add_token(toSend,pdu->hdr->token_length,pdu->hdr->token);
+        len = coap_encode_empty(type, pdu->hdr->id, pdu->hdr->token_length, \
+                                pdu->hdr->token, toSend, sizeof(toSend));
+        if(len){
             //we don't care send success or not
-            _wilddog_sec_send(arg->protocol,toSend->hdr,toSend->length);
-            coap_delete_pdu(toSend);
+            _wilddog_sec_send(arg->protocol,toSend,len);
         }
     }
 
-    //we free recvPkt
-    coap_delete_pdu(pdu);
+    //we free recvPkt, it is a view over the receive buffer.
+    _wilddog_coap_freeRecvBuffer((u8*)pdu->hdr);
     
     return WILDDOG_ERR_NOERR;
 }
 
 STATIC Wilddog_Return_T WD_SYSTEM _wilddog_coap_recv_getPkt(void* data, int flag){
     u8* recv_data = NULL;
+    u32 recv_len = 0;
     int res = 0;
     coap_pdu_t * pdu;
     int len;
     Wilddog_Proto_Cmd_Arg_T * arg = (Wilddog_Proto_Cmd_Arg_T*)data;
 
     wilddog_assert(data, WILDDOG_ERR_NULL);
-    //1. recv from socket
-    recv_data = _wilddog_coap_mallocRecvBuffer(arg->protocol);
+    //1. wait for a datagram, then recv it with a buffer just large enough
+    res = wilddog_receiveSize(arg->protocol->socketFd, WILDDOG_RECEIVE_TIMEOUT);
+    if(res < 0){
+        return WILDDOG_ERR_RECVTIMEOUT;
+    }
+    recv_data = _wilddog_coap_mallocRecvBuffer((u32)res, &recv_len);
     wilddog_assert(recv_data, WILDDOG_ERR_NULL);
-    res = _wilddog_sec_recv(arg->protocol,(void*)recv_data,(s32)WILDDOG_PROTO_MAXSIZE);
-    if(res <= 0 || res > WILDDOG_PROTO_MAXSIZE){
-        _wilddog_coap_freeRecvBuffer(arg->protocol,recv_data);
+    res = _wilddog_sec_recv(arg->protocol,(void*)recv_data,(s32)recv_len);
+    if(res <= 0 || res > recv_len){
+        _wilddog_coap_freeRecvBuffer(recv_data);
         //wilddog_debug_level(WD_DEBUG_LOG, "Receive failed, error = %d",res);
         return WILDDOG_ERR_RECVTIMEOUT;
     }
-    //2. malloc coap buffer, handle coap, get token
-    pdu = coap_new_pdu();
-    if(NULL == pdu){
-        _wilddog_coap_freeRecvBuffer(arg->protocol,recv_data);
-        wilddog_debug_level(WD_DEBUG_ERROR, "Malloc pdu failed!");
-        return WILDDOG_ERR_NULL;
-    }
-    if(0 == coap_pdu_parse(recv_data, res,pdu)){
-        coap_delete_pdu(pdu);
-        _wilddog_coap_freeRecvBuffer(arg->protocol,recv_data);
+    //2. parse in place, the pdu is a view over the receive buffer, both are 
+    //handed to connect layer and freed by WD_PROTO_CMD_RECV_FREEPKT.
+    pdu = WILDDOG_COAP_RECV_PDU(recv_data);
+    if(0 == coap_pdu_view(recv_data, res, pdu)){
+        _wilddog_coap_freeRecvBuffer(recv_data);
         wilddog_debug_level(WD_DEBUG_ERROR, "Parse pdu failed!");
         return WILDDOG_ERR_INVALID;
     }
     if(pdu->hdr->version != COAP_DEFAULT_VERSION){
-        coap_delete_pdu(pdu);
-        _wilddog_coap_freeRecvBuffer(arg->protocol,recv_data);
+        _wilddog_coap_freeRecvBuffer(recv_data);
         wilddog_debug_level(WD_DEBUG_ERROR, "Parse pdu failed!");
         return WILDDOG_ERR_INVALID;
     }
@@ -1354,7 +2466,6 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_coap_recv_getPkt(void* data, int flag
     len = pdu->hdr->token_length > WILDDOG_COAP_TOKEN_LEN? \
             (WILDDOG_COAP_TOKEN_LEN):(pdu->hdr->token_length);
     memcpy((u8*)arg->p_message_id,pdu->hdr->token, len);
-    _wilddog_coap_freeRecvBuffer(arg->protocol,recv_data);
     //send pdu to connect layer to store.
     *(arg->p_out_data) = (u8*)pdu;
     *(arg->p_out_data_len) = pdu->length;
@@ -1383,6 +2494,9 @@ Wilddog_Func_T _wilddog_protocol_funcTable[WD_PROTO_CMD_MAX + 1] =
     (Wilddog_Func_T)_wilddog_coap_recv_getPkt,//get pkt
     (Wilddog_Func_T)_wilddog_coap_recv_freePkt,//free pkt
     (Wilddog_Func_T)_wilddog_coap_recv_handlePkt,//handle pkt
+    (Wilddog_Func_T)_wilddog_coap_send_setValueNon,//set non
+    (Wilddog_Func_T)_wilddog_coap_send_pushNon,//push non
+    (Wilddog_Func_T)_wilddog_coap_send_update,//update
     NULL
 };
 
@@ -1445,6 +2559,7 @@ Wilddog_Protocol_T * WD_SYSTEM _wilddog_protocol_init(void *data)
         wilddog_debug_level(WD_DEBUG_ERROR, "Init secure failed!");
         return NULL;
     }
+    l_coap_recvPool.d_refs++;
 
     return protocol;
 }
@@ -1465,6 +2580,9 @@ Wilddog_Return_T WD_SYSTEM _wilddog_protocol_deInit(void *data)
     p_conn->p_protocol->user_data = NULL;
     
     wfree(p_conn->p_protocol);
+    //the last one gone, the pool keeps nothing.
+    if(l_coap_recvPool.d_refs > 0 && 0 == --l_coap_recvPool.d_refs)
+        _wilddog_coap_trimRecvBuffer();
     return WILDDOG_ERR_NOERR;
 }
 
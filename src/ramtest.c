@@ -61,7 +61,7 @@ void WD_SYSTEM ramtest_init(u32 tree_num,u32 request_num)
     memset(p,0,sizeof(Ramtest_T));
     p->d_mallocblks_init = ramtest_getLastMallocSize(p);
     p->d_stackblks_init = ramtest_getLastStackSize(p);
-    p->d_protocol_size = WILDDOG_PROTO_MAXSIZE ;
+    p->d_protocol_size = 0;
     p->tree_num = tree_num;
     p->request_num = request_num;
 }
@@ -171,6 +171,11 @@ void WD_SYSTEM ramtest_caculate_packetsize(unsigned short packetSize)
 {
     d_ramtest.d_packet_size = packetSize ;
 }
+void WD_SYSTEM ramtest_caculate_protocolRam(u32 protocolSize)
+{
+    d_ramtest.d_protocol_size = 
+        (d_ramtest.d_protocol_size>protocolSize)?d_ramtest.d_protocol_size:protocolSize;
+}
 void WD_SYSTEM ramtest_caculate_averageRam(void)
 {
 /*  todo */
@@ -192,7 +197,7 @@ void WD_SYSTEM ramtest_titile_printf(void)
 {
     printf("\n---------------------------RAM--test-------------------------\n");
     printf("NO\tQueries\tUnSend\tErrorRecv\tUDPSize\tPeakMemory\tAverageMemory"
-           "\tRequestQueueMemory\tX509Memory\tNodeTreeMemory\t| \n");
+           "\tRequestQueueMemory\tX509Memory\tNodeTreeMemory\tProtocolMemory\t| \n");
 }
 void WD_SYSTEM ramtest_end_printf(void)
 {
@@ -213,6 +218,7 @@ void WD_SYSTEM ramtest_printf(Ramtest_T *p)
     printf("\t\t%ld",p->d_requestQeue_ram);
     printf("\t\t\t%ld",p->d_x509_ram);
     printf("\t\t%ld",p->d_node_ram);
+    printf("\t\t%ld",p->d_protocol_size);
 
     printf("\n");
 
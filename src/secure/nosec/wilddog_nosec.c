@@ -28,7 +28,8 @@ Wilddog_Return_T WD_SYSTEM _wilddog_sec_send
     {
         if(protocol->socketFd)
             wilddog_closeSocket(protocol->socketFd);
-        wilddog_openSocket(&protocol->socketFd);        
+        if(0 == wilddog_openSocket(&protocol->socketFd))
+            wilddog_connectSocket(protocol->socketFd, &protocol->addr);
     }
     return res;
 }
@@ -66,6 +67,8 @@ Wilddog_Return_T WD_SYSTEM _wilddog_sec_init
     Wilddog_Protocol_T *protocol
     )
 {
+    int res;
+
     wilddog_assert(protocol, WILDDOG_ERR_NULL);
     
     if(0 != wilddog_openSocket(&protocol->socketFd)){
@@ -73,7 +76,12 @@ Wilddog_Return_T WD_SYSTEM _wilddog_sec_init
         return WILDDOG_ERR_INVALID;
     }
 
-    return _wilddog_sec_getHost(&protocol->addr, protocol->host);
+    res = _wilddog_sec_getHost(&protocol->addr, protocol->host);
+    if(0 != res)
+        return res;
+    //connected socket, no address building and filtering for each packet.
+    wilddog_connectSocket(protocol->socketFd, &protocol->addr);
+    return WILDDOG_ERR_NOERR;
 }
 
 /*
@@ -274,7 +274,7 @@ STATIC int read_from_peer
         return 0;
     sec_session->d_recvFig = 1;
     readlen = (sec_session->d_recvlen > len)?len:sec_session->d_recvlen;
-    for (i = 0; i < len; i++)
+    for (i = 0; i < readlen; i++)
     {
         sec_session->p_recvbuf[i] = data[i];
     }
@@ -564,6 +564,7 @@ Wilddog_Return_T _wilddog_sec_init(Wilddog_Protocol_T *protocol)
     res = _wilddog_sec_getHost(&protocol->addr,protocol->host);
     if(res < 0)
         return res;
+    wilddog_connectSocket(protocol->socketFd, &protocol->addr);
     if(protocol->user_data){
         wfree(protocol->user_data);
         protocol->user_data = NULL;
@@ -77,6 +77,7 @@ extern void ramtest_caculate_peakRam(void);
 extern void ramtest_skipLastmalloc(void);
 extern void ramtest_gethostbyname(void);
 extern void ramtest_caculate_packetsize(unsigned short packetSize);
+extern void ramtest_caculate_protocolRam(u32 protocolSize);
 extern int ramtest_printfmallocState(void);
 extern int ramtest_handle( const u8 *p_url,u32 tree_num, u8 request_num);
 
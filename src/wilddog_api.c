@@ -20,6 +20,7 @@
 #include "wilddog.h"
 #include "wilddog_ct.h"
 #include "wilddog_common.h"
+#include "wilddog_thread.h"
 
 /*
  * Function:    wilddog_increaseTime
@@ -50,6 +51,75 @@ void wilddog_trySync(void)
     _wilddog_ct_ioctl(WILDDOG_APICMD_SYNC, NULL, 0);
 }
 
+/*
+ * Function:    wilddog_getFds
+ * Description: Get the sockets SDK is waiting on, for the user's event loop.
+ * Input:       maxNum: the size of fds.
+ * Output:      fds: the sockets.
+ * Return:      the number of sockets stored in fds.
+*/
+int wilddog_getFds(int *fds, int maxNum)
+{
+    Wilddog_Arg_GetFds_T args;
+
+    wilddog_assert(fds, 0);
+    if(maxNum <= 0)
+        return 0;
+    args.p_fds = fds;
+    args.d_maxNum = maxNum;
+    return (int)_wilddog_ct_ioctl(WILDDOG_APICMD_GETFDS, &args, 0);
+}
+
+/*
+ * Function:    wilddog_getNextTimeout
+ * Description: Get how long the user's event loop can wait.
+ * Input:       N/A
+ * Output:      N/A
+ * Return:      the time in ms, 0 means process now, -1 means no deadline.
+*/
+s32 wilddog_getNextTimeout(void)
+{
+    return (s32)_wilddog_ct_ioctl(WILDDOG_APICMD_GETTIMEOUT, NULL, 0);
+}
+
+/*
+ * Function:    wilddog_processFd
+ * Description: Handle a readable socket and everything due, never waits.
+ * Input:       fd: the readable socket, -1 if the timeout expired.
+ * Output:      N/A
+ * Return:      0 means succeed, negative number means failed.
+*/
+Wilddog_Return_T wilddog_processFd(int fd)
+{
+    return (Wilddog_Return_T)_wilddog_ct_ioctl(WILDDOG_APICMD_PROCESSFD, \
+                                               &fd, 0);
+}
+
+/*
+ * Function:    wilddog_startThread
+ * Description: Start the threaded mode, SDK syncs in its own i/o thread, and
+ *              APIs can be called from any thread.
+ * Input:       N/A
+ * Output:      N/A
+ * Return:      0 means succeed, negative number means failed.
+*/
+Wilddog_Return_T wilddog_startThread(void)
+{
+    return _wilddog_thread_start();
+}
+
+/*
+ * Function:    wilddog_stopThread
+ * Description: Stop the threaded mode after queued requests are done.
+ * Input:       N/A
+ * Output:      N/A
+ * Return:      0 means succeed, negative number means failed.
+*/
+Wilddog_Return_T wilddog_stopThread(void)
+{
+    return _wilddog_thread_stop();
+}
+
 /*
  * Function:    wilddog_initWithUrl
  * Description: Init a wilddog client. A client is the path in the HOST tree.
@@ -239,6 +309,220 @@ Wilddog_Return_T wilddog_push
     return (Wilddog_Return_T)_wilddog_ct_ioctl(WILDDOG_APICMD_PUSH, &args,0);
 }
 
+/*
+ * Function:    wilddog_update
+ * Description: Merge the children of the node into the path of the client, 
+ *              by one request, the children not in the node are kept.
+ * Input:       wilddog: Id of the client.
+ *              p_node: a point to an object node(Wilddog_Node_T structure) 
+ *                      with the children to update, can free after this 
+ *                      function.
+ *              callback: the callback function called when the server returns 
+ *                      a response or send fail.
+ *              args: the arg defined by user, if you do not need, can be NULL.
+ * Output:      N/A
+ * Return:      0 means succeed, negative number means failed.
+*/
+Wilddog_Return_T wilddog_update
+    (
+    Wilddog_T wilddog,
+    Wilddog_Node_T *p_node, 
+    onSetFunc callback, 
+    void* arg
+    )
+{
+    Wilddog_Arg_Set_T args;
+    
+    wilddog_assert(wilddog, WILDDOG_ERR_NULL);
+    
+    args.p_ref = wilddog;
+    args.p_node = p_node;
+    args.p_callback = (Wilddog_Func_T)callback;
+    args.arg = arg;
+    
+    return (Wilddog_Return_T)_wilddog_ct_ioctl(WILDDOG_APICMD_UPDATE, &args,0);
+}
+
+/*
+ * Function:    wilddog_setValueNon
+ * Description: Post the data of the client to server once, as non-confirmable,
+ *              no retransmission and no response, for high rate telemetry.
+ * Input:       wilddog: Id of the client.
+ *              p_node: a point to node(Wilddog_Node_T structure), you can
+ *                      create a node tree by call node APIs.
+ *              callback: the callback function called only when send fail
+ *                      locally, can be NULL.
+ *              args: the arg defined by user, if you do not need, can be NULL.
+ * Output:      N/A
+ * Return:      0 means sent, negative number means failed.
+*/
+Wilddog_Return_T wilddog_setValueNon
+    (
+    Wilddog_T wilddog, 
+    Wilddog_Node_T *p_node, 
+    onSetFunc callback, 
+    void* arg
+    )
+{
+    Wilddog_Arg_Set_T args;
+    
+    wilddog_assert(wilddog, WILDDOG_ERR_NULL);
+    
+    args.p_ref = wilddog;
+    args.p_node = p_node;
+    args.p_callback = (Wilddog_Func_T)callback;
+    args.arg = arg;
+    
+    return (Wilddog_Return_T)_wilddog_ct_ioctl(WILDDOG_APICMD_SET, &args, \
+                                               WD_CMD_NON);
+}
+
+/*
+ * Function:    wilddog_pushNon
+ * Description: Push the data of the client to server once, as non-confirmable,
+ *              no retransmission and no response, so the new path is unknown.
+ * Input:       wilddog: Id of the client.
+ *              p_node: a point to node(Wilddog_Node_T structure), you can 
+ *                      create a node tree by call node APIs.
+ *              callback: the callback function called only when send fail
+ *                      locally, can be NULL.
+ *              args: the arg defined by user, if you do not need, can be NULL.
+ * Output:      N/A
+ * Return:      0 means sent, negative number means failed.
+*/
+Wilddog_Return_T wilddog_pushNon
+    (
+    Wilddog_T wilddog,
+    Wilddog_Node_T *p_node, 
+    onPushFunc callback,
+    void* arg
+    )
+{
+    Wilddog_Arg_Push_T args;
+    
+    wilddog_assert(wilddog, WILDDOG_ERR_NULL);
+    
+    args.p_ref = wilddog;
+    args.p_node = p_node;
+    args.p_callback = (Wilddog_Func_T)callback;
+    args.arg = arg;
+    
+    return (Wilddog_Return_T)_wilddog_ct_ioctl(WILDDOG_APICMD_PUSH, &args, \
+                                               WD_CMD_NON);
+}
+
+/*
+ * Function:    wilddog_setSendMode
+ * Description: Set how wilddog_setValue and wilddog_push of the client are 
+ *              sent, WILDDOG_SENDMODE_CON by default, or coalesce the 
+ *              wilddog_setValue not sent yet by WILDDOG_SENDMODE_COALESCE.
+ * Input:       wilddog: Id of the client.
+ *              mode: the send mode.
+ * Output:      N/A
+ * Return:      0 means succeed, negative number means failed.
+*/
+Wilddog_Return_T wilddog_setSendMode
+    (
+    Wilddog_T wilddog,
+    Wilddog_SendMode_T mode
+    )
+{
+    wilddog_assert(wilddog, WILDDOG_ERR_NULL);
+
+    return (Wilddog_Return_T)_wilddog_ct_ioctl(WILDDOG_APICMD_SETSENDMODE, \
+                                               (void*)wilddog, mode);
+}
+
+/*
+ * Function:    wilddog_getMetrics
+ * Description: Get the metrics of the connection the client uses, such as
+ *              the retransmit timeout adapted to the measured rtt, and
+ *              how many requests are in flight and queued.
+ * Input:       wilddog: Id of the client.
+ * Output:      p_metrics: the metrics.
+ * Return:      0 means succeed, negative number means failed.
+*/
+Wilddog_Return_T wilddog_getMetrics
+    (
+    Wilddog_T wilddog,
+    Wilddog_Metrics_T *p_metrics
+    )
+{
+    Wilddog_Arg_GetMetrics_T args;
+
+    wilddog_assert(wilddog && p_metrics, WILDDOG_ERR_NULL);
+
+    args.p_ref = wilddog;
+    args.p_metrics = p_metrics;
+
+    return (Wilddog_Return_T)_wilddog_ct_ioctl(WILDDOG_APICMD_GETMETRICS, \
+                                               &args, 0);
+}
+
+/*
+ * Function:    wilddog_setQueueBudget
+ * Description: Set the count and byte budget of the connection the client
+ *              uses, new requests over it fail with WILDDOG_ERR_QUEUEFULL.
+ * Input:       wilddog: Id of the client.
+ *              maxCount: the count budget, 0 means WILDDOG_REQ_QUEUE_NUM.
+ *              maxBytes: the byte budget, 0 means WILDDOG_REQ_QUEUE_BYTES.
+ * Output:      N/A
+ * Return:      0 means succeed, negative number means failed.
+*/
+Wilddog_Return_T wilddog_setQueueBudget
+    (
+    Wilddog_T wilddog,
+    u32 maxCount,
+    u32 maxBytes
+    )
+{
+    Wilddog_Arg_SetBudget_T args;
+
+    wilddog_assert(wilddog, WILDDOG_ERR_NULL);
+
+    args.p_ref = wilddog;
+    args.d_maxCount = maxCount;
+    args.d_maxBytes = maxBytes;
+
+    return (Wilddog_Return_T)_wilddog_ct_ioctl(WILDDOG_APICMD_SETBUDGET, \
+                                               &args, 0);
+}
+
+/*
+ * Function:    wilddog_setQueueLowWater
+ * Description: Set the low-water mark of the connection the client uses,
+ *              onLow is called once the requests not responded fall to it.
+ * Input:       wilddog: Id of the client.
+ *              lowCount: the requests, sent or not, not responded.
+ *              lowBytes: the value bytes of those requests.
+ *              onLow: the callback, NULL to remove it.
+ *              arg: the arg defined by user, if you do not need, can be NULL.
+ * Output:      N/A
+ * Return:      0 means succeed, negative number means failed.
+*/
+Wilddog_Return_T wilddog_setQueueLowWater
+    (
+    Wilddog_T wilddog,
+    u32 lowCount,
+    u32 lowBytes,
+    onQueueLowFunc onLow,
+    void* arg
+    )
+{
+    Wilddog_Arg_SetLowWater_T args;
+
+    wilddog_assert(wilddog, WILDDOG_ERR_NULL);
+
+    args.p_ref = wilddog;
+    args.d_lowCount = lowCount;
+    args.d_lowBytes = lowBytes;
+    args.onLow = onLow;
+    args.arg = arg;
+
+    return (Wilddog_Return_T)_wilddog_ct_ioctl(WILDDOG_APICMD_SETLOWWATER, \
+                                               &args, 0);
+}
+
 /*
  * Function:    wilddog_removeValue
  * Description: Remove the data of the client from server.
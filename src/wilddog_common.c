@@ -23,9 +23,17 @@
 #include "wilddog_url_parser.h"
 #include "wilddog_config.h"
 #include "wilddog_ct.h"
+#include "wilddog_port.h"
 
-/* store current time */
+#define WILDDOG_CLOCK_UNKNOWN   0
+#define WILDDOG_CLOCK_PORT      1
+#define WILDDOG_CLOCK_SIMULATED 2
+
+/* store current time, if platform has a clock, store the user's increase */
 STATIC VOLATILE u32 l_wilddog_currTime = 0;
+/* platform monotonic clock's value when sdk first get time */
+STATIC u32 l_wilddog_clockBase = 0;
+STATIC u8 l_wilddog_clockType = WILDDOG_CLOCK_UNKNOWN;
 /*
  * Function:    wmalloc
  * Description: alloc a memory block.
@@ -137,7 +145,12 @@ u8 WD_SYSTEM _wilddog_isAuthValid(u8 * auth, int len)
 */
 void WD_SYSTEM _wilddog_setTimeIncrease(u32 ms)
 {
+#ifdef __GNUC__
+    /*may be called by other threads than the sdk i/o thread*/
+    __atomic_fetch_add(&l_wilddog_currTime, ms, __ATOMIC_RELAXED);
+#else
     l_wilddog_currTime += ms;
+#endif
     return;
 }
 /*
@@ -151,15 +164,48 @@ STATIC INLINE void WD_SYSTEM _wilddog_setTime(u32 ms)
 {
     l_wilddog_currTime = ms;
 }
+/*
+ * Function:    _wilddog_getClock
+ * Description: Get the platform's monotonic clock, decide which clock to use
+ *              at the first time.
+ * Input:       N/A
+ * Output:      p_ms: the ms passed since sdk first get time.
+ * Return:      TRUE if the platform has a monotonic clock, else FALSE.
+*/
+STATIC BOOL WD_SYSTEM _wilddog_getClock(u32 *p_ms)
+{
+    u32 now = 0;
+    
+    if(WILDDOG_CLOCK_SIMULATED == l_wilddog_clockType)
+        return FALSE;
+    if(wilddog_getMonotonicTime(&now) < 0)
+    {
+        l_wilddog_clockType = WILDDOG_CLOCK_SIMULATED;
+        return FALSE;
+    }
+    if(WILDDOG_CLOCK_UNKNOWN == l_wilddog_clockType)
+    {
+        l_wilddog_clockBase = now;
+        l_wilddog_clockType = WILDDOG_CLOCK_PORT;
+    }
+    *p_ms = now - l_wilddog_clockBase;
+    return TRUE;
+}
+
 /*
  * Function:    _wilddog_getTime
- * Description: Get current time.
+ * Description: Get current time, use the platform's monotonic clock if it has,
+ *              else the time simulated by sync and user's increase.
  * Input:       N/A
  * Output:      N/A
  * Return:      Current time.
 */
 u32 WD_SYSTEM _wilddog_getTime(void)
 {
+    u32 clock = 0;
+    
+    if(TRUE == _wilddog_getClock(&clock))
+        return clock + l_wilddog_currTime;
     return l_wilddog_currTime;
 }
 
@@ -172,7 +218,12 @@ u32 WD_SYSTEM _wilddog_getTime(void)
 */
 void WD_SYSTEM _wilddog_syncTime(void)
 {
-    u32 currTime = _wilddog_getTime() + WILDDOG_RECEIVE_TIMEOUT;
+    u32 currTime;
+    
+    /*real clock, time passed by itself.*/
+    if(TRUE == _wilddog_getClock(&currTime))
+        return;
+    currTime = _wilddog_getTime() + WILDDOG_RECEIVE_TIMEOUT;
     wilddog_debug_level(WD_DEBUG_ALL,"Sync time, current time is %ld",currTime);
     _wilddog_setTime(currTime);
     return;
@@ -36,7 +36,6 @@
 #include "test_lib.h"
 #include "wilddog_protocol.h"
 
-#define WILDDOG_RETRANSMIT_DEFAULT_INTERVAL (1)//Ĭϵݰش,s
 #define WILDDOG_SESSION_OFFLINE_TIMES (3)//session ʧܶٴκΪ
 #define WILDDOG_SESSION_MAX_RETRY_TIME_INTERVAL (150)//Լ
 #define WILDDOG_SMART_PING
@@ -63,9 +62,1139 @@ extern Wilddog_Return_T WD_SYSTEM _wilddog_node_setKey
     );
 STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_packet_deInit(Wilddog_Conn_Pkt_T * pkt);
 STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_packet_init(Wilddog_Conn_Pkt_T * pkt,Wilddog_Url_T *s_url);
+STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_get(void* data,int flag);
 
-STATIC INLINE u32 WD_SYSTEM _wilddog_conn_getNextSendTime(int count){
-    return (_wilddog_getTime() + (WILDDOG_RETRANSMIT_DEFAULT_INTERVAL << count) * 1000);
+/*
+ * Function:    _wilddog_conn_rto_estimate
+ * Description: smooth a rtt sample into srtt and rttvar as rfc6298.
+ * Input:       p_srtt: the srtt, 0 if no sample yet.
+ *              p_var: the rttvar.
+ *              rtt: the sample, ms.
+ *              k: the variance factor.
+ * Output:      p_srtt, p_var: updated.
+ * Return:      the estimated rto, srtt + k * rttvar.
+*/
+STATIC u32 WD_SYSTEM _wilddog_conn_rto_estimate
+    (
+    u32 *p_srtt, 
+    u32 *p_var, 
+    u32 rtt, 
+    u32 k
+    )
+{
+    u32 diff;
+
+    if(0 == *p_srtt){
+        *p_var = rtt / 2;
+    }else{
+        diff = (*p_srtt > rtt)?(*p_srtt - rtt):(rtt - *p_srtt);
+        *p_var = (3 * (*p_var) + diff) / 4;
+        rtt = (7 * (*p_srtt) + rtt) / 8;
+    }
+    //0 means no sample, a fast link keeps 1ms.
+    *p_srtt = (rtt > 0)?(rtt):(1);
+    return *p_srtt + k * (*p_var);
+}
+
+/*
+ * Function:    _wilddog_conn_rto_sample
+ * Description: take a rtt sample from the response of pkt, and update the rto.
+ *              a packet sent more than 3 times is not sampled, its rtt is 
+ *              too ambiguous, nor a packet already sampled, like observe.
+ * Input:       p_conn: the connect layer.
+ *              pkt: the packet responded.
+ * Output:      N/A
+ * Return:      N/A
+*/
+void WD_SYSTEM _wilddog_conn_rto_sample
+    (
+    Wilddog_Conn_T *p_conn, 
+    Wilddog_Conn_Pkt_T *pkt
+    )
+{
+    Wilddog_Conn_Rto_T *p_rto = &p_conn->d_rto;
+    u32 now = _wilddog_getTime();
+    u32 rtt, rto;
+
+    if(0 == pkt->d_send_time || pkt->d_count < 1 || pkt->d_count > 3)
+        return;
+    rtt = now - pkt->d_send_time;
+    pkt->d_send_time = 0;
+    if(1 == pkt->d_count){
+        rto = _wilddog_conn_rto_estimate(&p_rto->d_strong_srtt, \
+                                        &p_rto->d_strong_var, rtt, 4);
+        rto = (rto + p_rto->d_rto) / 2;
+    }else{
+        rto = _wilddog_conn_rto_estimate(&p_rto->d_weak_srtt, \
+                                        &p_rto->d_weak_var, rtt, 1);
+        rto = (rto + 3 * p_rto->d_rto) / 4;
+    }
+    if(rto < WILDDOG_RTO_MIN)
+        rto = WILDDOG_RTO_MIN;
+    if(rto > WILDDOG_RTO_MAX)
+        rto = WILDDOG_RTO_MAX;
+    p_rto->d_rto = rto;
+    p_rto->d_last_rtt = rtt;
+    p_rto->d_update_time = now;
+    p_rto->d_samples++;
+    wilddog_debug_level(WD_DEBUG_LOG, "Rtt %lu ms, rto %lu ms", \
+                        (unsigned long)rtt, (unsigned long)rto);
+}
+
+/*
+ * Function:    _wilddog_conn_getNextSendTime
+ * Description: get when to retransmit pkt, which is just sent d_count times.
+ *              the first wait is the rto dithered up to 1.5 times, then it 
+ *              backs off by 3 if the rto is small, 1.5 if large, else 2.
+ * Input:       p_conn: the connect layer.
+ *              pkt: the packet sent.
+ * Output:      N/A
+ * Return:      the time to retransmit.
+*/
+u32 WD_SYSTEM _wilddog_conn_getNextSendTime
+    (
+    Wilddog_Conn_T *p_conn, 
+    Wilddog_Conn_Pkt_T *pkt
+    )
+{
+    Wilddog_Conn_Rto_T *p_rto = &p_conn->d_rto;
+    u32 now = _wilddog_getTime();
+    u32 idle = now - p_rto->d_update_time;
+
+    if(pkt->d_count > 1){
+        p_rto->d_retransmits++;
+        pkt->d_rto = pkt->d_rto * pkt->d_backoff / 2;
+        if(pkt->d_rto > WILDDOG_RTO_MAX)
+            pkt->d_rto = WILDDOG_RTO_MAX;
+        return now + pkt->d_rto;
+    }
+    //aging, an rto not updated for long goes back towards the default.
+    if(p_rto->d_rto < 1000 && idle > 16 * p_rto->d_rto){
+        p_rto->d_rto *= 2;
+        p_rto->d_update_time = now;
+    }else if(p_rto->d_rto > 3000 && idle > 4 * p_rto->d_rto){
+        p_rto->d_rto = (p_rto->d_rto + WILDDOG_RTO_INIT) / 2;
+        p_rto->d_update_time = now;
+    }
+    p_rto->d_seed = p_rto->d_seed * 1103515245 + 12345;
+    pkt->d_rto = p_rto->d_rto + (p_rto->d_seed >> 16) % (p_rto->d_rto / 2 + 1);
+    pkt->d_backoff = (p_rto->d_rto < 1000)?(6):((p_rto->d_rto > 3000)?(3):(4));
+    pkt->d_send_time = now;
+    return now + pkt->d_rto;
+}
+
+/*
+ * Function:    _wilddog_conn_getMetrics
+ * Description: get the retransmission and window metrics of the connect layer.
+ * Input:       p_conn: the connect layer.
+ * Output:      p_metrics: the metrics.
+ * Return:      N/A
+*/
+void WD_SYSTEM _wilddog_conn_getMetrics
+    (
+    Wilddog_Conn_T *p_conn, 
+    Wilddog_Metrics_T *p_metrics
+    )
+{
+    Wilddog_Conn_Rto_T *p_rto = &p_conn->d_rto;
+    Wilddog_Conn_Budget_T *p_bgt = &p_conn->d_budget;
+    Wilddog_Conn_Pkt_T *p_oldest = p_conn->d_conn_user.p_rest_list;
+
+    p_metrics->d_rto = p_rto->d_rto;
+    p_metrics->d_srtt = p_rto->d_strong_srtt;
+    p_metrics->d_rttvar = p_rto->d_strong_var;
+    p_metrics->d_lastRtt = p_rto->d_last_rtt;
+    p_metrics->d_rttSamples = p_rto->d_samples;
+    p_metrics->d_retransmits = p_rto->d_retransmits;
+    p_metrics->d_window = p_conn->d_window.d_window;
+    p_metrics->d_inflight = p_conn->d_window.d_inflight;
+    p_metrics->d_queued = p_conn->d_window.d_queued;
+    p_metrics->d_queuedBytes = p_bgt->d_bytes;
+    //rest list is in the order requests are made.
+    p_metrics->d_oldestAge = (p_oldest)?(_wilddog_getTime() - p_oldest->d_create_time):(0);
+    p_metrics->d_maxCount = p_bgt->d_max_count;
+    p_metrics->d_maxBytes = p_bgt->d_max_bytes;
+}
+
+/*
+ * Function:    _wilddog_conn_setBudget
+ * Description: set the count and byte budget of the connect layer.
+ * Input:       p_conn: the connect layer.
+ *              maxCount: the count budget, 0 means WILDDOG_REQ_QUEUE_NUM.
+ *              maxBytes: the byte budget, 0 means WILDDOG_REQ_QUEUE_BYTES.
+ * Output:      N/A
+ * Return:      N/A
+*/
+void WD_SYSTEM _wilddog_conn_setBudget
+    (
+    Wilddog_Conn_T *p_conn, 
+    u32 maxCount,
+    u32 maxBytes
+    )
+{
+    p_conn->d_budget.d_max_count = (maxCount)?(maxCount):(WILDDOG_REQ_QUEUE_NUM);
+    p_conn->d_budget.d_max_bytes = (maxBytes)?(maxBytes):(WILDDOG_REQ_QUEUE_BYTES);
+}
+
+/*
+ * Function:    _wilddog_conn_setLowWater
+ * Description: set the low-water mark of the rest packets and its callback.
+ * Input:       p_conn: the connect layer.
+ *              lowCount: the rest packets.
+ *              lowBytes: the value bytes of the rest packets.
+ *              onLow: the callback, NULL to remove it.
+ *              arg: the arg of the callback.
+ * Output:      N/A
+ * Return:      N/A
+*/
+void WD_SYSTEM _wilddog_conn_setLowWater
+    (
+    Wilddog_Conn_T *p_conn, 
+    u32 lowCount,
+    u32 lowBytes,
+    onQueueLowFunc onLow,
+    void *arg
+    )
+{
+    Wilddog_Conn_Budget_T *p_bgt = &p_conn->d_budget;
+
+    p_bgt->d_low_count = lowCount;
+    p_bgt->d_low_bytes = lowBytes;
+    p_bgt->p_low_callback = onLow;
+    p_bgt->p_low_arg = arg;
+    p_bgt->d_above = (p_bgt->d_requests > lowCount || p_bgt->d_bytes > lowBytes);
+}
+
+/*
+ * Function:    _wilddog_conn_budget_full
+ * Description: a new request is over the budget or not, a value larger 
+ *              than the byte budget is accepted when no value is kept.
+ * Input:       p_conn: the connect layer.
+ *              bytes: the value bytes of the new request.
+ * Output:      N/A
+ * Return:      TRUE if it should fail with WILDDOG_ERR_QUEUEFULL.
+*/
+STATIC BOOL WD_SYSTEM _wilddog_conn_budget_full
+    (
+    Wilddog_Conn_T *p_conn, 
+    u32 bytes
+    )
+{
+    Wilddog_Conn_Budget_T *p_bgt = &p_conn->d_budget;
+
+    if(p_conn->d_conn_user.d_count > p_bgt->d_max_count){
+        wilddog_debug_level(WD_DEBUG_WARN, "Too many requests! Max is %lu", \
+                            (unsigned long)p_bgt->d_max_count);
+        return TRUE;
+    }
+    if(p_bgt->d_bytes > 0 && \
+       (bytes > p_bgt->d_max_bytes || p_bgt->d_bytes > p_bgt->d_max_bytes - bytes)){
+        wilddog_debug_level(WD_DEBUG_WARN, "Too many bytes queued! Max is %lu", \
+                            (unsigned long)p_bgt->d_max_bytes);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/*
+ * Function:    _wilddog_conn_budget_add
+ * Description: a rest packet is added to the rest list, count it in budget.
+ * Input:       p_conn: the connect layer.
+ *              pkt: the packet.
+ *              bytes: the value bytes of it.
+ * Output:      N/A
+ * Return:      N/A
+*/
+STATIC void WD_SYSTEM _wilddog_conn_budget_add
+    (
+    Wilddog_Conn_T *p_conn, 
+    Wilddog_Conn_Pkt_T *pkt,
+    u32 bytes
+    )
+{
+    Wilddog_Conn_Budget_T *p_bgt = &p_conn->d_budget;
+
+    pkt->d_flag |= WILDDOG_CONN_PKT_FLAG_BUDGET;
+    pkt->d_bytes = bytes;
+    p_bgt->d_requests++;
+    p_bgt->d_bytes += bytes;
+    if(p_bgt->d_requests > p_bgt->d_low_count || p_bgt->d_bytes > p_bgt->d_low_bytes)
+        p_bgt->d_above = TRUE;
+}
+
+/*
+ * Function:    _wilddog_conn_budget_remove
+ * Description: a rest packet is deleted, it leaves the budget.
+ * Input:       p_conn: the connect layer.
+ *              pkt: the packet.
+ * Output:      N/A
+ * Return:      N/A
+*/
+STATIC void WD_SYSTEM _wilddog_conn_budget_remove
+    (
+    Wilddog_Conn_T *p_conn, 
+    Wilddog_Conn_Pkt_T *pkt
+    )
+{
+    if(0 == (WILDDOG_CONN_PKT_FLAG_BUDGET & pkt->d_flag))
+        return;
+    p_conn->d_budget.d_requests--;
+    p_conn->d_budget.d_bytes -= pkt->d_bytes;
+    pkt->d_bytes = 0;
+    pkt->d_flag &= ~WILDDOG_CONN_PKT_FLAG_BUDGET;
+}
+
+/*
+ * Function:    _wilddog_conn_budget_lowWater
+ * Description: call the low-water callback if the rest packets fell to the
+ *              mark after they were above it.
+ * Input:       p_conn: the connect layer.
+ * Output:      N/A
+ * Return:      N/A
+*/
+STATIC void WD_SYSTEM _wilddog_conn_budget_lowWater(Wilddog_Conn_T *p_conn){
+    Wilddog_Conn_Budget_T *p_bgt = &p_conn->d_budget;
+
+    if(NULL == p_bgt->p_low_callback || FALSE == p_bgt->d_above)
+        return;
+    if(p_bgt->d_requests > p_bgt->d_low_count || p_bgt->d_bytes > p_bgt->d_low_bytes)
+        return;
+    p_bgt->d_above = FALSE;
+    (p_bgt->p_low_callback)(p_bgt->p_low_arg);
+}
+
+/*time a is before time b, works when time wrapped*/
+#define WILDDOG_CONN_TIME_BEFORE(a,b) ((s32)((u32)(a) - (u32)(b)) < 0)
+
+#define WILDDOG_CONN_TIMER_INIT_SIZE 16
+
+STATIC void WD_SYSTEM _wilddog_conn_timer_swap
+    (
+    Wilddog_Conn_Timer_T *p_timer, 
+    u32 a, 
+    u32 b
+    )
+{
+    Wilddog_Conn_Pkt_T *tmp = p_timer->p_heap[a];
+    
+    p_timer->p_heap[a] = p_timer->p_heap[b];
+    p_timer->p_heap[b] = tmp;
+    p_timer->p_heap[a]->d_timer_index = a + 1;
+    p_timer->p_heap[b]->d_timer_index = b + 1;
+}
+
+/*
+ * Function:    _wilddog_conn_timer_sift
+ * Description: move the heap node at pos up or down to its right position.
+ * Input:       p_timer: the timer.
+ *              pos: position in heap, begin with 0.
+ * Output:      N/A
+ * Return:      N/A
+*/
+STATIC void WD_SYSTEM _wilddog_conn_timer_sift
+    (
+    Wilddog_Conn_Timer_T *p_timer, 
+    u32 pos
+    )
+{
+    Wilddog_Conn_Pkt_T **heap = p_timer->p_heap;
+    u32 child;
+    
+    while(pos > 0 && WILDDOG_CONN_TIME_BEFORE(heap[pos]->d_timer_due, \
+                                              heap[(pos - 1) / 2]->d_timer_due)){
+        _wilddog_conn_timer_swap(p_timer, pos, (pos - 1) / 2);
+        pos = (pos - 1) / 2;
+    }
+    while((child = pos * 2 + 1) < p_timer->d_num){
+        if(child + 1 < p_timer->d_num && \
+           WILDDOG_CONN_TIME_BEFORE(heap[child + 1]->d_timer_due, \
+                                    heap[child]->d_timer_due)){
+            child++;
+        }
+        if(!WILDDOG_CONN_TIME_BEFORE(heap[child]->d_timer_due, \
+                                     heap[pos]->d_timer_due)){
+            break;
+        }
+        _wilddog_conn_timer_swap(p_timer, pos, child);
+        pos = child;
+    }
+}
+
+/*
+ * Function:    _wilddog_conn_timer_remove
+ * Description: remove the packet from timer, must be called when it was
+ *              deleted from observer/rest list.
+ * Input:       p_conn: the connect layer.
+ *              pkt: the packet.
+ * Output:      N/A
+ * Return:      N/A
+*/
+void WD_SYSTEM _wilddog_conn_timer_remove
+    (
+    Wilddog_Conn_T *p_conn, 
+    Wilddog_Conn_Pkt_T *pkt
+    )
+{
+    Wilddog_Conn_Timer_T *p_timer = &p_conn->d_timer[pkt->d_prio];
+    u32 pos;
+
+    if(0 == pkt->d_timer_index)
+        return;
+    pos = pkt->d_timer_index - 1;
+    pkt->d_timer_index = 0;
+    p_timer->d_num--;
+    if(pos == p_timer->d_num)
+        return;
+    p_timer->p_heap[pos] = p_timer->p_heap[p_timer->d_num];
+    p_timer->p_heap[pos]->d_timer_index = pos + 1;
+    _wilddog_conn_timer_sift(p_timer, pos);
+}
+
+/*
+ * Function:    _wilddog_conn_timer_schedule
+ * Description: add the packet to timer, or change its due time.
+ * Input:       p_conn: the connect layer.
+ *              pkt: the packet.
+ *              due: when to check it.
+ * Output:      N/A
+ * Return:      If success, return WILDDOG_ERR_NOERR.
+*/
+Wilddog_Return_T WD_SYSTEM _wilddog_conn_timer_schedule
+    (
+    Wilddog_Conn_T *p_conn, 
+    Wilddog_Conn_Pkt_T *pkt, 
+    u32 due
+    )
+{
+    Wilddog_Conn_Timer_T *p_timer = &p_conn->d_timer[pkt->d_prio];
+
+    pkt->d_timer_due = due;
+    if(0 != pkt->d_timer_index){
+        _wilddog_conn_timer_sift(p_timer, pkt->d_timer_index - 1);
+        return WILDDOG_ERR_NOERR;
+    }
+    if(p_timer->d_num == p_timer->d_size){
+        u32 size = p_timer->d_size ? p_timer->d_size * 2 : \
+                   WILDDOG_CONN_TIMER_INIT_SIZE;
+        Wilddog_Conn_Pkt_T **heap = (Wilddog_Conn_Pkt_T **)wrealloc( \
+                                p_timer->p_heap, \
+                                p_timer->d_size * sizeof(Wilddog_Conn_Pkt_T*), \
+                                size * sizeof(Wilddog_Conn_Pkt_T*));
+        if(NULL == heap){
+            wilddog_debug_level(WD_DEBUG_ERROR, "Malloc timer failed!");
+            return WILDDOG_ERR_NULL;
+        }
+        p_timer->p_heap = heap;
+        p_timer->d_size = size;
+    }
+    p_timer->p_heap[p_timer->d_num] = pkt;
+    pkt->d_timer_index = ++p_timer->d_num;
+    _wilddog_conn_timer_sift(p_timer, p_timer->d_num - 1);
+    return WILDDOG_ERR_NOERR;
+}
+
+/*
+ * Function:    _wilddog_conn_timer_update
+ * Description: compute the packet's deadline and reschedule it, the 
+ *              deadline is the timeout time, and the next send time if 
+ *              authed. Packet has no deadline will be removed from timer.
+ * Input:       p_conn: the connect layer.
+ *              pkt: the packet.
+ * Output:      N/A
+ * Return:      If success, return WILDDOG_ERR_NOERR.
+*/
+STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_timer_update
+    (
+    Wilddog_Conn_T *p_conn, 
+    Wilddog_Conn_Pkt_T *pkt
+    )
+{
+    BOOL hasDue = FALSE;
+    u32 due = 0;
+    
+    if(0 == (WILDDOG_CONN_PKT_FLAG_NEVERTIMEOUT & pkt->d_flag)){
+        due = pkt->d_register_time + WILDDOG_RETRANSMITE_TIME + 1;
+        hasDue = TRUE;
+    }
+    //queued packet waits for window, only its timeout is timed.
+    if(WILDDOG_SESSION_AUTHED == p_conn->d_session.d_session_status && \
+       0 == (WILDDOG_CONN_PKT_FLAG_QUEUED & pkt->d_flag)){
+        if(FALSE == hasDue || \
+           WILDDOG_CONN_TIME_BEFORE(pkt->d_next_send_time, due)){
+            due = pkt->d_next_send_time;
+        }
+        hasDue = TRUE;
+    }
+    if(FALSE == hasDue){
+        _wilddog_conn_timer_remove(p_conn, pkt);
+        return WILDDOG_ERR_NOERR;
+    }
+    return _wilddog_conn_timer_schedule(p_conn, pkt, due);
+}
+
+/*
+ * Function:    _wilddog_conn_timer_setPrio
+ * Description: change the priority class of a packet not in window yet, it 
+ *              moves to the heap of the class.
+ * Input:       p_conn: the connect layer.
+ *              pkt: the packet.
+ *              prio: the priority class.
+ * Output:      N/A
+ * Return:      N/A
+*/
+void WD_SYSTEM _wilddog_conn_timer_setPrio
+    (
+    Wilddog_Conn_T *p_conn, 
+    Wilddog_Conn_Pkt_T *pkt, 
+    u8 prio
+    )
+{
+    if(prio == pkt->d_prio)
+        return;
+    if(0 == pkt->d_timer_index){
+        pkt->d_prio = prio;
+        return;
+    }
+    _wilddog_conn_timer_remove(p_conn, pkt);
+    pkt->d_prio = prio;
+    _wilddog_conn_timer_schedule(p_conn, pkt, pkt->d_timer_due);
+}
+
+/*
+ * Function:    _wilddog_conn_timer_deinit
+ * Description: free the heaps of all classes, the packets are not touched.
+ * Input:       p_conn: the connect layer.
+ * Output:      N/A
+ * Return:      N/A
+*/
+void WD_SYSTEM _wilddog_conn_timer_deinit(Wilddog_Conn_T *p_conn)
+{
+    int prio;
+
+    for(prio = 0; prio < WILDDOG_CONN_PRIO_MAX; prio++){
+        if(p_conn->d_timer[prio].p_heap)
+            wfree(p_conn->d_timer[prio].p_heap);
+    }
+    memset(p_conn->d_timer, 0, sizeof(p_conn->d_timer));
+}
+
+#define WILDDOG_CONN_MID_INDEX_INIT_SIZE 16
+#define WILDDOG_CONN_MID_HASH(mid,size) (((u32)(mid) * 2654435761U) & ((size) - 1))
+
+/*slot marker of a deleted packet, probing must go on over it.*/
+STATIC Wilddog_Conn_Pkt_T l_wilddog_conn_midDeleted;
+#define WILDDOG_CONN_MID_DELETED (&l_wilddog_conn_midDeleted)
+
+/*
+ * Function:    _wilddog_conn_midIndex_resize
+ * Description: rebuild the message id index with a new size, drop all
+ *              deleted slots.
+ * Input:       p_conn: the connect layer.
+ *              size: new size, must be power of 2.
+ * Output:      N/A
+ * Return:      If success, return WILDDOG_ERR_NOERR.
+*/
+STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_midIndex_resize
+    (
+    Wilddog_Conn_T *p_conn, 
+    u32 size
+    )
+{
+    Wilddog_Conn_Mid_Index_T *p_index = &p_conn->d_mid_index;
+    Wilddog_Conn_Pkt_T **table;
+    u32 i, pos;
+
+    table = (Wilddog_Conn_Pkt_T **)wmalloc(size * sizeof(Wilddog_Conn_Pkt_T*));
+    if(NULL == table){
+        wilddog_debug_level(WD_DEBUG_ERROR, "Malloc mid index failed!");
+        return WILDDOG_ERR_NULL;
+    }
+    for(i = 0; i < p_index->d_size; i++){
+        Wilddog_Conn_Pkt_T *pkt = p_index->p_table[i];
+        if(NULL == pkt || WILDDOG_CONN_MID_DELETED == pkt)
+            continue;
+        pos = WILDDOG_CONN_MID_HASH(pkt->d_message_id, size);
+        while(table[pos])
+            pos = (pos + 1) & (size - 1);
+        table[pos] = pkt;
+    }
+    if(p_index->p_table)
+        wfree(p_index->p_table);
+    p_index->p_table = table;
+    p_index->d_size = size;
+    p_index->d_used = p_index->d_num;
+    return WILDDOG_ERR_NOERR;
+}
+
+/*
+ * Function:    _wilddog_conn_midIndex_add
+ * Description: add the packet to message id index, must be called after the 
+ *              protocol layer gave it a message id.
+ * Input:       p_conn: the connect layer.
+ *              pkt: the packet.
+ * Output:      N/A
+ * Return:      If success, return WILDDOG_ERR_NOERR.
+*/
+Wilddog_Return_T WD_SYSTEM _wilddog_conn_midIndex_add
+    (
+    Wilddog_Conn_T *p_conn, 
+    Wilddog_Conn_Pkt_T *pkt
+    )
+{
+    Wilddog_Conn_Mid_Index_T *p_index;
+    u32 pos;
+
+    wilddog_assert(p_conn && pkt, WILDDOG_ERR_NULL);
+    p_index = &p_conn->d_mid_index;
+    //no message id, means it was never sent, cannot be matched.
+    if(0 == pkt->d_message_id)
+        return WILDDOG_ERR_NOERR;
+    //keep load under 1/2
+    if((p_index->d_used + 1) * 2 > p_index->d_size){
+        u32 size = WILDDOG_CONN_MID_INDEX_INIT_SIZE;
+        while(size < (p_index->d_num + 1) * 4)
+            size <<= 1;
+        if(WILDDOG_ERR_NOERR != _wilddog_conn_midIndex_resize(p_conn, size))
+            return WILDDOG_ERR_NULL;
+    }
+    pos = WILDDOG_CONN_MID_HASH(pkt->d_message_id, p_index->d_size);
+    while(p_index->p_table[pos] && \
+          WILDDOG_CONN_MID_DELETED != p_index->p_table[pos]){
+        pos = (pos + 1) & (p_index->d_size - 1);
+    }
+    if(NULL == p_index->p_table[pos])
+        p_index->d_used++;
+    p_index->p_table[pos] = pkt;
+    p_index->d_num++;
+    return WILDDOG_ERR_NOERR;
+}
+
+/*
+ * Function:    _wilddog_conn_midIndex_remove
+ * Description: remove the packet from message id index, must be called when
+ *              it was deleted from observer/rest list.
+ * Input:       p_conn: the connect layer.
+ *              pkt: the packet.
+ * Output:      N/A
+ * Return:      N/A
+*/
+void WD_SYSTEM _wilddog_conn_midIndex_remove
+    (
+    Wilddog_Conn_T *p_conn, 
+    Wilddog_Conn_Pkt_T *pkt
+    )
+{
+    Wilddog_Conn_Mid_Index_T *p_index = &p_conn->d_mid_index;
+    u32 pos;
+
+    if(0 == p_index->d_num || 0 == pkt->d_message_id)
+        return;
+    pos = WILDDOG_CONN_MID_HASH(pkt->d_message_id, p_index->d_size);
+    while(p_index->p_table[pos]){
+        if(pkt == p_index->p_table[pos]){
+            p_index->p_table[pos] = WILDDOG_CONN_MID_DELETED;
+            p_index->d_num--;
+            return;
+        }
+        pos = (pos + 1) & (p_index->d_size - 1);
+    }
+}
+
+/*
+ * Function:    _wilddog_conn_midIndex_find
+ * Description: find the observe/rest packet which has the message id.
+ * Input:       p_conn: the connect layer.
+ *              mid: the message id.
+ * Output:      N/A
+ * Return:      The packet, or NULL if not found.
+*/
+Wilddog_Conn_Pkt_T * WD_SYSTEM _wilddog_conn_midIndex_find
+    (
+    Wilddog_Conn_T *p_conn, 
+    u32 mid
+    )
+{
+    Wilddog_Conn_Mid_Index_T *p_index = &p_conn->d_mid_index;
+    u32 pos;
+
+    if(0 == p_index->d_num)
+        return NULL;
+    pos = WILDDOG_CONN_MID_HASH(mid, p_index->d_size);
+    while(p_index->p_table[pos]){
+        if(WILDDOG_CONN_MID_DELETED != p_index->p_table[pos] && \
+           mid == p_index->p_table[pos]->d_message_id){
+            return p_index->p_table[pos];
+        }
+        pos = (pos + 1) & (p_index->d_size - 1);
+    }
+    return NULL;
+}
+
+/*
+ * Function:    _wilddog_conn_midIndex_deinit
+ * Description: free the message id index.
+ * Input:       p_conn: the connect layer.
+ * Output:      N/A
+ * Return:      N/A
+*/
+void WD_SYSTEM _wilddog_conn_midIndex_deinit(Wilddog_Conn_T *p_conn)
+{
+    if(p_conn->d_mid_index.p_table)
+        wfree(p_conn->d_mid_index.p_table);
+    memset(&p_conn->d_mid_index, 0, sizeof(Wilddog_Conn_Mid_Index_T));
+}
+
+/*
+ * Function:    _wilddog_conn_timer_rebuild
+ * Description: recompute all observe/rest packets' deadline, used when
+ *              deadlines become earlier, such as session authed.
+ * Input:       p_conn: the connect layer.
+ * Output:      N/A
+ * Return:      N/A
+*/
+STATIC void WD_SYSTEM _wilddog_conn_timer_rebuild(Wilddog_Conn_T *p_conn){
+    Wilddog_Conn_Pkt_T *curr;
+    
+    LL_FOREACH(p_conn->d_conn_user.p_observer_list,curr){
+        _wilddog_conn_timer_update(p_conn, curr);
+    }
+    LL_FOREACH(p_conn->d_conn_user.p_rest_list,curr){
+        _wilddog_conn_timer_update(p_conn, curr);
+    }
+}
+
+/*
+ * Function:    _wilddog_conn_window_transmit
+ * Description: send a queued rest packet, it was built but not sent.
+ * Input:       p_conn: the connect layer.
+ *              pkt: the packet.
+ * Output:      N/A
+ * Return:      the protocol layer result.
+*/
+STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_window_transmit
+    (
+    Wilddog_Conn_T *p_conn, 
+    Wilddog_Conn_Pkt_T *pkt
+    )
+{
+    Wilddog_Proto_Cmd_Arg_T command;
+
+    if(NULL == p_conn->p_protocol->callback || NULL == pkt->p_data)
+        return WILDDOG_ERR_NULL;
+    command.p_data = (u8*)pkt->p_data->data;
+    command.d_data_len = pkt->p_data->len;
+    command.p_message_id= &pkt->d_message_id;
+    command.p_url = pkt->p_url;
+    command.protocol = p_conn->p_protocol;
+    command.p_out_data = NULL;
+    command.p_out_data_len = NULL;
+    command.p_proto_data = &(pkt->p_proto_data);
+    command.p_session_info = p_conn->d_session.short_sid;
+    command.d_session_len = WILDDOG_CONN_SESSION_SHORT_LEN - 1;
+    wilddog_debug_level(WD_DEBUG_LOG, "Send queued pkt 0x%x", \
+                        (unsigned int)pkt->d_message_id);
+    return (p_conn->p_protocol->callback)(WD_PROTO_CMD_SEND_RETRANSMIT, \
+                                          &command, 0);
+}
+
+/*
+ * Function:    _wilddog_conn_window_coalesce
+ * Description: get the url cache of a coalescing set packet.
+ * Input:       pkt: the packet.
+ * Output:      N/A
+ * Return:      the url cache, NULL if pkt is not a coalescing set.
+*/
+STATIC Wilddog_Url_Cache_T * WD_SYSTEM _wilddog_conn_window_coalesce
+    (
+    Wilddog_Conn_Pkt_T *pkt
+    )
+{
+    if(0 == (WILDDOG_CONN_PKT_FLAG_COALESCE & pkt->d_flag) || NULL == pkt->p_url)
+        return NULL;
+    return pkt->p_url->p_url_cache;
+}
+
+/*d_seq a is before d_seq b, works when d_seq wrapped*/
+#define WILDDOG_CONN_SEQ_BEFORE(a,b) ((s32)((u32)(a) - (u32)(b)) < 0)
+
+/*
+ * Function:    _wilddog_conn_window_related
+ * Description: whether two packets are of the same path, or one is of the 
+ *              parent of the other, they must keep the order.
+ * Input:       p_a, p_b: the packets of the same host.
+ * Output:      N/A
+ * Return:      TRUE if related.
+*/
+STATIC BOOL WD_SYSTEM _wilddog_conn_window_related
+    (
+    Wilddog_Conn_Pkt_T *p_a, 
+    Wilddog_Conn_Pkt_T *p_b
+    )
+{
+    const char *p_short, *p_long;
+    u32 len;
+
+    if(NULL == p_a->p_url->p_url_path || NULL == p_b->p_url->p_url_path)
+        return TRUE;
+    p_short = (const char*)p_a->p_url->p_url_path;
+    p_long = (const char*)p_b->p_url->p_url_path;
+    len = p_a->d_path_len;
+    if(len > p_b->d_path_len){
+        p_short = (const char*)p_b->p_url->p_url_path;
+        p_long = (const char*)p_a->p_url->p_url_path;
+        len = p_b->d_path_len;
+    }
+    if(0 != memcmp(p_short, p_long, len))
+        return FALSE;
+    //"/a" is the parent of "/a/b" but not of "/ab", "/" is the root.
+    return ('\0' == p_long[len] || '/' == p_long[len] || \
+            (len > 0 && '/' == p_short[len - 1]));
+}
+
+/*
+ * Function:    _wilddog_conn_window_blocked
+ * Description: whether a rest packet must wait, a packet never overtakes a 
+ *              queued one before it of a related path.
+ * Input:       p_conn: the connect layer.
+ *              pkt: the packet in rest list.
+ * Output:      N/A
+ * Return:      TRUE if a related packet before it is queued.
+*/
+STATIC BOOL WD_SYSTEM _wilddog_conn_window_blocked
+    (
+    Wilddog_Conn_T *p_conn, 
+    Wilddog_Conn_Pkt_T *pkt
+    )
+{
+    Wilddog_Conn_Pkt_T *curr;
+    int prio;
+
+    for(prio = 0; prio < WILDDOG_CONN_PRIO_MAX; prio++){
+        for(curr = p_conn->d_window.p_queue[prio]; curr && \
+            WILDDOG_CONN_SEQ_BEFORE(curr->d_seq, pkt->d_seq); \
+            curr = curr->p_queue_next){
+            if(_wilddog_conn_window_related(curr, pkt))
+                return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/*
+ * Function:    _wilddog_conn_window_seq
+ * Description: get d_seq for a rest packet after the others, 0 is never 
+ *              used, it means not numbered.
+ * Input:       p_win: the window.
+ * Output:      N/A
+ * Return:      the d_seq.
+*/
+STATIC u32 WD_SYSTEM _wilddog_conn_window_seq(Wilddog_Conn_Window_T *p_win){
+    if(0 == ++p_win->d_seq)
+        ++p_win->d_seq;
+    return p_win->d_seq;
+}
+
+/*
+ * Function:    _wilddog_conn_window_enqueue
+ * Description: mark a rest packet queued, and put it in the queue of its 
+ *              class by d_seq, mostly at the tail.
+ * Input:       p_win: the window.
+ *              pkt: the packet, not queued.
+ * Output:      N/A
+ * Return:      N/A
+*/
+STATIC void WD_SYSTEM _wilddog_conn_window_enqueue
+    (
+    Wilddog_Conn_Window_T *p_win, 
+    Wilddog_Conn_Pkt_T *pkt
+    )
+{
+    Wilddog_Conn_Pkt_T *p_prev = p_win->p_queue_tail[pkt->d_prio];
+
+    while(p_prev && WILDDOG_CONN_SEQ_BEFORE(pkt->d_seq, p_prev->d_seq))
+        p_prev = p_prev->p_queue_prev;
+    pkt->p_queue_prev = p_prev;
+    if(p_prev){
+        pkt->p_queue_next = p_prev->p_queue_next;
+        p_prev->p_queue_next = pkt;
+    }else{
+        pkt->p_queue_next = p_win->p_queue[pkt->d_prio];
+        p_win->p_queue[pkt->d_prio] = pkt;
+    }
+    if(pkt->p_queue_next)
+        pkt->p_queue_next->p_queue_prev = pkt;
+    else
+        p_win->p_queue_tail[pkt->d_prio] = pkt;
+    pkt->d_flag |= WILDDOG_CONN_PKT_FLAG_QUEUED;
+    p_win->d_queued++;
+    p_win->d_class_queued[pkt->d_prio]++;
+}
+
+/*
+ * Function:    _wilddog_conn_window_dequeue
+ * Description: a queued rest packet leaves the queue of its class.
+ * Input:       p_win: the window.
+ *              pkt: the packet, queued.
+ * Output:      N/A
+ * Return:      N/A
+*/
+STATIC void WD_SYSTEM _wilddog_conn_window_dequeue
+    (
+    Wilddog_Conn_Window_T *p_win, 
+    Wilddog_Conn_Pkt_T *pkt
+    )
+{
+    if(pkt->p_queue_prev)
+        pkt->p_queue_prev->p_queue_next = pkt->p_queue_next;
+    else
+        p_win->p_queue[pkt->d_prio] = pkt->p_queue_next;
+    if(pkt->p_queue_next)
+        pkt->p_queue_next->p_queue_prev = pkt->p_queue_prev;
+    else
+        p_win->p_queue_tail[pkt->d_prio] = pkt->p_queue_prev;
+    pkt->p_queue_prev = NULL;
+    pkt->p_queue_next = NULL;
+    pkt->d_flag &= ~WILDDOG_CONN_PKT_FLAG_QUEUED;
+    p_win->d_queued--;
+    p_win->d_class_queued[pkt->d_prio]--;
+}
+
+/*
+ * Function:    _wilddog_conn_window_room
+ * Description: whether the window has room for a packet of the class, bulk
+ *              leaves the last slot to the others.
+ * Input:       p_win: the window.
+ *              prio: the priority class.
+ * Output:      N/A
+ * Return:      TRUE if it can be sent.
+*/
+STATIC BOOL WD_SYSTEM _wilddog_conn_window_room
+    (
+    Wilddog_Conn_Window_T *p_win, 
+    u8 prio
+    )
+{
+    if(WILDDOG_CONN_PRIO_BULK == prio && p_win->d_window > 1)
+        return (p_win->d_inflight + 1 < p_win->d_window);
+    return (p_win->d_inflight < p_win->d_window);
+}
+
+/*
+ * Function:    _wilddog_conn_window_send
+ * Description: decide whether a new rest packet is sent now, it is sent 
+ *              when authed, the window has room for its class, and nothing
+ *              of its class or higher, or of a related path, is queued 
+ *              before it, else it is queued. A coalescing set is also queued
+ *              while a set of the url is in flight.
+ * Input:       p_conn: the connect layer.
+ *              pkt: the packet, just added to rest list.
+ * Output:      N/A
+ * Return:      TRUE if send it now.
+*/
+BOOL WD_SYSTEM _wilddog_conn_window_send
+    (
+    Wilddog_Conn_T *p_conn, 
+    Wilddog_Conn_Pkt_T *pkt
+    )
+{
+    Wilddog_Conn_Window_T *p_win = &p_conn->d_window;
+    Wilddog_Url_Cache_T *p_cache = _wilddog_conn_window_coalesce(pkt);
+    BOOL isQueue = FALSE;
+    int prio;
+    
+    //a replacing set has d_seq of the one it replaced.
+    if(0 == pkt->d_seq)
+        pkt->d_seq = _wilddog_conn_window_seq(p_win);
+    for(prio = 0; prio <= pkt->d_prio; prio++){
+        if(p_win->d_class_queued[prio] > 0)
+            isQueue = TRUE;
+    }
+    if(WILDDOG_SESSION_AUTHED != p_conn->d_session.d_session_status || \
+       TRUE == isQueue || FALSE == _wilddog_conn_window_room(p_win, pkt->d_prio) || \
+       (p_cache && p_cache->d_inflight > 0) || \
+       (p_win->d_queued > 0 && _wilddog_conn_window_blocked(p_conn, pkt))){
+        _wilddog_conn_window_enqueue(p_win, pkt);
+        _wilddog_conn_timer_update(p_conn, pkt);
+        return FALSE;
+    }
+    pkt->d_flag |= WILDDOG_CONN_PKT_FLAG_INFLIGHT;
+    p_win->d_inflight++;
+    if(p_cache)
+        p_cache->d_inflight++;
+    ++pkt->d_count;
+    pkt->d_next_send_time = _wilddog_conn_getNextSendTime(p_conn, pkt);
+    _wilddog_conn_timer_update(p_conn, pkt);
+    return TRUE;
+}
+
+/*
+ * Function:    _wilddog_conn_window_queue
+ * Description: put a rest packet back to queue, when the session changed,
+ *              it is called in rest list order, so each packet gets a new 
+ *              d_seq and goes to the tail of its class.
+ * Input:       p_conn: the connect layer.
+ *              pkt: the packet.
+ * Output:      N/A
+ * Return:      N/A
+*/
+STATIC void WD_SYSTEM _wilddog_conn_window_queue
+    (
+    Wilddog_Conn_T *p_conn, 
+    Wilddog_Conn_Pkt_T *pkt
+    )
+{
+    Wilddog_Url_Cache_T *p_cache = _wilddog_conn_window_coalesce(pkt);
+
+    if(WILDDOG_CONN_PKT_FLAG_INFLIGHT & pkt->d_flag){
+        pkt->d_flag &= ~WILDDOG_CONN_PKT_FLAG_INFLIGHT;
+        p_conn->d_window.d_inflight--;
+        if(p_cache)
+            p_cache->d_inflight--;
+    }
+    if(WILDDOG_CONN_PKT_FLAG_QUEUED & pkt->d_flag)
+        _wilddog_conn_window_dequeue(&p_conn->d_window, pkt);
+    pkt->d_seq = _wilddog_conn_window_seq(&p_conn->d_window);
+    _wilddog_conn_window_enqueue(&p_conn->d_window, pkt);
+}
+
+/*
+ * Function:    _wilddog_conn_window_remove
+ * Description: a rest packet is deleted, it leaves the window or queue, 
+ *              and the budget.
+ * Input:       p_conn: the connect layer.
+ *              pkt: the packet.
+ * Output:      N/A
+ * Return:      N/A
+*/
+STATIC void WD_SYSTEM _wilddog_conn_window_remove
+    (
+    Wilddog_Conn_T *p_conn, 
+    Wilddog_Conn_Pkt_T *pkt
+    )
+{
+    Wilddog_Url_Cache_T *p_cache = _wilddog_conn_window_coalesce(pkt);
+
+    if(WILDDOG_CONN_PKT_FLAG_INFLIGHT & pkt->d_flag){
+        p_conn->d_window.d_inflight--;
+        if(p_cache)
+            p_cache->d_inflight--;
+    }
+    if(WILDDOG_CONN_PKT_FLAG_QUEUED & pkt->d_flag)
+        _wilddog_conn_window_dequeue(&p_conn->d_window, pkt);
+    if(p_cache && pkt == p_cache->p_pending)
+        p_cache->p_pending = NULL;
+    pkt->d_flag &= ~(WILDDOG_CONN_PKT_FLAG_INFLIGHT | \
+                     WILDDOG_CONN_PKT_FLAG_QUEUED);
+    _wilddog_conn_budget_remove(p_conn, pkt);
+}
+
+/*
+ * Function:    _wilddog_conn_window_release
+ * Description: send the queued rest packets while window is open, class by
+ *              class, in order in a class. the timeout of a packet never sent
+ *              counts from now. A coalescing set waits until the set of its 
+ *              url in flight is responded, and a packet waits the queued ones
+ *              before it of a related path.
+ * Input:       p_conn: the connect layer.
+ * Output:      N/A
+ * Return:      N/A
+*/
+void WD_SYSTEM _wilddog_conn_window_release(Wilddog_Conn_T *p_conn){
+    Wilddog_Conn_Window_T *p_win = &p_conn->d_window;
+    Wilddog_Conn_Pkt_T *curr, *tmp;
+    Wilddog_Url_Cache_T *p_cache;
+    int prio;
+
+    if(WILDDOG_SESSION_AUTHED != p_conn->d_session.d_session_status)
+        return;
+    for(prio = 0; prio < WILDDOG_CONN_PRIO_MAX; prio++){
+        for(curr = p_win->p_queue[prio]; curr; curr = tmp){
+            tmp = curr->p_queue_next;
+            if(FALSE == _wilddog_conn_window_room(p_win, (u8)prio))
+                break;
+            p_cache = _wilddog_conn_window_coalesce(curr);
+            if(p_cache && p_cache->d_inflight > 0)
+                continue;
+            if(_wilddog_conn_window_blocked(p_conn, curr))
+                continue;
+            _wilddog_conn_window_dequeue(p_win, curr);
+            curr->d_flag |= WILDDOG_CONN_PKT_FLAG_INFLIGHT;
+            p_win->d_inflight++;
+            if(p_cache){
+                p_cache->d_inflight++;
+                if(curr == p_cache->p_pending)
+                    p_cache->p_pending = NULL;
+            }
+            if(0 == curr->d_count)
+                curr->d_register_time = _wilddog_getTime();
+            curr->d_count++;
+            curr->d_next_send_time = _wilddog_conn_getNextSendTime(p_conn, curr);
+            _wilddog_conn_timer_update(p_conn, curr);
+            _wilddog_conn_window_transmit(p_conn, curr);
+        }
+    }
+}
+
+/*
+ * Function:    _wilddog_conn_window_ack
+ * Description: a rest packet is responded, grow the window if it is full.
+ * Input:       p_conn: the connect layer.
+ *              pkt: the packet responded.
+ * Output:      N/A
+ * Return:      N/A
+*/
+void WD_SYSTEM _wilddog_conn_window_ack
+    (
+    Wilddog_Conn_T *p_conn, 
+    Wilddog_Conn_Pkt_T *pkt
+    )
+{
+    Wilddog_Conn_Window_T *p_win = &p_conn->d_window;
+
+    if(0 == (WILDDOG_CONN_PKT_FLAG_INFLIGHT & pkt->d_flag))
+        return;
+    //the window not used up by its class tells nothing about the path.
+    if(TRUE == _wilddog_conn_window_room(p_win, pkt->d_prio) || \
+       p_win->d_window >= WILDDOG_WINDOW_MAX){
+        return;
+    }
+    if(p_win->d_window < p_win->d_ssthresh){
+        p_win->d_window++;
+    }else if(++p_win->d_acked >= p_win->d_window){
+        p_win->d_acked = 0;
+        p_win->d_window++;
+    }
+}
+
+/*
+ * Function:    _wilddog_conn_window_loss
+ * Description: a rest packet is retransmitted, halve the window, but only
+ *              once per rto, the packets lost together count once.
+ * Input:       p_conn: the connect layer.
+ *              pkt: the packet retransmitted.
+ * Output:      N/A
+ * Return:      N/A
+*/
+void WD_SYSTEM _wilddog_conn_window_loss
+    (
+    Wilddog_Conn_T *p_conn, 
+    Wilddog_Conn_Pkt_T *pkt
+    )
+{
+    Wilddog_Conn_Window_T *p_win = &p_conn->d_window;
+    u32 now = _wilddog_getTime();
+
+    if(0 == (WILDDOG_CONN_PKT_FLAG_INFLIGHT & pkt->d_flag) || \
+       now - p_win->d_loss_time < p_conn->d_rto.d_rto){
+        return;
+    }
+    p_win->d_loss_time = now;
+    p_win->d_ssthresh = (p_win->d_window > 2)?(p_win->d_window / 2):(1);
+    p_win->d_window = p_win->d_ssthresh;
+    p_win->d_acked = 0;
+    wilddog_debug_level(WD_DEBUG_LOG, "Lost pkt 0x%x, window %lu", \
+                        (unsigned int)pkt->d_message_id, \
+                        (unsigned long)p_win->d_window);
 }
 /*
     Ping policy: When authed:
@@ -162,6 +1291,69 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_ping_callback
     }
     return ret;
 }
+/*
+ * Function:    _wilddog_conn_get_keep
+ * Description: keep a copy of the value got in the url cache, with the etag
+ *              the protocol layer kept, the next get of the url reuses it if
+ *              the server answers 2.03. The old one is freed, a value 
+ *              without etag or too large is not kept, and the etag is not 
+ *              sent.
+ * Input:       p_cache: the url cache.
+ *              p_node: the value got, the user owns it.
+ *              len: the encoded length of the value.
+ * Output:      N/A
+ * Return:      N/A
+*/
+STATIC void WD_SYSTEM _wilddog_conn_get_keep
+    (
+    Wilddog_Url_Cache_T *p_cache,
+    Wilddog_Node_T *p_node,
+    u32 len
+    )
+{
+    if(NULL == p_cache)
+        return;
+    if(p_cache->p_snapshot){
+        wilddog_node_delete(p_cache->p_snapshot);
+        p_cache->p_snapshot = NULL;
+    }
+    if(p_node && p_cache->d_etag_len && 0 != WILDDOG_GET_SNAPSHOT_MAXSIZE && \
+       len <= WILDDOG_GET_SNAPSHOT_MAXSIZE){
+        p_cache->p_snapshot = wilddog_node_clone(p_node);
+    }
+    //nothing to reuse, do not ask with the etag.
+    if(NULL == p_cache->p_snapshot)
+        p_cache->d_etag_len = 0;
+}
+
+/*
+ * Function:    _wilddog_conn_get_again
+ * Description: the server answers 2.03 but the value is not kept, get the 
+ *              whole value again without the etag, the new get calls the 
+ *              user callback instead.
+ * Input:       p_conn: the connect layer.
+ *              pkt: the get answered.
+ * Output:      N/A
+ * Return:      WILDDOG_ERR_NOERR if the new get is queued.
+*/
+STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_get_again
+    (
+    Wilddog_Conn_T *p_conn, 
+    Wilddog_Conn_Pkt_T *pkt
+    )
+{
+    Wilddog_ConnCmd_Arg_T arg;
+
+    if(pkt->p_url->p_url_cache)
+        pkt->p_url->p_url_cache->d_etag_len = 0;
+    memset(&arg, 0, sizeof(arg));
+    arg.p_repo = p_conn->p_conn_repo;
+    arg.p_url = pkt->p_url;
+    arg.p_complete = pkt->p_user_callback;
+    arg.p_completeArg = pkt->p_user_arg;
+    return _wilddog_conn_get(&arg, 0);
+}
+
 STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_get_callback
     (
     Wilddog_Conn_T *p_conn, 
@@ -174,6 +1366,7 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_get_callback
     Wilddog_Return_T ret = WILDDOG_ERR_INVALID;
     Wilddog_Node_T *p_node = NULL;
     Wilddog_Conn_Pkt_T *curr,*tmp;
+    Wilddog_Url_Cache_T *p_cache = NULL;
     
     wilddog_assert(p_conn&&pkt, WILDDOG_ERR_NULL);
 
@@ -181,7 +1374,25 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_get_callback
         "Receive get packet [0x%x], return code is [%d]", \
         (unsigned int)pkt->d_message_id,error_code);
     
-    if(WILDDOG_HTTP_OK == error_code){
+    p_cache = pkt->p_url->p_url_cache;
+    if(WILDDOG_HTTP_NOT_MODIFIED == error_code){
+        //the etag we sent is valid, the value is not changed, reuse it.
+        if(p_cache && p_cache->p_snapshot){
+            p_node = wilddog_node_clone(p_cache->p_snapshot);
+            if(p_node){
+                error_code = WILDDOG_HTTP_OK;
+                ret = WILDDOG_ERR_NOERR;
+            }else{
+                error_code = WILDDOG_ERR_NULL;
+            }
+        }else{
+            //the value is dropped after the get was sent, ask it again.
+            ret = _wilddog_conn_get_again(p_conn, pkt);
+            if(WILDDOG_ERR_NOERR == ret)
+                goto get_done;
+            error_code = ret;
+        }
+    }else if(WILDDOG_HTTP_OK == error_code){
         //handle the payload
         Wilddog_Payload_T node_payload;
         Wilddog_Str_T *p_path = NULL;
@@ -212,6 +1423,8 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_get_callback
             _wilddog_node_setKey(p_node, p_path);
         }
         ret = WILDDOG_ERR_NOERR;
+        //kept before the user can change it.
+        _wilddog_conn_get_keep(p_cache, p_node, payload_len);
 
     }else if(WILDDOG_HTTP_UNAUTHORIZED == error_code){
         p_conn->d_session.d_session_status = WILDDOG_SESSION_NOTAUTHED;
@@ -229,10 +1442,14 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_get_callback
     if(p_node)
         wilddog_node_delete(p_node);
 
+get_done:
     LL_FOREACH_SAFE(p_conn->d_conn_user.p_rest_list,curr,tmp){
         if(curr == pkt){
             //match, remove it
             LL_DELETE(p_conn->d_conn_user.p_rest_list, curr);
+            _wilddog_conn_timer_remove(p_conn, curr);
+            _wilddog_conn_midIndex_remove(p_conn, curr);
+            _wilddog_conn_window_remove(p_conn, curr);
             _wilddog_conn_packet_deInit(curr);
             wfree(curr);
             p_conn->d_conn_user.d_count--;
@@ -241,6 +1458,29 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_get_callback
     }
     return ret;
 }
+/*
+ * Function:    _wilddog_conn_coalesce_callback
+ * Description: call the callbacks chained to a set, in order, and free them.
+ * Input:       pkt: the set.
+ *              error_code: the result of the set.
+ * Output:      N/A
+ * Return:      N/A
+*/
+STATIC void WD_SYSTEM _wilddog_conn_coalesce_callback
+    (
+    Wilddog_Conn_Pkt_T *pkt,
+    Wilddog_Return_T error_code
+    )
+{
+    Wilddog_Conn_Pkt_Cb_T *p_cb, *p_tmp;
+
+    LL_FOREACH_SAFE(pkt->p_chain, p_cb, p_tmp){
+        LL_DELETE(pkt->p_chain, p_cb);
+        (p_cb->p_user_callback)(p_cb->p_user_arg, error_code);
+        wfree(p_cb);
+    }
+}
+
 STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_set_callback
     (
     Wilddog_Conn_T *p_conn, 
@@ -268,6 +1508,8 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_set_callback
         wilddog_debug_level(WD_DEBUG_WARN, "Get an error [%d].",(int)error_code);
     }
     
+    //the sets it replaced first, then its own.
+    _wilddog_conn_coalesce_callback(pkt, error_code);
     //user callback
     if(pkt->p_user_callback){
         wilddog_debug_level(WD_DEBUG_LOG, "Tigger setValue callback.");
@@ -278,6 +1520,9 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_set_callback
         if(curr == pkt){
             //match, remove it
             LL_DELETE(p_conn->d_conn_user.p_rest_list, curr);
+            _wilddog_conn_timer_remove(p_conn, curr);
+            _wilddog_conn_midIndex_remove(p_conn, curr);
+            _wilddog_conn_window_remove(p_conn, curr);
             _wilddog_conn_packet_deInit(curr);
             wfree(curr);
             p_conn->d_conn_user.d_count--;
@@ -323,6 +1568,9 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_push_callback
         if(curr == pkt){
             //match, remove it
             LL_DELETE(p_conn->d_conn_user.p_rest_list, curr);
+            _wilddog_conn_timer_remove(p_conn, curr);
+            _wilddog_conn_midIndex_remove(p_conn, curr);
+            _wilddog_conn_window_remove(p_conn, curr);
             _wilddog_conn_packet_deInit(curr);
             wfree(curr);
             p_conn->d_conn_user.d_count--;
@@ -395,6 +1643,9 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_remove_callback
         if(curr == pkt){
             //match, remove it
             LL_DELETE(p_conn->d_conn_user.p_rest_list, curr);
+            _wilddog_conn_timer_remove(p_conn, curr);
+            _wilddog_conn_midIndex_remove(p_conn, curr);
+            _wilddog_conn_window_remove(p_conn, curr);
             _wilddog_conn_packet_deInit(curr);
             wfree(curr);
             p_conn->d_conn_user.d_count--;
@@ -480,6 +1731,8 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_addObserver_callback
             if(curr == pkt){
                 //match, remove it
                 LL_DELETE(p_conn->d_conn_user.p_observer_list, curr);
+                _wilddog_conn_timer_remove(p_conn, curr);
+                _wilddog_conn_midIndex_remove(p_conn, curr);
                 _wilddog_conn_packet_deInit(curr);
                 wfree(curr);
                 p_conn->d_conn_user.d_count--;
@@ -527,6 +1780,9 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_removeObserver_callback
         if(curr == pkt){
             //match, remove it
             LL_DELETE(p_conn->d_conn_user.p_rest_list, curr);
+            _wilddog_conn_timer_remove(p_conn, curr);
+            _wilddog_conn_midIndex_remove(p_conn, curr);
+            _wilddog_conn_window_remove(p_conn, curr);
             _wilddog_conn_packet_deInit(curr);
             wfree(curr);
             p_conn->d_conn_user.d_count--;
@@ -568,6 +1824,9 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_disCommon_callback
         if(curr == pkt){
             //match, remove it
             LL_DELETE(p_conn->d_conn_user.p_rest_list, curr);
+            _wilddog_conn_timer_remove(p_conn, curr);
+            _wilddog_conn_midIndex_remove(p_conn, curr);
+            _wilddog_conn_window_remove(p_conn, curr);
             _wilddog_conn_packet_deInit(curr);
             wfree(curr);
             p_conn->d_conn_user.d_count--;
@@ -664,14 +1923,162 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_offline_callback
         if(curr == pkt){
             //match, remove it
             LL_DELETE(p_conn->d_conn_user.p_rest_list, curr);
+            _wilddog_conn_timer_remove(p_conn, curr);
+            _wilddog_conn_midIndex_remove(p_conn, curr);
+            _wilddog_conn_window_remove(p_conn, curr);
             _wilddog_conn_packet_deInit(curr);
             wfree(curr);
             p_conn->d_conn_user.d_count--;
             break;
         }
     }
-    return ret;
-
+    return ret;
+
+}
+
+/*
+ * Function:    _wilddog_conn_getAuthToken
+ * Description: get the user auth token in store. It is read directly, the
+ *              store ioctl inits the connect layer of a repo without one, so
+ *              it can not be used before _wilddog_conn_init returns.
+ * Input:       p_conn: the connect layer.
+ * Output:      pp_token: the token, NULL if no store.
+ * Return:      the length of the token.
+*/
+STATIC u32 WD_SYSTEM _wilddog_conn_getAuthToken
+    (
+    Wilddog_Conn_T *p_conn, 
+    u8 **pp_token
+    )
+{
+    Wilddog_Store_T *p_store = p_conn->p_conn_repo->p_rp_store;
+
+    *pp_token = NULL;
+    if(NULL == p_store || NULL == p_store->p_se_auth)
+        return 0;
+    *pp_token = p_store->p_se_auth->p_auth;
+    return p_store->p_se_auth->d_len;
+}
+/*
+ * Function:    _wilddog_conn_authHash
+ * Description: FNV-1a hash of an auth token, tells which token a saved 
+ *              session is got with, without saving the token.
+ * Input:       p_token: the token.
+ *              len: the length of the token, may be 0.
+ * Output:      N/A
+ * Return:      the hash.
+*/
+STATIC u32 WD_SYSTEM _wilddog_conn_authHash(u8 *p_token, u32 len){
+    u32 hash = 2166136261U, i;
+
+    for(i = 0; p_token && i < len; i++){
+        hash = (hash ^ p_token[i]) * 16777619U;
+    }
+    return hash;
+}
+/*
+ * Function:    _wilddog_conn_sessionSave
+ * Description: save the session by the port layer, with the hash of the 
+ *              token it is got with, so the next start can reuse it.
+ * Input:       p_conn: the connect layer.
+ * Output:      N/A
+ * Return:      N/A
+*/
+STATIC void WD_SYSTEM _wilddog_conn_sessionSave(Wilddog_Conn_T *p_conn){
+    Wilddog_Conn_Session_Saved_T saved;
+
+    memset(&saved, 0, sizeof(saved));
+    saved.d_magic = WILDDOG_CONN_SESSION_MAGIC;
+    saved.d_auth_hash = p_conn->d_conn_sys.d_auth_hash;
+    memcpy(&saved.d_session, &p_conn->d_session, sizeof(Wilddog_Session_T));
+    if(wilddog_sessionSave((char*)p_conn->p_conn_repo->p_rp_url->p_url_host, \
+                           &saved, sizeof(saved)) < 0){
+        wilddog_debug_level(WD_DEBUG_LOG, "Session is not saved.");
+    }
+}
+/*
+ * Function:    _wilddog_conn_sessionReady
+ * Description: the session is authed, register the observers again and send
+ *              the stored rest packets through the window.
+ * Input:       p_conn: the connect layer.
+ * Output:      N/A
+ * Return:      N/A
+*/
+STATIC void WD_SYSTEM _wilddog_conn_sessionReady(Wilddog_Conn_T *p_conn){
+    Wilddog_Conn_Pkt_T *curr,*tmp;
+
+    //change observe/rest stored packets' send time to now.
+    LL_FOREACH_SAFE(p_conn->d_conn_user.p_observer_list,curr,tmp){
+        if(curr){
+            if((WILDDOG_CONN_PKT_FLAG_NEVERTIMEOUT & curr->d_flag) == 0x1){
+                //first observe response packet received before, 
+                //now re auth, so need register again.
+                curr->d_register_time = _wilddog_getTime();
+            }
+            curr->d_flag &= ~WILDDOG_CONN_PKT_FLAG_NEVERTIMEOUT;
+            curr->d_count = 0;
+            curr->d_next_send_time = _wilddog_getTime();
+        }
+    }
+    //rest packets are sent again through the window.
+    LL_FOREACH_SAFE(p_conn->d_conn_user.p_rest_list,curr,tmp){
+        if(curr){
+            _wilddog_conn_window_queue(p_conn, curr);
+            //the session changed, its rtt means nothing.
+            curr->d_send_time = 0;
+        }
+    }
+    _wilddog_conn_timer_rebuild(p_conn);
+    //online, change status
+    p_conn->d_conn_sys.d_auth_fail_count = 0;
+    p_conn->d_conn_sys.d_offline_time = 0;
+    p_conn->d_conn_sys.d_online_retry_count = 0;
+}
+/*
+ * Function:    _wilddog_conn_sessionResume
+ * Description: reuse the saved session if it is got with the token in 
+ *              store, so no need to wait for auth. It is only a guess, if 
+ *              the server rejects it, sessionInit erases it and auths.
+ * Input:       p_conn: the connect layer.
+ * Output:      N/A
+ * Return:      TRUE if the saved session is used.
+*/
+STATIC BOOL WD_SYSTEM _wilddog_conn_sessionResume(Wilddog_Conn_T *p_conn){
+    Wilddog_Conn_Session_Saved_T saved;
+    u8 *p_token = NULL;
+    u32 len, hash;
+
+    len = _wilddog_conn_getAuthToken(p_conn, &p_token);
+    hash = _wilddog_conn_authHash(p_token, len);
+    if((int)sizeof(saved) != wilddog_sessionLoad( \
+            (char*)p_conn->p_conn_repo->p_rp_url->p_url_host, \
+            &saved, sizeof(saved)) || \
+       WILDDOG_CONN_SESSION_MAGIC != saved.d_magic || \
+       hash != saved.d_auth_hash){
+        return FALSE;
+    }
+    //the saved tokens are not trusted to be terminated.
+    memcpy(p_conn->d_session.short_sid, saved.d_session.short_sid, \
+           WILDDOG_CONN_SESSION_SHORT_LEN - 1);
+    p_conn->d_session.short_sid[WILDDOG_CONN_SESSION_SHORT_LEN - 1] = '\0';
+    memcpy(p_conn->d_session.long_sid, saved.d_session.long_sid, \
+           WILDDOG_CONN_SESSION_LONG_LEN - 1);
+    p_conn->d_session.long_sid[WILDDOG_CONN_SESSION_LONG_LEN - 1] = '\0';
+    p_conn->d_session.d_session_status = WILDDOG_SESSION_AUTHED;
+    p_conn->d_conn_sys.d_auth_hash = hash;
+    p_conn->d_conn_sys.d_resumed = TRUE;
+    //an auth in flight is not needed any more.
+    if(p_conn->d_conn_sys.p_auth){
+        _wilddog_conn_packet_deInit(p_conn->d_conn_sys.p_auth);
+        wfree(p_conn->d_conn_sys.p_auth);
+        p_conn->d_conn_sys.p_auth = NULL;
+    }
+    wilddog_debug_level(WD_DEBUG_LOG, \
+        "Reuse saved session!Short token is %s, long token is %s", \
+        p_conn->d_session.short_sid,
+        p_conn->d_session.long_sid);
+    _wilddog_conn_sessionReady(p_conn);
+    return TRUE;
 }
 
 STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_auth_callback
@@ -684,7 +2091,6 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_auth_callback
     )
 {
     Wilddog_Return_T ret = WILDDOG_ERR_INVALID;
-    Wilddog_Conn_Pkt_T *curr,*tmp;
     wilddog_assert(p_conn&&pkt, WILDDOG_ERR_NULL);
     wilddog_assert(p_conn->d_conn_sys.p_auth == pkt, WILDDOG_ERR_INVALID);
 
@@ -787,28 +2193,9 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_auth_callback
             //free p_node
             wilddog_node_delete(p_node);
             ret = WILDDOG_ERR_NOERR;
-            //change observe/rest stored packets' send time to now.
-            LL_FOREACH_SAFE(p_conn->d_conn_user.p_observer_list,curr,tmp){
-                if(curr){
-                    if((WILDDOG_CONN_PKT_FLAG_NEVERTIMEOUT & curr->d_flag) == 0x1){
-                        //first observe response packet received before, 
-                        //now re auth, so need register again.
-                        curr->d_register_time = _wilddog_getTime();
-                    }
-                    curr->d_flag &= ~WILDDOG_CONN_PKT_FLAG_NEVERTIMEOUT;
-                    curr->d_count = 0;
-                    curr->d_next_send_time = _wilddog_getTime();
-                }
-            }
-            LL_FOREACH_SAFE(p_conn->d_conn_user.p_rest_list,curr,tmp){
-                if(curr){
-                    curr->d_next_send_time = _wilddog_getTime();
-                }
-            }
-            //online, change status
-            p_conn->d_conn_sys.d_auth_fail_count = 0;
-            p_conn->d_conn_sys.d_offline_time = 0;
-            p_conn->d_conn_sys.d_online_retry_count = 0;
+            p_conn->d_conn_sys.d_resumed = FALSE;
+            _wilddog_conn_sessionSave(p_conn);
+            _wilddog_conn_sessionReady(p_conn);
             break;
         }
         case WILDDOG_HTTP_BAD_REQUEST:
@@ -896,8 +2283,13 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_pkt_data_free(Wilddog_Conn_Pkt_D
     return WILDDOG_ERR_NOERR;
 }
 STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_packet_deInit(Wilddog_Conn_Pkt_T * pkt){
+    Wilddog_Conn_Pkt_Cb_T *p_cb, *p_tmp;
     wilddog_assert(pkt, WILDDOG_ERR_NULL);
 
+    LL_FOREACH_SAFE(pkt->p_chain, p_cb, p_tmp){
+        LL_DELETE(pkt->p_chain, p_cb);
+        wfree(p_cb);
+    }
     if(pkt->p_proto_data){
         wfree(pkt->p_proto_data);
         pkt->p_proto_data = NULL;
@@ -934,11 +2326,15 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_packet_init(Wilddog_Conn_Pkt_T *
         return WILDDOG_ERR_NULL;
     }
     pkt->p_complete = NULL;
+    pkt->d_prio = WILDDOG_CONN_PRIO_INTERACTIVE;
     pkt->d_count = 0;
     pkt->d_next_send_time = 0;
     pkt->d_message_id = 0;
     pkt->next = NULL;
     pkt->d_register_time = _wilddog_getTime();
+    pkt->d_create_time = pkt->d_register_time;
+    if(pkt->p_url->p_url_path)
+        pkt->d_path_len = strlen((const char*)pkt->p_url->p_url_path);
     return WILDDOG_ERR_NOERR;
 }
 STATIC BOOL WD_SYSTEM _wilddog_conn_midCmp(u32 s_mid,u32 d_mid){
@@ -952,8 +2348,6 @@ STATIC BOOL WD_SYSTEM _wilddog_conn_midCmp(u32 s_mid,u32 d_mid){
  * find the send packet matched with received packet
 */
 STATIC Wilddog_Conn_Pkt_T * WD_SYSTEM _wilddog_conn_recv_sendPktFind(Wilddog_Conn_T *p_conn,u32 mid){
-    Wilddog_Conn_Pkt_T *curr, *tmp;
-
     wilddog_assert(p_conn,NULL);
         
     if(p_conn->d_conn_sys.p_auth){
@@ -967,19 +2361,8 @@ STATIC Wilddog_Conn_Pkt_T * WD_SYSTEM _wilddog_conn_recv_sendPktFind(Wilddog_Con
             return p_conn->d_conn_sys.p_ping;
         }
     }
-    //observe list check
-    LL_FOREACH_SAFE(p_conn->d_conn_user.p_observer_list,curr,tmp){
-        if(TRUE == _wilddog_conn_midCmp(mid,curr->d_message_id)){
-            return curr;
-        }
-    }
-    //rest list check
-    LL_FOREACH_SAFE(p_conn->d_conn_user.p_rest_list,curr,tmp){
-        if(TRUE == _wilddog_conn_midCmp(mid,curr->d_message_id)){
-            return curr;
-        }
-    }
-    return NULL;
+    //observe and rest list check
+    return _wilddog_conn_midIndex_find(p_conn, mid);
 }
 STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_reconnect(Wilddog_Conn_T *p_conn){
     //reconnect socket 
@@ -1033,9 +2416,17 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_retransmitPkt(Wilddog_Conn_T *p_
     command.p_session_info = p_conn->d_session.short_sid;
     command.d_session_len = WILDDOG_CONN_SESSION_SHORT_LEN - 1;
 
+    //a packet queued for window does not time out while the session is 
+    //fine, its timeout counts from the first transmission.
+    if((WILDDOG_CONN_PKT_FLAG_QUEUED & pkt->d_flag) && \
+       WILDDOG_SESSION_AUTHED == p_conn->d_session.d_session_status){
+        pkt->d_register_time = _wilddog_getTime();
+    }
     if(_wilddog_conn_isTimeout(_wilddog_getTime(),pkt->d_register_time,WILDDOG_RETRANSMITE_TIME) && \
         0 == (WILDDOG_CONN_PKT_FLAG_NEVERTIMEOUT & pkt->d_flag)){
-        //timeout, trigger callback
+        //timeout, callback will delete it, if not, check it next time.
+        if(pkt != p_conn->d_conn_sys.p_ping)
+            _wilddog_conn_timer_schedule(p_conn, pkt, _wilddog_getTime() + 1);
         if(pkt->p_complete){
             Wilddog_Return_T ret;
             if(WILDDOG_SESSION_INIT == p_conn->d_session.d_session_status){
@@ -1049,11 +2440,14 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_retransmitPkt(Wilddog_Conn_T *p_
         }
         p_conn->d_timeout_count++;
         return WILDDOG_ERR_RECVTIMEOUT;
-    }else if(_wilddog_getTime() >= pkt->d_next_send_time){
+    }else if(_wilddog_getTime() >= pkt->d_next_send_time && \
+             0 == (WILDDOG_CONN_PKT_FLAG_QUEUED & pkt->d_flag)){
         //if authed, we can handle retransmit.
         if(WILDDOG_SESSION_AUTHED == p_conn->d_session.d_session_status){
             pkt->d_count++;
-            pkt->d_next_send_time = _wilddog_conn_getNextSendTime(pkt->d_count);
+            pkt->d_next_send_time = _wilddog_conn_getNextSendTime(p_conn, pkt);
+            if(pkt->d_count > 1)
+                _wilddog_conn_window_loss(p_conn, pkt);
             if(p_conn->p_protocol->callback){
                 wilddog_debug_level(WD_DEBUG_LOG, "Retransmit pkt 0x%x",(unsigned int)pkt->d_message_id);
                 (p_conn->p_protocol->callback)(WD_PROTO_CMD_SEND_RETRANSMIT, &command, 0);
@@ -1062,9 +2456,11 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_retransmitPkt(Wilddog_Conn_T *p_
             //not authed
 //            wilddog_debug_level(WD_DEBUG_WARN, "Not authed, do not retransmit packet 0x%x.",(unsigned int)pkt->d_message_id);
             //pkt->d_count++;
-            //pkt->d_next_send_time = _wilddog_conn_getNextSendTime(pkt->d_count);
+            //pkt->d_next_send_time = _wilddog_conn_getNextSendTime(p_conn, pkt);
         }
     }
+    if(pkt != p_conn->d_conn_sys.p_ping)
+        _wilddog_conn_timer_update(p_conn, pkt);
     return WILDDOG_ERR_NOERR;
 }
 /*
@@ -1081,7 +2477,7 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_pingHandler(Wilddog_Conn_T* p_co
     Wilddog_Conn_Pkt_T *pkt = p_conn->d_conn_sys.p_ping;
 
     wilddog_assert(p_conn&&p_conn->p_protocol, WILDDOG_ERR_NULL);
-    //already handled ping retransmit and timeout, now we handle send
+    //ping retransmit and timeout are handled by retransmitHandler, here send
     if(WILDDOG_SESSION_AUTHED == p_conn->d_session.d_session_status && NULL == p_conn->d_conn_sys.p_ping){
         Wilddog_Proto_Cmd_Arg_T command;
         command.p_data = NULL;
@@ -1115,6 +2511,7 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_pingHandler(Wilddog_Conn_T* p_co
                 return WILDDOG_ERR_NULL;
             }
             pkt->p_complete = (Wilddog_Func_T)_wilddog_conn_ping_callback;
+            pkt->d_prio = WILDDOG_CONN_PRIO_CONTROL;
             //add to ping queue
             p_conn->d_conn_sys.p_ping = pkt;
 
@@ -1143,15 +2540,16 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_pingHandler(Wilddog_Conn_T* p_co
                 }
             }
             pkt->d_count++;
-            pkt->d_next_send_time = _wilddog_conn_getNextSendTime(pkt->d_count);
+            pkt->d_next_send_time = _wilddog_conn_getNextSendTime(p_conn, pkt);
         }
     }
     return WILDDOG_ERR_NOERR;
 }
 STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_retransmitHandler(Wilddog_Conn_T *p_conn){
     u32 last_timeout_count = 0;
+    u32 now;
+    int prio;
     Wilddog_Conn_Pkt_T *pkt = NULL;
-    Wilddog_Conn_Pkt_T *curr, *tmp;
     wilddog_assert(p_conn, WILDDOG_ERR_NULL);
 
     last_timeout_count = p_conn->d_timeout_count;
@@ -1209,7 +2607,7 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_retransmitHandler(Wilddog_Conn_T
                 command.p_session_info = NULL;
                 command.d_session_len = 0;
                 pkt->d_count++;
-                pkt->d_next_send_time = _wilddog_conn_getNextSendTime(pkt->d_count);
+                pkt->d_next_send_time = _wilddog_conn_getNextSendTime(p_conn, pkt);
                 if(p_conn->p_protocol->callback){
                     wilddog_debug_level(WD_DEBUG_LOG, "Retransmit auth pkt 0x%x",(unsigned int)pkt->d_message_id);
                     (p_conn->p_protocol->callback)(WD_PROTO_CMD_SEND_RETRANSMIT, &command, 0);
@@ -1221,17 +2619,15 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_retransmitHandler(Wilddog_Conn_T
     if(pkt){
         _wilddog_conn_retransmitPkt(p_conn,pkt);
     }
-    //observe list
-    LL_FOREACH_SAFE(p_conn->d_conn_user.p_observer_list,curr,tmp){
-        if(curr){
-            //flash observe's regster time, never timeout
-            _wilddog_conn_retransmitPkt(p_conn,curr);
-        }
-    }
-    //rest list
-    LL_FOREACH_SAFE(p_conn->d_conn_user.p_rest_list,curr,tmp){
-        if(curr){
-            _wilddog_conn_retransmitPkt(p_conn,curr);
+    //observe and rest list, only the due packets in timer, higher class 
+    //first. retransmitPkt always reschedule or remove the packet.
+    now = _wilddog_getTime();
+    for(prio = 0; prio < WILDDOG_CONN_PRIO_MAX; prio++){
+        while(p_conn->d_timer[prio].d_num > 0){
+            pkt = p_conn->d_timer[prio].p_heap[0];
+            if(WILDDOG_CONN_TIME_BEFORE(now, pkt->d_timer_due))
+                break;
+            _wilddog_conn_retransmitPkt(p_conn,pkt);
         }
     }
 
@@ -1243,6 +2639,148 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_retransmitHandler(Wilddog_Conn_T
     }
     return WILDDOG_ERR_NOERR;
 }
+/*
+ * Function:    _wilddog_conn_sendNon
+ * Description: send a set or push once as non-confirmable. no packet is 
+ *              queued, so no retransmit and no timeout, the user callback is
+ *              called only when it fails locally, a push gets no new path.
+ * Input:       p_conn: the connect layer.
+ *              arg: the set or push arg.
+ *              cmd: WD_PROTO_CMD_SEND_SET_NON or WD_PROTO_CMD_SEND_PUSH_NON.
+ * Output:      N/A
+ * Return:      WILDDOG_ERR_NOERR if sent.
+*/
+STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_sendNon
+    (
+    Wilddog_Conn_T *p_conn,
+    Wilddog_ConnCmd_Arg_T *arg,
+    Wilddog_Proto_Cmd_T cmd
+    )
+{
+    Wilddog_Proto_Cmd_Arg_T command;
+    Wilddog_Payload_T *payload = NULL;
+    u32 message_id = 0;
+    Wilddog_Return_T ret = WILDDOG_ERR_NULL;
+
+    //nothing keeps it until the session is ready.
+    if(p_conn->d_session.d_session_status != WILDDOG_SESSION_AUTHED){
+        ret = WILDDOG_ERR_CLIENTOFFLINE;
+        goto non_done;
+    }
+    if(NULL == arg->p_data || NULL == p_conn->p_protocol->callback)
+        goto non_done;
+    payload = _wilddog_node2Payload(arg->p_data);
+    if(NULL == payload)
+        goto non_done;
+    //the ref url lives longer than the request, its cache saves the options.
+    _wilddog_url_getCache(arg->p_url);
+
+    memset(&command, 0, sizeof(command));
+    command.p_data = payload->p_dt_data;
+    command.d_data_len = payload->d_dt_len;
+    command.p_message_id= &message_id;
+    command.p_url = arg->p_url;
+    command.protocol = p_conn->p_protocol;
+    command.p_session_info = p_conn->d_session.short_sid;
+    command.d_session_len = WILDDOG_CONN_SESSION_SHORT_LEN - 1;
+    ret = (p_conn->p_protocol->callback)(cmd, &command, TRUE);
+    wilddog_debug_level(WD_DEBUG_LOG, "Send non pkt 0x%x, ret %d", \
+                        (unsigned int)message_id, ret);
+
+    if(payload->p_dt_data)
+        wfree(payload->p_dt_data);
+    wfree(payload);
+non_done:
+    //no response will come, a local failure is the only result.
+    if(WILDDOG_ERR_NOERR != ret && arg->p_complete){
+        if(WD_PROTO_CMD_SEND_PUSH_NON == cmd)
+            (arg->p_complete)(NULL, arg->p_completeArg, ret);
+        else
+            (arg->p_complete)(arg->p_completeArg, ret);
+        arg->p_complete = NULL;
+    }
+    return ret;
+}
+
+/*
+ * Function:    _wilddog_conn_coalesce_fence
+ * Description: a write of the url never coalesced, such as an update or a 
+ *              remove, keeps its order with the coalescing sets of the url,
+ *              it waits the set in flight as they do, and the sets after it
+ *              never replace the one queued before it.
+ * Input:       pkt: the write, just added to rest list.
+ * Output:      N/A
+ * Return:      N/A
+*/
+STATIC void WD_SYSTEM _wilddog_conn_coalesce_fence(Wilddog_Conn_Pkt_T *pkt){
+    Wilddog_Url_Cache_T *p_cache = pkt->p_url->p_url_cache;
+
+    if(NULL == p_cache || (0 == p_cache->d_inflight && NULL == p_cache->p_pending))
+        return;
+    pkt->d_flag |= WILDDOG_CONN_PKT_FLAG_COALESCE;
+    p_cache->p_pending = NULL;
+}
+
+/*
+ * Function:    _wilddog_conn_coalesce_replace
+ * Description: a newer set of the url takes the place of the queued one, 
+ *              which is never sent, the callback of the old one is chained
+ *              to it, and its timeout counts from the old one.
+ * Input:       p_conn: the connect layer.
+ *              p_old: the queued set.
+ *              pkt: the newer set, not in rest list.
+ * Output:      N/A
+ * Return:      WILDDOG_ERR_NOERR if success.
+*/
+STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_coalesce_replace
+    (
+    Wilddog_Conn_T *p_conn, 
+    Wilddog_Conn_Pkt_T *p_old,
+    Wilddog_Conn_Pkt_T *pkt
+    )
+{
+    Wilddog_Conn_Pkt_Cb_T *p_cb = NULL;
+    Wilddog_Conn_Pkt_T *curr;
+
+    if(p_old->p_user_callback){
+        p_cb = (Wilddog_Conn_Pkt_Cb_T*)wmalloc(sizeof(Wilddog_Conn_Pkt_Cb_T));
+        if(NULL == p_cb){
+            wilddog_debug_level(WD_DEBUG_ERROR, "Malloc failed!");
+            return WILDDOG_ERR_NULL;
+        }
+        p_cb->p_user_callback = p_old->p_user_callback;
+        p_cb->p_user_arg = p_old->p_user_arg;
+    }
+    pkt->p_chain = p_old->p_chain;
+    p_old->p_chain = NULL;
+    if(p_cb)
+        LL_APPEND(pkt->p_chain, p_cb);
+    pkt->d_register_time = p_old->d_register_time;
+    pkt->d_create_time = p_old->d_create_time;
+    pkt->d_seq = p_old->d_seq;
+
+    //in place, it keeps the position in the queue.
+    pkt->next = p_old->next;
+    if(p_old == p_conn->d_conn_user.p_rest_list){
+        p_conn->d_conn_user.p_rest_list = pkt;
+    }else{
+        LL_FOREACH(p_conn->d_conn_user.p_rest_list,curr){
+            if(p_old == curr->next){
+                curr->next = pkt;
+                break;
+            }
+        }
+    }
+    p_old->next = NULL;
+    _wilddog_conn_timer_remove(p_conn, p_old);
+    _wilddog_conn_midIndex_remove(p_conn, p_old);
+    _wilddog_conn_window_remove(p_conn, p_old);
+    _wilddog_conn_packet_deInit(p_old);
+    wfree(p_old);
+    wilddog_debug_level(WD_DEBUG_LOG, "Coalesce setValue, replace the queued one.");
+    return WILDDOG_ERR_NOERR;
+}
+
 STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_commonSet(void* data,int flag, Wilddog_Func_T func,BOOL isDis){
     Wilddog_ConnCmd_Arg_T *arg = (Wilddog_ConnCmd_Arg_T*)data;
     Wilddog_Conn_T *p_conn;
@@ -1250,29 +2788,26 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_commonSet(void* data,int flag, W
     Wilddog_Conn_Pkt_T *pkt;
     Wilddog_Return_T ret = WILDDOG_ERR_INVALID;
     Wilddog_Payload_T *payload = NULL;
+    Wilddog_Conn_Pkt_T *p_old = NULL;
+    Wilddog_Proto_Cmd_T cmd = WD_PROTO_CMD_SEND_SET;
+    u32 bytes = 0;
     wilddog_assert(data, WILDDOG_ERR_NULL);
 
     p_conn = arg->p_repo->p_rp_conn;
     wilddog_assert(p_conn, WILDDOG_ERR_NULL);
 
-    if(p_conn->d_conn_user.d_count > WILDDOG_REQ_QUEUE_NUM){
-        wilddog_debug_level(WD_DEBUG_WARN, "Too many requests! Max is %d",WILDDOG_REQ_QUEUE_NUM);
-        return WILDDOG_ERR_QUEUEFULL;
-    }
-    pkt = (Wilddog_Conn_Pkt_T*)wmalloc(sizeof(Wilddog_Conn_Pkt_T));
-    wilddog_assert(pkt, WILDDOG_ERR_NULL);
-    if(WILDDOG_ERR_NOERR != _wilddog_conn_packet_init(pkt, arg->p_url)){
-        wfree(pkt);
-        wilddog_debug_level(WD_DEBUG_ERROR, "Connect layer packet init failed!");
-        return WILDDOG_ERR_NULL;
-    }
-    pkt->p_complete = (Wilddog_Func_T)func;
-    pkt->p_user_callback = arg->p_complete;
-    pkt->p_user_arg = arg->p_completeArg;
+    if(FALSE == isDis && (WILDDOG_CONN_CMD_FLAG_NON & flag))
+        return _wilddog_conn_sendNon(p_conn, arg, WD_PROTO_CMD_SEND_SET_NON);
+    if(TRUE == isDis)
+        cmd = WD_PROTO_CMD_SEND_DIS_SET;
+    else if(WILDDOG_CONN_CMD_FLAG_UPDATE & flag)
+        cmd = WD_PROTO_CMD_SEND_UPDATE;
 
-    //add to rest queue
-    LL_APPEND(p_conn->d_conn_user.p_rest_list,pkt);
-    p_conn->d_conn_user.d_count++;
+    //the set of the url queued and never sent, it will be replaced.
+    if(FALSE == isDis && (WILDDOG_CONN_CMD_FLAG_COALESCE & flag) && \
+       _wilddog_url_getCache(arg->p_url)){
+        p_old = (Wilddog_Conn_Pkt_T*)arg->p_url->p_url_cache->p_pending;
+    }
     
     if(arg->p_data){
 #if (DEBUG_LEVEL)<=(WD_DEBUG_LOG)
@@ -1293,7 +2828,49 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_commonSet(void* data,int flag, W
             printf("\n");
         }
 #endif
+        if(payload)
+            bytes = payload->d_dt_len;
+    }
+    if(NULL == p_old && TRUE == _wilddog_conn_budget_full(p_conn, bytes)){
+        ret = WILDDOG_ERR_QUEUEFULL;
+        goto set_done;
     }
+    pkt = (Wilddog_Conn_Pkt_T*)wmalloc(sizeof(Wilddog_Conn_Pkt_T));
+    if(NULL == pkt){
+        ret = WILDDOG_ERR_NULL;
+        goto set_done;
+    }
+    if(WILDDOG_ERR_NOERR != _wilddog_conn_packet_init(pkt, arg->p_url)){
+        wfree(pkt);
+        wilddog_debug_level(WD_DEBUG_ERROR, "Connect layer packet init failed!");
+        ret = WILDDOG_ERR_NULL;
+        goto set_done;
+    }
+    pkt->p_complete = (Wilddog_Func_T)func;
+    pkt->p_user_callback = arg->p_complete;
+    pkt->p_user_arg = arg->p_completeArg;
+    if(FALSE == isDis && (WILDDOG_CONN_CMD_FLAG_COALESCE & flag))
+        pkt->d_flag |= WILDDOG_CONN_PKT_FLAG_COALESCE;
+    else if(WD_PROTO_CMD_SEND_UPDATE == cmd)
+        _wilddog_conn_coalesce_fence(pkt);
+
+    if(p_old){
+        if(WILDDOG_ERR_NOERR != _wilddog_conn_coalesce_replace(p_conn, p_old, pkt)){
+            _wilddog_conn_packet_deInit(pkt);
+            wfree(pkt);
+            ret = WILDDOG_ERR_NULL;
+            goto set_done;
+        }
+    }else{
+        //add to rest queue
+        LL_APPEND(p_conn->d_conn_user.p_rest_list,pkt);
+        _wilddog_conn_timer_update(p_conn, pkt);
+        p_conn->d_conn_user.d_count++;
+    }
+    _wilddog_conn_budget_add(p_conn, pkt, bytes);
+    //large values are bulk, sent after the others.
+    if(payload && payload->d_dt_len > WILDDOG_CONN_BULK_SIZE)
+        _wilddog_conn_timer_setPrio(p_conn, pkt, WILDDOG_CONN_PRIO_BULK);
     //send to server
     command.p_data = NULL;
     command.d_data_len = 0;
@@ -1306,6 +2883,7 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_commonSet(void* data,int flag, W
     command.protocol = p_conn->p_protocol;
     command.p_out_data = (u8**)&pkt->p_data;
     command.p_out_data_len = NULL;
+    command.p_proto_data = &(pkt->p_proto_data);
 
     //send pkt must need session info, exclude auth pkt.
     command.p_session_info = p_conn->d_session.short_sid;
@@ -1313,20 +2891,20 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_commonSet(void* data,int flag, W
 
     if(p_conn->p_protocol->callback){
         BOOL isSend = FALSE;//send to server or not
-        if(p_conn->d_session.d_session_status == WILDDOG_SESSION_AUTHED){
-            isSend = TRUE;
-            ++pkt->d_count;
-            pkt->d_next_send_time = _wilddog_conn_getNextSendTime(pkt->d_count);
-        }
-        if(TRUE == isDis){
-            ret = (p_conn->p_protocol->callback)(WD_PROTO_CMD_SEND_DIS_SET, &command, isSend);
-            wilddog_debug_level(WD_DEBUG_LOG, "Send dis setValue pkt 0x%x",(unsigned int)pkt->d_message_id);
-        }else{
-            ret = (p_conn->p_protocol->callback)(WD_PROTO_CMD_SEND_SET, &command, isSend);
-            wilddog_debug_level(WD_DEBUG_LOG, "Send setValue pkt 0x%x",(unsigned int)pkt->d_message_id);
-        }
-    }
-
+        isSend = _wilddog_conn_window_send(p_conn, pkt);
+        //a coalescing set queued can be replaced by the next one.
+        if(FALSE == isSend && (WILDDOG_CONN_CMD_FLAG_COALESCE & flag) && \
+           FALSE == isDis)
+            pkt->p_url->p_url_cache->p_pending = pkt;
+        ret = (p_conn->p_protocol->callback)(cmd, &command, isSend);
+        _wilddog_conn_midIndex_add(p_conn, pkt);
+        wilddog_debug_level(WD_DEBUG_LOG, "Send %s pkt 0x%x", \
+                            (WD_PROTO_CMD_SEND_DIS_SET == cmd) ? "dis setValue" : \
+                            ((WD_PROTO_CMD_SEND_UPDATE == cmd) ? "update" : "setValue"), \
+                            (unsigned int)pkt->d_message_id);
+    }
+
+set_done:
     if(payload){
         if(payload->p_dt_data)
             wfree(payload->p_dt_data);
@@ -1342,30 +2920,14 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_commonPush(void* data,int flag,
     Wilddog_Conn_Pkt_T *pkt;
     Wilddog_Return_T ret = WILDDOG_ERR_INVALID;
     Wilddog_Payload_T *payload = NULL;
+    u32 bytes = 0;
     wilddog_assert(data, WILDDOG_ERR_NULL);
 
     p_conn = arg->p_repo->p_rp_conn;
     wilddog_assert(p_conn, WILDDOG_ERR_NULL);
 
-    if(p_conn->d_conn_user.d_count > WILDDOG_REQ_QUEUE_NUM){
-        wilddog_debug_level(WD_DEBUG_WARN, "Too many requests! Max is %d",WILDDOG_REQ_QUEUE_NUM);
-        return WILDDOG_ERR_QUEUEFULL;
-    }
-
-    pkt = (Wilddog_Conn_Pkt_T*)wmalloc(sizeof(Wilddog_Conn_Pkt_T));
-    wilddog_assert(pkt, WILDDOG_ERR_NULL);
-    if(WILDDOG_ERR_NOERR != _wilddog_conn_packet_init(pkt, arg->p_url)){
-        wfree(pkt);
-        wilddog_debug_level(WD_DEBUG_ERROR, "Connect layer packet init failed!");
-        return WILDDOG_ERR_NULL;
-    }
-    pkt->p_complete = (Wilddog_Func_T)func;
-    pkt->p_user_callback = arg->p_complete;
-    pkt->p_user_arg = arg->p_completeArg;
-
-    //add to rest queue
-    LL_APPEND(p_conn->d_conn_user.p_rest_list,pkt);
-    p_conn->d_conn_user.d_count++;
+    if(FALSE == isDis && (WILDDOG_CONN_CMD_FLAG_NON & flag))
+        return _wilddog_conn_sendNon(p_conn, arg, WD_PROTO_CMD_SEND_PUSH_NON);
     
     if(arg->p_data){
 #if (DEBUG_LEVEL)<=(WD_DEBUG_LOG)
@@ -1386,7 +2948,37 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_commonPush(void* data,int flag,
             printf("\n");
         }
 #endif
+        if(payload)
+            bytes = payload->d_dt_len;
+    }
+    if(TRUE == _wilddog_conn_budget_full(p_conn, bytes)){
+        ret = WILDDOG_ERR_QUEUEFULL;
+        goto push_done;
+    }
+
+    pkt = (Wilddog_Conn_Pkt_T*)wmalloc(sizeof(Wilddog_Conn_Pkt_T));
+    if(NULL == pkt){
+        ret = WILDDOG_ERR_NULL;
+        goto push_done;
+    }
+    if(WILDDOG_ERR_NOERR != _wilddog_conn_packet_init(pkt, arg->p_url)){
+        wfree(pkt);
+        wilddog_debug_level(WD_DEBUG_ERROR, "Connect layer packet init failed!");
+        ret = WILDDOG_ERR_NULL;
+        goto push_done;
     }
+    pkt->p_complete = (Wilddog_Func_T)func;
+    pkt->p_user_callback = arg->p_complete;
+    pkt->p_user_arg = arg->p_completeArg;
+
+    //add to rest queue
+    LL_APPEND(p_conn->d_conn_user.p_rest_list,pkt);
+    _wilddog_conn_timer_update(p_conn, pkt);
+    p_conn->d_conn_user.d_count++;
+    _wilddog_conn_budget_add(p_conn, pkt, bytes);
+    //large values are bulk, sent after the others.
+    if(payload && payload->d_dt_len > WILDDOG_CONN_BULK_SIZE)
+        _wilddog_conn_timer_setPrio(p_conn, pkt, WILDDOG_CONN_PRIO_BULK);
 
     //send to server
     command.p_data = NULL;
@@ -1400,6 +2992,7 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_commonPush(void* data,int flag,
     command.protocol = p_conn->p_protocol;
     command.p_out_data = (u8**)&pkt->p_data;
     command.p_out_data_len = NULL;
+    command.p_proto_data = &(pkt->p_proto_data);
 
     //send pkt must need session info, exclude auth pkt.
     command.p_session_info = p_conn->d_session.short_sid;
@@ -1407,21 +3000,20 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_commonPush(void* data,int flag,
 
     if(p_conn->p_protocol->callback){
         BOOL isSend = FALSE;//send to server or not
-        if(p_conn->d_session.d_session_status == WILDDOG_SESSION_AUTHED){
-            isSend = TRUE;
-            ++pkt->d_count;
-            pkt->d_next_send_time = _wilddog_conn_getNextSendTime(pkt->d_count);
-        }
+        isSend = _wilddog_conn_window_send(p_conn, pkt);
         if(TRUE == isDis){
             ret = (p_conn->p_protocol->callback)(WD_PROTO_CMD_SEND_DIS_PUSH, &command, isSend);
+            _wilddog_conn_midIndex_add(p_conn, pkt);
             wilddog_debug_level(WD_DEBUG_LOG, "Send dis setValue pkt 0x%x",(unsigned int)pkt->d_message_id);
         }else{
             ret = (p_conn->p_protocol->callback)(WD_PROTO_CMD_SEND_PUSH, &command, isSend);
+            _wilddog_conn_midIndex_add(p_conn, pkt);
             wilddog_debug_level(WD_DEBUG_LOG, "Send setValue pkt 0x%x",(unsigned int)pkt->d_message_id);
         }
 
     }
 
+push_done:
     if(payload){
         if(payload->p_dt_data)
             wfree(payload->p_dt_data);
@@ -1441,10 +3033,8 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_commonRemove(void* data,int flag
     p_conn = arg->p_repo->p_rp_conn;
     wilddog_assert(p_conn, WILDDOG_ERR_NULL);
 
-    if(p_conn->d_conn_user.d_count > WILDDOG_REQ_QUEUE_NUM){
-        wilddog_debug_level(WD_DEBUG_WARN, "Too many requests! Max is %d",WILDDOG_REQ_QUEUE_NUM);
+    if(TRUE == _wilddog_conn_budget_full(p_conn, 0))
         return WILDDOG_ERR_QUEUEFULL;
-    }
 
     pkt = (Wilddog_Conn_Pkt_T*)wmalloc(sizeof(Wilddog_Conn_Pkt_T));
     wilddog_assert(pkt, WILDDOG_ERR_NULL);
@@ -1457,9 +3047,14 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_commonRemove(void* data,int flag
     pkt->p_user_callback = arg->p_complete;
     pkt->p_user_arg = arg->p_completeArg;
 
+    if(FALSE == isDis)
+        _wilddog_conn_coalesce_fence(pkt);
+
     //add to rest queue
     LL_APPEND(p_conn->d_conn_user.p_rest_list,pkt);
+    _wilddog_conn_timer_update(p_conn, pkt);
     p_conn->d_conn_user.d_count++;
+    _wilddog_conn_budget_add(p_conn, pkt, 0);
     
     //send to server, delete method has no p_data
     command.p_data = NULL;
@@ -1476,16 +3071,14 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_commonRemove(void* data,int flag
 
     if(p_conn->p_protocol->callback){
         BOOL isSend = FALSE;//send to server or not
-        if(p_conn->d_session.d_session_status == WILDDOG_SESSION_AUTHED){
-            isSend = TRUE;
-            ++pkt->d_count;
-            pkt->d_next_send_time = _wilddog_conn_getNextSendTime(pkt->d_count);
-        }
+        isSend = _wilddog_conn_window_send(p_conn, pkt);
         if(TRUE == isDis){
             ret = (p_conn->p_protocol->callback)(WD_PROTO_CMD_SEND_DIS_REMOVE, &command, isSend);
+            _wilddog_conn_midIndex_add(p_conn, pkt);
             wilddog_debug_level(WD_DEBUG_LOG, "Send dis removeValue pkt 0x%x",(unsigned int)pkt->d_message_id);
         }else{
             ret = (p_conn->p_protocol->callback)(WD_PROTO_CMD_SEND_REMOVE, &command, isSend);
+            _wilddog_conn_midIndex_add(p_conn, pkt);
             wilddog_debug_level(WD_DEBUG_LOG, "Send removeValue pkt 0x%x",(unsigned int)pkt->d_message_id);
         }
         
@@ -1511,6 +3104,7 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_sessionInit(Wilddog_Conn_T *p_co
         return WILDDOG_ERR_NULL;
     }
     pkt->p_complete = (Wilddog_Func_T)_wilddog_conn_auth_callback;
+    pkt->d_prio = WILDDOG_CONN_PRIO_CONTROL;
     //add to auth queue
     if(p_conn->d_conn_sys.p_auth){
         _wilddog_conn_packet_deInit(p_conn->d_conn_sys.p_auth);
@@ -1533,13 +3127,23 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_sessionInit(Wilddog_Conn_T *p_co
     //send pkt must need session info, exclude auth pkt.
     command.p_session_info = NULL;
     command.d_session_len = 0;
+    //the saved session failed, erase it, and auth with the token it used.
+    if(p_conn->d_conn_sys.d_resumed){
+        wilddog_debug_level(WD_DEBUG_WARN, "Saved session failed, auth again.");
+        p_conn->d_conn_sys.d_resumed = FALSE;
+        wilddog_sessionSave((char*)p_conn->p_conn_repo->p_rp_url->p_url_host, \
+                            NULL, 0);
+        command.d_data_len = _wilddog_conn_getAuthToken(p_conn, &command.p_data);
+    }
+    p_conn->d_conn_sys.d_auth_hash = _wilddog_conn_authHash(command.p_data, \
+                                                            command.d_data_len);
 
     if(p_conn->p_protocol->callback){
         (p_conn->p_protocol->callback)(WD_PROTO_CMD_SEND_SESSION_INIT, &command, 0);
         wilddog_debug_level(WD_DEBUG_LOG, "Send init pkt 0x%x",(unsigned int)pkt->d_message_id);
     }
     ++pkt->d_count;
-    pkt->d_next_send_time = _wilddog_conn_getNextSendTime(pkt->d_count);
+    pkt->d_next_send_time = _wilddog_conn_getNextSendTime(p_conn, pkt);
     return WILDDOG_ERR_NOERR;
 }
 STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_sessionRetry(Wilddog_Conn_T *p_conn){
@@ -1580,10 +3184,8 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_get(void* data,int flag){
     p_conn = arg->p_repo->p_rp_conn;
     wilddog_assert(p_conn, WILDDOG_ERR_NULL);
 
-    if(p_conn->d_conn_user.d_count > WILDDOG_REQ_QUEUE_NUM){
-        wilddog_debug_level(WD_DEBUG_WARN, "Too many requests! Max is %d",WILDDOG_REQ_QUEUE_NUM);
+    if(TRUE == _wilddog_conn_budget_full(p_conn, 0))
         return WILDDOG_ERR_QUEUEFULL;
-    }
     
     pkt = (Wilddog_Conn_Pkt_T*)wmalloc(sizeof(Wilddog_Conn_Pkt_T));
     wilddog_assert(pkt, WILDDOG_ERR_NULL);
@@ -1598,7 +3200,9 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_get(void* data,int flag){
 
     //add to rest queue
     LL_APPEND(p_conn->d_conn_user.p_rest_list,pkt);
+    _wilddog_conn_timer_update(p_conn, pkt);
     p_conn->d_conn_user.d_count++;
+    _wilddog_conn_budget_add(p_conn, pkt, 0);
     
     //send to server, get method has no p_data
     command.p_data = NULL;
@@ -1608,19 +3212,17 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_get(void* data,int flag){
     command.protocol = p_conn->p_protocol;
     command.p_out_data = (u8**)&pkt->p_data;
     command.p_out_data_len = NULL;
+    command.p_proto_data = &(pkt->p_proto_data);
 
     //send pkt must need session info, exclude auth pkt.
     command.p_session_info = p_conn->d_session.short_sid;
     command.d_session_len = WILDDOG_CONN_SESSION_SHORT_LEN - 1;
     if(p_conn->p_protocol->callback){
         BOOL isSend = FALSE;//send to server or not
-        if(p_conn->d_session.d_session_status == WILDDOG_SESSION_AUTHED){
-            isSend = TRUE;
-            ++pkt->d_count;
-            pkt->d_next_send_time = _wilddog_conn_getNextSendTime(pkt->d_count);
-        }
+        isSend = _wilddog_conn_window_send(p_conn, pkt);
         
         ret = (p_conn->p_protocol->callback)(WD_PROTO_CMD_SEND_GET, &command, isSend);
+        _wilddog_conn_midIndex_add(p_conn, pkt);
         wilddog_debug_level(WD_DEBUG_LOG, "Send getValue pkt 0x%x",(unsigned int)pkt->d_message_id);
     }
     return ret;
@@ -1645,10 +3247,8 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_addObserver(void* data,int flag)
     p_conn = arg->p_repo->p_rp_conn;
     wilddog_assert(p_conn, WILDDOG_ERR_NULL);
 
-    if(p_conn->d_conn_user.d_count > WILDDOG_REQ_QUEUE_NUM){
-        wilddog_debug_level(WD_DEBUG_WARN, "Too many requests! Max is %d",WILDDOG_REQ_QUEUE_NUM);
+    if(TRUE == _wilddog_conn_budget_full(p_conn, 0))
         return WILDDOG_ERR_QUEUEFULL;
-    }
 
     pkt = (Wilddog_Conn_Pkt_T*)wmalloc(sizeof(Wilddog_Conn_Pkt_T));
     wilddog_assert(pkt, WILDDOG_ERR_NULL);
@@ -1658,11 +3258,13 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_addObserver(void* data,int flag)
         return WILDDOG_ERR_NULL;
     }
     pkt->p_complete = (Wilddog_Func_T)_wilddog_conn_addObserver_callback;
+    pkt->d_prio = WILDDOG_CONN_PRIO_CONTROL;
     pkt->p_user_callback = arg->p_complete;
     pkt->p_user_arg = arg->p_completeArg;
 
     //add to rest queue
     LL_APPEND(p_conn->d_conn_user.p_observer_list,pkt);
+    _wilddog_conn_timer_update(p_conn, pkt);
     p_conn->d_conn_user.d_count++;
     
     //send to server
@@ -1683,10 +3285,11 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_addObserver(void* data,int flag)
         if(p_conn->d_session.d_session_status == WILDDOG_SESSION_AUTHED){
             isSend = TRUE;
             ++pkt->d_count;
-            pkt->d_next_send_time = _wilddog_conn_getNextSendTime(pkt->d_count);
+            pkt->d_next_send_time = _wilddog_conn_getNextSendTime(p_conn, pkt);
         }
         
         ret = (p_conn->p_protocol->callback)(WD_PROTO_CMD_SEND_ON, &command, isSend);
+        _wilddog_conn_midIndex_add(p_conn, pkt);
         wilddog_debug_level(WD_DEBUG_LOG, "Send addObserver pkt 0x%x",(unsigned int)pkt->d_message_id);
     }
     return ret;
@@ -1703,10 +3306,8 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_removeObserver(void* data,int fl
     p_conn = arg->p_repo->p_rp_conn;
     wilddog_assert(p_conn, WILDDOG_ERR_NULL);
 
-    if(p_conn->d_conn_user.d_count > WILDDOG_REQ_QUEUE_NUM){
-        wilddog_debug_level(WD_DEBUG_WARN, "Too many requests! Max is %d",WILDDOG_REQ_QUEUE_NUM);
+    if(TRUE == _wilddog_conn_budget_full(p_conn, 0))
         return WILDDOG_ERR_QUEUEFULL;
-    }
 
     pkt = (Wilddog_Conn_Pkt_T*)wmalloc(sizeof(Wilddog_Conn_Pkt_T));
     wilddog_assert(pkt, WILDDOG_ERR_NULL);
@@ -1716,12 +3317,15 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_removeObserver(void* data,int fl
         return WILDDOG_ERR_NULL;
     }
     pkt->p_complete = (Wilddog_Func_T)_wilddog_conn_removeObserver_callback;
+    pkt->d_prio = WILDDOG_CONN_PRIO_CONTROL;
     pkt->p_user_callback = arg->p_complete;
     pkt->p_user_arg = arg->p_completeArg;
 
     //add to rest queue
     LL_APPEND(p_conn->d_conn_user.p_rest_list,pkt);
+    _wilddog_conn_timer_update(p_conn, pkt);
     p_conn->d_conn_user.d_count++;
+    _wilddog_conn_budget_add(p_conn, pkt, 0);
     
     //send to server, get method has no p_data
     command.p_data = NULL;
@@ -1738,12 +3342,9 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_removeObserver(void* data,int fl
 
     if(p_conn->p_protocol->callback){
         BOOL isSend = FALSE;//send to server or not
-        if(p_conn->d_session.d_session_status == WILDDOG_SESSION_AUTHED){
-            isSend = TRUE;
-            ++pkt->d_count;
-            pkt->d_next_send_time = _wilddog_conn_getNextSendTime(pkt->d_count);
-        }
+        isSend = _wilddog_conn_window_send(p_conn, pkt);
         ret = (p_conn->p_protocol->callback)(WD_PROTO_CMD_SEND_OFF, &command, isSend);
+        _wilddog_conn_midIndex_add(p_conn, pkt);
         wilddog_debug_level(WD_DEBUG_LOG, "Send removeObserver pkt 0x%x",(unsigned int)pkt->d_message_id);
     }
     //remove observer
@@ -1752,6 +3353,8 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_removeObserver(void* data,int fl
             if(TRUE == _wilddog_url_diff(curr->p_url, arg->p_url)){
                 //diff
                 LL_DELETE(p_conn->d_conn_user.p_observer_list,curr);
+                _wilddog_conn_timer_remove(p_conn, curr);
+                _wilddog_conn_midIndex_remove(p_conn, curr);
                 _wilddog_conn_packet_deInit(curr);
                 wfree(curr);
                 break;
@@ -1773,6 +3376,13 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_auth(void* data,int flag){
     p_conn = arg->p_repo->p_rp_conn;
     wilddog_assert(p_conn, WILDDOG_ERR_NULL);
 
+    //the saved session got with this token is used, no need to auth.
+    if(TRUE == _wilddog_conn_sessionResume(p_conn)){
+        if(arg->p_complete){
+            (arg->p_complete)(arg->p_completeArg, WILDDOG_HTTP_OK);
+        }
+        return WILDDOG_ERR_NOERR;
+    }
     pkt = (Wilddog_Conn_Pkt_T*)wmalloc(sizeof(Wilddog_Conn_Pkt_T));
     wilddog_assert(pkt, WILDDOG_ERR_NULL);
     if(WILDDOG_ERR_NOERR != _wilddog_conn_packet_init(pkt, arg->p_url)){
@@ -1781,6 +3391,7 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_auth(void* data,int flag){
         return WILDDOG_ERR_NULL;
     }
     pkt->p_complete = (Wilddog_Func_T)_wilddog_conn_auth_callback;
+    pkt->d_prio = WILDDOG_CONN_PRIO_CONTROL;
     pkt->p_user_callback = arg->p_complete;
     pkt->p_user_arg = arg->p_completeArg;
     //add to auth queue
@@ -1808,18 +3419,17 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_auth(void* data,int flag){
     command.d_session_len = 0;
 
     //get user auth token
-    if(p_conn->p_conn_repo->p_rp_store->p_se_callback){
-        command.d_data_len = (p_conn->p_conn_repo->p_rp_store->p_se_callback)(
-                              p_conn->p_conn_repo->p_rp_store,
-                              WILDDOG_STORE_CMD_GETAUTH,&command.p_data,0);
-    }
+    command.d_data_len = _wilddog_conn_getAuthToken(p_conn, &command.p_data);
+    p_conn->d_conn_sys.d_auth_hash = _wilddog_conn_authHash(command.p_data, \
+                                                            command.d_data_len);
+    p_conn->d_conn_sys.d_resumed = FALSE;
 
     if(p_conn->p_protocol->callback){
         (p_conn->p_protocol->callback)(WD_PROTO_CMD_SEND_SESSION_INIT, &command, 0);
         wilddog_debug_level(WD_DEBUG_LOG, "Send auth pkt 0x%x",(unsigned int)pkt->d_message_id);
     }
     ++pkt->d_count;
-    pkt->d_next_send_time = _wilddog_conn_getNextSendTime(pkt->d_count);
+    pkt->d_next_send_time = _wilddog_conn_getNextSendTime(p_conn, pkt);
     return WILDDOG_ERR_NOERR;
 }
 
@@ -1843,10 +3453,8 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_disCancel(void* data,int flag){
     p_conn = arg->p_repo->p_rp_conn;
     wilddog_assert(p_conn, WILDDOG_ERR_NULL);
 
-    if(p_conn->d_conn_user.d_count > WILDDOG_REQ_QUEUE_NUM){
-        wilddog_debug_level(WD_DEBUG_WARN, "Too many requests! Max is %d",WILDDOG_REQ_QUEUE_NUM);
+    if(TRUE == _wilddog_conn_budget_full(p_conn, 0))
         return WILDDOG_ERR_QUEUEFULL;
-    }
 
     pkt = (Wilddog_Conn_Pkt_T*)wmalloc(sizeof(Wilddog_Conn_Pkt_T));
     wilddog_assert(pkt, WILDDOG_ERR_NULL);
@@ -1861,7 +3469,9 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_disCancel(void* data,int flag){
 
     //add to rest queue
     LL_APPEND(p_conn->d_conn_user.p_rest_list,pkt);
+    _wilddog_conn_timer_update(p_conn, pkt);
     p_conn->d_conn_user.d_count++;
+    _wilddog_conn_budget_add(p_conn, pkt, 0);
     
     command.p_data = NULL;
     command.d_data_len = 0;
@@ -1877,12 +3487,9 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_disCancel(void* data,int flag){
 
     if(p_conn->p_protocol->callback){
         BOOL isSend = FALSE;//send to server or not
-        if(p_conn->d_session.d_session_status == WILDDOG_SESSION_AUTHED){
-            isSend = TRUE;
-            ++pkt->d_count;
-            pkt->d_next_send_time = _wilddog_conn_getNextSendTime(pkt->d_count);
-        }
+        isSend = _wilddog_conn_window_send(p_conn, pkt);
         ret = (p_conn->p_protocol->callback)(WD_PROTO_CMD_SEND_DIS_CANCEL, &command, isSend);
+        _wilddog_conn_midIndex_add(p_conn, pkt);
         wilddog_debug_level(WD_DEBUG_LOG, "Send dis cancel pkt 0x%x",(unsigned int)pkt->d_message_id);
     }
         
@@ -1899,10 +3506,8 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_offline(void* data,int flag){
     p_conn = arg->p_repo->p_rp_conn;
     wilddog_assert(p_conn, WILDDOG_ERR_NULL);
 
-    if(p_conn->d_conn_user.d_count > WILDDOG_REQ_QUEUE_NUM){
-        wilddog_debug_level(WD_DEBUG_WARN, "Too many requests! Max is %d",WILDDOG_REQ_QUEUE_NUM);
+    if(TRUE == _wilddog_conn_budget_full(p_conn, 0))
         return WILDDOG_ERR_QUEUEFULL;
-    }
 
     pkt = (Wilddog_Conn_Pkt_T*)wmalloc(sizeof(Wilddog_Conn_Pkt_T));
     wilddog_assert(pkt, WILDDOG_ERR_NULL);
@@ -1912,12 +3517,19 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_offline(void* data,int flag){
         return WILDDOG_ERR_NULL;
     }
     pkt->p_complete = (Wilddog_Func_T)_wilddog_conn_offline_callback;
+    pkt->d_prio = WILDDOG_CONN_PRIO_CONTROL;
     pkt->p_user_callback = arg->p_complete;
     pkt->p_user_arg = arg->p_completeArg;
+    //the session is closed, it can not be reused after restart.
+    p_conn->d_conn_sys.d_resumed = FALSE;
+    wilddog_sessionSave((char*)p_conn->p_conn_repo->p_rp_url->p_url_host, \
+                        NULL, 0);
 
     //add to rest queue
     LL_APPEND(p_conn->d_conn_user.p_rest_list,pkt);
+    _wilddog_conn_timer_update(p_conn, pkt);
     p_conn->d_conn_user.d_count++;
+    _wilddog_conn_budget_add(p_conn, pkt, 0);
     
     command.p_data = NULL;
     command.d_data_len = 0;
@@ -1933,12 +3545,9 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_offline(void* data,int flag){
 
     if(p_conn->p_protocol->callback){
         BOOL isSend = FALSE;//send to server or not
-        if(p_conn->d_session.d_session_status == WILDDOG_SESSION_AUTHED){
-            isSend = TRUE;
-            ++pkt->d_count;
-            pkt->d_next_send_time = _wilddog_conn_getNextSendTime(pkt->d_count);
-        }
+        isSend = _wilddog_conn_window_send(p_conn, pkt);
         ret = (p_conn->p_protocol->callback)(WD_PROTO_CMD_SEND_OFFLINE, &command, isSend);
+        _wilddog_conn_midIndex_add(p_conn, pkt);
         wilddog_debug_level(WD_DEBUG_LOG, "Send offline pkt 0x%x",(unsigned int)pkt->d_message_id);
     }
         
@@ -1959,45 +3568,44 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_online(void* data,int flag){
     return _wilddog_conn_auth(data, flag);
 }
 
-STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_trySync(void* data,int flag){
+/*
+ * Function:    _wilddog_conn_recvPkt
+ * Description: receive one packet, match it with the send packet and handle.
+ * Input:       p_conn: the pointer of the conn struct
+ *              p_url: the url
+ * Output:      N/A
+ * Return:      WILDDOG_ERR_RECVTIMEOUT if nothing received, else the result.
+*/
+STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_recvPkt
+    (
+    Wilddog_Conn_T *p_conn,
+    Wilddog_Url_T *p_url
+    )
+{
     Wilddog_Return_T ret = WILDDOG_ERR_INVALID;
     Wilddog_Return_T error_code = WILDDOG_ERR_INVALID;
     Wilddog_Proto_Cmd_Arg_T command;
-    Wilddog_ConnCmd_Arg_T *arg = (Wilddog_ConnCmd_Arg_T*)data;
     u32 message_id = 0;
-    Wilddog_Conn_T *p_conn;
     u8* recvPkt = NULL, *payload = NULL;
     u32 recvPkt_len = 0, payload_len = 0;
     Wilddog_Conn_Pkt_T * sendPkt = NULL;
     
-    wilddog_assert(data, WILDDOG_ERR_NULL);
-
-    p_conn = arg->p_repo->p_rp_conn;
-
-    wilddog_assert(p_conn, WILDDOG_ERR_NULL);
-    
     command.protocol = p_conn->p_protocol;
-
-    wilddog_assert(p_conn && command.protocol,WILDDOG_ERR_NULL);
-    
     command.p_out_data = &recvPkt;
     command.p_out_data_len = &recvPkt_len;
     command.p_data = NULL;
     command.d_data_len = 0;
-    command.p_url = arg->p_url;
+    command.p_url = p_url;
     command.p_message_id = &message_id;
     //1. receive packet
     if(p_conn->p_protocol->callback){
         ret = (p_conn->p_protocol->callback)(WD_PROTO_CMD_RECV_GETPKT, &command, 0);
     }
     if(WILDDOG_ERR_NOERR != ret){
-        if(WILDDOG_ERR_RECVTIMEOUT == ret){
-            goto next;
-        }
-        else{
+        if(WILDDOG_ERR_RECVTIMEOUT != ret){
             wilddog_debug_level(WD_DEBUG_WARN,"Received error [%d]",ret);
-            return ret;
         }
+        return ret;
     }
     //We have received packet, reset timeout count
     p_conn->d_timeout_count = 0;
@@ -2014,15 +3622,26 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_trySync(void* data,int flag){
         wilddog_debug_level(WD_DEBUG_WARN, "Received an unmatched packet, mid = 0x%x!",(unsigned int)message_id);
         return ret;
     }
+    _wilddog_conn_rto_sample(p_conn, sendPkt);
+    _wilddog_conn_window_ack(p_conn, sendPkt);
 
     //3. handle packet
     command.p_out_data = &payload;
     command.p_out_data_len = &payload_len;
     command.p_proto_data = &sendPkt->p_proto_data;
+    //the etag of a value is kept in the url cache of the request.
+    command.p_url = sendPkt->p_url;
     if(p_conn->p_protocol->callback){
         error_code = (p_conn->p_protocol->callback)(WD_PROTO_CMD_RECV_HANDLEPKT, &command, 0);
     }
 
+    //blockwise transfer goes on, the next block is waited as a new request.
+    if(WILDDOG_PROTO_ERR_CONTINUE == error_code){
+        sendPkt->d_register_time = _wilddog_getTime();
+        sendPkt->d_count = 1;
+        sendPkt->d_next_send_time = _wilddog_conn_getNextSendTime(p_conn, sendPkt);
+        _wilddog_conn_timer_update(p_conn, sendPkt);
+    }
     //if sendPkt want to be freed, it must be freed in callback, because
     //we cannot operate the linklist which sendPkt belonged to.
     if(error_code >= WILDDOG_ERR_NOERR){
@@ -2037,18 +3656,48 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_trySync(void* data,int flag){
     if(p_conn->p_protocol->callback){
         ret = (p_conn->p_protocol->callback)(WD_PROTO_CMD_RECV_FREEPKT, &command, TRUE);
     }
-    recvPkt = NULL;
-    recvPkt_len = 0;
-next:
-    //4. retransmit or timeout logic
-    _wilddog_conn_retransmitHandler(p_conn);
-    //5. session maintain
+    return ret;
+}
+
+STATIC Wilddog_Return_T WD_SYSTEM _wilddog_conn_trySync(void* data,int flag){
+    Wilddog_Return_T ret = WILDDOG_ERR_RECVTIMEOUT;
+    Wilddog_ConnCmd_Arg_T *arg = (Wilddog_ConnCmd_Arg_T*)data;
+    Wilddog_Conn_T *p_conn;
+    int count;
+    
+    wilddog_assert(data, WILDDOG_ERR_NULL);
+
+    p_conn = arg->p_repo->p_rp_conn;
+
+    wilddog_assert(p_conn && p_conn->p_protocol, WILDDOG_ERR_NULL);
+    
+    //1. receive packets, skip it if sync loop told us socket has nothing.
+    //   The first receive may wait, the others only take datagrams the port
+    //   already has, at most WILDDOG_SYNC_RECV_BUDGET packets.
+    for(count = 0; count < WILDDOG_SYNC_RECV_BUDGET; count++){
+        if(flag & WILDDOG_CONN_SYNC_FLAG_NORECV)
+            break;
+        if(count > 0 && \
+           wilddog_receivePending(p_conn->p_protocol->socketFd) <= 0){
+            break;
+        }
+        ret = _wilddog_conn_recvPkt(p_conn, arg->p_url);
+        if(WILDDOG_ERR_RECVTIMEOUT == ret)
+            break;
+    }
+    //2. session maintain, control traffic goes before the rest packets.
     if(p_conn->d_session.d_session_status == WILDDOG_SESSION_NOTAUTHED){
         //retry
         _wilddog_conn_sessionRetry(p_conn);
     }
     //ping status
     _wilddog_conn_pingHandler(p_conn);
+    //3. retransmit or timeout logic
+    _wilddog_conn_retransmitHandler(p_conn);
+    //responses and timeouts may open the window.
+    _wilddog_conn_window_release(p_conn);
+    //and drain the queue, tell the producer to go on.
+    _wilddog_conn_budget_lowWater(p_conn);
     return ret;
 }
 /* send interface */
@@ -2089,6 +3738,87 @@ STATIC int WD_SYSTEM _wilddog_conn_ioctl(
     }
 }
 
+STATIC INLINE void WD_SYSTEM _wilddog_conn_minDeadline
+    (
+    BOOL *p_hasDue, 
+    u32 *p_due, 
+    u32 time
+    )
+{
+    if(FALSE == *p_hasDue || WILDDOG_CONN_TIME_BEFORE(time, *p_due))
+        *p_due = time;
+    *p_hasDue = TRUE;
+}
+
+/*
+ * Function:    _wilddog_conn_getNextDeadline
+ * Description: get the earliest time the connect layer has something to do, 
+ *              include retransmit, timeout, ping and session retry.
+ * Input:       p_conn: the pointer of the conn struct
+ * Output:      p_deadline: the earliest deadline.
+ * Return:      TRUE if has deadline, FALSE if nothing to do.
+*/
+BOOL WD_SYSTEM _wilddog_conn_getNextDeadline
+    (
+    Wilddog_Conn_T *p_conn, 
+    u32 *p_deadline
+    )
+{
+    BOOL hasDue = FALSE;
+    u32 due = 0;
+    int prio;
+    Wilddog_Conn_Pkt_T *pkt;
+    BOOL isAuthed;
+
+    wilddog_assert(p_conn && p_deadline, FALSE);
+    isAuthed = (WILDDOG_SESSION_AUTHED == p_conn->d_session.d_session_status);
+    //observe and rest packets
+    for(prio = 0; prio < WILDDOG_CONN_PRIO_MAX; prio++){
+        if(p_conn->d_timer[prio].d_num > 0){
+            _wilddog_conn_minDeadline(&hasDue, &due, \
+                              p_conn->d_timer[prio].p_heap[0]->d_timer_due);
+        }
+    }
+    //auth packet
+    pkt = p_conn->d_conn_sys.p_auth;
+    if(pkt && FALSE == isAuthed){
+        _wilddog_conn_minDeadline(&hasDue, &due, \
+                        pkt->d_register_time + WILDDOG_RETRANSMITE_TIME + 1);
+        _wilddog_conn_minDeadline(&hasDue, &due, pkt->d_next_send_time);
+    }
+    //ping packet, or next ping
+    pkt = p_conn->d_conn_sys.p_ping;
+    if(pkt){
+        if(0 == (WILDDOG_CONN_PKT_FLAG_NEVERTIMEOUT & pkt->d_flag)){
+            _wilddog_conn_minDeadline(&hasDue, &due, \
+                        pkt->d_register_time + WILDDOG_RETRANSMITE_TIME + 1);
+        }
+        if(isAuthed)
+            _wilddog_conn_minDeadline(&hasDue, &due, pkt->d_next_send_time);
+    }else if(isAuthed){
+        if(0 == p_conn->d_conn_sys.d_ping_next_send_time)
+            _wilddog_conn_minDeadline(&hasDue, &due, _wilddog_getTime());
+        else
+            _wilddog_conn_minDeadline(&hasDue, &due, \
+                            p_conn->d_conn_sys.d_ping_next_send_time + 1);
+    }
+    //session retry
+    if(WILDDOG_SESSION_NOTAUTHED == p_conn->d_session.d_session_status && \
+       NULL == p_conn->d_conn_sys.p_auth){
+        if(0 != p_conn->d_conn_sys.d_offline_time){
+            u32 interval = (1 << p_conn->d_conn_sys.d_online_retry_count);
+            interval = (interval > WILDDOG_SESSION_MAX_RETRY_TIME_INTERVAL)? \
+                       (WILDDOG_SESSION_MAX_RETRY_TIME_INTERVAL):(interval);
+            _wilddog_conn_minDeadline(&hasDue, &due, \
+                        p_conn->d_conn_sys.d_offline_time + interval * 1000);
+        }else{
+            _wilddog_conn_minDeadline(&hasDue, &due, _wilddog_getTime());
+        }
+    }
+    *p_deadline = due;
+    return hasDue;
+}
+
 /*
  * Function:    _wilddog_conn_init
  * Description: creat session and register send and trysync function.
@@ -2112,6 +3842,13 @@ Wilddog_Conn_T * WD_SYSTEM _wilddog_conn_init(Wilddog_Repo_T *p_repo)
     p_conn->d_conn_sys.d_curr_ping_interval = WILDDOG_DEFAULT_PING_INTERVAL;
     p_conn->d_conn_sys.d_ping_delta = WILDDOG_DEFAULT_PING_DELTA;
     p_conn->d_session.d_session_status = WILDDOG_SESSION_INIT;
+    p_conn->d_rto.d_rto = WILDDOG_RTO_INIT;
+    p_conn->d_rto.d_update_time = _wilddog_getTime();
+    p_conn->d_rto.d_seed = _wilddog_getTime() ^ (u32)(size_t)p_conn;
+    p_conn->d_window.d_window = WILDDOG_WINDOW_INIT;
+    p_conn->d_window.d_ssthresh = WILDDOG_WINDOW_MAX;
+    p_conn->d_window.d_loss_time = _wilddog_getTime() - WILDDOG_RTO_MAX;
+    _wilddog_conn_setBudget(p_conn, 0, 0);
     sprintf((char*)p_conn->d_session.short_sid, "00000000");
     sprintf((char*)p_conn->d_session.long_sid, "00000000000000000000000000000000");
     //Init protocol layer.
@@ -2121,8 +3858,9 @@ Wilddog_Conn_T * WD_SYSTEM _wilddog_conn_init(Wilddog_Repo_T *p_repo)
         wilddog_debug_level(WD_DEBUG_ERROR, "Init protocol failed!");
         return NULL;
     }
-    //Init session.
-    if(WILDDOG_ERR_NOERR != _wilddog_conn_sessionInit(p_conn)){
+    //Init session, reuse the saved one if any.
+    if(FALSE == _wilddog_conn_sessionResume(p_conn) && \
+       WILDDOG_ERR_NOERR != _wilddog_conn_sessionInit(p_conn)){
         _wilddog_protocol_deInit(p_conn);
         wfree(p_conn);
         wilddog_debug_level(WD_DEBUG_ERROR, "Init session failed!");
@@ -2163,6 +3901,8 @@ Wilddog_Return_T WD_SYSTEM _wilddog_conn_deinit(Wilddog_Repo_T *p_repo)
         LL_FOREACH_SAFE(p_conn->d_conn_user.p_observer_list,curr,p_tmp){
             if(curr){
                 LL_DELETE(p_conn->d_conn_user.p_observer_list, curr);
+                _wilddog_conn_timer_remove(p_conn, curr);
+                _wilddog_conn_midIndex_remove(p_conn, curr);
                 _wilddog_conn_packet_deInit(curr);
                 wfree(curr);
             }
@@ -2175,12 +3915,17 @@ Wilddog_Return_T WD_SYSTEM _wilddog_conn_deinit(Wilddog_Repo_T *p_repo)
         LL_FOREACH_SAFE(p_conn->d_conn_user.p_rest_list,curr,p_tmp){
             if(curr){
                 LL_DELETE(p_conn->d_conn_user.p_rest_list, curr);
+                _wilddog_conn_timer_remove(p_conn, curr);
+                _wilddog_conn_midIndex_remove(p_conn, curr);
+                _wilddog_conn_window_remove(p_conn, curr);
                 _wilddog_conn_packet_deInit(curr);
                 wfree(curr);
             }
         }
     }
     p_conn->d_conn_user.p_rest_list = NULL;
+    _wilddog_conn_timer_deinit(p_conn);
+    _wilddog_conn_midIndex_deinit(p_conn);
     //TODO: Deinit session.We don't need deinit, let it timeout.--jimmy
     
     //Deinit protocol layer.
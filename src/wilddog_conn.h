@@ -30,6 +30,16 @@ extern "C"
 #define WILDDOG_CONN_SESSION_LONG_LEN (32 + 1)
 
 #define WILDDOG_CONN_PKT_FLAG_NEVERTIMEOUT (0x01)//this flag mean packet never timeout.
+#define WILDDOG_CONN_PKT_FLAG_INFLIGHT (0x02)//rest packet sent, counted in window.
+#define WILDDOG_CONN_PKT_FLAG_QUEUED (0x04)//rest packet waiting for window or session.
+#define WILDDOG_CONN_PKT_FLAG_COALESCE (0x08)//set packet, a newer set of the url replaces it until sent.
+#define WILDDOG_CONN_PKT_FLAG_BUDGET (0x10)//rest packet, counted in budget.
+
+#define WILDDOG_CONN_SYNC_FLAG_NORECV (0x01)//trysync flag, socket not ready, skip receive.
+
+#define WILDDOG_CONN_CMD_FLAG_NON (0x01)//set/push flag, send once as non-confirmable, not queued.
+#define WILDDOG_CONN_CMD_FLAG_COALESCE (0x02)//set flag, coalesce with the unsent set of the url.
+#define WILDDOG_CONN_CMD_FLAG_UPDATE (0x04)//set flag, merge the children into the url.
 
 /*
     Session State machine:
@@ -55,6 +65,9 @@ extern "C"
         2. Authed: We can send any type of packets, and will generate ping packet.
         3. Authing->Authed: All stored packets will be send right now.
         4. Authed->Authing/NotAuthed: the same as 1.
+        5. Init/Authing->Authed: the session saved by wilddog_sessionSave() is
+           reused without auth if it is got with the same auth token. If it is
+           rejected, the saved one is erased and auth is sent with the token.
 */
 typedef enum WILDDOG_SESSION_STATE{
     WILDDOG_SESSION_INIT = 0,
@@ -89,6 +102,17 @@ typedef enum{
     WILDDOG_PING_TYPE_SHORT = 0,
     WILDDOG_PING_TYPE_LONG
 }Wilddog_Ping_Type_T;
+/*
+    Priority classes, the higher class is always sent and retransmitted 
+    first: control keeps the session and the observers alive, interactive is
+    the small requests, bulk is the values larger than WILDDOG_CONN_BULK_SIZE.
+*/
+typedef enum WILDDOG_CONN_PRIO_T{
+    WILDDOG_CONN_PRIO_CONTROL = 0,
+    WILDDOG_CONN_PRIO_INTERACTIVE,
+    WILDDOG_CONN_PRIO_BULK,
+    WILDDOG_CONN_PRIO_MAX
+}Wilddog_Conn_Prio_T;
 
 typedef struct WILDDOG_CONN_CMD_ARG
 {
@@ -104,6 +128,16 @@ typedef struct WILDDOG_CONN_PKT_DATA_T{
     //int seq;//sequence number
     u32 len;
 }Wilddog_Conn_Pkt_Data_T;
+/*
+ * user callback of a set replaced by a newer set of the same url, it is 
+ * called with the result of the newer one.
+*/
+typedef struct WILDDOG_CONN_PKT_CB_T{
+    struct WILDDOG_CONN_PKT_CB_T *next;
+    Wilddog_Func_T p_user_callback;
+    void *p_user_arg;
+}Wilddog_Conn_Pkt_Cb_T;
+
 typedef struct WILDDOG_CONN_PKT_T{
     struct WILDDOG_CONN_PKT_T *next;
     int d_count;
@@ -117,6 +151,19 @@ typedef struct WILDDOG_CONN_PKT_T{
     void *p_user_arg;
     Wilddog_Conn_Pkt_Data_T *p_data; //packet data serialized and packeted by protocol.
     u8 *p_proto_data;
+    u32 d_timer_due;//when the timer should check it.
+    u32 d_timer_index;//position in timer heap, 0 means not in heap.
+    u32 d_send_time;//first transmission not responded yet, 0 if none.
+    u32 d_rto;//how long to wait this transmission, ms.
+    u8 d_backoff;//rto multiplied by d_backoff / 2 per retransmission.
+    Wilddog_Conn_Pkt_Cb_T *p_chain;//callbacks of the sets it replaced, in order.
+    u8 d_prio;//Wilddog_Conn_Prio_T, fixed once it is sent or queued.
+    u32 d_bytes;//value bytes counted in budget.
+    u32 d_create_time;//when the request is made, d_register_time is reset when sent.
+    struct WILDDOG_CONN_PKT_T *p_queue_prev;//queued packets of its class, by d_seq.
+    struct WILDDOG_CONN_PKT_T *p_queue_next;
+    u32 d_seq;//order in rest list, a replacing set takes the one it replaced.
+    u32 d_path_len;//length of p_url->p_url_path.
 }Wilddog_Conn_Pkt_T;
 
 typedef struct WILDDOG_CONN_SYS_T{
@@ -130,6 +177,8 @@ typedef struct WILDDOG_CONN_SYS_T{
     u32 d_ping_next_send_time;
     Wilddog_Conn_Pkt_T *p_ping;
     Wilddog_Conn_Pkt_T *p_auth;
+    u32 d_auth_hash;//hash of the auth token the session is got with.
+    BOOL d_resumed;//the session is a saved one, not got by auth.
 }Wilddog_Conn_Sys_T;
 
 typedef struct WILDDOG_CONN_USER_T{
@@ -139,12 +188,114 @@ typedef struct WILDDOG_CONN_USER_T{
     Wilddog_Conn_Pkt_T *p_rest_list;
 }Wilddog_Conn_User_T;
 
+/*
+    Timer: observe/rest packets are kept in a min heap ordered by d_timer_due,
+    the earliest of the retransmit time and the timeout time, so trysync only
+    touch packets which are due. d_timer_due may be earlier than the real
+    deadline but never later, a packet checked too early is just rescheduled.
+    Each priority class has its own heap, the due packets of a higher class 
+    are retransmitted first.
+*/
+typedef struct WILDDOG_CONN_TIMER_T{
+    Wilddog_Conn_Pkt_T **p_heap;
+    u32 d_num;
+    u32 d_size;
+}Wilddog_Conn_Timer_T;
+
+/*
+    Message id index: open addressing hash from d_message_id to observe/rest 
+    packets, so a received packet is matched without walking the lists.
+*/
+typedef struct WILDDOG_CONN_MID_INDEX_T{
+    Wilddog_Conn_Pkt_T **p_table;
+    u32 d_size;//always power of 2
+    u32 d_used;//packets and deleted slots
+    u32 d_num;//packets
+}Wilddog_Conn_Mid_Index_T;
+
+/*
+    Retransmission timeout, CoCoA style [draft-ietf-core-cocoa]: rtt sampled
+    from matched responses, strong samples from packets sent once, weak ones
+    from packets sent 2 or 3 times (measured from the first transmission),
+    each smoothed with variance like rfc6298, and merged into one rto.
+*/
+typedef struct WILDDOG_CONN_RTO_T{
+    u32 d_rto;//overall rto, ms
+    u32 d_strong_srtt;//0 if no strong sample
+    u32 d_strong_var;
+    u32 d_weak_srtt;//0 if no weak sample
+    u32 d_weak_var;
+    u32 d_last_rtt;
+    u32 d_update_time;//when d_rto changed, for aging.
+    u32 d_samples;
+    u32 d_retransmits;
+    u32 d_seed;//dithering
+}Wilddog_Conn_Rto_T;
+
+/*
+    In-flight window: rest packets sent and not responded are limited to 
+    d_window, the others are queued in the rest list in order, and sent when
+    responses come. Like tcp, the window grows by one per response in slow 
+    start, by one per window of responses after ssthresh, only when it is 
+    full; it halves on retransmission, once per rto.
+    Coalescing sets of a url are sent one at a time, the next one is queued
+    until the one in flight is responded, and a newer set replaces the 
+    queued one, so only the latest value is sent.
+    Queued packets are released by priority class, bulk never takes the last
+    slot of the window, and no packet overtakes a queued one of the same 
+    path, its parent or its children. Each class keeps its queued packets in
+    p_queue by d_seq, so only the queued ones are walked, never the whole
+    rest list.
+*/
+typedef struct WILDDOG_CONN_WINDOW_T{
+    u32 d_window;
+    u32 d_ssthresh;
+    u32 d_acked;//responses counted to grow the window after ssthresh.
+    u32 d_inflight;
+    u32 d_queued;
+    u32 d_class_queued[WILDDOG_CONN_PRIO_MAX];//d_queued of each class.
+    u32 d_loss_time;//when the window was halved.
+    u32 d_seq;//d_seq of the last rest packet.
+    Wilddog_Conn_Pkt_T *p_queue[WILDDOG_CONN_PRIO_MAX];
+    Wilddog_Conn_Pkt_T *p_queue_tail[WILDDOG_CONN_PRIO_MAX];
+}Wilddog_Conn_Window_T;
+
+/*
+    Budget: a new request fails with WILDDOG_ERR_QUEUEFULL when the requests
+    and observers kept are more than d_max_count, or the values of the rest
+    packets would be more than d_max_bytes. After the rest packets were above
+    the low-water mark, p_low_callback is called once they fall to it, so the
+    producer goes on without polling.
+*/
+typedef struct WILDDOG_CONN_BUDGET_T{
+    u32 d_requests;//rest packets, sent or not.
+    u32 d_bytes;//value bytes of the rest packets.
+    u32 d_max_count;
+    u32 d_max_bytes;
+    u32 d_low_count;
+    u32 d_low_bytes;
+    onQueueLowFunc p_low_callback;
+    void *p_low_arg;
+    BOOL d_above;//above the low-water mark since p_low_callback was called.
+}Wilddog_Conn_Budget_T;
+
 typedef struct WILDDOG_SESSION_T{
     Wilddog_Session_State  d_session_status;
     u8 short_sid[WILDDOG_CONN_SESSION_SHORT_LEN];
     u8 long_sid[WILDDOG_CONN_SESSION_LONG_LEN];
 }Wilddog_Session_T;
 
+/*
+    Saved session, see wilddog_sessionSave() in wilddog_port.h. d_magic 
+    tells the data is a session of this version.
+*/
+#define WILDDOG_CONN_SESSION_MAGIC (0x57445331)
+typedef struct WILDDOG_CONN_SESSION_SAVED_T{
+    u32 d_magic;
+    u32 d_auth_hash;
+    Wilddog_Session_T d_session;
+}Wilddog_Conn_Session_Saved_T;
+
 typedef struct WILDDOG_CONN_T
 {
     Wilddog_Repo_T *p_conn_repo;
@@ -152,6 +303,11 @@ typedef struct WILDDOG_CONN_T
     Wilddog_Session_T d_session;
     Wilddog_Conn_Sys_T d_conn_sys;
     Wilddog_Conn_User_T d_conn_user;
+    Wilddog_Conn_Timer_T d_timer[WILDDOG_CONN_PRIO_MAX];
+    Wilddog_Conn_Mid_Index_T d_mid_index;
+    Wilddog_Conn_Rto_T d_rto;
+    Wilddog_Conn_Window_T d_window;
+    Wilddog_Conn_Budget_T d_budget;
     Wilddog_Protocol_T *p_protocol;
     Wilddog_Func_T f_conn_ioctl;
 }Wilddog_Conn_T;
@@ -159,6 +315,86 @@ typedef struct WILDDOG_CONN_T
 /*implemented interface.*/
 extern Wilddog_Conn_T* _wilddog_conn_init(Wilddog_Repo_T* p_repo);
 extern Wilddog_Return_T _wilddog_conn_deinit(Wilddog_Repo_T*p_repo);
+extern BOOL _wilddog_conn_getNextDeadline(Wilddog_Conn_T *p_conn, u32 *p_deadline);
+extern void _wilddog_conn_rto_sample
+    (
+    Wilddog_Conn_T *p_conn, 
+    Wilddog_Conn_Pkt_T *pkt
+    );
+extern u32 _wilddog_conn_getNextSendTime
+    (
+    Wilddog_Conn_T *p_conn, 
+    Wilddog_Conn_Pkt_T *pkt
+    );
+extern void _wilddog_conn_window_ack
+    (
+    Wilddog_Conn_T *p_conn, 
+    Wilddog_Conn_Pkt_T *pkt
+    );
+extern void _wilddog_conn_window_loss
+    (
+    Wilddog_Conn_T *p_conn, 
+    Wilddog_Conn_Pkt_T *pkt
+    );
+extern BOOL _wilddog_conn_window_send
+    (
+    Wilddog_Conn_T *p_conn, 
+    Wilddog_Conn_Pkt_T *pkt
+    );
+extern void _wilddog_conn_window_release(Wilddog_Conn_T *p_conn);
+extern void _wilddog_conn_getMetrics
+    (
+    Wilddog_Conn_T *p_conn, 
+    Wilddog_Metrics_T *p_metrics
+    );
+extern void _wilddog_conn_setBudget
+    (
+    Wilddog_Conn_T *p_conn, 
+    u32 maxCount,
+    u32 maxBytes
+    );
+extern void _wilddog_conn_setLowWater
+    (
+    Wilddog_Conn_T *p_conn, 
+    u32 lowCount,
+    u32 lowBytes,
+    onQueueLowFunc onLow,
+    void *arg
+    );
+extern Wilddog_Return_T _wilddog_conn_midIndex_add
+    (
+    Wilddog_Conn_T *p_conn, 
+    Wilddog_Conn_Pkt_T *pkt
+    );
+extern void _wilddog_conn_midIndex_remove
+    (
+    Wilddog_Conn_T *p_conn, 
+    Wilddog_Conn_Pkt_T *pkt
+    );
+extern Wilddog_Conn_Pkt_T *_wilddog_conn_midIndex_find
+    (
+    Wilddog_Conn_T *p_conn, 
+    u32 mid
+    );
+extern void _wilddog_conn_midIndex_deinit(Wilddog_Conn_T *p_conn);
+extern Wilddog_Return_T _wilddog_conn_timer_schedule
+    (
+    Wilddog_Conn_T *p_conn, 
+    Wilddog_Conn_Pkt_T *pkt, 
+    u32 due
+    );
+extern void _wilddog_conn_timer_remove
+    (
+    Wilddog_Conn_T *p_conn, 
+    Wilddog_Conn_Pkt_T *pkt
+    );
+extern void _wilddog_conn_timer_setPrio
+    (
+    Wilddog_Conn_T *p_conn, 
+    Wilddog_Conn_Pkt_T *pkt, 
+    u8 prio
+    );
+extern void _wilddog_conn_timer_deinit(Wilddog_Conn_T *p_conn);
 
 #endif /*_WILDDOG_CONN_H_*/
 
@@ -28,9 +28,9 @@
 #include "wilddog_store.h"
 #include "utlist.h"
 #include "wilddog_conn.h"
+#include "wilddog_port.h"
+#include "wilddog_thread.h"
 
-#define WD_CMD_NORMAL 0
-#define WD_CMD_ONDIS  1
 #ifdef WILDDOG_ADD_ONLINESTAT
 //#define WILDDOG_ONLINE_PATH ".info/connected"
 #define WILDDOG_ONLINE_PATH_WITH_SPRIT "/.info/connected"
@@ -724,11 +724,38 @@ query_done:
     return ret;
 }
 
+/*
+ * Function:    _wilddog_ct_getConnFlag
+ * Description: get the connect layer flag of a set or push, it is sent as 
+ *              non-confirmable if the call or the ref asks, a set of the ref
+ *              in coalesce mode is coalesced, an update is always sent 
+ *              confirmable and never coalesced.
+ * Input:       p_ref: the ref.
+ *              flag: WD_CMD_NORMAL, WD_CMD_ONDIS, WD_CMD_NON or WD_CMD_UPDATE.
+ * Output:      N/A
+ * Return:      the flag.
+*/
+STATIC int WD_SYSTEM _wilddog_ct_getConnFlag
+    (
+    Wilddog_Ref_T *p_ref, 
+    int flag
+    )
+{
+    if(WD_CMD_UPDATE == flag)
+        return WILDDOG_CONN_CMD_FLAG_UPDATE;
+    if(WD_CMD_NON == flag || (WD_CMD_NORMAL == flag && \
+       WILDDOG_SENDMODE_NON == p_ref->d_ref_sendMode))
+        return WILDDOG_CONN_CMD_FLAG_NON;
+    if(WD_CMD_NORMAL == flag && WILDDOG_SENDMODE_COALESCE == p_ref->d_ref_sendMode)
+        return WILDDOG_CONN_CMD_FLAG_COALESCE;
+    return 0;
+}
+
 /*
  * Function:    _wilddog_ct_store_set
  * Description: set function
  * Input:       p_args: the pointer of the arg set auth struct
- *              flag: the flag, not used
+ *              flag: WD_CMD_NORMAL, WD_CMD_ONDIS, WD_CMD_NON or WD_CMD_UPDATE
  * Output:      N/A
  * Return:      if failed, return WILDDOG_ERR_INVALID
 */
@@ -744,6 +771,10 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_ct_store_set
     Wilddog_Ref_T * p_ref = (Wilddog_Ref_T *)(arg->p_ref);
     Wilddog_Store_Cmd_T cmd = WILDDOG_STORE_CMD_SENDSET;
     Wilddog_Return_T ret = WILDDOG_ERR_NULL;
+
+    //conn layer clears it if it has called back already.
+    connCmd.p_complete = arg->p_callback;
+    connCmd.p_completeArg = arg->arg;
 #ifdef WILDDOG_ADD_ONLINESTAT
     if(NULL != p_ref->p_ref_url && NULL != p_ref->p_ref_url->p_url_path){
         if(0 == strncmp((const char*)p_ref->p_ref_url->p_url_path, WILDDOG_ONLINE_PATH_WITH_SPRIT,strlen(WILDDOG_ONLINE_PATH_WITH_SPRIT))){
@@ -761,26 +792,33 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_ct_store_set
         goto set_done;
     }
 #endif
+    //an update merges the children, so it must have some.
+    if(WD_CMD_UPDATE == flag && (NULL == arg->p_node || \
+       WILDDOG_NODE_TYPE_OBJECT != arg->p_node->d_wn_type || \
+       NULL == arg->p_node->p_wn_child)){
+        wilddog_debug_level(WD_DEBUG_ERROR, "Update needs an object with children!");
+        ret = WILDDOG_ERR_INVALID;
+        goto set_done;
+    }
 
-    cmd = (flag == WD_CMD_NORMAL)? \
+    cmd = (flag != WD_CMD_ONDIS)? \
                    (WILDDOG_STORE_CMD_SENDSET): (WILDDOG_STORE_CMD_ONDISSET);
     connCmd.p_repo = p_ref->p_ref_repo;
     connCmd.p_url = p_ref->p_ref_url;
     connCmd.p_data = arg->p_node;
-    connCmd.p_complete = arg->p_callback;
-    connCmd.p_completeArg = arg->arg;
 
     p_rp_store = p_ref->p_ref_repo->p_rp_store;
     
     if(p_rp_store && p_rp_store->p_se_callback){
         ret = (p_rp_store->p_se_callback)(p_rp_store, \
-                                    cmd, &connCmd, 0);
+                                    cmd, &connCmd, \
+                                    _wilddog_ct_getConnFlag(p_ref, flag));
     }
 
 set_done:
     if(WILDDOG_ERR_NOERR != ret){
-        if(arg->p_callback){
-            ((onSetFunc)(arg->p_callback))(arg->arg, ret);
+        if(connCmd.p_complete){
+            ((onSetFunc)(connCmd.p_complete))(arg->arg, ret);
         }
     }
     return ret;
@@ -806,6 +844,10 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_ct_store_push
     Wilddog_Ref_T * p_ref = (Wilddog_Ref_T *)(arg->p_ref);
     Wilddog_Store_Cmd_T cmd = WILDDOG_STORE_CMD_SENDSET;
     Wilddog_Return_T ret = WILDDOG_ERR_NULL;
+
+    //conn layer clears it if it has called back already.
+    connCmd.p_complete = arg->p_callback;
+    connCmd.p_completeArg = arg->arg;
 #ifdef WILDDOG_ADD_ONLINESTAT
     if(NULL != p_ref->p_ref_url && NULL != p_ref->p_ref_url->p_url_path){
         if(0 == strncmp((const char*)p_ref->p_ref_url->p_url_path, WILDDOG_ONLINE_PATH_WITH_SPRIT,strlen(WILDDOG_ONLINE_PATH_WITH_SPRIT))){
@@ -823,25 +865,24 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_ct_store_push
     }
 #endif
 
-    cmd = (flag == WD_CMD_NORMAL)? \
+    cmd = (flag != WD_CMD_ONDIS)? \
                    (WILDDOG_STORE_CMD_SENDPUSH): (WILDDOG_STORE_CMD_ONDISPUSH);
 
     connCmd.p_repo = p_ref->p_ref_repo;
     connCmd.p_url = p_ref->p_ref_url;
     connCmd.p_data = arg->p_node;
-    connCmd.p_complete = arg->p_callback;
-    connCmd.p_completeArg = arg->arg;
     
     p_rp_store = p_ref->p_ref_repo->p_rp_store;
     if(p_rp_store && p_rp_store->p_se_callback){
         ret = (p_rp_store->p_se_callback)(p_rp_store, \
-                                    cmd, &connCmd, 0);
+                                    cmd, &connCmd, \
+                                    _wilddog_ct_getConnFlag(p_ref, flag));
     }
     
 push_done:
     if(WILDDOG_ERR_NOERR != ret){
-        if(arg->p_callback){
-            ((onPushFunc)(arg->p_callback))(NULL, arg->arg, ret);
+        if(connCmd.p_complete){
+            ((onPushFunc)(connCmd.p_complete))(NULL, arg->arg, ret);
         }
     }
     return ret;
@@ -1246,42 +1287,111 @@ Wilddog_Return_T _wilddog_ct_conn_goOnline()
 }
 
 /*
- * Function:    _wilddog_ct_conn_sync
- * Description: sync function 
- * Input:       arg: the pointer of the repo struct
- *              flag: the flag, not used
+ * Function:    _wilddog_ct_getNextTimeout
+ * Description: get how long until the earliest deadline of all repos.
+ * Input:       p_head: the head of repos
  * Output:      N/A
- * Return:      if success, return WILDDOG_ERR_NOERR
+ * Return:      the time in ms, 0 if already due, -1 if no deadline
 */
-STATIC Wilddog_Return_T WD_SYSTEM _wilddog_ct_conn_sync
+STATIC s32 WD_SYSTEM _wilddog_ct_getNextTimeout(Wilddog_Repo_T *p_head)
+{
+    Wilddog_Repo_T *p_curr;
+    s32 timeout = -1;
+    u32 now = _wilddog_getTime();
+    u32 deadline = 0;
+
+    LL_FOREACH(p_head, p_curr)
+    {
+        if(!p_curr->p_rp_conn || FALSE == \
+           _wilddog_conn_getNextDeadline(p_curr->p_rp_conn, &deadline))
+        {
+            continue;
+        }
+        if((s32)(deadline - now) <= 0)
+            return 0;
+        if(timeout < 0 || (s32)(deadline - now) < timeout)
+            timeout = (s32)(deadline - now);
+    }
+    return timeout;
+}
+
+/*
+ * Function:    _wilddog_ct_getWaitTime
+ * Description: get how long the sync can wait for sockets, no longer than 
+ *              WILDDOG_RECEIVE_TIMEOUT and the earliest deadline of all repos.
+ * Input:       p_head: the head of repos
+ * Output:      N/A
+ * Return:      the wait time, in ms
+*/
+STATIC s32 WD_SYSTEM _wilddog_ct_getWaitTime(Wilddog_Repo_T *p_head)
+{
+    s32 waitTime = _wilddog_ct_getNextTimeout(p_head);
+
+    if(waitTime < 0 || waitTime > WILDDOG_RECEIVE_TIMEOUT)
+        waitTime = WILDDOG_RECEIVE_TIMEOUT;
+    return waitTime;
+}
+
+/*
+ * Function:    _wilddog_ct_isSocketReady
+ * Description: check whether the repo's socket is in the ready list.
+ * Input:       p_conn: the pointer of the conn struct
+ *              readyIds: the ready socket ids
+ *              readyNum: the number of ready socket ids
+ * Output:      N/A
+ * Return:      TRUE if ready, else FALSE
+*/
+STATIC BOOL WD_SYSTEM _wilddog_ct_isSocketReady
     (
-    void *arg, 
-    int flag
+    Wilddog_Conn_T *p_conn, 
+    int *readyIds, 
+    int readyNum
     )
+{
+    int i;
+    
+    if(!p_conn->p_protocol || p_conn->p_protocol->socketFd < 0)
+        return FALSE;
+    for(i = 0; i < readyNum; i++)
+    {
+        if(readyIds[i] == p_conn->p_protocol->socketFd)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+/*
+ * Function:    _wilddog_ct_conn_syncRepos
+ * Description: call syncs in all repos, only ready sockets are received.
+ * Input:       readyIds: the ready socket ids
+ *              readyNum: the number of ready socket ids, <0 means unknown,
+ *                        every repo receives and increases time itself.
+ * Output:      N/A
+ * Return:      N/A
+*/
+STATIC void WD_SYSTEM _wilddog_ct_conn_syncRepos(int *readyIds, int readyNum)
 {
     Wilddog_Repo_T** p_head = _wilddog_ct_getRepoHead();
     Wilddog_Repo_T* p_curr, *p_tmp;
     Wilddog_Conn_T * p_conn;
     int total=0,offline=0;
-#ifdef WILDDOG_FORCE_OFFLINE
-    if(TRUE == _wilddog_ct_getOfflineForced()){
-        return WILDDOG_ERR_CLIENTOFFLINE;
-    }
-#endif
 
-    /*1. time increase
-     *
-     *2. call syncs in all repo
-    */
     LL_FOREACH_SAFE(*p_head, p_curr, p_tmp)
     {
         p_conn = p_curr->p_rp_conn;
         if(p_conn && p_conn->f_conn_ioctl)
         {
             Wilddog_ConnCmd_Arg_T cmd = {NULL, NULL, NULL, NULL, NULL};
+            int syncFlag = 0;
             cmd.p_repo = p_curr;
-            (p_conn->f_conn_ioctl)(WILDDOG_CONN_CMD_TRYSYNC, &cmd, 0);
-			_wilddog_syncTime();
+            if(readyNum >= 0 && \
+               FALSE == _wilddog_ct_isSocketReady(p_conn, readyIds, readyNum))
+            {
+                syncFlag = WILDDOG_CONN_SYNC_FLAG_NORECV;
+            }
+            (p_conn->f_conn_ioctl)(WILDDOG_CONN_CMD_TRYSYNC, &cmd, syncFlag);
+            if(readyNum < 0)
+                _wilddog_syncTime();
             total++;
             if(0 != p_conn->d_conn_sys.d_offline_time){
                 offline++;
@@ -1290,6 +1400,7 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_ct_conn_sync
             p_curr->p_rp_conn = _wilddog_conn_init(p_curr);
         }
     }
+    wilddog_sendStageFlush();
     if(total == offline){
         //all repo offline, then we offline
         if(TRUE == _wilddog_ct_getOnlineStatus()){
@@ -1301,9 +1412,285 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_ct_conn_sync
             _wilddog_ct_setOnlineStatus(TRUE);
         }
     }
+}
+
+/*
+ * Function:    _wilddog_ct_conn_sync
+ * Description: sync function 
+ * Input:       arg: the pointer of the repo struct
+ *              flag: the flag, not used
+ * Output:      N/A
+ * Return:      if success, return WILDDOG_ERR_NOERR
+*/
+STATIC Wilddog_Return_T WD_SYSTEM _wilddog_ct_conn_sync
+    (
+    void *arg, 
+    int flag
+    )
+{
+    Wilddog_Repo_T** p_head = _wilddog_ct_getRepoHead();
+    int readyIds[WILDDOG_SYNC_MAX_EVENTS];
+    int readyNum = -1;
+#ifdef WILDDOG_FORCE_OFFLINE
+    if(TRUE == _wilddog_ct_getOfflineForced()){
+        return WILDDOG_ERR_CLIENTOFFLINE;
+    }
+#endif
+
+    /*1. wait once for all repos' sockets if port support it, then
+     *   time increase once, else every repo receive and increase itself.
+     *
+     *2. call syncs in all repo
+    */
+    if(*p_head){
+        /*packets sent during this pass are flushed together at the end*/
+        wilddog_sendStageBegin();
+        readyNum = wilddog_waitSockets(readyIds, WILDDOG_SYNC_MAX_EVENTS, \
+                                       _wilddog_ct_getWaitTime(*p_head));
+        if(readyNum >= 0)
+            _wilddog_syncTime();
+    }
+    _wilddog_ct_conn_syncRepos(readyIds, readyNum);
     return WILDDOG_ERR_NOERR;
 }
 
+/*
+ * Function:    _wilddog_ct_conn_getFds
+ * Description: get the sockets of all repos, for the user's event loop.
+ * Input:       arg: the pointer of Wilddog_Arg_GetFds_T
+ *              flag: the flag, not used
+ * Output:      N/A
+ * Return:      the number of sockets stored
+*/
+STATIC int WD_SYSTEM _wilddog_ct_conn_getFds
+    (
+    void *arg, 
+    int flag
+    )
+{
+    Wilddog_Arg_GetFds_T *p_arg = (Wilddog_Arg_GetFds_T*)arg;
+    Wilddog_Repo_T** p_head = _wilddog_ct_getRepoHead();
+    Wilddog_Repo_T* p_curr;
+    Wilddog_Conn_T * p_conn;
+    int num = 0;
+
+    wilddog_assert(p_arg && p_arg->p_fds, 0);
+
+    LL_FOREACH(*p_head, p_curr)
+    {
+        p_conn = p_curr->p_rp_conn;
+        if(num >= p_arg->d_maxNum)
+            break;
+        if(p_conn && p_conn->p_protocol && p_conn->p_protocol->socketFd >= 0)
+            p_arg->p_fds[num++] = p_conn->p_protocol->socketFd;
+    }
+    return num;
+}
+
+/*
+ * Function:    _wilddog_ct_conn_getTimeout
+ * Description: get how long the user's event loop can wait, datagrams 
+ *              already received by the port but not handled make it 0.
+ * Input:       arg: not used
+ *              flag: the flag, not used
+ * Output:      N/A
+ * Return:      the time in ms, -1 means no deadline
+*/
+STATIC s32 WD_SYSTEM _wilddog_ct_conn_getTimeout
+    (
+    void *arg, 
+    int flag
+    )
+{
+    Wilddog_Repo_T** p_head = _wilddog_ct_getRepoHead();
+    Wilddog_Repo_T* p_curr;
+    Wilddog_Conn_T * p_conn;
+
+    _wilddog_syncTime();
+    LL_FOREACH(*p_head, p_curr)
+    {
+        p_conn = p_curr->p_rp_conn;
+        //not inited yet, sync will do it.
+        if(!p_conn)
+            return 0;
+        if(p_conn->p_protocol && p_conn->p_protocol->socketFd >= 0 && \
+           wilddog_receivePending(p_conn->p_protocol->socketFd) > 0)
+            return 0;
+    }
+    return _wilddog_ct_getNextTimeout(*p_head);
+}
+
+/*
+ * Function:    _wilddog_ct_conn_processFd
+ * Description: handle a readable socket and the due deadlines, without 
+ *              waiting.
+ * Input:       arg: the pointer of the readable socket, -1 if only the 
+ *                   deadline is due
+ *              flag: the flag, not used
+ * Output:      N/A
+ * Return:      if success, return WILDDOG_ERR_NOERR
+*/
+STATIC Wilddog_Return_T WD_SYSTEM _wilddog_ct_conn_processFd
+    (
+    void *arg, 
+    int flag
+    )
+{
+    Wilddog_Repo_T** p_head = _wilddog_ct_getRepoHead();
+    Wilddog_Repo_T* p_curr;
+    Wilddog_Conn_T * p_conn;
+    int readyIds[WILDDOG_SYNC_MAX_EVENTS];
+    int readyNum = 0, fd;
+
+    wilddog_assert(arg, WILDDOG_ERR_NULL);
+#ifdef WILDDOG_FORCE_OFFLINE
+    if(TRUE == _wilddog_ct_getOfflineForced()){
+        return WILDDOG_ERR_CLIENTOFFLINE;
+    }
+#endif
+    fd = *(int*)arg;
+    wilddog_sendStageBegin();
+    _wilddog_syncTime();
+    //the readable one, and the ones the port still has datagrams.
+    LL_FOREACH(*p_head, p_curr)
+    {
+        p_conn = p_curr->p_rp_conn;
+        if(readyNum >= WILDDOG_SYNC_MAX_EVENTS)
+            break;
+        if(!p_conn || !p_conn->p_protocol || p_conn->p_protocol->socketFd < 0)
+            continue;
+        if(fd == p_conn->p_protocol->socketFd || \
+           wilddog_receivePending(p_conn->p_protocol->socketFd) > 0)
+            readyIds[readyNum++] = p_conn->p_protocol->socketFd;
+    }
+    _wilddog_ct_conn_syncRepos(readyIds, readyNum);
+    return WILDDOG_ERR_NOERR;
+}
+
+/*
+ * Function:    _wilddog_ct_setSendMode
+ * Description: set how setValue and push of the ref are sent.
+ * Input:       p_args: the pointer of the ref struct
+ *              flag: the Wilddog_SendMode_T
+ * Output:      N/A
+ * Return:      if success, return WILDDOG_ERR_NOERR
+*/
+STATIC Wilddog_Return_T WD_SYSTEM _wilddog_ct_setSendMode
+    (
+    void* p_args, 
+    int flag
+    )
+{
+    Wilddog_Ref_T * p_ref = (Wilddog_Ref_T*)p_args;
+
+    wilddog_assert(p_ref, WILDDOG_ERR_NULL);
+
+    if(WILDDOG_SENDMODE_CON != flag && WILDDOG_SENDMODE_NON != flag && \
+       WILDDOG_SENDMODE_COALESCE != flag)
+        return WILDDOG_ERR_INVALID;
+    p_ref->d_ref_sendMode = (u8)flag;
+    return WILDDOG_ERR_NOERR;
+}
+
+/*
+ * Function:    _wilddog_ct_getMetrics
+ * Description: get the metrics of the connection the ref uses.
+ * Input:       p_args: the pointer of Wilddog_Arg_GetMetrics_T
+ *              flag: the flag, not used
+ * Output:      N/A
+ * Return:      if success, return WILDDOG_ERR_NOERR
+*/
+STATIC Wilddog_Return_T WD_SYSTEM _wilddog_ct_getMetrics
+    (
+    void* p_args, 
+    int flag
+    )
+{
+    Wilddog_Arg_GetMetrics_T *arg = (Wilddog_Arg_GetMetrics_T*)p_args;
+    Wilddog_Ref_T * p_ref = NULL;
+
+    wilddog_assert(arg && arg->p_ref && arg->p_metrics, WILDDOG_ERR_NULL);
+
+    p_ref = (Wilddog_Ref_T*)arg->p_ref;
+    memset(arg->p_metrics, 0, sizeof(Wilddog_Metrics_T));
+    if(NULL == p_ref->p_ref_repo || NULL == p_ref->p_ref_repo->p_rp_conn)
+        return WILDDOG_ERR_CLIENTOFFLINE;
+    _wilddog_conn_getMetrics(p_ref->p_ref_repo->p_rp_conn, arg->p_metrics);
+    return WILDDOG_ERR_NOERR;
+}
+
+/*
+ * Function:    _wilddog_ct_setBudget
+ * Description: set the budget of the connection the ref uses.
+ * Input:       p_args: the pointer of Wilddog_Arg_SetBudget_T
+ *              flag: the flag, not used
+ * Output:      N/A
+ * Return:      if success, return WILDDOG_ERR_NOERR
+*/
+STATIC Wilddog_Return_T WD_SYSTEM _wilddog_ct_setBudget
+    (
+    void* p_args, 
+    int flag
+    )
+{
+    Wilddog_Arg_SetBudget_T *arg = (Wilddog_Arg_SetBudget_T*)p_args;
+    Wilddog_Ref_T * p_ref = NULL;
+
+    wilddog_assert(arg && arg->p_ref, WILDDOG_ERR_NULL);
+
+    p_ref = (Wilddog_Ref_T*)arg->p_ref;
+    if(NULL == p_ref->p_ref_repo || NULL == p_ref->p_ref_repo->p_rp_conn)
+        return WILDDOG_ERR_CLIENTOFFLINE;
+    _wilddog_conn_setBudget(p_ref->p_ref_repo->p_rp_conn, arg->d_maxCount, \
+                            arg->d_maxBytes);
+    return WILDDOG_ERR_NOERR;
+}
+
+/*
+ * Function:    _wilddog_ct_setLowWater
+ * Description: set the low-water mark of the connection the ref uses.
+ * Input:       p_args: the pointer of Wilddog_Arg_SetLowWater_T
+ *              flag: the flag, not used
+ * Output:      N/A
+ * Return:      if success, return WILDDOG_ERR_NOERR
+*/
+STATIC Wilddog_Return_T WD_SYSTEM _wilddog_ct_setLowWater
+    (
+    void* p_args, 
+    int flag
+    )
+{
+    Wilddog_Arg_SetLowWater_T *arg = (Wilddog_Arg_SetLowWater_T*)p_args;
+    Wilddog_Ref_T * p_ref = NULL;
+
+    wilddog_assert(arg && arg->p_ref, WILDDOG_ERR_NULL);
+
+    p_ref = (Wilddog_Ref_T*)arg->p_ref;
+    if(NULL == p_ref->p_ref_repo || NULL == p_ref->p_ref_repo->p_rp_conn)
+        return WILDDOG_ERR_CLIENTOFFLINE;
+    _wilddog_conn_setLowWater(p_ref->p_ref_repo->p_rp_conn, arg->d_lowCount, \
+                              arg->d_lowBytes, arg->onLow, arg->arg);
+    return WILDDOG_ERR_NOERR;
+}
+
+/*
+ * Function:    _wilddog_ct_store_update
+ * Description: update function, merge the children of the node into the 
+ *              path by one request.
+ * Input:       p_args: the pointer of Wilddog_Arg_Set_T
+ *              flag: the flag, not used
+ * Output:      N/A
+ * Return:      if failed, return WILDDOG_ERR_INVALID
+*/
+STATIC Wilddog_Return_T WD_SYSTEM _wilddog_ct_store_update
+    (
+    void *p_args, 
+    int flag
+    )
+{
+    return _wilddog_ct_store_set(p_args, WD_CMD_UPDATE);
+}
+
 Wilddog_Func_T Wilddog_ApiCmd_FuncTable[WILDDOG_APICMD_MAXCMD + 1] = 
 {
     (Wilddog_Func_T)_wilddog_ct_init,
@@ -1327,6 +1714,14 @@ Wilddog_Func_T Wilddog_ApiCmd_FuncTable[WILDDOG_APICMD_MAXCMD + 1] =
     (Wilddog_Func_T)_wilddog_ct_conn_goOffline,
     (Wilddog_Func_T)_wilddog_ct_conn_goOnline,
     (Wilddog_Func_T)_wilddog_ct_conn_sync,
+    (Wilddog_Func_T)_wilddog_ct_conn_getFds,
+    (Wilddog_Func_T)_wilddog_ct_conn_getTimeout,
+    (Wilddog_Func_T)_wilddog_ct_conn_processFd,
+    (Wilddog_Func_T)_wilddog_ct_setSendMode,
+    (Wilddog_Func_T)_wilddog_ct_getMetrics,
+    (Wilddog_Func_T)_wilddog_ct_store_update,
+    (Wilddog_Func_T)_wilddog_ct_setBudget,
+    (Wilddog_Func_T)_wilddog_ct_setLowWater,
     NULL
 };
 
@@ -1353,7 +1748,9 @@ size_t WD_SYSTEM _wilddog_ct_ioctl
     
     if(cmd > WILDDOG_APICMD_MAXCMD || cmd <= 0)
         return 0;
-    else
-        return (size_t)(Wilddog_ApiCmd_FuncTable[cmd])(arg, flags);     
+    //in threaded mode, only the i/o thread touches repos.
+    if(TRUE == _wilddog_thread_isForeign())
+        return _wilddog_thread_submit(cmd, arg, flags);
+    return (size_t)(Wilddog_ApiCmd_FuncTable[cmd])(arg, flags);     
 }
 
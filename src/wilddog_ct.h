@@ -16,6 +16,11 @@ extern "C"
 #ifndef WILDDOG_WEAK
 #define WILDDOG_WEAK  __attribute__((weak))
 #endif
+
+#define WD_CMD_NORMAL 0
+#define WD_CMD_ONDIS  1
+#define WD_CMD_NON    2//set or push as non-confirmable, no response waited.
+#define WD_CMD_UPDATE 3//set as a merge of the children, others are kept.
 typedef enum WILDDOG_API_CMDS
 {
     WILDDOG_APICMD_INIT = 0,
@@ -41,6 +46,14 @@ typedef enum WILDDOG_API_CMDS
     WILDDOG_APICMD_GOONLINE,
 
     WILDDOG_APICMD_SYNC,
+    WILDDOG_APICMD_GETFDS,
+    WILDDOG_APICMD_GETTIMEOUT,
+    WILDDOG_APICMD_PROCESSFD,
+    WILDDOG_APICMD_SETSENDMODE,
+    WILDDOG_APICMD_GETMETRICS,
+    WILDDOG_APICMD_UPDATE,
+    WILDDOG_APICMD_SETBUDGET,
+    WILDDOG_APICMD_SETLOWWATER,
     
     WILDDOG_APICMD_MAXCMD
 }Wilddog_Api_Cmd_T;
@@ -50,6 +63,7 @@ typedef struct WILDDOG_REF_T
     struct WILDDOG_REF_T * next;
     struct WILDDOG_REPO_T * p_ref_repo;
     struct WILDDOG_URL_T * p_ref_url;
+    u8 d_ref_sendMode;//Wilddog_SendMode_T of setValue and push.
 }Wilddog_Ref_T;
 
 typedef struct WILDDOG_ARG_SETAUTH
@@ -93,6 +107,34 @@ typedef struct WILDDOG_ARG_OFF
     Wilddog_EventType_T d_event;
 }Wilddog_Arg_Off_T;
 
+typedef struct WILDDOG_ARG_GETFDS
+{
+    int *p_fds;
+    int d_maxNum;
+}Wilddog_Arg_GetFds_T;
+
+typedef struct WILDDOG_ARG_GETMETRICS
+{
+    Wilddog_T p_ref;
+    Wilddog_Metrics_T *p_metrics;
+}Wilddog_Arg_GetMetrics_T;
+
+typedef struct WILDDOG_ARG_SETBUDGET
+{
+    Wilddog_T p_ref;
+    u32 d_maxCount;
+    u32 d_maxBytes;
+}Wilddog_Arg_SetBudget_T;
+
+typedef struct WILDDOG_ARG_SETLOWWATER
+{
+    Wilddog_T p_ref;
+    u32 d_lowCount;
+    u32 d_lowBytes;
+    onQueueLowFunc onLow;
+    void* arg;
+}Wilddog_Arg_SetLowWater_T;
+
 typedef struct WILDDOG_ARG_GETREF
 {
     Wilddog_T p_ref;
@@ -10,13 +10,8 @@ extern "C"
 #include "wilddog_ct.h"
 #include "wilddog_url_parser.h"
 
-#define WILDDOG_PROTO_RECV_BUF_NUM 1
-
-typedef struct _WILDDOG_PROTO_RECV_STRUCT
-{   
-    u8 data[WILDDOG_PROTO_MAXSIZE]; 
-    u8 isused;
-}_wilddog_Proto_Recv_T;
+/*handle pkt result, a blockwise transfer goes on, wait for the next block.*/
+#define WILDDOG_PROTO_ERR_CONTINUE (-100)
 
 typedef struct WILDDOG_PROTOCOL_T{
     Wilddog_Str_T *host;
@@ -24,7 +19,6 @@ typedef struct WILDDOG_PROTOCOL_T{
     Wilddog_Address_T addr;
     void *user_data;
     Wilddog_Func_T callback;
-    _wilddog_Proto_Recv_T recv_buf[WILDDOG_PROTO_RECV_BUF_NUM];
 }Wilddog_Protocol_T;
 typedef struct WILDDOG_PROTO_CMD_ARG_T{
     Wilddog_Protocol_T* protocol;
@@ -58,6 +52,9 @@ typedef enum WILDDOG_PROTO_CMD_T{
     WD_PROTO_CMD_RECV_GETPKT,// 16
     WD_PROTO_CMD_RECV_FREEPKT,// 17
     WD_PROTO_CMD_RECV_HANDLEPKT,// 18
+    WD_PROTO_CMD_SEND_SET_NON,// 19
+    WD_PROTO_CMD_SEND_PUSH_NON,// 20
+    WD_PROTO_CMD_SEND_UPDATE,// 21
     WD_PROTO_CMD_MAX
 }Wilddog_Proto_Cmd_T;
 extern Wilddog_Protocol_T * _wilddog_protocol_init(void *p_conn);
@@ -23,8 +23,28 @@
 #include "wilddog_debug.h"
 #include "wilddog_port.h"
 #include "wilddog_api.h"
+#include "wilddog_common.h"
+#include "utlist.h"
 #include "test_lib.h"
 
+#define WILDDOG_DNS_TIME_BEFORE(a,b) ((s32)((a) - (b)) < 0)
+
+/*resolved addresses of a host, shared by init and reconnect of all repos.*/
+typedef struct WILDDOG_DNS_CACHE_T
+{
+    struct WILDDOG_DNS_CACHE_T *next;
+    char *p_host;
+    Wilddog_Address_T d_addr[WILDDOG_DNS_MAX_ADDR];//IPv6 and IPv4 interleaved
+    int d_num;//d_addr is valid if not 0, maybe expired
+    int d_best;//index of the address won the race, -1 means not raced
+    BOOL isTried;//d_expire is valid
+    u32 d_expire;//resolve again after it
+    void *p_query;//resolving in background
+    void *p_race;//racing d_addr in background
+}Wilddog_Dns_Cache_T;
+
+STATIC Wilddog_Dns_Cache_T *l_wilddog_dnsCache = NULL;
+
 STATIC Wilddog_Address_T l_defaultAddr_t[2] = 
 {
     {4, {211,151,208,196}, 5683},
@@ -85,6 +105,273 @@ STATIC int WD_SYSTEM _wilddog_sec_getDefaultIpIndex
     return index;
 }
 
+/*
+ * Function:    _wilddog_sec_dnsFind
+ * Description: find the host's cache entry, create it if not exist.
+ * Input:       p_host: the host name
+ * Output:      N/A
+ * Return:      the entry, or NULL if malloc failed
+*/
+STATIC Wilddog_Dns_Cache_T * WD_SYSTEM _wilddog_sec_dnsFind(char *p_host)
+{
+    Wilddog_Dns_Cache_T *p_entry;
+
+    LL_FOREACH(l_wilddog_dnsCache, p_entry)
+    {
+        if(0 == strcmp(p_entry->p_host, p_host))
+            return p_entry;
+    }
+    p_entry = (Wilddog_Dns_Cache_T*)wmalloc(sizeof(Wilddog_Dns_Cache_T));
+    if(NULL == p_entry)
+        return NULL;
+    p_entry->p_host = (char*)wmalloc(strlen(p_host) + 1);
+    if(NULL == p_entry->p_host)
+    {
+        wfree(p_entry);
+        return NULL;
+    }
+    strcpy(p_entry->p_host, p_host);
+    LL_PREPEND(l_wilddog_dnsCache, p_entry);
+    return p_entry;
+}
+
+/*
+ * Function:    _wilddog_sec_dnsUpdate
+ * Description: store a resolving result, a failure keeps the old addresses.
+ *              Addresses are stored IPv6 first and the families interleaved, 
+ *              the order Happy Eyeballs tries them. The race winner is kept 
+ *              while the addresses do not change.
+ * Input:       p_entry: the cache entry
+ *              num: the number of resolved addresses, <=0 means failed
+ *              p_addr: the resolved addresses
+ *              ttl: the record's ttl in second, 0 if unknown
+ * Output:      N/A
+ * Return:      N/A
+*/
+STATIC void WD_SYSTEM _wilddog_sec_dnsUpdate
+    (
+    Wilddog_Dns_Cache_T *p_entry,
+    int num,
+    Wilddog_Address_T *p_addr,
+    u32 ttl
+    )
+{
+    Wilddog_Address_T addrs[WILDDOG_DNS_MAX_ADDR];
+    u32 now = _wilddog_getTime();
+    int i, v6 = 0, v4 = 0, pos = 0;
+    BOOL isSame;
+
+    p_entry->isTried = TRUE;
+    if(num > 0)
+    {
+        if(num > WILDDOG_DNS_MAX_ADDR)
+            num = WILDDOG_DNS_MAX_ADDR;
+        memset(addrs, 0, sizeof(addrs));
+        while(pos < num)
+        {
+            //next IPv6, then next IPv4
+            for(; v6 < num && 16 != p_addr[v6].len; v6++)
+                ;
+            if(v6 < num)
+                addrs[pos++] = p_addr[v6++];
+            for(; v4 < num && 16 == p_addr[v4].len; v4++)
+                ;
+            if(v4 < num && pos < num)
+                addrs[pos++] = p_addr[v4++];
+        }
+        isSame = (num == p_entry->d_num) ? TRUE : FALSE;
+        for(i = 0; i < num; i++)
+        {
+            addrs[i].port = 0;
+            if(addrs[i].len != p_entry->d_addr[i].len || \
+               memcmp(addrs[i].ip, p_entry->d_addr[i].ip, addrs[i].len))
+                isSame = FALSE;
+        }
+        if(FALSE == isSame)
+        {
+            //a race of the old addresses is useless.
+            if(p_entry->p_race)
+            {
+                wilddog_raceCancel(p_entry->p_race);
+                p_entry->p_race = NULL;
+            }
+            memcpy(p_entry->d_addr, addrs, sizeof(addrs));
+            p_entry->d_num = num;
+            p_entry->d_best = (1 == num) ? 0 : -1;
+        }
+        p_entry->d_expire = now + (ttl ? ttl * 1000 : WILDDOG_DNS_CACHE_TTL);
+    }
+    else
+    {
+        p_entry->d_expire = now + WILDDOG_DNS_NEGATIVE_TTL;
+    }
+}
+
+/*
+ * Function:    _wilddog_sec_dnsPoll
+ * Description: collect the background resolving result if it is finished.
+ * Input:       p_entry: the cache entry
+ *              timeout: the max time to wait, in ms
+ * Output:      N/A
+ * Return:      N/A
+*/
+STATIC void WD_SYSTEM _wilddog_sec_dnsPoll
+    (
+    Wilddog_Dns_Cache_T *p_entry,
+    s32 timeout
+    )
+{
+    Wilddog_Address_T addrs[WILDDOG_DNS_MAX_ADDR];
+    u32 ttl = 0;
+    int res;
+
+    if(NULL == p_entry->p_query)
+        return;
+    res = wilddog_resolvePoll(p_entry->p_query, addrs, WILDDOG_DNS_MAX_ADDR, \
+                              &ttl, timeout);
+    if(0 == res)
+        return;
+    p_entry->p_query = NULL;
+    _wilddog_sec_dnsUpdate(p_entry, res, addrs, ttl);
+}
+
+/*
+ * Function:    _wilddog_sec_dnsRace
+ * Description: Happy Eyeballs, pick the address answers a coap ping first,
+ *              if no one answers, use the first one, IPv6 preferred. The 
+ *              first connect to the host waits for the race, at most 
+ *              WILDDOG_RACE_TIMEOUT ms, a reconnect races in background and
+ *              collects it if it is finished.
+ * Input:       p_entry: the cache entry
+ *              port: the port of the session, the probes are sent to it 
+ *                    unless WILDDOG_RACE_PROBE_PORT is defined
+ *              isWait: wait for the race or not
+ * Output:      N/A
+ * Return:      N/A
+*/
+STATIC void WD_SYSTEM _wilddog_sec_dnsRace
+    (
+    Wilddog_Dns_Cache_T *p_entry,
+    u16 port,
+    BOOL isWait
+    )
+{
+    Wilddog_Address_T addrs[WILDDOG_DNS_MAX_ADDR];
+    STATIC u16 mid = 0;
+    u8 ping[4];
+    int i, winner = -1;
+
+    if(p_entry->d_best >= 0)
+        return;
+    if(p_entry->p_race)
+    {
+        if(0 == wilddog_racePoll(p_entry->p_race, &winner))
+            return;
+        p_entry->p_race = NULL;
+        wilddog_debug_level(WD_DEBUG_LOG, "Address race of %s: %d of %d won", \
+                            p_entry->p_host, winner, p_entry->d_num);
+        p_entry->d_best = (winner >= 0) ? winner : 0;
+        return;
+    }
+    //coap empty CON message, the server answers RST.
+    mid++;
+    ping[0] = 0x40;
+    ping[1] = 0;
+    ping[2] = (u8)(mid >> 8);
+    ping[3] = (u8)(mid & 0xff);
+    for(i = 0; i < p_entry->d_num; i++)
+    {
+        addrs[i] = p_entry->d_addr[i];
+#ifdef WILDDOG_RACE_PROBE_PORT
+        addrs[i].port = WILDDOG_RACE_PROBE_PORT;
+#else
+        addrs[i].port = port;
+#endif
+    }
+    if(TRUE == isWait)
+    {
+        winner = wilddog_raceAddress(addrs, p_entry->d_num, ping, \
+                                     sizeof(ping), WILDDOG_RACE_DELAY, \
+                                     WILDDOG_RACE_TIMEOUT);
+        wilddog_debug_level(WD_DEBUG_LOG, "Address race of %s: %d of %d won", \
+                            p_entry->p_host, winner, p_entry->d_num);
+        p_entry->d_best = (winner >= 0) ? winner : 0;
+        return;
+    }
+    p_entry->p_race = wilddog_raceStart(addrs, p_entry->d_num, ping, \
+                                        sizeof(ping), WILDDOG_RACE_DELAY, \
+                                        WILDDOG_RACE_TIMEOUT);
+    //platform can not race in background.
+    if(NULL == p_entry->p_race)
+        p_entry->d_best = 0;
+}
+
+/*
+ * Function:    _wilddog_sec_dnsResolve
+ * Description: get the host's address from the cache, resolve it in 
+ *              background when expired, and use the old address until the
+ *              new one comes. A host has no address yet waits for the 
+ *              background resolving at most WILDDOG_DNS_INIT_WAIT ms, then
+ *              resolves it by wilddog_gethostbyname. If it has several 
+ *              addresses, the one won the Happy Eyeballs race is used, a
+ *              reconnect uses the first one until its race is finished.
+ * Input:       p_host: the host name
+ * Output:      p_remoteAddr: the pointer of the ip address, its port is the
+ *                            port of the session
+ * Return:      0 if got the address, -1 if the host can not be resolved
+*/
+STATIC int WD_SYSTEM _wilddog_sec_dnsResolve
+    (
+    Wilddog_Address_T *p_remoteAddr,
+    char *p_host
+    )
+{
+    Wilddog_Dns_Cache_T *p_entry = _wilddog_sec_dnsFind(p_host);
+    Wilddog_Address_T addr;
+    int res;
+    Wilddog_Address_T *p_best;
+    BOOL isFirst;
+
+    if(NULL == p_entry)
+        return wilddog_gethostbyname(p_remoteAddr, p_host);
+    //no address to connect yet, the race can not wait for a reconnect.
+    isFirst = (0 == p_entry->d_num) ? TRUE : FALSE;
+    _wilddog_sec_dnsPoll(p_entry, 0);
+    if(p_entry->isTried && \
+       WILDDOG_DNS_TIME_BEFORE(_wilddog_getTime(), p_entry->d_expire))
+        goto answer;
+    if(NULL == p_entry->p_query)
+    {
+        p_entry->p_query = wilddog_resolveStart(p_host);
+        if(NULL == p_entry->p_query)
+        {
+            //platform can not resolve in background.
+            res = wilddog_gethostbyname(&addr, p_host);
+            _wilddog_sec_dnsUpdate(p_entry, (0 == res) ? 1 : -1, &addr, 0);
+            goto answer;
+        }
+    }
+    if(0 == p_entry->d_num)
+    {
+        _wilddog_sec_dnsPoll(p_entry, WILDDOG_DNS_INIT_WAIT);
+        if(p_entry->p_query)
+        {
+            //too slow, the background one still updates it when it comes.
+            res = wilddog_gethostbyname(&addr, p_host);
+            _wilddog_sec_dnsUpdate(p_entry, (0 == res) ? 1 : -1, &addr, 0);
+        }
+    }
+answer:
+    if(0 == p_entry->d_num)
+        return -1;
+    //new addresses, race them once, reconnects reuse the winner.
+    _wilddog_sec_dnsRace(p_entry, p_remoteAddr->port, isFirst);
+    p_best = &p_entry->d_addr[(p_entry->d_best < 0) ? 0 : p_entry->d_best];
+    p_remoteAddr->len = p_best->len;
+    memcpy(p_remoteAddr->ip, p_best->ip, p_best->len);
+    return 0;
+}
+
 /*
  * Function:    _wilddog_sec_getHost
  * Description: sec layer  get host ip by the name
@@ -92,7 +379,7 @@ STATIC int WD_SYSTEM _wilddog_sec_getDefaultIpIndex
  * Input:       p_host: the pointer of the host
  *              
  * Output:      p_remoteAddr: the pointer of the ip address
- * Return:      the gethostbyname result
+ * Return:      the resolving result
 */
 int WD_SYSTEM _wilddog_sec_getHost
     (
@@ -108,7 +395,7 @@ int WD_SYSTEM _wilddog_sec_getHost
         ramtest_skipLastmalloc();
 #endif   
 
-    res = wilddog_gethostbyname(p_remoteAddr,WILDDOG_COAP_LOCAL_HOST);
+    res = _wilddog_sec_dnsResolve(p_remoteAddr,WILDDOG_COAP_LOCAL_HOST);
     
 #ifdef WILDDOG_SELFTEST                        
     ramtest_gethostbyname();
@@ -117,6 +404,7 @@ int WD_SYSTEM _wilddog_sec_getHost
     performtest_timeReset();
 #endif
 
+    //the resolver failed, not only slow.
     if(-1 == res)
     {
         i = _wilddog_sec_getDefaultIpIndex(p_host);
@@ -222,7 +222,7 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_store_ioctl
             break;
         case WILDDOG_STORE_CMD_SENDSET:
             if(p_conn && p_conn->f_conn_ioctl)
-                return p_conn->f_conn_ioctl(WILDDOG_CONN_CMD_SET, arg, 0);
+                return p_conn->f_conn_ioctl(WILDDOG_CONN_CMD_SET, arg, flags);
             break;
         case WILDDOG_STORE_CMD_ONDISSET:
             if(p_conn && p_conn->f_conn_ioctl)
@@ -230,7 +230,7 @@ STATIC Wilddog_Return_T WD_SYSTEM _wilddog_store_ioctl
             break;
         case WILDDOG_STORE_CMD_SENDPUSH:
             if(p_conn && p_conn->f_conn_ioctl)
-                return p_conn->f_conn_ioctl(WILDDOG_CONN_CMD_PUSH, arg, 0);
+                return p_conn->f_conn_ioctl(WILDDOG_CONN_CMD_PUSH, arg, flags);
             break;
         case WILDDOG_STORE_CMD_ONDISPUSH:
             if(p_conn && p_conn->f_conn_ioctl)
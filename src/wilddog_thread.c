@@ -0,0 +1,375 @@
+/*
+ * Copyright (C) 2014-2016 Wilddog Technologies. All Rights Reserved.
+ *
+ * FileName: wilddog_thread.c
+ *
+ * Description: threaded mode, api calls from other threads are queued to a
+ *              lock-free multi-producer single-consumer queue, and run by
+ *              the sdk i/o thread, which also does all the syncs.
+ *
+ * History:
+ * Version      Author          Date        Description
+ *
+ * 2.0.2                        2016-10-16  Create file.
+ *
+ */
+#ifndef WILDDOG_PORT_TYPE_ESP
+#include <stdio.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+
+#include "wilddog.h"
+#include "wilddog_ct.h"
+#include "wilddog_common.h"
+#include "wilddog_port.h"
+#include "wilddog_thread.h"
+
+/*wait time of the i/o thread when there is no repo, it is woken by submit.*/
+#define WILDDOG_THREAD_IDLE_WAIT 1000
+
+#define WILDDOG_ATOMIC_XCHG(p, v) __atomic_exchange_n((p), (v), __ATOMIC_ACQ_REL)
+#define WILDDOG_ATOMIC_LOAD(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define WILDDOG_ATOMIC_STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+/*copy of the caller's arg, the caller does not wait for queued commands.*/
+typedef union WILDDOG_THREAD_ARG_T
+{
+    Wilddog_Arg_Set_T d_set;
+    Wilddog_Arg_Query_T d_query;
+    Wilddog_Arg_On_T d_on;
+    Wilddog_Arg_Off_T d_off;
+}Wilddog_Thread_Arg_T;
+
+typedef struct WILDDOG_THREAD_CMD_T
+{
+    struct WILDDOG_THREAD_CMD_T *next;
+    Wilddog_Api_Cmd_T d_cmd;
+    int d_flags;
+    void *p_arg;
+    Wilddog_Thread_Arg_T d_arg;
+    size_t d_ret;
+    void *p_done;//semaphore of the waiting caller, NULL means not wait.
+}Wilddog_Thread_Cmd_T;
+
+/*
+    Intrusive MPSC queue: producers exchange p_head and then link the old
+    head to the new command, the i/o thread is the only one walks p_tail.
+*/
+typedef struct WILDDOG_THREAD_QUEUE_T
+{
+    Wilddog_Thread_Cmd_T *p_head;
+    Wilddog_Thread_Cmd_T *p_tail;
+    Wilddog_Thread_Cmd_T d_stub;
+}Wilddog_Thread_Queue_T;
+
+STATIC Wilddog_Thread_Queue_T l_wilddog_threadQueue;
+STATIC void *l_wilddog_thread = NULL;
+STATIC BOOL l_wilddog_threadRunning = FALSE;
+
+/*
+ * Function:    _wilddog_thread_push
+ * Description: add a command to the queue, can be called from any thread.
+ * Input:       p_cmd: the command.
+ * Output:      N/A
+ * Return:      N/A
+*/
+STATIC void WD_SYSTEM _wilddog_thread_push(Wilddog_Thread_Cmd_T *p_cmd)
+{
+    Wilddog_Thread_Cmd_T *p_prev;
+
+    p_cmd->next = NULL;
+    p_prev = WILDDOG_ATOMIC_XCHG(&l_wilddog_threadQueue.p_head, p_cmd);
+    WILDDOG_ATOMIC_STORE(&p_prev->next, p_cmd);
+}
+
+/*
+ * Function:    _wilddog_thread_pop
+ * Description: get the oldest command, only called by the i/o thread.
+ * Input:       N/A
+ * Output:      N/A
+ * Return:      The command, or NULL if empty or a producer is pushing, the
+ *              producer will wake the i/o thread after push.
+*/
+STATIC Wilddog_Thread_Cmd_T * WD_SYSTEM _wilddog_thread_pop(void)
+{
+    Wilddog_Thread_Queue_T *p_queue = &l_wilddog_threadQueue;
+    Wilddog_Thread_Cmd_T *p_tail = p_queue->p_tail;
+    Wilddog_Thread_Cmd_T *p_next = WILDDOG_ATOMIC_LOAD(&p_tail->next);
+
+    if(&p_queue->d_stub == p_tail)
+    {
+        if(NULL == p_next)
+            return NULL;
+        p_queue->p_tail = p_next;
+        p_tail = p_next;
+        p_next = WILDDOG_ATOMIC_LOAD(&p_tail->next);
+    }
+    if(p_next)
+    {
+        p_queue->p_tail = p_next;
+        return p_tail;
+    }
+    if(p_tail != WILDDOG_ATOMIC_LOAD(&p_queue->p_head))
+        return NULL;
+    //the last one, put the stub back so it can be taken out
+    _wilddog_thread_push(&p_queue->d_stub);
+    p_next = WILDDOG_ATOMIC_LOAD(&p_tail->next);
+    if(p_next)
+    {
+        p_queue->p_tail = p_next;
+        return p_tail;
+    }
+    return NULL;
+}
+
+/*
+ * Function:    _wilddog_thread_isNodeCmd
+ * Description: whether the command's arg has a node copied.
+ * Input:       cmd: the api command.
+ * Output:      N/A
+ * Return:      TRUE or FALSE.
+*/
+STATIC BOOL WD_SYSTEM _wilddog_thread_isNodeCmd(Wilddog_Api_Cmd_T cmd)
+{
+    return (WILDDOG_APICMD_SET == cmd || WILDDOG_APICMD_PUSH == cmd || \
+            WILDDOG_APICMD_DISCONN_SET == cmd || \
+            WILDDOG_APICMD_DISCONN_PUSH == cmd || \
+            WILDDOG_APICMD_UPDATE == cmd);
+}
+
+/*
+ * Function:    _wilddog_thread_drain
+ * Description: run all queued commands, in the i/o thread.
+ * Input:       N/A
+ * Output:      N/A
+ * Return:      N/A
+*/
+STATIC void WD_SYSTEM _wilddog_thread_drain(void)
+{
+    Wilddog_Thread_Cmd_T *p_cmd;
+
+    while(NULL != (p_cmd = _wilddog_thread_pop()))
+    {
+        p_cmd->d_ret = _wilddog_ct_ioctl(p_cmd->d_cmd, p_cmd->p_arg, \
+                                         p_cmd->d_flags);
+        if(p_cmd->p_done)
+        {
+            //caller owns the command, do not touch it after post.
+            wilddog_semPost(p_cmd->p_done);
+            continue;
+        }
+        if((Wilddog_Return_T)p_cmd->d_ret < 0)
+        {
+            wilddog_debug_level(WD_DEBUG_WARN, "Queued cmd %d failed %d", \
+                                p_cmd->d_cmd, (int)p_cmd->d_ret);
+        }
+        if(_wilddog_thread_isNodeCmd(p_cmd->d_cmd) && p_cmd->d_arg.d_set.p_node)
+            wilddog_node_delete(p_cmd->d_arg.d_set.p_node);
+        wfree(p_cmd);
+    }
+}
+
+/*
+ * Function:    _wilddog_thread_loop
+ * Description: the i/o thread, run queued commands and sync all repos.
+ * Input:       arg: not used.
+ * Output:      N/A
+ * Return:      N/A
+*/
+STATIC void WD_SYSTEM _wilddog_thread_loop(void* arg)
+{
+    Wilddog_Return_T ret;
+    int readyId;
+
+    while(1)
+    {
+        _wilddog_thread_drain();
+        if(FALSE == WILDDOG_ATOMIC_LOAD(&l_wilddog_threadRunning))
+            break;
+        ret = WILDDOG_ERR_CLIENTOFFLINE;
+        if(*_wilddog_ct_getRepoHead())
+            ret = (Wilddog_Return_T)_wilddog_ct_ioctl(WILDDOG_APICMD_SYNC, \
+                                                      NULL, 0);
+        //sync did not wait, wait here until timeout or submit.
+        if(WILDDOG_ERR_NOERR != ret)
+            wilddog_waitSockets(&readyId, 1, WILDDOG_THREAD_IDLE_WAIT);
+    }
+    //commands queued before stop
+    _wilddog_thread_drain();
+}
+
+/*
+ * Function:    _wilddog_thread_start
+ * Description: start the i/o thread.
+ * Input:       N/A
+ * Output:      N/A
+ * Return:      If success, return WILDDOG_ERR_NOERR, if the platform do not
+ *              support threads, return WILDDOG_ERR_INVALID.
+*/
+Wilddog_Return_T WD_SYSTEM _wilddog_thread_start(void)
+{
+    Wilddog_Thread_Queue_T *p_queue = &l_wilddog_threadQueue;
+    void *thread = NULL;
+
+    if(l_wilddog_thread)
+        return WILDDOG_ERR_NOERR;
+    memset(p_queue, 0, sizeof(Wilddog_Thread_Queue_T));
+    p_queue->p_head = &p_queue->d_stub;
+    p_queue->p_tail = &p_queue->d_stub;
+    //the i/o thread must can be woken when a command is queued.
+    if(wilddog_wakeupWait() < 0)
+        return WILDDOG_ERR_INVALID;
+    WILDDOG_ATOMIC_STORE(&l_wilddog_threadRunning, TRUE);
+    if(wilddog_threadCreate(&thread, _wilddog_thread_loop, NULL) < 0)
+    {
+        WILDDOG_ATOMIC_STORE(&l_wilddog_threadRunning, FALSE);
+        return WILDDOG_ERR_INVALID;
+    }
+    WILDDOG_ATOMIC_STORE(&l_wilddog_thread, thread);
+    return WILDDOG_ERR_NOERR;
+}
+
+/*
+ * Function:    _wilddog_thread_stop
+ * Description: stop the i/o thread after the queued commands are run.
+ * Input:       N/A
+ * Output:      N/A
+ * Return:      If success, return WILDDOG_ERR_NOERR, if called in the i/o
+ *              thread, return WILDDOG_ERR_INVALID.
+*/
+Wilddog_Return_T WD_SYSTEM _wilddog_thread_stop(void)
+{
+    void *thread = WILDDOG_ATOMIC_LOAD(&l_wilddog_thread);
+
+    if(NULL == thread)
+        return WILDDOG_ERR_NOERR;
+    if(wilddog_threadIsSelf(thread))
+        return WILDDOG_ERR_INVALID;
+    WILDDOG_ATOMIC_STORE(&l_wilddog_threadRunning, FALSE);
+    wilddog_wakeupWait();
+    wilddog_threadJoin(thread);
+    WILDDOG_ATOMIC_STORE(&l_wilddog_thread, NULL);
+    return WILDDOG_ERR_NOERR;
+}
+
+/*
+ * Function:    _wilddog_thread_isForeign
+ * Description: whether api calls of the caller must be queued to the i/o
+ *              thread.
+ * Input:       N/A
+ * Output:      N/A
+ * Return:      TRUE if the i/o thread is running and the caller is not it.
+*/
+BOOL WD_SYSTEM _wilddog_thread_isForeign(void)
+{
+    void *thread = WILDDOG_ATOMIC_LOAD(&l_wilddog_thread);
+
+    if(NULL == thread || FALSE == WILDDOG_ATOMIC_LOAD(&l_wilddog_threadRunning))
+        return FALSE;
+    return wilddog_threadIsSelf(thread) ? FALSE : TRUE;
+}
+
+/*
+ * Function:    _wilddog_thread_submit
+ * Description: queue the api command to the i/o thread. Requests whose
+ *              result comes by callback return at once, their result is
+ *              delivered in the i/o thread; others wait for the result.
+ * Input:       cmd: api command.
+ *              arg: the arg.
+ *              flags: the flag.
+ * Output:      N/A
+ * Return:      The same as _wilddog_ct_ioctl.
+*/
+size_t WD_SYSTEM _wilddog_thread_submit
+    (
+    Wilddog_Api_Cmd_T cmd,
+    void* arg,
+    int flags
+    )
+{
+    Wilddog_Thread_Cmd_T syncCmd, *p_cmd = NULL;
+    BOOL isWait;
+
+    switch(cmd)
+    {
+        case WILDDOG_APICMD_SYNC:
+        case WILDDOG_APICMD_PROCESSFD:
+            //the i/o thread syncs by itself.
+            return WILDDOG_ERR_NOERR;
+        case WILDDOG_APICMD_GETFDS:
+            //nothing for the user's event loop to wait.
+            return 0;
+        case WILDDOG_APICMD_GETTIMEOUT:
+            return (size_t)-1;
+        case WILDDOG_APICMD_SET:
+        case WILDDOG_APICMD_PUSH:
+        case WILDDOG_APICMD_UPDATE:
+        case WILDDOG_APICMD_DISCONN_SET:
+        case WILDDOG_APICMD_DISCONN_PUSH:
+        case WILDDOG_APICMD_QUERY:
+        case WILDDOG_APICMD_REMOVE:
+        case WILDDOG_APICMD_DISCONN_RMV:
+        case WILDDOG_APICMD_DISCONN_CANCEL:
+        case WILDDOG_APICMD_ON:
+        case WILDDOG_APICMD_OFF:
+            p_cmd = (Wilddog_Thread_Cmd_T*)wmalloc(sizeof(Wilddog_Thread_Cmd_T));
+            if(NULL == p_cmd)
+                return (size_t)WILDDOG_ERR_NULL;
+            if(_wilddog_thread_isNodeCmd(cmd))
+            {
+                //caller can free the node after api returns.
+                p_cmd->d_arg.d_set = *(Wilddog_Arg_Set_T*)arg;
+                if(p_cmd->d_arg.d_set.p_node)
+                {
+                    p_cmd->d_arg.d_set.p_node = \
+                        wilddog_node_clone(p_cmd->d_arg.d_set.p_node);
+                    if(NULL == p_cmd->d_arg.d_set.p_node)
+                    {
+                        wfree(p_cmd);
+                        return (size_t)WILDDOG_ERR_NULL;
+                    }
+                }
+            }
+            else if(WILDDOG_APICMD_ON == cmd)
+                p_cmd->d_arg.d_on = *(Wilddog_Arg_On_T*)arg;
+            else if(WILDDOG_APICMD_OFF == cmd)
+                p_cmd->d_arg.d_off = *(Wilddog_Arg_Off_T*)arg;
+            else
+                p_cmd->d_arg.d_query = *(Wilddog_Arg_Query_T*)arg;
+            p_cmd->p_arg = &p_cmd->d_arg;
+            break;
+        default:
+            memset(&syncCmd, 0, sizeof(syncCmd));
+            syncCmd.p_done = wilddog_semCreate();
+            if(NULL == syncCmd.p_done)
+            {
+                wilddog_debug_level(WD_DEBUG_ERROR, "Create semaphore failed!");
+                //commands return a ref or a string give 0 when failed.
+                if(WILDDOG_APICMD_DESTROYREF == cmd || \
+                   WILDDOG_APICMD_SETAUTH == cmd || \
+                   WILDDOG_APICMD_GOOFFLINE == cmd || \
+                   WILDDOG_APICMD_GOONLINE == cmd || \
+                   WILDDOG_APICMD_SETSENDMODE == cmd || \
+                   WILDDOG_APICMD_GETMETRICS == cmd || \
+                   WILDDOG_APICMD_SETBUDGET == cmd || \
+                   WILDDOG_APICMD_SETLOWWATER == cmd)
+                    return (size_t)WILDDOG_ERR_NULL;
+                return 0;
+            }
+            p_cmd = &syncCmd;
+            p_cmd->p_arg = arg;
+            break;
+    }
+    p_cmd->d_cmd = cmd;
+    p_cmd->d_flags = flags;
+    //queued command may be freed by i/o thread as soon as it is pushed.
+    isWait = (&syncCmd == p_cmd);
+    _wilddog_thread_push(p_cmd);
+    wilddog_wakeupWait();
+    if(FALSE == isWait)
+        return WILDDOG_ERR_NOERR;
+    wilddog_semWait(syncCmd.p_done);
+    wilddog_semDestroy(syncCmd.p_done);
+    return syncCmd.d_ret;
+}
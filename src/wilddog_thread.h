@@ -0,0 +1,28 @@
+
+#ifndef _WILDDOG_THREAD_H_
+#define _WILDDOG_THREAD_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "wilddog.h"
+#include "wilddog_ct.h"
+
+extern Wilddog_Return_T _wilddog_thread_start(void);
+extern Wilddog_Return_T _wilddog_thread_stop(void);
+extern BOOL _wilddog_thread_isForeign(void);
+extern size_t _wilddog_thread_submit
+    (
+    Wilddog_Api_Cmd_T cmd,
+    void* arg,
+    int flags
+    );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*_WILDDOG_THREAD_H_*/
+
@@ -407,6 +407,25 @@ int WD_SYSTEM _wilddog_url_checkPath(Wilddog_Str_T *p_path)
     return WILDDOG_ERR_NOERR;
 }
 
+/*
+ * Function:    _wilddog_url_getCache
+ * Description: get the cache of the url, create it if not exist. the url 
+ *              must be freed by _wilddog_url_freeParsedUrl.
+ * Input:       p_url: the url.
+ * Output:      N/A
+ * Return:      the cache, or NULL if malloc failed.
+*/
+Wilddog_Url_Cache_T * WD_SYSTEM _wilddog_url_getCache(Wilddog_Url_T* p_url){
+    wilddog_assert(p_url, NULL);
+
+    if(NULL == p_url->p_url_cache){
+        p_url->p_url_cache = (Wilddog_Url_Cache_T*)wmalloc(sizeof(Wilddog_Url_Cache_T));
+        if(p_url->p_url_cache)
+            p_url->p_url_cache->d_refs = 1;
+    }
+    return p_url->p_url_cache;
+}
+
 Wilddog_Return_T WD_SYSTEM _wilddog_url_copy(Wilddog_Url_T* src, Wilddog_Url_T* dst){
     wilddog_assert(src && dst, WILDDOG_ERR_NULL);
 
@@ -440,6 +459,11 @@ Wilddog_Return_T WD_SYSTEM _wilddog_url_copy(Wilddog_Url_T* src, Wilddog_Url_T*
         }
         strcpy((char*)dst->p_url_query,(char*)src->p_url_query);
     }
+    //the copy is the same url, it shares the cache.
+    if(_wilddog_url_getCache(src)){
+        dst->p_url_cache = src->p_url_cache;
+        dst->p_url_cache->d_refs++;
+    }
     return WILDDOG_ERR_NOERR;
 }
 
@@ -569,6 +593,14 @@ void WD_SYSTEM _wilddog_url_freeParsedUrl(Wilddog_Url_T * p_url)
 
     if(NULL != p_url->p_url_query)
         wfree(p_url->p_url_query);
+
+    if(NULL != p_url->p_url_cache && 0 == --p_url->p_url_cache->d_refs){
+        if(p_url->p_url_cache->p_data)
+            wfree(p_url->p_url_cache->p_data);
+        if(p_url->p_url_cache->p_snapshot)
+            wilddog_node_delete(p_url->p_url_cache->p_snapshot);
+        wfree(p_url->p_url_cache);
+    }
     
     wfree(p_url);
     return;
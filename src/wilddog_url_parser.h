@@ -16,11 +16,33 @@ extern "C" {
 #include "wilddog.h"
 
 
+/*
+ * what the protocol layer builds from a url and keeps for the next request,
+ * shared by the url and its copies, freed with the last of them. The etag
+ * and the snapshot are the last value got of the url, the next get sends
+ * the etag and reuses the snapshot if the server says it is not changed.
+ * The connect layer coalesces sets of the url by the pending one.
+*/
+#define WILDDOG_URL_ETAG_MAXLEN 8
+
+typedef struct WILDDOG_URL_CACHE_T
+{
+    u32 d_refs;
+    u32 d_len;
+    u8 *p_data;
+    u8 d_etag_len;
+    u8 d_etag[WILDDOG_URL_ETAG_MAXLEN];
+    Wilddog_Node_T *p_snapshot;
+    u32 d_inflight;//coalescing sets of the url in flight
+    void *p_pending;//the coalescing set of the url queued and never sent
+}Wilddog_Url_Cache_T;
+
 typedef struct WILDDOG_URL_T
 {
     Wilddog_Str_T     * p_url_host;
     Wilddog_Str_T     * p_url_path;
     Wilddog_Str_T     * p_url_query;
+    Wilddog_Url_Cache_T * p_url_cache;
 }Wilddog_Url_T;
 
 
@@ -49,6 +71,7 @@ extern Wilddog_Return_T _wilddog_url_getPath
     );
 extern Wilddog_Str_T *_wilddog_url_getKey(Wilddog_Str_T * p_path);
 extern Wilddog_Return_T _wilddog_url_copy(Wilddog_Url_T* src, Wilddog_Url_T* dst);
+extern Wilddog_Url_Cache_T *_wilddog_url_getCache(Wilddog_Url_T* p_url);
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,353 @@
+/*
+ * Copyright (C) 2014-2016 Wilddog Technologies. All Rights Reserved.
+ *
+ * FileName: test_ack.c
+ *
+ * Description: in place pdu parser, empty ack/rst encoder and cached uri 
+ *              options tests, and a benchmark of handling observe 
+ *              notifications, compare with acking by a new pdu, over 
+ *              loopback, no server needed.
+ *
+ * History:
+ * Version      Author          Date        Description
+ *
+ * 2.0.2                        2016-10-17  Create file.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "wilddog.h"
+#include "wilddog_port.h"
+#include "wilddog_protocol.h"
+#include "wilddog_sec.h"
+#include "wilddog_conn.h"
+#include "networking/coap/option.h"
+
+#define TEST_ACK_NOTIFY     2000
+#define TEST_ACK_PAYLOAD    32
+
+extern size_t _wilddog_protocol_ioctl(Wilddog_Proto_Cmd_T cmd, void *p_args, \
+                                      int flags);
+
+struct test_reult_t
+{
+    char* name;
+    Wilddog_Func_T func;
+    int result;
+};
+
+STATIC const u8 l_test_token[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+
+STATIC u32 test_usec(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (u32)(tv.tv_sec * 1000000 + tv.tv_usec);
+}
+
+/*a notification like the server sends, confirmable, observe and payload.*/
+STATIC coap_pdu_t *test_notify(u16 mid)
+{
+    coap_pdu_t *pdu;
+    u8 observe[2], payload[TEST_ACK_PAYLOAD];
+
+    pdu = coap_pdu_init(COAP_MESSAGE_CON, COAP_RESPONSE_CODE(205), \
+                        htons(mid), 64);
+    if(NULL == pdu)
+        return NULL;
+    observe[0] = (u8)(mid >> 8);
+    observe[1] = (u8)mid;
+    memset(payload, 0xa5, sizeof(payload));
+    coap_add_token(pdu, 4, l_test_token);
+    coap_add_option(pdu, COAP_OPTION_OBSERVE, 2, observe);
+    coap_add_data(pdu, sizeof(payload), payload);
+    return pdu;
+}
+
+/*the empty message must be the same bytes as a pdu with the token.*/
+int test_ackEncode()
+{
+    u8 buf[COAP_EMPTY_MAX_SIZE];
+    coap_pdu_t *pdu;
+    size_t tkl, len;
+    u8 type;
+    int res = -1;
+
+    for(type = COAP_MESSAGE_ACK; type <= COAP_MESSAGE_RST; type++){
+        for(tkl = 0; tkl <= 8; tkl++){
+            pdu = coap_pdu_init(type, 0, htons(0x1234 + tkl), 16);
+            if(NULL == pdu)
+                return -1;
+            coap_add_token(pdu, tkl, l_test_token);
+            len = coap_encode_empty(type, htons(0x1234 + tkl), tkl, \
+                                    l_test_token, buf, sizeof(buf));
+            if(len != pdu->length || memcmp(buf, pdu->hdr, len)){
+                wilddog_debug("type = %d, tkl = %lu, len = %lu", type, \
+                              (unsigned long)tkl, (unsigned long)len);
+                coap_delete_pdu(pdu);
+                return -1;
+            }
+            coap_delete_pdu(pdu);
+        }
+    }
+    /*too long token or too small buffer*/
+    if(0 == coap_encode_empty(COAP_MESSAGE_ACK, 0, 9, l_test_token, \
+                              buf, sizeof(buf)) && \
+       0 == coap_encode_empty(COAP_MESSAGE_ACK, 0, 8, l_test_token, buf, 11))
+        res = 0;
+    return res;
+}
+
+/*a view must see the same message as a parsed copy, without copying.*/
+int test_pduView()
+{
+    coap_pdu_t *pdu, *copy, view;
+    u8 data[64];
+    int res = -1;
+
+    pdu = test_notify(0x1234);
+    copy = coap_pdu_init(0, 0, 0, 64);
+    if(NULL == pdu || NULL == copy)
+        goto end;
+    memcpy(data, pdu->hdr, pdu->length);
+    if(0 == coap_pdu_parse(data, pdu->length, copy) || \
+       0 == coap_pdu_view(data, pdu->length, &view))
+        goto end;
+    if((u8*)view.hdr != data || view.length != copy->length || \
+       view.hdr->id != copy->hdr->id || \
+       view.hdr->token_length != copy->hdr->token_length || \
+       view.data - data != copy->data - (u8*)copy->hdr || \
+       memcmp(view.data, copy->data, TEST_ACK_PAYLOAD))
+        goto end;
+    /*payload marker without payload, and a truncated header*/
+    if(0 != coap_pdu_view(data, pdu->length - TEST_ACK_PAYLOAD, &view) || \
+       0 != coap_pdu_view(data, 3, &view))
+        goto end;
+    res = 0;
+end:
+    if(pdu)
+        coap_delete_pdu(pdu);
+    if(copy)
+        coap_delete_pdu(copy);
+    return res;
+}
+
+/*build a get request of the url, without sending.*/
+STATIC coap_pdu_t *test_getPdu(Wilddog_Url_T *url, const char *sid)
+{
+    Wilddog_Protocol_T proto;
+    Wilddog_Proto_Cmd_Arg_T arg;
+    Wilddog_Conn_Pkt_Data_T pkt, *p_pkt = &pkt;
+    u32 token = 0;
+
+    memset(&proto, 0, sizeof(proto));
+    memset(&arg, 0, sizeof(arg));
+    arg.protocol = &proto;
+    arg.p_url = url;
+    arg.p_session_info = (u8*)sid;
+    arg.d_session_len = strlen(sid);
+    arg.p_message_id = &token;
+    arg.p_out_data = (u8**)&p_pkt;
+    if(WILDDOG_ERR_NOERR != \
+       _wilddog_protocol_ioctl(WD_PROTO_CMD_SEND_GET, &arg, FALSE))
+        return NULL;
+    return (coap_pdu_t*)pkt.data;
+}
+
+/*requests by cached options must be the same as encoded one by one.*/
+int test_urlOpts()
+{
+    Wilddog_Url_T url;
+    Wilddog_Url_Cache_T *p_cache;
+    coap_pdu_t *pdu, *cached;
+    const char *path[] = {"/", "/a/b", "/a/b", "/c"};
+    const char *query[] = {NULL, NULL, "auth=abc", "auth=abc"};
+    const char *sid[] = {"1234abcd", "1234abcd", "5678efgh", "5678efgh"};
+    int i, res = 0;
+
+    p_cache = (Wilddog_Url_Cache_T*)wmalloc(sizeof(Wilddog_Url_Cache_T));
+    if(NULL == p_cache)
+        return -1;
+    memset(&url, 0, sizeof(url));
+    url.p_url_host = (Wilddog_Str_T*)"test.wilddogio.com";
+    for(i = 0; i < 4 && 0 == res; i++){
+        url.p_url_path = (Wilddog_Str_T*)path[i];
+        url.p_url_query = (Wilddog_Str_T*)query[i];
+        url.p_url_cache = NULL;
+        pdu = test_getPdu(&url, sid[i]);
+        url.p_url_cache = p_cache;
+        cached = test_getPdu(&url, sid[i]);
+        /*the message id and token are new ones, compare the options*/
+        if(NULL == pdu || NULL == cached || pdu->length != cached->length || \
+           memcmp(pdu->hdr->token + pdu->hdr->token_length, \
+                  cached->hdr->token + cached->hdr->token_length, \
+                  pdu->length - 4 - pdu->hdr->token_length))
+            res = -1;
+        if(pdu)
+            coap_delete_pdu(pdu);
+        if(cached)
+            coap_delete_pdu(cached);
+    }
+    if(p_cache->p_data)
+        wfree(p_cache->p_data);
+    wfree(p_cache);
+    return res;
+}
+
+/*receive a notification from the server, the pdu is a view over the buffer.*/
+STATIC coap_pdu_t *test_recvNotify
+    (
+    int server, 
+    struct sockaddr_in *p_clientAddr, 
+    Wilddog_Proto_Cmd_Arg_T *p_arg, 
+    u16 mid
+    )
+{
+    coap_pdu_t *pdu = test_notify(mid);
+    u8 *recvPkt = NULL;
+    u32 recvLen = 0, message_id = 0;
+
+    if(NULL == pdu)
+        return NULL;
+    sendto(server, pdu->hdr, pdu->length, 0, \
+           (struct sockaddr*)p_clientAddr, sizeof(struct sockaddr_in));
+    coap_delete_pdu(pdu);
+    p_arg->p_out_data = &recvPkt;
+    p_arg->p_out_data_len = &recvLen;
+    p_arg->p_message_id = &message_id;
+    if(WILDDOG_ERR_NOERR != \
+       _wilddog_protocol_ioctl(WD_PROTO_CMD_RECV_GETPKT, p_arg, 0))
+        return NULL;
+    p_arg->p_data = recvPkt;
+    p_arg->d_data_len = recvLen;
+    return (coap_pdu_t*)recvPkt;
+}
+
+/*notifications per second, the old way mallocs and zeroes a max size pdu.*/
+int test_ackBench()
+{
+    Wilddog_Protocol_T proto;
+    Wilddog_Proto_Cmd_Arg_T arg;
+    struct sockaddr_in servaddr, clientAddr;
+    socklen_t addrLen = sizeof(servaddr);
+    coap_pdu_t *pdu, *toSend;
+    u8 buf[64];
+    u32 i, start, pduTime, encodeTime;
+    int server, acks = 0, res = -1;
+
+    server = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&servaddr, 0, sizeof(servaddr));
+    servaddr.sin_family = AF_INET;
+    servaddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if(server < 0 || \
+       bind(server, (struct sockaddr*)&servaddr, sizeof(servaddr)) < 0 || \
+       getsockname(server, (struct sockaddr*)&servaddr, &addrLen) < 0)
+        goto end;
+    memset(&proto, 0, sizeof(proto));
+    proto.addr.len = 4;
+    memcpy(proto.addr.ip, &servaddr.sin_addr.s_addr, 4);
+    proto.addr.port = ntohs(servaddr.sin_port);
+    if(0 != wilddog_openSocket(&proto.socketFd))
+        goto end;
+    /*so the server knows where to send*/
+    addrLen = sizeof(clientAddr);
+    if(wilddog_send(proto.socketFd, &proto.addr, "hello", 5) != 5 || \
+       recvfrom(server, buf, sizeof(buf), 0, \
+                (struct sockaddr*)&clientAddr, &addrLen) != 5)
+        goto close;
+    memset(&arg, 0, sizeof(arg));
+    arg.protocol = &proto;
+
+    /*before: an ack pdu of WILDDOG_PROTO_MAXSIZE per notification*/
+    start = test_usec();
+    for(i = 0; i < TEST_ACK_NOTIFY; i++){
+        pdu = test_recvNotify(server, &clientAddr, &arg, (u16)i);
+        if(NULL == pdu)
+            goto close;
+        toSend = coap_pdu_init(COAP_MESSAGE_ACK, 0, pdu->hdr->id, \
+                               WILDDOG_PROTO_MAXSIZE);
+        if(toSend){
+            coap_add_token(toSend, pdu->hdr->token_length, pdu->hdr->token);
+            _wilddog_sec_send(&proto, toSend->hdr, toSend->length);
+            coap_delete_pdu(toSend);
+        }
+        /*acked already, only release it*/
+        pdu->hdr->type = COAP_MESSAGE_NON;
+        _wilddog_protocol_ioctl(WD_PROTO_CMD_RECV_FREEPKT, &arg, TRUE);
+        while(recv(server, buf, sizeof(buf), MSG_DONTWAIT) > 0);
+    }
+    pduTime = test_usec() - start;
+
+    /*after: the protocol layer acks from the stack*/
+    start = test_usec();
+    for(i = 0; i < TEST_ACK_NOTIFY; i++){
+        if(NULL == test_recvNotify(server, &clientAddr, &arg, (u16)i))
+            goto close;
+        _wilddog_protocol_ioctl(WD_PROTO_CMD_RECV_FREEPKT, &arg, TRUE);
+        while(recv(server, buf, sizeof(buf), MSG_DONTWAIT) == 8){
+            /*ack, 4 bytes token, the notification's mid*/
+            if(buf[0] == 0x64 && buf[1] == 0 && buf[4] == 1)
+                acks++;
+        }
+    }
+    encodeTime = test_usec() - start;
+
+    printf("\n%-14s%-20s\n", "ack by", "notifications/sec");
+    printf("%-14s%-20lu\n", "pdu", \
+           (unsigned long)(TEST_ACK_NOTIFY * 1000000.0 / (pduTime + 1)));
+    printf("%-14s%-20lu\n", "encode", \
+           (unsigned long)(TEST_ACK_NOTIFY * 1000000.0 / (encodeTime + 1)));
+    /*loopback may drop some, but most must arrive*/
+    if(acks > TEST_ACK_NOTIFY / 2)
+        res = 0;
+close:
+    wilddog_closeSocket(proto.socketFd);
+end:
+    if(server >= 0)
+        close(server);
+    return res;
+}
+
+struct test_reult_t test_results[] =
+{
+    {"coap pdu view",               (Wilddog_Func_T)test_pduView,       0},
+    {"coap empty ack encode",       (Wilddog_Func_T)test_ackEncode,     0},
+    {"coap cached uri options",     (Wilddog_Func_T)test_urlOpts,       0},
+    {"coap ack benchmark",          (Wilddog_Func_T)test_ackBench,      0},
+    {NULL, NULL, -1},
+};
+
+int test_printResult()
+{
+    int i;
+    printf("\n\nTest results:\n\n");
+    for(i = 0; i < sizeof(test_results)/ sizeof(struct test_reult_t); i++)
+    {
+        if(test_results[i].name != NULL)
+            test_results[i].result = test_results[i].func();
+    }
+    for(i = 0; i < sizeof(test_results)/ sizeof(struct test_reult_t); i++)
+    {
+        if(test_results[i].name != NULL)
+        {
+            printf("%-32s\t%s\n", test_results[i].name, \
+                    test_results[i].result == 0? ("PASS"):("FAIL"));
+
+            if(test_results[i].result != 0)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+int main(void)
+{
+    return test_printResult();
+}
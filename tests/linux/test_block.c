@@ -0,0 +1,351 @@
+/*
+ * Copyright (C) 2014-2016 Wilddog Technologies. All Rights Reserved.
+ *
+ * FileName: test_block.c
+ *
+ * Description: coap blockwise transfer test [rfc7959], a loopback server
+ *              acks block1 requests and serves block2 responses, one block
+ *              is lost in each direction, no cloud needed.
+ *
+ * History:
+ * Version      Author          Date        Description
+ *
+ * 2.0.2                        2016-10-16  Create file.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "wilddog.h"
+#include "wilddog_port.h"
+#include "wilddog_conn.h"
+#include "wilddog_protocol.h"
+#include "networking/coap/option.h"
+#include "test_loopback.h"
+
+#define TEST_BLOCK_VALUE_LEN    5000
+#define TEST_BLOCK_SZX          6
+#define TEST_BLOCK_SIZE         (16 << TEST_BLOCK_SZX)
+#define TEST_BLOCK_LOST         2
+#define TEST_BLOCK_MAX_ROUNDS   200
+/*the last block is held until the others are acked, block 0 of block2 too*/
+#define TEST_BLOCK_INFLIGHT     ((TEST_BLOCK_VALUE_LEN - 1) / TEST_BLOCK_SIZE < \
+                                 WILDDOG_COAP_BLOCK_WINDOW ? \
+                                 (TEST_BLOCK_VALUE_LEN - 1) / TEST_BLOCK_SIZE : \
+                                 WILDDOG_COAP_BLOCK_WINDOW)
+
+extern size_t _wilddog_protocol_ioctl(Wilddog_Proto_Cmd_T cmd, void *p_args, \
+                                      int flags);
+
+struct test_reult_t
+{
+    char* name;
+    Wilddog_Func_T func;
+    int result;
+};
+
+typedef struct TEST_BLOCK_SERVER_T
+{
+    u8 value[TEST_BLOCK_VALUE_LEN];
+    u8 recvd[TEST_BLOCK_VALUE_LEN];
+    u32 recvdBits;
+    BOOL isLost;
+    int maxBatch;
+    BOOL isDone;
+}Test_Block_Server_T;
+
+STATIC Test_Block_Server_T l_test_server;
+STATIC Wilddog_Protocol_T l_test_proto;
+STATIC Wilddog_Url_T l_test_url = {(Wilddog_Str_T*)"test.wilddogio.com", \
+                                   (Wilddog_Str_T*)"/block", NULL};
+STATIC u8 l_test_sid[WILDDOG_CONN_SESSION_SHORT_LEN] = "12345678";
+
+STATIC BOOL test_getUint(coap_pdu_t *pdu, u16 type, u32 *p_value)
+{
+    coap_opt_iterator_t oi;
+    coap_opt_t *opt = coap_check_option(pdu, type, &oi);
+    u8 *value;
+    u16 i;
+
+    *p_value = 0;
+    if(NULL == opt)
+        return FALSE;
+    value = coap_opt_value(opt);
+    for(i = 0; i < coap_opt_length(opt); i++)
+        *p_value = (*p_value << 8) | value[i];
+    return TRUE;
+}
+
+STATIC void test_addUint(coap_pdu_t *pdu, u16 type, u32 value)
+{
+    u8 buf[4];
+    int len = 0;
+    if(value > 0xffffff)
+        buf[len++] = (value >> 24) & 0xff;
+    if(value > 0xffff)
+        buf[len++] = (value >> 16) & 0xff;
+    if(value > 0xff)
+        buf[len++] = (value >> 8) & 0xff;
+    if(value)
+        buf[len++] = value & 0xff;
+    coap_add_option(pdu, type, len, buf);
+}
+
+/*
+ * block1: store the block, 2.31 for the others, 2.04 for the last one if
+ * all blocks came, else 4.08. block2: serve the value from the asked block.
+ * The first request of block TEST_BLOCK_LOST is dropped.
+*/
+STATIC void test_serverHandle
+    (
+    coap_pdu_t *req,
+    struct sockaddr_in *p_from
+    )
+{
+    coap_pdu_t *resp;
+    u32 block, num, more, offset, len;
+
+    resp = coap_pdu_init(COAP_MESSAGE_ACK, 0, req->hdr->id, 1500);
+    coap_add_token(resp, req->hdr->token_length, req->hdr->token);
+    if(TRUE == test_getUint(req, COAP_OPTION_BLOCK1, &block))
+    {
+        u8 *data = NULL;
+        size_t dataLen = 0;
+
+        num = block >> 4;
+        more = (block >> 3) & 1;
+        if(TEST_BLOCK_LOST == num && FALSE == l_test_server.isLost)
+        {
+            l_test_server.isLost = TRUE;
+            goto end;
+        }
+        coap_get_data(req, &dataLen, &data);
+        offset = num * (16 << (block & 0x07));
+        if(offset + dataLen <= TEST_BLOCK_VALUE_LEN)
+        {
+            memcpy(l_test_server.recvd + offset, data, dataLen);
+            l_test_server.recvdBits |= 1 << num;
+        }
+        if(more)
+            resp->hdr->code = COAP_RESPONSE_231;
+        else if(l_test_server.recvdBits == (2u << num) - 1)
+        {
+            resp->hdr->code = COAP_RESPONSE_CODE(204);
+            l_test_server.isDone = TRUE;
+        }
+        else
+            resp->hdr->code = COAP_RESPONSE_408;
+        test_addUint(resp, COAP_OPTION_BLOCK1, block);
+    }
+    else
+    {
+        num = 0;
+        if(TRUE == test_getUint(req, COAP_OPTION_BLOCK2, &block))
+            num = block >> 4;
+        if(TEST_BLOCK_LOST == num && FALSE == l_test_server.isLost)
+        {
+            l_test_server.isLost = TRUE;
+            goto end;
+        }
+        offset = num * TEST_BLOCK_SIZE;
+        len = TEST_BLOCK_VALUE_LEN - offset;
+        more = len > TEST_BLOCK_SIZE;
+        if(more)
+            len = TEST_BLOCK_SIZE;
+        resp->hdr->code = COAP_RESPONSE_CODE(205);
+        test_addUint(resp, COAP_OPTION_BLOCK2, \
+                     (num << 4) | (more << 3) | TEST_BLOCK_SZX);
+        if(0 == num && test_getUint(req, COAP_OPTION_SIZE2, &block))
+            test_addUint(resp, COAP_OPTION_SIZE2, TEST_BLOCK_VALUE_LEN);
+        coap_add_data(resp, len, l_test_server.value + offset);
+    }
+    test_loopbackSend(resp, p_from);
+end:
+    coap_delete_pdu(resp);
+}
+
+/*handle all the requests queued, count how many came together.*/
+STATIC void test_serverStep(void)
+{
+    int batch = test_loopbackStep();
+
+    if(batch > l_test_server.maxBatch)
+        l_test_server.maxBatch = batch;
+}
+
+STATIC int test_open(void)
+{
+    int i;
+
+    memset(&l_test_server, 0, sizeof(l_test_server));
+    for(i = 0; i < TEST_BLOCK_VALUE_LEN; i++)
+        l_test_server.value[i] = (u8)(i * 7 + i / 256);
+    memset(&l_test_proto, 0, sizeof(l_test_proto));
+    l_test_proto.callback = (Wilddog_Func_T)_wilddog_protocol_ioctl;
+    if(test_loopbackOpen(test_serverHandle) < 0 || \
+       wilddog_openSocket(&l_test_proto.socketFd) < 0)
+        return -1;
+    test_loopbackConnect(&l_test_proto);
+    return 0;
+}
+
+STATIC void test_close(void)
+{
+    wilddog_closeSocket(l_test_proto.socketFd);
+    test_loopbackClose();
+}
+
+/*
+ * send a request, then drive receive and handle like conn layer does, resend
+ * the stored request when nothing comes, until the transfer ends.
+*/
+STATIC Wilddog_Return_T test_transfer
+    (
+    Wilddog_Proto_Cmd_T cmd,
+    u8 *p_data,
+    u32 len,
+    u8 *p_value
+    )
+{
+    Wilddog_Proto_Cmd_Arg_T command;
+    Wilddog_Conn_Pkt_Data_T send_data;
+    Wilddog_Conn_Pkt_Data_T *p_send = &send_data;
+    u8 *p_proto_data = NULL;
+    u8 *p_recv = NULL, *payload = NULL;
+    u32 token = 0, recv_len = 0, payload_len = 0;
+    Wilddog_Return_T ret = WILDDOG_ERR_RECVTIMEOUT;
+    int round, idle = 0;
+
+    memset(&send_data, 0, sizeof(send_data));
+    memset(&command, 0, sizeof(command));
+    command.protocol = &l_test_proto;
+    command.p_data = p_data;
+    command.d_data_len = len;
+    command.p_url = &l_test_url;
+    command.p_message_id = &token;
+    command.p_out_data = (u8**)&p_send;
+    command.p_proto_data = &p_proto_data;
+    command.p_session_info = l_test_sid;
+    command.d_session_len = WILDDOG_CONN_SESSION_SHORT_LEN - 1;
+    if(WILDDOG_ERR_NOERR != _wilddog_protocol_ioctl(cmd, &command, TRUE))
+        return WILDDOG_ERR_SENDERR;
+
+    for(round = 0; round < TEST_BLOCK_MAX_ROUNDS; round++)
+    {
+        test_serverStep();
+        command.p_out_data = &p_recv;
+        command.p_out_data_len = &recv_len;
+        if(WILDDOG_ERR_NOERR != \
+           _wilddog_protocol_ioctl(WD_PROTO_CMD_RECV_GETPKT, &command, 0))
+        {
+            /*the conn layer's retransmit*/
+            if(++idle >= 3)
+            {
+                idle = 0;
+                command.p_data = send_data.data;
+                command.d_data_len = send_data.len;
+                _wilddog_protocol_ioctl(WD_PROTO_CMD_SEND_RETRANSMIT, \
+                                        &command, 0);
+            }
+            continue;
+        }
+        idle = 0;
+        command.p_data = p_recv;
+        command.d_data_len = recv_len;
+        command.p_out_data = &payload;
+        command.p_out_data_len = &payload_len;
+        ret = _wilddog_protocol_ioctl(WD_PROTO_CMD_RECV_HANDLEPKT, &command, 0);
+        if(ret >= WILDDOG_ERR_NOERR && p_value)
+        {
+            if(payload_len != TEST_BLOCK_VALUE_LEN || \
+               memcmp(payload, p_value, payload_len))
+                ret = WILDDOG_ERR_INVALID;
+        }
+        command.p_data = p_recv;
+        _wilddog_protocol_ioctl(WD_PROTO_CMD_RECV_FREEPKT, &command, TRUE);
+        if(WILDDOG_PROTO_ERR_CONTINUE != ret && WILDDOG_ERR_IGNORE != ret)
+            break;
+    }
+    printf("%s: result %d, %d rounds, max %d requests at once\n", \
+           WD_PROTO_CMD_SEND_GET == cmd ? "block2" : "block1", \
+           ret, round, l_test_server.maxBatch);
+    if(send_data.data)
+        wfree(send_data.data);
+    if(p_proto_data)
+        wfree(p_proto_data);
+    return ret;
+}
+
+/*a large setValue goes block by block, a lost block is resent.*/
+int test_block1()
+{
+    Wilddog_Return_T ret;
+    int res = -1;
+
+    if(test_open() < 0)
+        return -1;
+    ret = test_transfer(WD_PROTO_CMD_SEND_SET, l_test_server.value, \
+                        TEST_BLOCK_VALUE_LEN, NULL);
+    if(WILDDOG_HTTP_NO_CONTENT == ret && TRUE == l_test_server.isDone && \
+       0 == memcmp(l_test_server.value, l_test_server.recvd, TEST_BLOCK_VALUE_LEN) && \
+       l_test_server.maxBatch == TEST_BLOCK_INFLIGHT)
+    {
+        res = 0;
+    }
+    test_close();
+    return res;
+}
+
+/*a large value comes block by block, a lost block is asked again.*/
+int test_block2()
+{
+    Wilddog_Return_T ret;
+    int res = -1;
+
+    if(test_open() < 0)
+        return -1;
+    ret = test_transfer(WD_PROTO_CMD_SEND_GET, NULL, 0, l_test_server.value);
+    if(WILDDOG_HTTP_OK == ret && TRUE == l_test_server.isLost && \
+       l_test_server.maxBatch == TEST_BLOCK_INFLIGHT)
+    {
+        res = 0;
+    }
+    test_close();
+    return res;
+}
+
+struct test_reult_t test_results[] =
+{
+    {"coap block1 transfer",        (Wilddog_Func_T)test_block1,        0},
+    {"coap block2 transfer",        (Wilddog_Func_T)test_block2,        0},
+    {NULL, NULL, -1},
+};
+
+int test_printResult()
+{
+    int i;
+    printf("\n\nTest results:\n\n");
+    for(i = 0; i < sizeof(test_results)/ sizeof(struct test_reult_t); i++)
+    {
+        if(test_results[i].name != NULL)
+            test_results[i].result = test_results[i].func();
+    }
+    for(i = 0; i < sizeof(test_results)/ sizeof(struct test_reult_t); i++)
+    {
+        if(test_results[i].name != NULL)
+        {
+            printf("%-32s\t%s\n", test_results[i].name, \
+                    test_results[i].result == 0? ("PASS"):("FAIL"));
+
+            if(test_results[i].result != 0)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+int main(void)
+{
+    return test_printResult();
+}
@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2014-2016 Wilddog Technologies. All Rights Reserved.
+ *
+ * FileName: test_clock.c
+ *
+ * Description: sdk time tests, the time used by the connect layer follows
+ *              the port's monotonic clock, and does not move by
+ *              WILDDOG_RECEIVE_TIMEOUT each time a repo syncs, no server
+ *              needed.
+ *
+ * History:
+ * Version      Author          Date        Description
+ *
+ * 2.0.2                        2016-10-17  Create file.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "wilddog.h"
+#include "wilddog_api.h"
+#include "wilddog_port.h"
+#include "wilddog_common.h"
+
+/*repos synced in one trySync, and the trySyncs*/
+#define TEST_CLOCK_REPOS        8
+#define TEST_CLOCK_SYNCS        1000
+#define TEST_CLOCK_SLEEP        200
+/*ms the sdk time and the clock may differ, read one after another*/
+#define TEST_CLOCK_SLACK        20
+#define TEST_CLOCK_INCREASE     5000
+
+struct test_reult_t
+{
+    char* name;
+    Wilddog_Func_T func;
+    int result;
+};
+
+/*the sdk time moved as much as the port's clock, read around it.*/
+STATIC int test_isFollow(u32 clockStart, u32 start, u32 end, u32 clockEnd)
+{
+    u32 passed = end - start;
+    u32 clockPassed = clockEnd - clockStart;
+
+    if(passed > clockPassed || passed + TEST_CLOCK_SLACK < clockPassed)
+    {
+        wilddog_debug("sdk time passed %lu ms, clock passed %lu ms", \
+                      (unsigned long)passed, (unsigned long)clockPassed);
+        return -1;
+    }
+    return 0;
+}
+
+/*time passes by itself, nobody syncs.*/
+int test_clockFollow()
+{
+    u32 clockStart, clockEnd, start, end;
+
+    if(wilddog_getMonotonicTime(&clockStart) < 0)
+        return -1;
+    start = _wilddog_getTime();
+    usleep(TEST_CLOCK_SLEEP * 1000);
+    end = _wilddog_getTime();
+    wilddog_getMonotonicTime(&clockEnd);
+    if(end - start < TEST_CLOCK_SLEEP)
+        return -1;
+    return test_isFollow(clockStart, start, end, clockEnd);
+}
+
+/*
+ * each trySync syncs the time once for every repo, it moved
+ * WILDDOG_RECEIVE_TIMEOUT every time, now it is the clock.
+*/
+int test_clockSync()
+{
+    u32 clockStart, clockEnd, start, end;
+    int i, j;
+
+    wilddog_getMonotonicTime(&clockStart);
+    start = _wilddog_getTime();
+    for(i = 0; i < TEST_CLOCK_SYNCS; i++)
+    {
+        for(j = 0; j < TEST_CLOCK_REPOS; j++)
+            _wilddog_syncTime();
+    }
+    end = _wilddog_getTime();
+    wilddog_getMonotonicTime(&clockEnd);
+    printf("\n%-14s%-14s%-14s\n", "syncs", "sdk ms", "fixed ms");
+    printf("%-14d%-14lu%-14lu\n", TEST_CLOCK_SYNCS * TEST_CLOCK_REPOS, \
+           (unsigned long)(end - start), \
+           (unsigned long)TEST_CLOCK_SYNCS * TEST_CLOCK_REPOS * \
+           WILDDOG_RECEIVE_TIMEOUT);
+    return test_isFollow(clockStart, start, end, clockEnd);
+}
+
+/*wilddog_increaseTime still moves the time on top of the clock.*/
+int test_clockIncrease()
+{
+    u32 clockStart, clockEnd, start, end;
+
+    wilddog_getMonotonicTime(&clockStart);
+    start = _wilddog_getTime();
+    wilddog_increaseTime(TEST_CLOCK_INCREASE);
+    end = _wilddog_getTime() - TEST_CLOCK_INCREASE;
+    wilddog_getMonotonicTime(&clockEnd);
+    return test_isFollow(clockStart, start, end, clockEnd);
+}
+
+struct test_reult_t test_results[] =
+{
+    {"clock follow port",           (Wilddog_Func_T)test_clockFollow,   0},
+    {"clock not moved by sync",     (Wilddog_Func_T)test_clockSync,     0},
+    {"clock increase",              (Wilddog_Func_T)test_clockIncrease, 0},
+    {NULL, NULL, -1},
+};
+
+int test_printResult()
+{
+    int i;
+    printf("\n\nTest results:\n\n");
+    for(i = 0; i < sizeof(test_results)/ sizeof(struct test_reult_t); i++)
+    {
+        if(test_results[i].name != NULL)
+            test_results[i].result = test_results[i].func();
+    }
+    for(i = 0; i < sizeof(test_results)/ sizeof(struct test_reult_t); i++)
+    {
+        if(test_results[i].name != NULL)
+        {
+            printf("%-32s\t%s\n", test_results[i].name, \
+                    test_results[i].result == 0? ("PASS"):("FAIL"));
+
+            if(test_results[i].result != 0)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+int main(void)
+{
+    return test_printResult();
+}
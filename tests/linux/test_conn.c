@@ -0,0 +1,593 @@
+/*
+ * Copyright (C) 2014-2016 Wilddog Technologies. All Rights Reserved.
+ *
+ * FileName: test_conn.c
+ *
+ * Description: connect layer test, a client talks to a loopback coap
+ *              server, which auths it and answers the writes, and can hold
+ *              the answers to keep the writes in flight, no cloud needed.
+ *
+ * History:
+ * Version      Author          Date        Description
+ *
+ * 2.0.2                        2016-10-17  Create file.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "wilddog.h"
+#include "wilddog_api.h"
+#include "wilddog_port.h"
+#include "wilddog_conn.h"
+#include "wilddog_payload.h"
+#include "wilddog_protocol.h"
+#include "networking/coap/option.h"
+#include "test_loopback.h"
+
+#define TEST_CONN_URL           "coap://conn.wilddogio.com/sensor"
+#define TEST_CONN_WRITES        5
+/*writes and held answers the server remembers*/
+#define TEST_CONN_LOG_MAX       32
+#define TEST_CONN_DATA_MAX      32
+#define TEST_CONN_MAX_ROUNDS    200
+#define TEST_CONN_BUDGET_BYTES  64
+#define TEST_CONN_BUDGET_VALUE  "01234567890123456789"
+#define TEST_CONN_BUDGET_AGE    1000
+
+struct test_reult_t
+{
+    char* name;
+    Wilddog_Func_T func;
+    int result;
+};
+
+/*a write got by the server, in order, retransmits are not logged.*/
+typedef struct TEST_CONN_WRITE_T
+{
+    u8 code;
+    int len;
+    u8 data[TEST_CONN_DATA_MAX];
+}Test_Conn_Write_T;
+
+typedef struct TEST_CONN_SERVER_T
+{
+    BOOL isHold;//keep the answers of the writes until released
+    int auths;
+    int num;
+    Test_Conn_Write_T writes[TEST_CONN_LOG_MAX];
+    u16 mids[TEST_CONN_LOG_MAX];//mids seen, to skip retransmits
+    int mid_num;
+    int held;
+    coap_pdu_t *p_held[TEST_CONN_LOG_MAX];
+    struct sockaddr_in from[TEST_CONN_LOG_MAX];
+}Test_Conn_Server_T;
+
+STATIC Test_Conn_Server_T l_test_server;
+STATIC BOOL l_test_isAuthed = FALSE;
+/*times the callback of each write is called, and the last error*/
+STATIC int l_test_called[TEST_CONN_WRITES + 1];
+STATIC Wilddog_Return_T l_test_err[TEST_CONN_WRITES + 1];
+STATIC int l_test_lowCalled = 0;
+
+/*{"s":"12345678","l":"0000...0"}, the short and long token.*/
+STATIC u8 l_test_authData[] =
+{
+    0xa2, 0x61, 0x73, 0x68, '1', '2', '3', '4', '5', '6', '7', '8',
+    0x61, 0x6c, 0x78, 0x20,
+    '0', '0', '0', '0', '0', '0', '0', '0', '0', '0', '0', '0', '0', '0', '0',
+    '0', '0', '0', '0', '0', '0', '0', '0', '0', '0', '0', '0', '0', '0', '0',
+    '0', '0'
+};
+
+STATIC BOOL test_serverIsNew(u16 mid)
+{
+    int i;
+
+    for(i = 0; i < l_test_server.mid_num; i++)
+    {
+        if(mid == l_test_server.mids[i])
+            return FALSE;
+    }
+    l_test_server.mids[l_test_server.mid_num % TEST_CONN_LOG_MAX] = mid;
+    if(l_test_server.mid_num < TEST_CONN_LOG_MAX)
+        l_test_server.mid_num++;
+    return TRUE;
+}
+
+STATIC BOOL test_isAuth(coap_pdu_t *req)
+{
+    coap_opt_iterator_t oi;
+    coap_opt_t *opt;
+
+    opt = coap_check_option(req, COAP_OPTION_URI_PATH, &oi);
+    return (opt && 3 == coap_opt_length(opt) && \
+            0 == memcmp(coap_opt_value(opt), ".cs", 3));
+}
+
+/*auth gets the tokens, writes are logged and get 2.04, others 2.05.*/
+STATIC void test_serverHandle
+    (
+    coap_pdu_t *req,
+    struct sockaddr_in *p_from
+    )
+{
+    coap_pdu_t *resp;
+    Test_Conn_Write_T *p_write;
+    size_t len = 0;
+    u8 *data = NULL;
+    BOOL isNew = test_serverIsNew(req->hdr->id);
+    BOOL isHold = FALSE;
+
+    if(COAP_MESSAGE_CON != req->hdr->type)
+        return;
+    resp = coap_pdu_init(COAP_MESSAGE_ACK, COAP_RESPONSE_CODE(205), \
+                         req->hdr->id, 256);
+    if(NULL == resp)
+        return;
+    coap_add_token(resp, req->hdr->token_length, req->hdr->token);
+    if(COAP_REQUEST_POST == req->hdr->code && TRUE == test_isAuth(req))
+    {
+        if(isNew)
+            l_test_server.auths++;
+        coap_add_data(resp, sizeof(l_test_authData), l_test_authData);
+    }
+    else if(COAP_REQUEST_PUT == req->hdr->code || \
+            COAP_REQUEST_PATCH == req->hdr->code || \
+            COAP_REQUEST_DELETE == req->hdr->code)
+    {
+        if(isNew && l_test_server.num < TEST_CONN_LOG_MAX)
+        {
+            p_write = &l_test_server.writes[l_test_server.num++];
+            p_write->code = req->hdr->code;
+            coap_get_data(req, &len, &data);
+            p_write->len = (len < TEST_CONN_DATA_MAX) ? len : TEST_CONN_DATA_MAX;
+            if(data)
+                memcpy(p_write->data, data, p_write->len);
+        }
+        resp->hdr->code = COAP_RESPONSE_CODE(204);
+        isHold = l_test_server.isHold;
+    }
+    if(TRUE == isHold && isNew && l_test_server.held < TEST_CONN_LOG_MAX)
+    {
+        l_test_server.p_held[l_test_server.held] = resp;
+        l_test_server.from[l_test_server.held++] = *p_from;
+        return;
+    }
+    if(FALSE == isHold)
+        test_loopbackSend(resp, p_from);
+    coap_delete_pdu(resp);
+}
+
+/*send the held answers, in the order the writes came.*/
+STATIC void test_serverRelease(void)
+{
+    int i;
+
+    l_test_server.isHold = FALSE;
+    for(i = 0; i < l_test_server.held; i++)
+    {
+        test_loopbackSend(l_test_server.p_held[i], &l_test_server.from[i]);
+        coap_delete_pdu(l_test_server.p_held[i]);
+    }
+    l_test_server.held = 0;
+}
+
+/*serve, and let the client send and receive.*/
+STATIC void test_sync(int rounds)
+{
+    int i;
+
+    for(i = 0; i < rounds; i++)
+    {
+        test_loopbackStep();
+        wilddog_trySync();
+    }
+    test_loopbackStep();
+}
+
+STATIC void test_onAuth(void* arg, Wilddog_Return_T err)
+{
+    if(WILDDOG_HTTP_OK == err)
+        l_test_isAuthed = TRUE;
+}
+
+STATIC void test_onWrite(void* arg, Wilddog_Return_T err)
+{
+    int index = (int)(size_t)arg;
+
+    l_test_called[index]++;
+    l_test_err[index] = err;
+}
+
+STATIC void test_onLow(void* arg)
+{
+    l_test_lowCalled++;
+}
+
+STATIC Wilddog_T test_open(void)
+{
+    Wilddog_T wilddog = 0;
+    Wilddog_Conn_T *p_conn;
+    int i;
+
+    memset(&l_test_server, 0, sizeof(l_test_server));
+    memset(l_test_called, 0, sizeof(l_test_called));
+    memset(l_test_err, 0, sizeof(l_test_err));
+    l_test_isAuthed = FALSE;
+    l_test_lowCalled = 0;
+    /*a session saved by the last run is not reused*/
+    wilddog_sessionSave("conn.wilddogio.com", NULL, 0);
+    if(test_loopbackOpen(test_serverHandle) < 0)
+        return 0;
+    wilddog = wilddog_initWithUrl((Wilddog_Str_T*)TEST_CONN_URL);
+    if(0 == wilddog)
+        return 0;
+    /*inited to the cloud, the auth sent by init is lost, turn it to the
+      loopback server and auth again*/
+    p_conn = ((Wilddog_Ref_T*)wilddog)->p_ref_repo->p_rp_conn;
+    test_loopbackConnect(p_conn->p_protocol);
+    wilddog_auth((Wilddog_Str_T*)"conn.wilddogio.com", (u8*)"token", 5, \
+                 test_onAuth, NULL);
+    for(i = 0; i < TEST_CONN_MAX_ROUNDS && FALSE == l_test_isAuthed; i++)
+        test_sync(1);
+    if(FALSE == l_test_isAuthed)
+        wilddog_destroy(&wilddog);
+    return wilddog;
+}
+
+STATIC void test_close(Wilddog_T *p_wilddog)
+{
+    int i;
+
+    if(*p_wilddog)
+        wilddog_destroy(p_wilddog);
+    for(i = 0; i < l_test_server.held; i++)
+        coap_delete_pdu(l_test_server.p_held[i]);
+    l_test_server.held = 0;
+    test_loopbackClose();
+}
+
+/*the server got the write of the node.*/
+STATIC BOOL test_isWrite(int index, u8 code, Wilddog_Node_T *p_node)
+{
+    Test_Conn_Write_T *p_write = &l_test_server.writes[index];
+    Wilddog_Payload_T *payload;
+    BOOL isSame = FALSE;
+
+    if(index >= l_test_server.num || code != p_write->code)
+        return FALSE;
+    payload = _wilddog_node2Payload(p_node);
+    if(NULL == payload)
+        return FALSE;
+    if(payload->d_dt_len == p_write->len && \
+       0 == memcmp(payload->p_dt_data, p_write->data, p_write->len))
+        isSame = TRUE;
+    if(payload->p_dt_data)
+        wfree(payload->p_dt_data);
+    wfree(payload);
+    return isSame;
+}
+
+STATIC BOOL test_isNumWrite(int index, u8 code, int value)
+{
+    Wilddog_Node_T *p_node = wilddog_node_createNum(NULL, value);
+    BOOL res;
+
+    if(NULL == p_node)
+        return FALSE;
+    res = test_isWrite(index, code, p_node);
+    wilddog_node_delete(p_node);
+    return res;
+}
+
+STATIC Wilddog_Return_T test_setNum(Wilddog_T wilddog, int value)
+{
+    Wilddog_Node_T *p_node = wilddog_node_createNum(NULL, value);
+    Wilddog_Return_T ret;
+
+    if(NULL == p_node)
+        return WILDDOG_ERR_NULL;
+    ret = wilddog_setValue(wilddog, p_node, test_onWrite, (void*)(size_t)value);
+    wilddog_node_delete(p_node);
+    return ret;
+}
+
+/*{"a":index, "b":index}*/
+STATIC Wilddog_Node_T *test_updateNode(int index)
+{
+    Wilddog_Node_T *p_node = wilddog_node_createObject(NULL);
+
+    if(NULL == p_node)
+        return NULL;
+    wilddog_node_addChild(p_node, \
+                          wilddog_node_createNum((Wilddog_Str_T*)"a", index));
+    wilddog_node_addChild(p_node, \
+                          wilddog_node_createNum((Wilddog_Str_T*)"b", index));
+    return p_node;
+}
+
+STATIC Wilddog_Return_T test_update(Wilddog_T wilddog, int index)
+{
+    Wilddog_Node_T *p_node = test_updateNode(index);
+    Wilddog_Return_T ret;
+
+    if(NULL == p_node)
+        return WILDDOG_ERR_NULL;
+    ret = wilddog_update(wilddog, p_node, test_onWrite, (void*)(size_t)index);
+    wilddog_node_delete(p_node);
+    return ret;
+}
+
+STATIC BOOL test_isUpdateWrite(int index, int value)
+{
+    Wilddog_Node_T *p_node = test_updateNode(value);
+    BOOL res;
+
+    if(NULL == p_node)
+        return FALSE;
+    res = test_isWrite(index, COAP_REQUEST_PATCH, p_node);
+    wilddog_node_delete(p_node);
+    return res;
+}
+
+/*wait until the callbacks of all writes are called.*/
+STATIC void test_waitWrites(int num)
+{
+    int i, j, done = 0;
+
+    for(i = 0; i < TEST_CONN_MAX_ROUNDS && done < num; i++)
+    {
+        test_sync(1);
+        for(done = 0, j = 1; j <= num; j++)
+            done += (l_test_called[j] > 0) ? 1 : 0;
+    }
+    test_sync(2);
+}
+
+/*
+ * sets of a path sent one by one, the queued one is replaced by the newer,
+ * 1 is in flight, 2, 3 and 4 are replaced, only 1 and 5 are sent, every
+ * callback is called once, 2, 3 and 4 with the result of 5.
+ */
+int test_coalesce()
+{
+    Wilddog_T wilddog = test_open();
+    int i, res = -1;
+
+    if(0 == wilddog)
+        goto end;
+    wilddog_setSendMode(wilddog, WILDDOG_SENDMODE_COALESCE);
+    l_test_server.isHold = TRUE;
+    for(i = 1; i <= TEST_CONN_WRITES; i++)
+    {
+        if(WILDDOG_ERR_NOERR != test_setNum(wilddog, i))
+            goto end;
+        test_sync(1);
+    }
+    test_sync(5);
+    if(1 != l_test_server.num || 0 != l_test_called[1])
+        goto end;
+    test_serverRelease();
+    test_waitWrites(TEST_CONN_WRITES);
+    if(2 != l_test_server.num || \
+       FALSE == test_isNumWrite(0, COAP_REQUEST_PUT, 1) || \
+       FALSE == test_isNumWrite(1, COAP_REQUEST_PUT, TEST_CONN_WRITES))
+        goto end;
+    for(i = 1; i <= TEST_CONN_WRITES; i++)
+    {
+        if(1 != l_test_called[i] || WILDDOG_HTTP_NO_CONTENT != l_test_err[i])
+            goto end;
+    }
+    res = 0;
+end:
+    test_close(&wilddog);
+    return res;
+}
+
+/*an update is sent as one PATCH with the children.*/
+int test_updatePatch()
+{
+    Wilddog_T wilddog = test_open();
+    int res = -1;
+
+    if(0 == wilddog)
+        goto end;
+    if(WILDDOG_ERR_NOERR != test_update(wilddog, 1))
+        goto end;
+    test_waitWrites(1);
+    if(1 != l_test_server.num || FALSE == test_isUpdateWrite(0, 1) || \
+       1 != l_test_called[1] || WILDDOG_HTTP_NO_CONTENT != l_test_err[1])
+        goto end;
+    res = 0;
+end:
+    test_close(&wilddog);
+    return res;
+}
+
+/*an update of a node not an object with children is not sent, the callback
+ * is called once with the error.
+ */
+int test_updateInvalid()
+{
+    Wilddog_T wilddog = test_open();
+    Wilddog_Node_T *p_node = NULL;
+    Wilddog_Return_T ret;
+    int res = -1;
+
+    if(0 == wilddog)
+        goto end;
+    p_node = wilddog_node_createNum(NULL, 1);
+    ret = wilddog_update(wilddog, p_node, test_onWrite, (void*)1);
+    wilddog_node_delete(p_node);
+    p_node = wilddog_node_createObject(NULL);
+    wilddog_update(wilddog, p_node, test_onWrite, (void*)2);
+    wilddog_node_delete(p_node);
+    test_sync(5);
+    if(WILDDOG_ERR_INVALID != ret || 0 != l_test_server.num)
+        goto end;
+    if(1 != l_test_called[1] || WILDDOG_ERR_INVALID != l_test_err[1] || \
+       1 != l_test_called[2] || WILDDOG_ERR_INVALID != l_test_err[2])
+        goto end;
+    res = 0;
+end:
+    test_close(&wilddog);
+    return res;
+}
+
+/*
+ * an update fences the coalesced sets, set 1, set 2, update, set 4, set 5 
+ * are sent as 1, 2, update, 5, 4 is replaced by 5 but 2 is never replaced.
+ */
+int test_updateFence()
+{
+    Wilddog_T wilddog = test_open();
+    Wilddog_Return_T ret;
+    int i, res = -1;
+
+    if(0 == wilddog)
+        goto end;
+    wilddog_setSendMode(wilddog, WILDDOG_SENDMODE_COALESCE);
+    l_test_server.isHold = TRUE;
+    for(i = 1; i <= TEST_CONN_WRITES; i++)
+    {
+        ret = (3 == i) ? test_update(wilddog, i) : test_setNum(wilddog, i);
+        if(WILDDOG_ERR_NOERR != ret)
+            goto end;
+        test_sync(1);
+    }
+    test_sync(5);
+    if(1 != l_test_server.num)
+        goto end;
+    test_serverRelease();
+    test_waitWrites(TEST_CONN_WRITES);
+    if(4 != l_test_server.num || \
+       FALSE == test_isNumWrite(0, COAP_REQUEST_PUT, 1) || \
+       FALSE == test_isNumWrite(1, COAP_REQUEST_PUT, 2) || \
+       FALSE == test_isUpdateWrite(2, 3) || \
+       FALSE == test_isNumWrite(3, COAP_REQUEST_PUT, 5))
+        goto end;
+    for(i = 1; i <= TEST_CONN_WRITES; i++)
+    {
+        if(1 != l_test_called[i] || WILDDOG_HTTP_NO_CONTENT != l_test_err[i])
+            goto end;
+    }
+    res = 0;
+end:
+    test_close(&wilddog);
+    return res;
+}
+
+/*a set of a string value, its callback is the one of index.*/
+STATIC Wilddog_Return_T test_setString(Wilddog_T wilddog, int index)
+{
+    Wilddog_Node_T *p_node;
+    Wilddog_Return_T ret;
+
+    p_node = wilddog_node_createUString(NULL, \
+                                        (Wilddog_Str_T*)TEST_CONN_BUDGET_VALUE);
+    if(NULL == p_node)
+        return WILDDOG_ERR_NULL;
+    ret = wilddog_setValue(wilddog, p_node, test_onWrite, (void*)(size_t)index);
+    wilddog_node_delete(p_node);
+    return ret;
+}
+
+/*
+ * sets held by the server fill the byte budget, the next one fails with 
+ * WILDDOG_ERR_QUEUEFULL and its callback is called. When they are all 
+ * responded, the low-water callback is called once, and the bytes and age
+ * kept fall to 0.
+ */
+int test_budget()
+{
+    Wilddog_T wilddog = test_open();
+    Wilddog_Metrics_T metrics;
+    Wilddog_Return_T ret = WILDDOG_ERR_NOERR;
+    int i, num = 0, res = -1;
+
+    if(0 == wilddog)
+        goto end;
+    if(WILDDOG_ERR_NOERR != wilddog_setQueueBudget(wilddog, 0, \
+                                                   TEST_CONN_BUDGET_BYTES) || \
+       WILDDOG_ERR_NOERR != wilddog_setQueueLowWater(wilddog, 0, 0, \
+                                                     test_onLow, NULL))
+        goto end;
+    l_test_server.isHold = TRUE;
+    for(i = 0; i < TEST_CONN_LOG_MAX && WILDDOG_ERR_NOERR == ret; i++)
+    {
+        ret = test_setString(wilddog, 1);
+        if(WILDDOG_ERR_NOERR == ret)
+            num++;
+    }
+    test_sync(5);
+    if(WILDDOG_ERR_QUEUEFULL != ret || num < 2 || 1 != l_test_called[1] || \
+       WILDDOG_ERR_QUEUEFULL != l_test_err[1])
+        goto end;
+    wilddog_increaseTime(TEST_CONN_BUDGET_AGE);
+    if(WILDDOG_ERR_NOERR != wilddog_getMetrics(wilddog, &metrics) || \
+       TEST_CONN_BUDGET_BYTES != metrics.d_maxBytes || \
+       0 == metrics.d_queuedBytes || \
+       metrics.d_queuedBytes > TEST_CONN_BUDGET_BYTES || \
+       metrics.d_oldestAge < TEST_CONN_BUDGET_AGE || 0 != l_test_lowCalled)
+        goto end;
+    test_serverRelease();
+    for(i = 0; i < TEST_CONN_MAX_ROUNDS && l_test_called[1] < num + 1; i++)
+        test_sync(1);
+    test_sync(5);
+    if(num + 1 != l_test_called[1] || num != l_test_server.num || \
+       WILDDOG_HTTP_NO_CONTENT != l_test_err[1] || 1 != l_test_lowCalled)
+        goto end;
+    if(WILDDOG_ERR_NOERR != wilddog_getMetrics(wilddog, &metrics) || \
+       0 != metrics.d_queuedBytes || 0 != metrics.d_oldestAge)
+        goto end;
+    /*the budget is free again, above the mark and drained, called again*/
+    if(WILDDOG_ERR_NOERR != test_setString(wilddog, 2))
+        goto end;
+    test_waitWrites(2);
+    if(1 != l_test_called[2] || 2 != l_test_lowCalled)
+        goto end;
+    res = 0;
+end:
+    test_close(&wilddog);
+    return res;
+}
+
+struct test_reult_t test_results[] =
+{
+    {"conn coalesce sets",          (Wilddog_Func_T)test_coalesce,      0},
+    {"conn update patch",           (Wilddog_Func_T)test_updatePatch,   0},
+    {"conn update invalid",         (Wilddog_Func_T)test_updateInvalid, 0},
+    {"conn update fence",           (Wilddog_Func_T)test_updateFence,   0},
+    {"conn budget and low-water",   (Wilddog_Func_T)test_budget,        0},
+    {NULL, NULL, -1},
+};
+
+int test_printResult()
+{
+    int i;
+    printf("\n\nTest results:\n\n");
+    for(i = 0; i < sizeof(test_results)/ sizeof(struct test_reult_t); i++)
+    {
+        if(test_results[i].name != NULL)
+            test_results[i].result = test_results[i].func();
+    }
+    for(i = 0; i < sizeof(test_results)/ sizeof(struct test_reult_t); i++)
+    {
+        if(test_results[i].name != NULL)
+        {
+            printf("%-32s\t%s\n", test_results[i].name, \
+                    test_results[i].result == 0? ("PASS"):("FAIL"));
+
+            if(test_results[i].result != 0)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+int main(void)
+{
+    return test_printResult();
+}
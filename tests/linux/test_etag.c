@@ -0,0 +1,290 @@
+/*
+ * Copyright (C) 2014-2016 Wilddog Technologies. All Rights Reserved.
+ *
+ * FileName: test_etag.c
+ *
+ * Description: coap etag test [rfc7252 5.10.6], a loopback server serves a
+ *              value with its etag, and answers 2.03 without the value if
+ *              the get carries the etag of the current one, no cloud needed.
+ *
+ * History:
+ * Version      Author          Date        Description
+ *
+ * 2.0.2                        2016-10-17  Create file.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "wilddog.h"
+#include "wilddog_port.h"
+#include "wilddog_conn.h"
+#include "wilddog_protocol.h"
+#include "networking/coap/option.h"
+#include "test_loopback.h"
+
+#define TEST_ETAG_VALUE_LEN     600
+#define TEST_ETAG_GETS          20
+#define TEST_ETAG_MAX_ROUNDS    50
+
+extern size_t _wilddog_protocol_ioctl(Wilddog_Proto_Cmd_T cmd, void *p_args, \
+                                      int flags);
+
+struct test_reult_t
+{
+    char* name;
+    Wilddog_Func_T func;
+    int result;
+};
+
+typedef struct TEST_ETAG_SERVER_T
+{
+    u8 value[TEST_ETAG_VALUE_LEN];
+    u8 etag[4];
+    BOOL isEtag;//serve the etag or not
+    int gets;
+    int validated;//gets with the current etag
+    int stale;//gets with an old etag
+    u32 bytes;//value bytes sent
+}Test_Etag_Server_T;
+
+STATIC Test_Etag_Server_T l_test_server;
+STATIC Wilddog_Protocol_T l_test_proto;
+STATIC Wilddog_Url_Cache_T l_test_cache;
+STATIC Wilddog_Url_T l_test_url = {(Wilddog_Str_T*)"test.wilddogio.com", \
+                                   (Wilddog_Str_T*)"/etag", NULL, \
+                                   &l_test_cache};
+STATIC u8 l_test_sid[WILDDOG_CONN_SESSION_SHORT_LEN] = "12345678";
+
+/*a new value, with a new etag.*/
+STATIC void test_serverChange(u8 version)
+{
+    memset(l_test_server.value, version, TEST_ETAG_VALUE_LEN);
+    l_test_server.etag[0] = 0xe7;
+    l_test_server.etag[3] = version;
+}
+
+/*2.03 if the get has the etag of the value, else 2.05 with the value.*/
+STATIC void test_serverHandle
+    (
+    coap_pdu_t *req,
+    struct sockaddr_in *p_from
+    )
+{
+    coap_pdu_t *resp;
+    coap_opt_iterator_t oi;
+    coap_opt_t *opt;
+
+    resp = coap_pdu_init(COAP_MESSAGE_ACK, 0, req->hdr->id, 1500);
+    coap_add_token(resp, req->hdr->token_length, req->hdr->token);
+    l_test_server.gets++;
+    opt = coap_check_option(req, COAP_OPTION_ETAG, &oi);
+    if(opt && TRUE == l_test_server.isEtag && \
+       sizeof(l_test_server.etag) == coap_opt_length(opt) && \
+       0 == memcmp(coap_opt_value(opt), l_test_server.etag, \
+                   sizeof(l_test_server.etag)))
+    {
+        l_test_server.validated++;
+        resp->hdr->code = COAP_RESPONSE_CODE(203);
+        coap_add_option(resp, COAP_OPTION_ETAG, sizeof(l_test_server.etag), \
+                        l_test_server.etag);
+    }
+    else
+    {
+        if(opt)
+            l_test_server.stale++;
+        resp->hdr->code = COAP_RESPONSE_CODE(205);
+        if(TRUE == l_test_server.isEtag)
+            coap_add_option(resp, COAP_OPTION_ETAG, \
+                            sizeof(l_test_server.etag), l_test_server.etag);
+        coap_add_data(resp, TEST_ETAG_VALUE_LEN, l_test_server.value);
+        l_test_server.bytes += TEST_ETAG_VALUE_LEN;
+    }
+    test_loopbackSend(resp, p_from);
+    coap_delete_pdu(resp);
+}
+
+STATIC int test_open(void)
+{
+    memset(&l_test_server, 0, sizeof(l_test_server));
+    memset(&l_test_cache, 0, sizeof(l_test_cache));
+    l_test_server.isEtag = TRUE;
+    test_serverChange(1);
+    memset(&l_test_proto, 0, sizeof(l_test_proto));
+    l_test_proto.callback = (Wilddog_Func_T)_wilddog_protocol_ioctl;
+    if(test_loopbackOpen(test_serverHandle) < 0 || \
+       wilddog_openSocket(&l_test_proto.socketFd) < 0)
+        return -1;
+    test_loopbackConnect(&l_test_proto);
+    return 0;
+}
+
+STATIC void test_close(void)
+{
+    wilddog_closeSocket(l_test_proto.socketFd);
+    test_loopbackClose();
+    if(l_test_cache.p_data)
+        wfree(l_test_cache.p_data);
+    memset(&l_test_cache, 0, sizeof(l_test_cache));
+}
+
+/*one getValue, driven like conn layer does, return the response code.*/
+STATIC Wilddog_Return_T test_get(void)
+{
+    Wilddog_Proto_Cmd_Arg_T command;
+    Wilddog_Conn_Pkt_Data_T send_data;
+    Wilddog_Conn_Pkt_Data_T *p_send = &send_data;
+    u8 *p_proto_data = NULL;
+    u8 *p_recv = NULL, *payload = NULL;
+    u32 token = 0, recv_len = 0, payload_len = 0;
+    Wilddog_Return_T ret = WILDDOG_ERR_RECVTIMEOUT;
+    int round;
+
+    memset(&send_data, 0, sizeof(send_data));
+    memset(&command, 0, sizeof(command));
+    command.protocol = &l_test_proto;
+    command.p_url = &l_test_url;
+    command.p_message_id = &token;
+    command.p_out_data = (u8**)&p_send;
+    command.p_proto_data = &p_proto_data;
+    command.p_session_info = l_test_sid;
+    command.d_session_len = WILDDOG_CONN_SESSION_SHORT_LEN - 1;
+    if(WILDDOG_ERR_NOERR != \
+       _wilddog_protocol_ioctl(WD_PROTO_CMD_SEND_GET, &command, TRUE))
+        return WILDDOG_ERR_SENDERR;
+
+    for(round = 0; round < TEST_ETAG_MAX_ROUNDS; round++)
+    {
+        test_loopbackStep();
+        command.p_out_data = &p_recv;
+        command.p_out_data_len = &recv_len;
+        if(WILDDOG_ERR_NOERR != \
+           _wilddog_protocol_ioctl(WD_PROTO_CMD_RECV_GETPKT, &command, 0))
+            continue;
+        command.p_data = p_recv;
+        command.d_data_len = recv_len;
+        command.p_out_data = &payload;
+        command.p_out_data_len = &payload_len;
+        ret = _wilddog_protocol_ioctl(WD_PROTO_CMD_RECV_HANDLEPKT, &command, 0);
+        if(WILDDOG_HTTP_OK == ret && \
+           (TEST_ETAG_VALUE_LEN != payload_len || \
+            memcmp(payload, l_test_server.value, payload_len)))
+            ret = WILDDOG_ERR_INVALID;
+        if(WILDDOG_HTTP_NOT_MODIFIED == ret && payload_len)
+            ret = WILDDOG_ERR_INVALID;
+        command.p_data = p_recv;
+        _wilddog_protocol_ioctl(WD_PROTO_CMD_RECV_FREEPKT, &command, TRUE);
+        break;
+    }
+    if(send_data.data)
+        coap_delete_pdu((coap_pdu_t*)send_data.data);
+    if(p_proto_data)
+        wfree(p_proto_data);
+    return ret;
+}
+
+STATIC BOOL test_isEtagKept(void)
+{
+    return (sizeof(l_test_server.etag) == l_test_cache.d_etag_len && \
+            0 == memcmp(l_test_cache.d_etag, l_test_server.etag, \
+                        sizeof(l_test_server.etag)));
+}
+
+/*the etag of the value is kept and sent, the value is sent only if changed.*/
+int test_etagRevalidate()
+{
+    int res = -1;
+
+    if(test_open() < 0)
+        goto end;
+    if(WILDDOG_HTTP_OK != test_get() || FALSE == test_isEtagKept())
+        goto end;
+    if(WILDDOG_HTTP_NOT_MODIFIED != test_get() || \
+       1 != l_test_server.validated || FALSE == test_isEtagKept())
+        goto end;
+    /*changed, the old etag is not valid*/
+    test_serverChange(2);
+    if(WILDDOG_HTTP_OK != test_get() || 1 != l_test_server.stale || \
+       FALSE == test_isEtagKept())
+        goto end;
+    if(WILDDOG_HTTP_NOT_MODIFIED != test_get() || 2 != l_test_server.validated)
+        goto end;
+    /*no etag served, none is kept*/
+    l_test_server.isEtag = FALSE;
+    test_serverChange(3);
+    if(WILDDOG_HTTP_OK != test_get() || 0 != l_test_cache.d_etag_len)
+        goto end;
+    if(WILDDOG_HTTP_OK != test_get() || 2 != l_test_server.stale)
+        goto end;
+    res = 0;
+end:
+    test_close();
+    return res;
+}
+
+/*value bytes sent for the same value got again and again.*/
+int test_etagBench()
+{
+    u32 bytes[2];
+    int i, isEtag, res = -1;
+
+    for(isEtag = 0; isEtag < 2; isEtag++)
+    {
+        if(test_open() < 0)
+            goto end;
+        l_test_server.isEtag = isEtag ? TRUE : FALSE;
+        for(i = 0; i < TEST_ETAG_GETS; i++)
+        {
+            if(test_get() < WILDDOG_HTTP_OK)
+                goto end;
+        }
+        bytes[isEtag] = l_test_server.bytes;
+        test_close();
+    }
+    printf("\n%-14s%-14s%-14s\n", "etag", "gets", "value bytes");
+    printf("%-14s%-14d%-14lu\n", "no", TEST_ETAG_GETS, (unsigned long)bytes[0]);
+    printf("%-14s%-14d%-14lu\n", "yes", TEST_ETAG_GETS, (unsigned long)bytes[1]);
+    if(bytes[1] == TEST_ETAG_VALUE_LEN && \
+       bytes[0] == TEST_ETAG_GETS * TEST_ETAG_VALUE_LEN)
+        res = 0;
+    return res;
+end:
+    test_close();
+    return res;
+}
+
+struct test_reult_t test_results[] =
+{
+    {"coap etag revalidate",        (Wilddog_Func_T)test_etagRevalidate, 0},
+    {"coap etag benchmark",         (Wilddog_Func_T)test_etagBench,      0},
+    {NULL, NULL, -1},
+};
+
+int test_printResult()
+{
+    int i;
+    printf("\n\nTest results:\n\n");
+    for(i = 0; i < sizeof(test_results)/ sizeof(struct test_reult_t); i++)
+    {
+        if(test_results[i].name != NULL)
+            test_results[i].result = test_results[i].func();
+    }
+    for(i = 0; i < sizeof(test_results)/ sizeof(struct test_reult_t); i++)
+    {
+        if(test_results[i].name != NULL)
+        {
+            printf("%-32s\t%s\n", test_results[i].name, \
+                    test_results[i].result == 0? ("PASS"):("FAIL"));
+
+            if(test_results[i].result != 0)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+int main(void)
+{
+    return test_printResult();
+}
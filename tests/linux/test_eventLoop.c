@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2014-2016 Wilddog Technologies. All Rights Reserved.
+ *
+ * FileName: test_eventLoop.c
+ *
+ * Description: drive the sdk from a poll loop with wilddog_getFds, 
+ *              wilddog_getNextTimeout and wilddog_processFd, instead of
+ *              calling wilddog_trySync.
+ *
+ * History:
+ * Version      Author          Date        Description
+ *
+ * 2.0.2                        2016-10-17  Create file.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <time.h>
+#include "wilddog.h"
+#include "test_config.h"
+
+#define TEST_LOOP_REQ       5
+#define TEST_LOOP_MAXFD     8
+#define TEST_LOOP_TIMEOUT   60
+
+struct test_reult_t
+{
+    char* name;
+    Wilddog_Func_T func;
+    int result;
+};
+
+STATIC int l_test_done = 0;
+
+STATIC void test_onSetFunc(void* arg, Wilddog_Return_T err)
+{
+    l_test_done++;
+}
+
+/*every request must get its callback, and the loop must sleep between
+  events, not spin.*/
+int test_eventLoop()
+{
+    Wilddog_T ref;
+    Wilddog_Node_T *p_node;
+    struct pollfd pfds[TEST_LOOP_MAXFD];
+    int fds[TEST_LOOP_MAXFD];
+    int i, num, ready, res = -1;
+    u32 wakeups = 0;
+    s32 timeout;
+    time_t start;
+
+    ref = wilddog_initWithUrl((Wilddog_Str_T*)TEST_URL"/eventloop");
+    if(0 == ref)
+    {
+        wilddog_debug("new wilddog error");
+        return -1;
+    }
+    for(i = 0; i < TEST_LOOP_REQ; i++)
+    {
+        p_node = wilddog_node_createNum((Wilddog_Str_T*)"count", i);
+        wilddog_setValue(ref, p_node, test_onSetFunc, NULL);
+        wilddog_node_delete(p_node);
+    }
+    start = time(NULL);
+    while(l_test_done < TEST_LOOP_REQ && \
+          time(NULL) - start < TEST_LOOP_TIMEOUT)
+    {
+        num = wilddog_getFds(fds, TEST_LOOP_MAXFD);
+        for(i = 0; i < num; i++)
+        {
+            pfds[i].fd = fds[i];
+            pfds[i].events = POLLIN;
+            pfds[i].revents = 0;
+        }
+        timeout = wilddog_getNextTimeout();
+        ready = poll(pfds, num, timeout);
+        wakeups++;
+        if(ready <= 0)
+        {
+            wilddog_processFd(-1);
+            continue;
+        }
+        for(i = 0; i < num; i++)
+        {
+            if(pfds[i].revents & POLLIN)
+                wilddog_processFd(pfds[i].fd);
+        }
+    }
+    printf("callbacks %d/%d, wakeups %lu in %lds\n", l_test_done, \
+           TEST_LOOP_REQ, (unsigned long)wakeups, (long)(time(NULL) - start));
+    if(TEST_LOOP_REQ == l_test_done)
+        res = 0;
+    wilddog_destroy(&ref);
+    return res;
+}
+
+struct test_reult_t test_results[] =
+{
+    {"wilddog event loop",          (Wilddog_Func_T)test_eventLoop,     0},
+    {NULL, NULL, -1},
+};
+
+int test_printResult()
+{
+    int i;
+    printf("\n\nTest results:\n\n");
+    for(i = 0; i < sizeof(test_results)/ sizeof(struct test_reult_t); i++)
+    {
+        if(test_results[i].name != NULL)
+            test_results[i].result = test_results[i].func();
+    }
+    for(i = 0; i < sizeof(test_results)/ sizeof(struct test_reult_t); i++)
+    {
+        if(test_results[i].name != NULL)
+        {
+            printf("%-32s\t%s\n", test_results[i].name, \
+                    test_results[i].result == 0? ("PASS"):("FAIL"));
+
+            if(test_results[i].result != 0)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+int main(void)
+{
+    return test_printResult();
+}
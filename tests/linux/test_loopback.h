@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2014-2016 Wilddog Technologies. All Rights Reserved.
+ *
+ * FileName: test_loopback.h
+ *
+ * Description: a coap server on the loopback for the tests which need no
+ *              cloud, each test answers the requests in its own handler.
+ *
+ * History:
+ * Version      Author          Date        Description
+ *
+ * 2.0.2                        2016-10-17  Create file.
+ *
+ */
+
+#ifndef _WILDDOG_TEST_LOOPBACK_
+#define _WILDDOG_TEST_LOOPBACK_
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "wilddog.h"
+#include "wilddog_port.h"
+#include "wilddog_protocol.h"
+#include "networking/coap/pdu.h"
+
+#define TEST_LOOPBACK_BUF_LEN   2048
+
+/*answer one request, the pdu is freed after it returns.*/
+typedef void (*Test_Loopback_Handle_T)
+    (
+    coap_pdu_t *req,
+    struct sockaddr_in *p_from
+    );
+
+typedef struct TEST_LOOPBACK_T
+{
+    int fd;
+    struct sockaddr_in addr;
+    Test_Loopback_Handle_T handle;
+}Test_Loopback_T;
+
+STATIC Test_Loopback_T l_test_loopback = {-1};
+
+/*bind the server to a free port of the loopback.*/
+STATIC int test_loopbackOpen(Test_Loopback_Handle_T handle)
+{
+    socklen_t len = sizeof(l_test_loopback.addr);
+
+    memset(&l_test_loopback, 0, sizeof(l_test_loopback));
+    l_test_loopback.handle = handle;
+    l_test_loopback.fd = socket(AF_INET, SOCK_DGRAM, 0);
+    l_test_loopback.addr.sin_family = AF_INET;
+    l_test_loopback.addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if(l_test_loopback.fd < 0 || \
+       bind(l_test_loopback.fd, (struct sockaddr*)&l_test_loopback.addr, \
+            sizeof(l_test_loopback.addr)) < 0 || \
+       getsockname(l_test_loopback.fd, \
+                   (struct sockaddr*)&l_test_loopback.addr, &len) < 0)
+    {
+        wilddog_debug("open loopback server fail");
+        return -1;
+    }
+    return 0;
+}
+
+STATIC void test_loopbackClose(void)
+{
+    if(l_test_loopback.fd >= 0)
+        close(l_test_loopback.fd);
+    l_test_loopback.fd = -1;
+}
+
+/*turn the socket of the protocol to the server.*/
+STATIC void test_loopbackConnect(Wilddog_Protocol_T *p_proto)
+{
+    p_proto->addr.len = 4;
+    memcpy(p_proto->addr.ip, &l_test_loopback.addr.sin_addr.s_addr, 4);
+    p_proto->addr.port = ntohs(l_test_loopback.addr.sin_port);
+    wilddog_connectSocket(p_proto->socketFd, &p_proto->addr);
+}
+
+STATIC void test_loopbackSend(coap_pdu_t *resp, struct sockaddr_in *p_to)
+{
+    sendto(l_test_loopback.fd, resp->hdr, resp->length, 0, \
+           (struct sockaddr*)p_to, sizeof(struct sockaddr_in));
+}
+
+/*handle all the requests queued, return how many came.*/
+STATIC int test_loopbackStep(void)
+{
+    u8 buf[TEST_LOOPBACK_BUF_LEN];
+    struct sockaddr_in from;
+    socklen_t fromLen;
+    int len, num = 0;
+    coap_pdu_t *req;
+
+    while(1)
+    {
+        fromLen = sizeof(from);
+        len = recvfrom(l_test_loopback.fd, buf, sizeof(buf), MSG_DONTWAIT, \
+                       (struct sockaddr*)&from, &fromLen);
+        if(len <= 0)
+            break;
+        num++;
+        req = coap_pdu_init(0, 0, 0, len);
+        if(req && coap_pdu_parse(buf, len, req))
+            l_test_loopback.handle(req, &from);
+        coap_delete_pdu(req);
+    }
+    return num;
+}
+
+#endif /*_WILDDOG_TEST_LOOPBACK_*/
+
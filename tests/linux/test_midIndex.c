@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2014-2016 Wilddog Technologies. All Rights Reserved.
+ *
+ * FileName: test_midIndex.c
+ *
+ * Description: message id index tests and lookup benchmark, compare with
+ *              walking the packet list, no server needed.
+ *
+ * History:
+ * Version      Author          Date        Description
+ *
+ * 2.0.2                        2016-10-16  Create file.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "wilddog.h"
+#include "wilddog_conn.h"
+#include "utlist.h"
+
+#define TEST_MIDINDEX_LOOKUPS 1000
+
+struct test_reult_t
+{
+    char* name;
+    Wilddog_Func_T func;
+    int result;
+};
+
+STATIC const u32 l_test_num[] = {10, 100, 1000, 10000, 100000};
+
+STATIC u32 test_usec(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (u32)(tv.tv_sec * 1000000 + tv.tv_usec);
+}
+
+/*same shape as coap token, random high bits and mid in the low byte.*/
+STATIC u32 test_mid(u32 i)
+{
+    return (((u32)rand() << 8) ^ (i << 8)) | (i & 0xff) | 0x100;
+}
+
+STATIC Wilddog_Conn_Pkt_T *test_listFind(Wilddog_Conn_Pkt_T *p_head, u32 mid)
+{
+    Wilddog_Conn_Pkt_T *curr;
+    LL_FOREACH(p_head, curr){
+        if(mid == curr->d_message_id)
+            return curr;
+    }
+    return NULL;
+}
+
+/*add, find and remove must keep every packet reachable.*/
+int test_midIndexFind()
+{
+    Wilddog_Conn_T conn;
+    Wilddog_Conn_Pkt_T *pkts;
+    u32 i, num = 5000;
+    int res = -1;
+
+    memset(&conn, 0, sizeof(conn));
+    pkts = (Wilddog_Conn_Pkt_T*)calloc(num, sizeof(Wilddog_Conn_Pkt_T));
+    if(NULL == pkts)
+    {
+        wilddog_debug("malloc %lu packets fail", (unsigned long)num);
+        return -1;
+    }
+    for(i = 0; i < num; i++){
+        pkts[i].d_message_id = i + 1;
+        if(_wilddog_conn_midIndex_add(&conn, &pkts[i]) != WILDDOG_ERR_NOERR)
+            goto end;
+    }
+    /*remove the odd ones, then add them again, deleted slots are reused*/
+    for(i = 1; i < num; i += 2)
+        _wilddog_conn_midIndex_remove(&conn, &pkts[i]);
+    for(i = 0; i < num; i++){
+        if(_wilddog_conn_midIndex_find(&conn, i + 1) != \
+           ((i & 1)? NULL : &pkts[i]))
+            goto end;
+    }
+    for(i = 1; i < num; i += 2)
+        _wilddog_conn_midIndex_add(&conn, &pkts[i]);
+    for(i = 0; i < num; i++){
+        if(_wilddog_conn_midIndex_find(&conn, i + 1) != &pkts[i])
+            goto end;
+    }
+    if(_wilddog_conn_midIndex_find(&conn, num + 1) != NULL || \
+       conn.d_mid_index.d_num != num)
+        goto end;
+    res = 0;
+end:
+    _wilddog_conn_midIndex_deinit(&conn);
+    free(pkts);
+    return res;
+}
+
+/*lookup cost from 10 to 100k packets in flight, list walk vs index.*/
+int test_midIndexBench()
+{
+    Wilddog_Conn_T conn;
+    Wilddog_Conn_Pkt_T *pkts, *p_head;
+    u32 n, i, num, start, listTime, indexTime;
+    int res = 0;
+
+    printf("\n%-10s%-18s%-18s\n", "packets", "list(ns/find)", "index(ns/find)");
+    for(n = 0; n < sizeof(l_test_num) / sizeof(u32); n++){
+        num = l_test_num[n];
+        memset(&conn, 0, sizeof(conn));
+        p_head = NULL;
+        pkts = (Wilddog_Conn_Pkt_T*)calloc(num, sizeof(Wilddog_Conn_Pkt_T));
+        if(NULL == pkts)
+            return -1;
+        for(i = 0; i < num; i++){
+            pkts[i].d_message_id = test_mid(i);
+            LL_PREPEND(p_head, &pkts[i]);
+            _wilddog_conn_midIndex_add(&conn, &pkts[i]);
+        }
+        start = test_usec();
+        for(i = 0; i < TEST_MIDINDEX_LOOKUPS; i++){
+            u32 mid = pkts[(i * 7919) % num].d_message_id;
+            if(test_listFind(p_head, mid)->d_message_id != mid)
+                res = -1;
+        }
+        listTime = test_usec() - start;
+        start = test_usec();
+        for(i = 0; i < TEST_MIDINDEX_LOOKUPS; i++){
+            u32 mid = pkts[(i * 7919) % num].d_message_id;
+            if(_wilddog_conn_midIndex_find(&conn, mid)->d_message_id != mid)
+                res = -1;
+        }
+        indexTime = test_usec() - start;
+        printf("%-10lu%-18lu%-18lu\n", (unsigned long)num, \
+               (unsigned long)listTime * 1000 / TEST_MIDINDEX_LOOKUPS, \
+               (unsigned long)indexTime * 1000 / TEST_MIDINDEX_LOOKUPS);
+        _wilddog_conn_midIndex_deinit(&conn);
+        free(pkts);
+    }
+    return res;
+}
+
+struct test_reult_t test_results[] =
+{
+    {"mid index find",              (Wilddog_Func_T)test_midIndexFind,  0},
+    {"mid index benchmark",         (Wilddog_Func_T)test_midIndexBench, 0},
+    {NULL, NULL, -1},
+};
+
+int test_printResult()
+{
+    int i;
+    printf("\n\nTest results:\n\n");
+    for(i = 0; i < sizeof(test_results)/ sizeof(struct test_reult_t); i++)
+    {
+        if(test_results[i].name != NULL)
+            test_results[i].result = test_results[i].func();
+    }
+    for(i = 0; i < sizeof(test_results)/ sizeof(struct test_reult_t); i++)
+    {
+        if(test_results[i].name != NULL)
+        {
+            printf("%-32s\t%s\n", test_results[i].name, \
+                    test_results[i].result == 0? ("PASS"):("FAIL"));
+
+            if(test_results[i].result != 0)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+int main(void)
+{
+    return test_printResult();
+}
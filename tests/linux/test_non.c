@@ -0,0 +1,332 @@
+/*
+ * Copyright (C) 2014-2016 Wilddog Technologies. All Rights Reserved.
+ *
+ * FileName: test_non.c
+ *
+ * Description: benchmark of writes sent as non-confirmable, compare with
+ *              confirmable ones kept until acked, a loopback server acks
+ *              the confirmable writes, no cloud needed. A write failed 
+ *              locally must call its callback once, in threaded mode too.
+ *
+ * History:
+ * Version      Author          Date        Description
+ *
+ * 2.0.2                        2016-10-17  Create file.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "wilddog.h"
+#include "wilddog_port.h"
+#include "wilddog_conn.h"
+#include "wilddog_protocol.h"
+#include "networking/coap/option.h"
+#include "test_loopback.h"
+
+#define TEST_NON_WRITES     5000
+/*confirmable writes in flight, like the conn layer queue*/
+#define TEST_NON_WINDOW     32
+#define TEST_NON_PAYLOAD    24
+#define TEST_NON_FAIL_URL   "coap://test.wilddogio.com/sensor/temp"
+
+extern size_t _wilddog_protocol_ioctl(Wilddog_Proto_Cmd_T cmd, void *p_args, \
+                                      int flags);
+
+struct test_reult_t
+{
+    char* name;
+    Wilddog_Func_T func;
+    int result;
+};
+
+typedef struct TEST_NON_SERVER_T
+{
+    int con;
+    int non;
+}Test_Non_Server_T;
+
+STATIC Test_Non_Server_T l_test_server;
+STATIC Wilddog_Protocol_T l_test_proto;
+STATIC Wilddog_Url_Cache_T l_test_cache;
+STATIC Wilddog_Url_T l_test_url = {(Wilddog_Str_T*)"test.wilddogio.com", \
+                                   (Wilddog_Str_T*)"/sensor/temp", NULL, \
+                                   &l_test_cache};
+STATIC u8 l_test_sid[WILDDOG_CONN_SESSION_SHORT_LEN] = "12345678";
+STATIC u8 l_test_payload[TEST_NON_PAYLOAD];
+/*callbacks of the failed writes, set in the i/o thread in threaded mode*/
+STATIC volatile int l_test_setFails = 0;
+STATIC volatile int l_test_pushFails = 0;
+STATIC volatile BOOL l_test_isPathNull = TRUE;
+
+STATIC u32 test_usec(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (u32)(tv.tv_sec * 1000000 + tv.tv_usec);
+}
+
+/*count the writes, ack the confirmable ones with 2.04.*/
+STATIC void test_serverHandle
+    (
+    coap_pdu_t *req,
+    struct sockaddr_in *p_from
+    )
+{
+    coap_pdu_t *resp;
+
+    if(COAP_MESSAGE_NON == req->hdr->type)
+        l_test_server.non++;
+    else if(COAP_MESSAGE_CON == req->hdr->type)
+    {
+        l_test_server.con++;
+        resp = coap_pdu_init(COAP_MESSAGE_ACK, COAP_RESPONSE_CODE(204), \
+                             req->hdr->id, 32);
+        if(resp)
+        {
+            coap_add_token(resp, req->hdr->token_length, req->hdr->token);
+            test_loopbackSend(resp, p_from);
+            coap_delete_pdu(resp);
+        }
+    }
+}
+
+STATIC int test_open(void)
+{
+    memset(&l_test_server, 0, sizeof(l_test_server));
+    memset(l_test_payload, 0xa5, sizeof(l_test_payload));
+    memset(&l_test_proto, 0, sizeof(l_test_proto));
+    l_test_proto.callback = (Wilddog_Func_T)_wilddog_protocol_ioctl;
+    if(test_loopbackOpen(test_serverHandle) < 0 || \
+       wilddog_openSocket(&l_test_proto.socketFd) < 0)
+        return -1;
+    test_loopbackConnect(&l_test_proto);
+    return 0;
+}
+
+STATIC void test_close(void)
+{
+    wilddog_closeSocket(l_test_proto.socketFd);
+    test_loopbackClose();
+    if(l_test_cache.p_data)
+        wfree(l_test_cache.p_data);
+    memset(&l_test_cache, 0, sizeof(l_test_cache));
+}
+
+STATIC void test_initCommand(Wilddog_Proto_Cmd_Arg_T *p_command, u32 *p_token)
+{
+    memset(p_command, 0, sizeof(Wilddog_Proto_Cmd_Arg_T));
+    p_command->protocol = &l_test_proto;
+    p_command->p_data = l_test_payload;
+    p_command->d_data_len = sizeof(l_test_payload);
+    p_command->p_url = &l_test_url;
+    p_command->p_message_id = p_token;
+    p_command->p_session_info = l_test_sid;
+    p_command->d_session_len = WILDDOG_CONN_SESSION_SHORT_LEN - 1;
+}
+
+/*receive and release the acks, like the conn layer does, count them.*/
+STATIC int test_recvAcks(int expect)
+{
+    Wilddog_Proto_Cmd_Arg_T command;
+    u8 *p_recv = NULL, *payload = NULL;
+    u32 token = 0, recv_len = 0, payload_len = 0;
+    int acks = 0;
+
+    test_initCommand(&command, &token);
+    while(acks < expect)
+    {
+        command.p_out_data = &p_recv;
+        command.p_out_data_len = &recv_len;
+        if(WILDDOG_ERR_NOERR != \
+           _wilddog_protocol_ioctl(WD_PROTO_CMD_RECV_GETPKT, &command, 0))
+            break;
+        command.p_data = p_recv;
+        command.d_data_len = recv_len;
+        command.p_out_data = &payload;
+        command.p_out_data_len = &payload_len;
+        if(WILDDOG_HTTP_NO_CONTENT == \
+           _wilddog_protocol_ioctl(WD_PROTO_CMD_RECV_HANDLEPKT, &command, 0))
+            acks++;
+        command.p_data = p_recv;
+        _wilddog_protocol_ioctl(WD_PROTO_CMD_RECV_FREEPKT, &command, TRUE);
+    }
+    return acks;
+}
+
+/*writes per second, confirmable ones are kept until the ack comes.*/
+int test_nonBench()
+{
+    Wilddog_Proto_Cmd_Arg_T command;
+    Wilddog_Conn_Pkt_Data_T *window[TEST_NON_WINDOW];
+    u32 token = 0, i, start, conTime, nonTime;
+    int j, inflight = 0, acks = 0, res = -1;
+
+    if(0 != test_open())
+        goto end;
+
+    /*before: every write is kept and waits for its ack*/
+    test_initCommand(&command, &token);
+    start = test_usec();
+    for(i = 0; i < TEST_NON_WRITES; i++)
+    {
+        window[inflight] = (Wilddog_Conn_Pkt_Data_T*) \
+                            wmalloc(sizeof(Wilddog_Conn_Pkt_Data_T));
+        if(NULL == window[inflight])
+            goto end;
+        command.p_out_data = (u8**)&window[inflight];
+        if(WILDDOG_ERR_NOERR != \
+           _wilddog_protocol_ioctl(WD_PROTO_CMD_SEND_SET, &command, TRUE))
+        {
+            wfree(window[inflight]);
+            goto end;
+        }
+        if(++inflight < TEST_NON_WINDOW && i + 1 < TEST_NON_WRITES)
+            continue;
+        test_loopbackStep();
+        acks += test_recvAcks(inflight);
+        for(j = 0; j < inflight; j++)
+        {
+            coap_delete_pdu((coap_pdu_t*)window[j]->data);
+            wfree(window[j]);
+        }
+        inflight = 0;
+    }
+    conTime = test_usec() - start;
+
+    /*after: sent once, nothing kept*/
+    test_initCommand(&command, &token);
+    start = test_usec();
+    for(i = 0; i < TEST_NON_WRITES; i++)
+    {
+        if(WILDDOG_ERR_NOERR != \
+           _wilddog_protocol_ioctl(WD_PROTO_CMD_SEND_SET_NON, &command, TRUE))
+            goto end;
+        /*drain as often, so loopback does not drop them*/
+        if(0 == (i + 1) % TEST_NON_WINDOW)
+            test_loopbackStep();
+    }
+    test_loopbackStep();
+    nonTime = test_usec() - start;
+
+    printf("\n%-14s%-20s%-10s\n", "write as", "writes/sec", "received");
+    printf("%-14s%-20lu%-10d\n", "con", \
+           (unsigned long)(TEST_NON_WRITES * 1000000.0 / (conTime + 1)), acks);
+    printf("%-14s%-20lu%-10d\n", "non", \
+           (unsigned long)(TEST_NON_WRITES * 1000000.0 / (nonTime + 1)), \
+           l_test_server.non);
+    /*loopback may drop some, but most must arrive*/
+    if(acks > TEST_NON_WRITES / 2 && l_test_server.non > TEST_NON_WRITES / 2)
+        res = 0;
+end:
+    test_close();
+    return res;
+}
+
+STATIC void test_onSetFail(void* arg, Wilddog_Return_T err)
+{
+    if(err < 0)
+        l_test_setFails++;
+}
+
+STATIC void test_onPushFail
+    (
+    Wilddog_Str_T *p_newPath,
+    void* arg,
+    Wilddog_Return_T err
+    )
+{
+    if(p_newPath)
+        l_test_isPathNull = FALSE;
+    if(err < 0)
+        l_test_pushFails++;
+}
+
+/*
+ * the client never authed, so the writes fail locally, every callback is 
+ * called once, the push gets no path. In threaded mode the api returns at
+ * once and only the callback reports the failure.
+ */
+int test_nonFail()
+{
+    Wilddog_T wilddog;
+    Wilddog_Node_T *p_node;
+    int i, res = -1;
+
+    l_test_setFails = 0;
+    l_test_pushFails = 0;
+    l_test_isPathNull = TRUE;
+    wilddog = wilddog_initWithUrl((Wilddog_Str_T*)TEST_NON_FAIL_URL);
+    p_node = wilddog_node_createUString(NULL, (Wilddog_Str_T*)"25.5");
+    if(0 == wilddog || NULL == p_node)
+        goto end;
+    if(WILDDOG_ERR_NOERR == \
+       wilddog_setValueNon(wilddog, p_node, test_onSetFail, NULL) || \
+       WILDDOG_ERR_NOERR == \
+       wilddog_pushNon(wilddog, p_node, test_onPushFail, NULL))
+        goto end;
+    if(1 != l_test_setFails || 1 != l_test_pushFails)
+        goto end;
+    if(WILDDOG_ERR_NOERR == wilddog_startThread())
+    {
+        if(WILDDOG_ERR_NOERR != \
+           wilddog_setValueNon(wilddog, p_node, test_onSetFail, NULL) || \
+           WILDDOG_ERR_NOERR != \
+           wilddog_pushNon(wilddog, p_node, test_onPushFail, NULL))
+        {
+            wilddog_stopThread();
+            goto end;
+        }
+        for(i = 0; i < 100 && (l_test_setFails < 2 || l_test_pushFails < 2);\
+            i++)
+            usleep(10000);
+        wilddog_stopThread();
+        if(2 != l_test_setFails || 2 != l_test_pushFails)
+            goto end;
+    }
+    if(TRUE == l_test_isPathNull)
+        res = 0;
+end:
+    if(p_node)
+        wilddog_node_delete(p_node);
+    if(wilddog)
+        wilddog_destroy(&wilddog);
+    return res;
+}
+
+struct test_reult_t test_results[] =
+{
+    {"coap non write benchmark",    (Wilddog_Func_T)test_nonBench,      0},
+    {"coap non write local failure",(Wilddog_Func_T)test_nonFail,       0},
+    {NULL, NULL, -1},
+};
+
+int test_printResult()
+{
+    int i;
+    printf("\n\nTest results:\n\n");
+    for(i = 0; i < sizeof(test_results)/ sizeof(struct test_reult_t); i++)
+    {
+        if(test_results[i].name != NULL)
+            test_results[i].result = test_results[i].func();
+    }
+    for(i = 0; i < sizeof(test_results)/ sizeof(struct test_reult_t); i++)
+    {
+        if(test_results[i].name != NULL)
+        {
+            printf("%-32s\t%s\n", test_results[i].name, \
+                    test_results[i].result == 0? ("PASS"):("FAIL"));
+
+            if(test_results[i].result != 0)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+int main(void)
+{
+    return test_printResult();
+}
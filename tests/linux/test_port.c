@@ -0,0 +1,513 @@
+/*
+ * Copyright (C) 2014-2016 Wilddog Technologies. All Rights Reserved.
+ *
+ * FileName: test_port.c
+ *
+ * Description: port layer tests over loopback, no server needed.
+ *
+ * History:
+ * Version      Author          Date        Description
+ *
+ * 2.0.2                        2016-10-16  Create file.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+#include "wilddog.h"
+#include "wilddog_port.h"
+
+#define TEST_PORT_BURST 40
+#define TEST_PORT_LARGE (WILDDOG_RECV_BATCH_SLOTSIZE * 3)
+
+struct test_reult_t
+{
+    char* name;
+    Wilddog_Func_T func;
+    int result;
+};
+
+/*
+ * open a loopback "server" socket, and a sdk socket which has sent one
+ * datagram to it, so the server knows where to reply.
+*/
+STATIC int test_port_pair
+    (
+    int *p_server,
+    int *p_client,
+    Wilddog_Address_T *p_addr,
+    struct sockaddr_in *p_clientAddr
+    )
+{
+    struct sockaddr_in servaddr;
+    socklen_t len = sizeof(servaddr);
+    char buf[16];
+
+    *p_server = socket(AF_INET, SOCK_DGRAM, 0);
+    if(*p_server < 0)
+    {
+        wilddog_debug("open loopback socket fail");
+        return -1;
+    }
+    memset(&servaddr, 0, sizeof(servaddr));
+    servaddr.sin_family = AF_INET;
+    servaddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if(bind(*p_server, (struct sockaddr*)&servaddr, sizeof(servaddr)) < 0 || \
+       getsockname(*p_server, (struct sockaddr*)&servaddr, &len) < 0)
+    {
+        close(*p_server);
+        return -1;
+    }
+    p_addr->len = 4;
+    memcpy(p_addr->ip, &servaddr.sin_addr.s_addr, 4);
+    p_addr->port = ntohs(servaddr.sin_port);
+
+    if(0 != wilddog_openSocket(p_client))
+    {
+        close(*p_server);
+        return -1;
+    }
+    if(wilddog_send(*p_client, p_addr, "hello", 5) != 5)
+        goto err;
+    len = sizeof(struct sockaddr_in);
+    if(recvfrom(*p_server, buf, sizeof(buf), 0, \
+                (struct sockaddr*)p_clientAddr, &len) != 5)
+        goto err;
+    return 0;
+err:
+    wilddog_closeSocket(*p_client);
+    close(*p_server);
+    return -1;
+}
+
+/*a burst of datagrams must be drained by one wait and batched receives.*/
+int test_recvBatch()
+{
+    int server, client, i, res = -1, got = 0, pending;
+    int ready[4];
+    Wilddog_Address_T addr;
+    struct sockaddr_in clientAddr;
+    u8 buf[2048];
+
+    if(test_port_pair(&server, &client, &addr, &clientAddr) < 0)
+        return -1;
+    for(i = 0; i < TEST_PORT_BURST; i++)
+    {
+        sendto(server, &i, sizeof(i), 0, \
+               (struct sockaddr*)&clientAddr, sizeof(clientAddr));
+    }
+    if(wilddog_waitSockets(ready, 4, 100) != 1 || ready[0] != client)
+        goto end;
+
+    if(wilddog_receive(client, &addr, buf, sizeof(buf), 100) != sizeof(int))
+        goto end;
+    got++;
+    /*the first receive must have staged more datagrams*/
+    if(wilddog_receivePending(client) <= 0)
+        goto end;
+    while((pending = wilddog_receivePending(client)) > 0)
+    {
+        if(wilddog_receive(client, &addr, buf, sizeof(buf), 100) != sizeof(int))
+            goto end;
+        if(*(int*)buf != got)
+            goto end;
+        got++;
+    }
+    if(got == TEST_PORT_BURST)
+        res = 0;
+end:
+    wilddog_closeSocket(client);
+    close(server);
+    return res;
+}
+
+/*a datagram larger than a slot, after the first one, must be kept whole.*/
+int test_recvLarge()
+{
+    int server, client, i, res = -1;
+    int ready[4];
+    Wilddog_Address_T addr;
+    struct sockaddr_in clientAddr;
+    u8 big[TEST_PORT_LARGE], buf[TEST_PORT_LARGE + 16];
+
+    if(test_port_pair(&server, &client, &addr, &clientAddr) < 0)
+        return -1;
+    for(i = 0; i < sizeof(big); i++)
+        big[i] = (u8)i;
+    i = 1;
+    sendto(server, &i, sizeof(i), 0, \
+           (struct sockaddr*)&clientAddr, sizeof(clientAddr));
+    sendto(server, big, sizeof(big), 0, \
+           (struct sockaddr*)&clientAddr, sizeof(clientAddr));
+    i = 2;
+    sendto(server, &i, sizeof(i), 0, \
+           (struct sockaddr*)&clientAddr, sizeof(clientAddr));
+    if(wilddog_waitSockets(ready, 4, 100) != 1 || ready[0] != client)
+        goto end;
+
+    if(wilddog_receive(client, &addr, buf, sizeof(buf), 100) != sizeof(int) || \
+       *(int*)buf != 1)
+        goto end;
+    /*the large one is staged, not truncated*/
+    if(wilddog_receivePending(client) != 2 || \
+       wilddog_receiveSize(client, 100) != sizeof(big))
+        goto end;
+    if(wilddog_receive(client, &addr, buf, sizeof(buf), 100) != sizeof(big) || \
+       memcmp(buf, big, sizeof(big)))
+        goto end;
+    if(wilddog_receive(client, &addr, buf, sizeof(buf), 100) != sizeof(int) || \
+       *(int*)buf != 2)
+        goto end;
+    res = 0;
+end:
+    wilddog_closeSocket(client);
+    close(server);
+    return res;
+}
+
+/*the size is known before reading, from the socket or from the staged ones.*/
+int test_recvSize()
+{
+    int server, client, res = -1;
+    Wilddog_Address_T addr;
+    struct sockaddr_in clientAddr;
+    u8 buf[1500];
+
+    if(test_port_pair(&server, &client, &addr, &clientAddr) < 0)
+        return -1;
+    if(wilddog_receiveSize(client, 10) >= 0)
+        goto end;
+    memset(buf, 0, sizeof(buf));
+    sendto(server, buf, 100, 0, \
+           (struct sockaddr*)&clientAddr, sizeof(clientAddr));
+    sendto(server, buf, 1400, 0, \
+           (struct sockaddr*)&clientAddr, sizeof(clientAddr));
+    usleep(10000);
+
+    /*peeking twice does not consume it*/
+    if(wilddog_receiveSize(client, 100) != 100 || \
+       wilddog_receiveSize(client, 100) != 100)
+        goto end;
+    if(wilddog_receive(client, &addr, buf, 100, 100) != 100)
+        goto end;
+    if(wilddog_receiveSize(client, 100) != 1400 || \
+       wilddog_receive(client, &addr, buf, 1400, 100) != 1400)
+        goto end;
+    res = 0;
+end:
+    wilddog_closeSocket(client);
+    close(server);
+    return res;
+}
+
+/*staged datagrams from other address must be dropped.*/
+int test_recvFilter()
+{
+    int server, client, other, res = -1, value = 1;
+    Wilddog_Address_T addr;
+    struct sockaddr_in clientAddr;
+    u8 buf[2048];
+
+    if(test_port_pair(&server, &client, &addr, &clientAddr) < 0)
+        return -1;
+    other = socket(AF_INET, SOCK_DGRAM, 0);
+    sendto(other, &value, sizeof(value), 0, \
+           (struct sockaddr*)&clientAddr, sizeof(clientAddr));
+    sendto(other, &value, sizeof(value), 0, \
+           (struct sockaddr*)&clientAddr, sizeof(clientAddr));
+    value = 2;
+    sendto(server, &value, sizeof(value), 0, \
+           (struct sockaddr*)&clientAddr, sizeof(clientAddr));
+    usleep(10000);
+
+    /*first one is from other, rejected, server's is staged*/
+    if(wilddog_receive(client, &addr, buf, sizeof(buf), 100) >= 0)
+        goto end;
+    if(wilddog_receive(client, &addr, buf, sizeof(buf), 100) != sizeof(int) || \
+       *(int*)buf != 2)
+        goto end;
+    res = 0;
+end:
+    close(other);
+    wilddog_closeSocket(client);
+    close(server);
+    return res;
+}
+
+/*connected socket, the kernel drops the other's datagrams, send and staging
+  still reach the server.*/
+int test_connected()
+{
+    int server, client, other, i, res = -1, value = 1;
+    Wilddog_Address_T addr;
+    struct sockaddr_in clientAddr;
+    u8 buf[2048];
+
+    if(test_port_pair(&server, &client, &addr, &clientAddr) < 0)
+        return -1;
+    other = socket(AF_INET, SOCK_DGRAM, 0);
+    if(wilddog_connectSocket(client, &addr) < 0)
+        goto end;
+    sendto(other, &value, sizeof(value), 0, \
+           (struct sockaddr*)&clientAddr, sizeof(clientAddr));
+    value = 2;
+    sendto(server, &value, sizeof(value), 0, \
+           (struct sockaddr*)&clientAddr, sizeof(clientAddr));
+    usleep(10000);
+    if(wilddog_receive(client, &addr, buf, sizeof(buf), 100) != sizeof(int) || \
+       *(int*)buf != 2 || wilddog_receivePending(client) != 0)
+        goto end;
+    if(wilddog_send(client, &addr, &value, sizeof(value)) != sizeof(value) || \
+       recv(server, &value, sizeof(value), 0) != sizeof(value) || value != 2)
+        goto end;
+    wilddog_sendStageBegin();
+    for(i = 0; i < 3; i++)
+        wilddog_send(client, &addr, &i, sizeof(i));
+    if(wilddog_sendStageFlush() != 3)
+        goto end;
+    for(i = 0; i < 3; i++)
+    {
+        if(recv(server, &value, sizeof(value), 0) != sizeof(value) || \
+           value != i)
+            goto end;
+    }
+    res = 0;
+end:
+    close(other);
+    wilddog_closeSocket(client);
+    close(server);
+    return res;
+}
+
+/*datagrams sent while staging must wait for the flush, and keep order.*/
+int test_sendStage()
+{
+    int server, client, i, res = -1, value;
+    Wilddog_Address_T addr;
+    struct sockaddr_in clientAddr;
+
+    if(test_port_pair(&server, &client, &addr, &clientAddr) < 0)
+        return -1;
+    if(wilddog_sendStageBegin() < 0)
+        goto end;
+    for(i = 0; i < 5; i++)
+    {
+        if(wilddog_send(client, &addr, &i, sizeof(i)) != sizeof(i))
+            goto end;
+    }
+    if(wilddog_sendStageCount() != 5)
+        goto end;
+    if(recv(server, &value, sizeof(value), MSG_DONTWAIT) >= 0)
+        goto end;
+    if(wilddog_sendStageFlush() != 5 || wilddog_sendStageCount() != 0)
+        goto end;
+    for(i = 0; i < 5; i++)
+    {
+        if(recv(server, &value, sizeof(value), 0) != sizeof(value) || \
+           value != i)
+            goto end;
+    }
+    /*not staging any more, send at once*/
+    if(wilddog_send(client, &addr, &i, sizeof(i)) != sizeof(i) || \
+       wilddog_sendStageCount() != 0)
+        goto end;
+    if(recv(server, &value, sizeof(value), 0) != sizeof(value) || value != i)
+        goto end;
+    res = 0;
+end:
+    wilddog_sendStageFlush();
+    wilddog_closeSocket(client);
+    close(server);
+    return res;
+}
+
+/*a blocking receive must flush the staged request first.*/
+int test_sendStageRecv()
+{
+    int server, client, res = -1, value = 7;
+    Wilddog_Address_T addr;
+    struct sockaddr_in clientAddr;
+    socklen_t len = sizeof(clientAddr);
+    u8 buf[64];
+
+    if(test_port_pair(&server, &client, &addr, &clientAddr) < 0)
+        return -1;
+    wilddog_sendStageBegin();
+    wilddog_send(client, &addr, &value, sizeof(value));
+    /*nothing arrives, but the request must have gone out*/
+    wilddog_receive(client, &addr, buf, sizeof(buf), 10);
+    if(wilddog_sendStageCount() != 0)
+        goto end;
+    if(recvfrom(server, &value, sizeof(value), MSG_DONTWAIT, \
+                (struct sockaddr*)&clientAddr, &len) != sizeof(value) || \
+       value != 7)
+        goto end;
+    res = 0;
+end:
+    wilddog_sendStageFlush();
+    wilddog_closeSocket(client);
+    close(server);
+    return res;
+}
+
+/*background resolving must give the address without blocking the caller.*/
+int test_resolve()
+{
+    Wilddog_Address_T addrs[WILDDOG_DNS_MAX_ADDR];
+    void *query;
+    u32 ttl = 1;
+    int res, i;
+    u8 loopback[4] = {127, 0, 0, 1};
+    u8 loopback6[16] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1};
+
+    query = wilddog_resolveStart("localhost");
+    if(NULL == query)
+        return -1;
+    res = wilddog_resolvePoll(query, addrs, WILDDOG_DNS_MAX_ADDR, &ttl, 5000);
+    if(res <= 0)
+        return -1;
+    /*127.0.0.1 or ::1, depends on the configured families*/
+    for(i = 0; i < res; i++)
+    {
+        if((4 == addrs[i].len && 0 == memcmp(addrs[i].ip, loopback, 4)) || \
+           (16 == addrs[i].len && 0 == memcmp(addrs[i].ip, loopback6, 16)))
+            break;
+    }
+    if(i == res)
+        return -1;
+    /*a cancelled query is freed by the resolver*/
+    query = wilddog_resolveStart("localhost");
+    if(NULL == query)
+        return -1;
+    wilddog_resolveCancel(query);
+    return 0;
+}
+
+STATIC void* test_raceEcho(void* arg)
+{
+    int fd = *(int*)arg;
+    struct sockaddr_storage from;
+    socklen_t len = sizeof(from);
+    char buf[16];
+    ssize_t n;
+
+    n = recvfrom(fd, buf, sizeof(buf), 0, (struct sockaddr*)&from, &len);
+    if(n > 0)
+        sendto(fd, buf, n, 0, (struct sockaddr*)&from, len);
+    return NULL;
+}
+
+/*
+ * the first address never answers, the second one must win the race, in
+ * background the race is polled and never blocks the caller.
+ */
+STATIC int test_race(BOOL isBackground)
+{
+    Wilddog_Address_T addrs[2];
+    struct sockaddr_in servaddr;
+    socklen_t len;
+    void *race;
+    int fds[2] = {-1, -1}, i, polls = 0, res = -1;
+    pthread_t echo;
+    u8 ping[4] = {0x40, 0, 0x12, 0x34};
+
+    for(i = 0; i < 2; i++)
+    {
+        fds[i] = socket(AF_INET, SOCK_DGRAM, 0);
+        memset(&servaddr, 0, sizeof(servaddr));
+        servaddr.sin_family = AF_INET;
+        servaddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        len = sizeof(servaddr);
+        if(fds[i] < 0 || \
+           bind(fds[i], (struct sockaddr*)&servaddr, sizeof(servaddr)) < 0 || \
+           getsockname(fds[i], (struct sockaddr*)&servaddr, &len) < 0)
+            goto end;
+        addrs[i].len = 4;
+        memcpy(addrs[i].ip, &servaddr.sin_addr.s_addr, 4);
+        addrs[i].port = ntohs(servaddr.sin_port);
+    }
+    if(pthread_create(&echo, NULL, test_raceEcho, &fds[1]))
+        goto end;
+    if(FALSE == isBackground)
+        res = wilddog_raceAddress(addrs, 2, ping, sizeof(ping), 50, 2000);
+    else
+    {
+        race = wilddog_raceStart(addrs, 2, ping, sizeof(ping), 50, 2000);
+        while(race && 0 == wilddog_racePoll(race, &res))
+        {
+            polls++;
+            usleep(5000);
+        }
+        /*the reply comes after the second probe, at least 50ms later*/
+        if(NULL == race || 0 == polls)
+            res = -1;
+    }
+    pthread_join(echo, NULL);
+    res = (1 == res) ? 0 : -1;
+end:
+    for(i = 0; i < 2; i++)
+    {
+        if(fds[i] >= 0)
+            close(fds[i]);
+    }
+    return res;
+}
+
+int test_raceAddress()
+{
+    return test_race(FALSE);
+}
+
+int test_raceStart()
+{
+    return test_race(TRUE);
+}
+
+struct test_reult_t test_results[] =
+{
+    {"wilddog_receive batch",       (Wilddog_Func_T)test_recvBatch,     0},
+    {"wilddog_receive large",       (Wilddog_Func_T)test_recvLarge,     0},
+    {"wilddog_receive filter",      (Wilddog_Func_T)test_recvFilter,    0},
+    {"wilddog_receiveSize",         (Wilddog_Func_T)test_recvSize,      0},
+    {"wilddog_send stage",          (Wilddog_Func_T)test_sendStage,     0},
+    {"wilddog_send stage receive",  (Wilddog_Func_T)test_sendStageRecv, 0},
+    {"wilddog_connectSocket",       (Wilddog_Func_T)test_connected,     0},
+    {"wilddog_resolve",             (Wilddog_Func_T)test_resolve,       0},
+    {"wilddog_raceAddress",         (Wilddog_Func_T)test_raceAddress,   0},
+    {"wilddog_raceStart",           (Wilddog_Func_T)test_raceStart,     0},
+    {NULL, NULL, -1},
+};
+
+int test_printResult()
+{
+    int i;
+    printf("\n\nTest results:\n\n");
+    for(i = 0; i < sizeof(test_results)/ sizeof(struct test_reult_t); i++)
+    {
+        if(test_results[i].name != NULL)
+            test_results[i].result = test_results[i].func();
+    }
+    for(i = 0; i < sizeof(test_results)/ sizeof(struct test_reult_t); i++)
+    {
+        if(test_results[i].name != NULL)
+        {
+            printf("%-32s\t%s\n", test_results[i].name, \
+                    test_results[i].result == 0? ("PASS"):("FAIL"));
+
+            if(test_results[i].result != 0)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+int main(void)
+{
+    return test_printResult();
+}
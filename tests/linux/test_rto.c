@@ -0,0 +1,319 @@
+/*
+ * Copyright (C) 2014-2016 Wilddog Technologies. All Rights Reserved.
+ *
+ * FileName: test_rto.c
+ *
+ * Description: test of the adaptive retransmit timeout, feed rtt samples of
+ *              a fast and a slow link into the connect layer, compare its 
+ *              rto with the fixed default, and of the in-flight window 
+ *              growing with responses and halving on loss, and releasing 
+ *              the queued packets by class and path order, no cloud needed.
+ *
+ * History:
+ * Version      Author          Date        Description
+ *
+ * 2.0.2                        2016-10-17  Create file.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "wilddog.h"
+#include "wilddog_common.h"
+#include "wilddog_conn.h"
+#include "wilddog_protocol.h"
+
+#define TEST_RTO_SAMPLES    40
+#define TEST_RTO_FAST       60
+#define TEST_RTO_SLOW       2500
+#define TEST_ORDER_PKTS     8
+
+struct test_reult_t
+{
+    char* name;
+    Wilddog_Func_T func;
+    int result;
+};
+
+STATIC Wilddog_Conn_T l_test_conn;
+STATIC Wilddog_Protocol_T l_test_protocol;
+STATIC Wilddog_Conn_Pkt_T l_test_pkts[TEST_ORDER_PKTS];
+STATIC Wilddog_Url_T l_test_urls[TEST_ORDER_PKTS];
+
+STATIC void test_initConn(void)
+{
+    memset(&l_test_conn, 0, sizeof(l_test_conn));
+    l_test_conn.d_rto.d_rto = WILDDOG_RTO_INIT;
+    l_test_conn.d_rto.d_update_time = _wilddog_getTime();
+    l_test_conn.d_rto.d_seed = 1;
+    l_test_conn.d_window.d_window = WILDDOG_WINDOW_INIT;
+    l_test_conn.d_window.d_ssthresh = WILDDOG_WINDOW_MAX;
+    l_test_conn.d_window.d_loss_time = _wilddog_getTime() - WILDDOG_RTO_MAX;
+}
+
+/*send pkt count times, then it is responded rtt ms after the last send.*/
+STATIC void test_respond(Wilddog_Conn_Pkt_T *pkt, u8 count, u32 rtt)
+{
+    memset(pkt, 0, sizeof(Wilddog_Conn_Pkt_T));
+    for(pkt->d_count = 1; pkt->d_count <= count; pkt->d_count++)
+        _wilddog_conn_getNextSendTime(&l_test_conn, pkt);
+    pkt->d_count = count;
+    pkt->d_send_time -= rtt;
+    _wilddog_conn_rto_sample(&l_test_conn, pkt);
+}
+
+STATIC u32 test_link(char *name, u32 rtt)
+{
+    Wilddog_Conn_Pkt_T pkt;
+    int i;
+
+    test_initConn();
+    /*the rtt jitters by 20%*/
+    for(i = 0; i < TEST_RTO_SAMPLES; i++)
+        test_respond(&pkt, 1, (i % 2)?(rtt * 4 / 5):(rtt * 6 / 5));
+    printf("%-10s%-10lu%-10lu%-10lu\n", name, (unsigned long)rtt, \
+           (unsigned long)l_test_conn.d_rto.d_rto, \
+           (unsigned long)WILDDOG_RTO_INIT);
+    return l_test_conn.d_rto.d_rto;
+}
+
+/*the rto follows the link, a fast one retransmits sooner, a slow one 
+ * does not retransmit before the response could come.
+ */
+int test_rtoConverge()
+{
+    u32 fast, slow;
+
+    printf("\n%-10s%-10s%-10s%-10s\n", "link", "rtt", "rto", "fixed");
+    fast = test_link("fast", TEST_RTO_FAST);
+    slow = test_link("slow", TEST_RTO_SLOW);
+    if(fast < WILDDOG_RTO_MIN || fast > 4 * TEST_RTO_FAST || \
+       slow <= TEST_RTO_SLOW || slow > WILDDOG_RTO_MAX)
+    {
+        wilddog_debug("fast rto = %lu, slow rto = %lu", \
+                      (unsigned long)fast, (unsigned long)slow);
+        return -1;
+    }
+    return 0;
+}
+
+/*the first wait is dithered up to 1.5 rto, retransmits back off.*/
+int test_rtoBackoff()
+{
+    Wilddog_Conn_Pkt_T pkt;
+    u32 first, rto;
+
+    test_initConn();
+    rto = l_test_conn.d_rto.d_rto;
+    memset(&pkt, 0, sizeof(pkt));
+    pkt.d_count = 1;
+    _wilddog_conn_getNextSendTime(&l_test_conn, &pkt);
+    first = pkt.d_rto;
+    if(first < rto || first > rto + rto / 2)
+        return -1;
+    pkt.d_count = 2;
+    _wilddog_conn_getNextSendTime(&l_test_conn, &pkt);
+    if(pkt.d_rto != first * pkt.d_backoff / 2 || pkt.d_rto <= first)
+        return -1;
+    if(1 != l_test_conn.d_rto.d_retransmits)
+        return -1;
+    return 0;
+}
+
+/*a weak sample moves the rto less, one sent too often is not sampled.*/
+int test_rtoSamples()
+{
+    Wilddog_Conn_Pkt_T pkt;
+
+    test_initConn();
+    test_respond(&pkt, 2, TEST_RTO_FAST);
+    if(1 != l_test_conn.d_rto.d_samples || 0 != l_test_conn.d_rto.d_strong_srtt)
+        return -1;
+    if(l_test_conn.d_rto.d_rto <= WILDDOG_RTO_INIT / 2)
+        return -1;
+    test_respond(&pkt, 4, TEST_RTO_FAST);
+    if(1 != l_test_conn.d_rto.d_samples)
+        return -1;
+    return 0;
+}
+
+/*respond to a packet while the window is used up.*/
+STATIC void test_ackFull(Wilddog_Conn_Pkt_T *pkt)
+{
+    l_test_conn.d_window.d_inflight = l_test_conn.d_window.d_window;
+    _wilddog_conn_window_ack(&l_test_conn, pkt);
+}
+
+/*slow start up to max, halve once on a burst of losses, then grow by one
+ * per window of responses, a window not used up does not grow.
+ */
+int test_window()
+{
+    Wilddog_Conn_Pkt_T pkt;
+    Wilddog_Conn_Window_T *p_win = &l_test_conn.d_window;
+    u32 i;
+
+    test_initConn();
+    memset(&pkt, 0, sizeof(pkt));
+    pkt.d_flag = WILDDOG_CONN_PKT_FLAG_INFLIGHT;
+    for(i = 0; i < 2 * WILDDOG_WINDOW_MAX; i++)
+        test_ackFull(&pkt);
+    if(WILDDOG_WINDOW_MAX != p_win->d_window)
+        return -1;
+    for(i = 0; i < 4; i++)
+        _wilddog_conn_window_loss(&l_test_conn, &pkt);
+    if(WILDDOG_WINDOW_MAX / 2 != p_win->d_window)
+        return -1;
+    for(i = 0; i + 1 < WILDDOG_WINDOW_MAX / 2; i++)
+        test_ackFull(&pkt);
+    if(WILDDOG_WINDOW_MAX / 2 != p_win->d_window)
+        return -1;
+    test_ackFull(&pkt);
+    if(WILDDOG_WINDOW_MAX / 2 + 1 != p_win->d_window)
+        return -1;
+    p_win->d_inflight = 1;
+    for(i = 0; i < 2 * WILDDOG_WINDOW_MAX; i++)
+        _wilddog_conn_window_ack(&l_test_conn, &pkt);
+    if(WILDDOG_WINDOW_MAX / 2 + 1 != p_win->d_window)
+        return -1;
+    return 0;
+}
+
+/*a rest packet of the path and class, it is sent or queued.*/
+STATIC BOOL test_orderSend(int index, char *path, u8 prio)
+{
+    Wilddog_Conn_Pkt_T *pkt = &l_test_pkts[index];
+
+    memset(pkt, 0, sizeof(Wilddog_Conn_Pkt_T));
+    memset(&l_test_urls[index], 0, sizeof(Wilddog_Url_T));
+    l_test_urls[index].p_url_path = (Wilddog_Str_T*)path;
+    pkt->p_url = &l_test_urls[index];
+    pkt->d_path_len = strlen(path);
+    pkt->d_prio = prio;
+    pkt->d_register_time = _wilddog_getTime();
+    return _wilddog_conn_window_send(&l_test_conn, pkt);
+}
+
+/*the packet is responded, it leaves the window.*/
+STATIC void test_orderAck(int index)
+{
+    l_test_pkts[index].d_flag &= ~WILDDOG_CONN_PKT_FLAG_INFLIGHT;
+    l_test_conn.d_window.d_inflight--;
+}
+
+/*the packets in flight are the ones in mask.*/
+STATIC BOOL test_orderInflight(u32 mask)
+{
+    int i;
+
+    for(i = 0; i < TEST_ORDER_PKTS; i++)
+    {
+        if(!(l_test_pkts[i].d_flag & WILDDOG_CONN_PKT_FLAG_INFLIGHT) != \
+           !(mask & (1 << i)))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+ * window of 2, bulk b1 /bulk/a sent, bulk b2 /bulk/b queued, as bulk never 
+ * takes the last slot, interactive i1 /x takes it. b1 responded, i2 
+ * /bulk/b/c (child of b2), i3 /y (after i2 of its class), control c1 /bulk
+ * (parent of b2), c2 /bulk/b (same as b2) are all queued. i3 overtakes 
+ * the others, b2 is released before c1 and c2 of a higher class, then i2,
+ * which c1 and c2 wait for too, as it was queued before them.
+ */
+int test_windowOrder()
+{
+    Wilddog_Conn_Window_T *p_win = &l_test_conn.d_window;
+    int res = -1, prio;
+
+    test_initConn();
+    l_test_conn.d_session.d_session_status = WILDDOG_SESSION_AUTHED;
+    l_test_conn.p_protocol = &l_test_protocol;
+    p_win->d_window = 2;
+    if(TRUE != test_orderSend(0, "/bulk/a", WILDDOG_CONN_PRIO_BULK) || \
+       FALSE != test_orderSend(1, "/bulk/b", WILDDOG_CONN_PRIO_BULK) || \
+       TRUE != test_orderSend(2, "/x", WILDDOG_CONN_PRIO_INTERACTIVE))
+        goto end;
+    test_orderAck(0);
+    if(FALSE != test_orderSend(3, "/bulk/b/c", WILDDOG_CONN_PRIO_INTERACTIVE) || \
+       FALSE != test_orderSend(4, "/y", WILDDOG_CONN_PRIO_INTERACTIVE) || \
+       FALSE != test_orderSend(5, "/bulk", WILDDOG_CONN_PRIO_CONTROL) || \
+       FALSE != test_orderSend(6, "/bulk/b", WILDDOG_CONN_PRIO_CONTROL))
+        goto end;
+    if(5 != p_win->d_queued || 2 != p_win->d_class_queued[WILDDOG_CONN_PRIO_CONTROL])
+        goto end;
+    _wilddog_conn_window_release(&l_test_conn);
+    if(FALSE == test_orderInflight((1 << 2) | (1 << 4)))
+        goto end;
+    test_orderAck(2);
+    test_orderAck(4);
+    _wilddog_conn_window_release(&l_test_conn);
+    if(FALSE == test_orderInflight(1 << 1))
+        goto end;
+    _wilddog_conn_window_release(&l_test_conn);
+    if(FALSE == test_orderInflight((1 << 1) | (1 << 3)))
+        goto end;
+    test_orderAck(1);
+    test_orderAck(3);
+    _wilddog_conn_window_release(&l_test_conn);
+    if(FALSE == test_orderInflight((1 << 5) | (1 << 6)))
+        goto end;
+    if(0 != p_win->d_queued)
+        goto end;
+    for(prio = 0; prio < WILDDOG_CONN_PRIO_MAX; prio++)
+    {
+        if(0 != p_win->d_class_queued[prio] || p_win->p_queue[prio] || \
+           p_win->p_queue_tail[prio])
+            goto end;
+    }
+    res = 0;
+end:
+    for(prio = 0; prio < WILDDOG_CONN_PRIO_MAX; prio++)
+    {
+        if(l_test_conn.d_timer[prio].p_heap)
+            wfree(l_test_conn.d_timer[prio].p_heap);
+    }
+    memset(&l_test_conn, 0, sizeof(l_test_conn));
+    return res;
+}
+
+struct test_reult_t test_results[] =
+{
+    {"conn rto converge",           (Wilddog_Func_T)test_rtoConverge,   0},
+    {"conn rto backoff",            (Wilddog_Func_T)test_rtoBackoff,    0},
+    {"conn rto samples",            (Wilddog_Func_T)test_rtoSamples,    0},
+    {"conn in-flight window",       (Wilddog_Func_T)test_window,        0},
+    {"conn window order",           (Wilddog_Func_T)test_windowOrder,   0},
+    {NULL, NULL, -1},
+};
+
+int test_printResult()
+{
+    int i;
+    printf("\n\nTest results:\n\n");
+    for(i = 0; i < sizeof(test_results)/ sizeof(struct test_reult_t); i++)
+    {
+        if(test_results[i].name != NULL)
+            test_results[i].result = test_results[i].func();
+    }
+    for(i = 0; i < sizeof(test_results)/ sizeof(struct test_reult_t); i++)
+    {
+        if(test_results[i].name != NULL)
+        {
+            printf("%-32s\t%s\n", test_results[i].name, \
+                    test_results[i].result == 0? ("PASS"):("FAIL"));
+
+            if(test_results[i].result != 0)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+int main(void)
+{
+    return test_printResult();
+}
@@ -0,0 +1,502 @@
+/*
+ * Copyright (C) 2014-2016 Wilddog Technologies. All Rights Reserved.
+ *
+ * FileName: test_session.c
+ *
+ * Description: saved session test, a client auths to a loopback coap
+ *              server, the session is saved, reused at init and by
+ *              wilddog_auth, and erased when the server rejects it, when it
+ *              times out and when going offline, no cloud needed.
+ *
+ * History:
+ * Version      Author          Date        Description
+ *
+ * 2.0.2                        2016-10-17  Create file.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "wilddog.h"
+#include "wilddog_api.h"
+#include "wilddog_port.h"
+#include "wilddog_conn.h"
+#include "wilddog_protocol.h"
+#include "networking/coap/option.h"
+#include "test_loopback.h"
+
+#define TEST_SESSION_HOST       "session.wilddogio.com"
+#define TEST_SESSION_URL        "coap://"TEST_SESSION_HOST"/sensor"
+#define TEST_SESSION_TOKEN      "token"
+#define TEST_SESSION_SID        "12345678"
+#define TEST_SESSION_TIMEOUTS   4
+#define TEST_SESSION_MAX_ROUNDS 200
+
+struct test_reult_t
+{
+    char* name;
+    Wilddog_Func_T func;
+    int result;
+};
+
+typedef struct TEST_SESSION_SERVER_T
+{
+    BOOL isDrop;//answer nothing but auth
+    BOOL isDropAuth;//answer no auth
+    BOOL isReject;//answer the next write with 4.01
+    int auths;
+    int writes;
+    int auth_len;
+    u8 auth_data[64];//token of the last auth
+    u16 last_mid;//of the last one answered, to skip retransmits
+}Test_Session_Server_T;
+
+STATIC Test_Session_Server_T l_test_server;
+STATIC Wilddog_T l_test_client = 0;
+STATIC int l_test_authCalled = 0;
+STATIC Wilddog_Return_T l_test_authErr = 0;
+STATIC int l_test_setCalled = 0;
+STATIC Wilddog_Return_T l_test_setErr = 0;
+
+/*{"s":"12345678","l":"0000...0"}, the short and long token.*/
+STATIC u8 l_test_authData[] =
+{
+    0xa2, 0x61, 0x73, 0x68, '1', '2', '3', '4', '5', '6', '7', '8',
+    0x61, 0x6c, 0x78, 0x20,
+    '0', '0', '0', '0', '0', '0', '0', '0', '0', '0', '0', '0', '0', '0', '0',
+    '0', '0', '0', '0', '0', '0', '0', '0', '0', '0', '0', '0', '0', '0', '0',
+    '0', '0'
+};
+
+STATIC BOOL test_isAuth(coap_pdu_t *req)
+{
+    coap_opt_iterator_t oi;
+    coap_opt_t *opt;
+
+    opt = coap_check_option(req, COAP_OPTION_URI_PATH, &oi);
+    return (opt && 3 == coap_opt_length(opt) && \
+            0 == memcmp(coap_opt_value(opt), ".cs", 3));
+}
+
+/*auth gets the tokens, writes get 2.04 or 4.01, others 2.05.*/
+STATIC void test_serverHandle
+    (
+    coap_pdu_t *req,
+    struct sockaddr_in *p_from
+    )
+{
+    coap_pdu_t *resp;
+    size_t len = 0;
+    u8 *data = NULL;
+    BOOL isNew = (req->hdr->id != l_test_server.last_mid);
+
+    if(COAP_MESSAGE_CON != req->hdr->type)
+        return;
+    resp = coap_pdu_init(COAP_MESSAGE_ACK, COAP_RESPONSE_CODE(205), \
+                         req->hdr->id, 256);
+    if(NULL == resp)
+        return;
+    coap_add_token(resp, req->hdr->token_length, req->hdr->token);
+    if(COAP_REQUEST_POST == req->hdr->code && TRUE == test_isAuth(req))
+    {
+        if(TRUE == l_test_server.isDropAuth)
+            goto drop;
+        if(isNew)
+        {
+            l_test_server.auths++;
+            coap_get_data(req, &len, &data);
+            l_test_server.auth_len = (len < sizeof(l_test_server.auth_data)) ? \
+                                     len : sizeof(l_test_server.auth_data);
+            if(data)
+                memcpy(l_test_server.auth_data, data, l_test_server.auth_len);
+        }
+        coap_add_data(resp, sizeof(l_test_authData), l_test_authData);
+    }
+    else if(TRUE == l_test_server.isDrop)
+    {
+        goto drop;
+    }
+    else if(COAP_REQUEST_PUT == req->hdr->code)
+    {
+        if(isNew)
+            l_test_server.writes++;
+        resp->hdr->code = COAP_RESPONSE_CODE(204);
+        if(TRUE == l_test_server.isReject)
+        {
+            resp->hdr->code = COAP_RESPONSE_CODE(401);
+            l_test_server.isReject = FALSE;
+        }
+    }
+    /*a dropped one is new when it is sent again*/
+    l_test_server.last_mid = req->hdr->id;
+    test_loopbackSend(resp, p_from);
+drop:
+    coap_delete_pdu(resp);
+}
+
+STATIC int test_serverOpen(void)
+{
+    memset(&l_test_server, 0, sizeof(l_test_server));
+    return test_loopbackOpen(test_serverHandle);
+}
+
+STATIC Wilddog_Conn_T *test_conn(void)
+{
+    return ((Wilddog_Ref_T*)l_test_client)->p_ref_repo->p_rp_conn;
+}
+
+/*the client is inited to the cloud, turn it to the loopback server.*/
+STATIC void test_redirect(void)
+{
+    test_loopbackConnect(test_conn()->p_protocol);
+}
+
+/*serve, and let the client send and receive.*/
+STATIC void test_sync(int rounds)
+{
+    int i;
+
+    for(i = 0; i < rounds; i++)
+    {
+        test_loopbackStep();
+        wilddog_trySync();
+    }
+    test_loopbackStep();
+}
+
+STATIC BOOL test_isAuthed(void)
+{
+    return (WILDDOG_SESSION_AUTHED == test_conn()->d_session.d_session_status);
+}
+
+/*wait until authed, the lost auth is sent again by the rto.*/
+STATIC BOOL test_waitAuthed(void)
+{
+    int i;
+
+    for(i = 0; i < TEST_SESSION_MAX_ROUNDS && FALSE == test_isAuthed(); i++)
+    {
+        test_sync(1);
+        wilddog_increaseTime(WILDDOG_RTO_INIT / 4);
+    }
+    test_sync(2);
+    return test_isAuthed();
+}
+
+STATIC void test_onAuth(void* arg, Wilddog_Return_T err)
+{
+    l_test_authCalled++;
+    l_test_authErr = err;
+}
+
+STATIC void test_onSet(void* arg, Wilddog_Return_T err)
+{
+    l_test_setCalled++;
+    l_test_setErr = err;
+}
+
+/*init a client, turned to the server, and not authed to it yet.*/
+STATIC BOOL test_clientOpen(void)
+{
+    l_test_authCalled = 0;
+    l_test_authErr = 0;
+    l_test_setCalled = 0;
+    l_test_setErr = 0;
+    l_test_client = wilddog_initWithUrl((Wilddog_Str_T*)TEST_SESSION_URL);
+    if(0 == l_test_client)
+        return FALSE;
+    test_redirect();
+    return TRUE;
+}
+
+STATIC void test_clientClose(void)
+{
+    if(l_test_client)
+        wilddog_destroy(&l_test_client);
+    l_test_client = 0;
+}
+
+STATIC Wilddog_Return_T test_auth(void)
+{
+    return wilddog_auth((Wilddog_Str_T*)TEST_SESSION_HOST, \
+                        (u8*)TEST_SESSION_TOKEN, strlen(TEST_SESSION_TOKEN), \
+                        test_onAuth, NULL);
+}
+
+STATIC Wilddog_Return_T test_setNum(int value)
+{
+    Wilddog_Node_T *p_node = wilddog_node_createNum(NULL, value);
+    Wilddog_Return_T ret;
+
+    if(NULL == p_node)
+        return WILDDOG_ERR_NULL;
+    ret = wilddog_setValue(l_test_client, p_node, test_onSet, NULL);
+    wilddog_node_delete(p_node);
+    return ret;
+}
+
+/*the session of the server is saved.*/
+STATIC BOOL test_isSaved(void)
+{
+    Wilddog_Conn_Session_Saved_T saved;
+
+    if((int)sizeof(saved) != wilddog_sessionLoad(TEST_SESSION_HOST, \
+                                                 &saved, sizeof(saved)))
+        return FALSE;
+    return (WILDDOG_CONN_SESSION_MAGIC == saved.d_magic && \
+            0 == strcmp((char*)saved.d_session.short_sid, TEST_SESSION_SID));
+}
+
+STATIC BOOL test_isErased(void)
+{
+    Wilddog_Conn_Session_Saved_T saved;
+
+    return (wilddog_sessionLoad(TEST_SESSION_HOST, &saved, sizeof(saved)) < 0);
+}
+
+/*a client auths with the token to the server, the session is saved.*/
+STATIC BOOL test_clientAuth(void)
+{
+    int i;
+
+    if(FALSE == test_clientOpen() || WILDDOG_ERR_NOERR != test_auth())
+        return FALSE;
+    for(i = 0; i < TEST_SESSION_MAX_ROUNDS && 0 == l_test_authCalled; i++)
+        test_sync(1);
+    return (1 == l_test_authCalled && WILDDOG_HTTP_OK == l_test_authErr);
+}
+
+/*a client auths with the saved session, the server sees no auth,
+ * onAuth is called before wilddog_auth returns.
+ */
+STATIC BOOL test_clientResume(void)
+{
+    if(FALSE == test_clientOpen() || WILDDOG_ERR_NOERR != test_auth())
+        return FALSE;
+    if(1 != l_test_authCalled || WILDDOG_HTTP_OK != l_test_authErr || \
+       FALSE == test_isAuthed())
+        return FALSE;
+    test_sync(2);
+    return (0 == l_test_server.auths);
+}
+
+/*a set reaches the server and is answered.*/
+STATIC BOOL test_setDone(void)
+{
+    int i, writes = l_test_server.writes;
+
+    if(WILDDOG_ERR_NOERR != test_setNum(1))
+        return FALSE;
+    for(i = 0; i < TEST_SESSION_MAX_ROUNDS && 0 == l_test_setCalled; i++)
+        test_sync(1);
+    return (writes + 1 == l_test_server.writes && 1 == l_test_setCalled && \
+            WILDDOG_HTTP_NO_CONTENT == l_test_setErr);
+}
+
+/*the session got by wilddog_auth is saved.*/
+int test_sessionSave()
+{
+    int res = -1;
+
+    wilddog_sessionSave(TEST_SESSION_HOST, NULL, 0);
+    if(0 != test_serverOpen())
+        goto end;
+    if(FALSE == test_clientAuth() || 1 != l_test_server.auths)
+        goto end;
+    if((int)strlen(TEST_SESSION_TOKEN) != l_test_server.auth_len || \
+       0 != memcmp(l_test_server.auth_data, TEST_SESSION_TOKEN, \
+                   l_test_server.auth_len))
+        goto end;
+    if(FALSE == test_isSaved())
+        goto end;
+    res = 0;
+end:
+    test_clientClose();
+    test_loopbackClose();
+    return res;
+}
+
+/*wilddog_auth of the saved token reuses the session, no auth sent.*/
+int test_sessionResumeAuth()
+{
+    int res = -1;
+
+    if(0 != test_serverOpen())
+        goto end;
+    if(FALSE == test_clientResume() || FALSE == test_setDone())
+        goto end;
+    if(0 != l_test_server.auths || FALSE == test_isSaved())
+        goto end;
+    res = 0;
+end:
+    test_clientClose();
+    test_loopbackClose();
+    return res;
+}
+
+/*the session got with no token is reused at init, no auth sent.*/
+int test_sessionResumeInit()
+{
+    int res = -1;
+
+    wilddog_sessionSave(TEST_SESSION_HOST, NULL, 0);
+    if(0 != test_serverOpen())
+        goto end;
+    /*the auth of init is lost, it is sent again to the server*/
+    if(FALSE == test_clientOpen() || FALSE == test_waitAuthed())
+        goto end;
+    if(1 != l_test_server.auths || 0 != l_test_server.auth_len || \
+       FALSE == test_isSaved())
+        goto end;
+    test_clientClose();
+    l_test_client = wilddog_initWithUrl((Wilddog_Str_T*)TEST_SESSION_URL);
+    if(0 == l_test_client || FALSE == test_isAuthed())
+        goto end;
+    test_redirect();
+    l_test_setCalled = 0;
+    if(FALSE == test_setDone() || 1 != l_test_server.auths)
+        goto end;
+    res = 0;
+end:
+    test_clientClose();
+    test_loopbackClose();
+    return res;
+}
+
+/*a write rejected with 4.01, the saved session is erased, the client
+ * auths with the token, and the write is sent again.
+ */
+int test_sessionReject()
+{
+    int i, res = -1;
+
+    if(0 != test_serverOpen())
+        goto end;
+    if(FALSE == test_clientAuth() || FALSE == test_isSaved())
+        goto end;
+    test_clientClose();
+    l_test_server.auths = 0;
+    if(FALSE == test_clientResume())
+        goto end;
+    l_test_server.isReject = TRUE;
+    l_test_server.isDropAuth = TRUE;
+    if(WILDDOG_ERR_NOERR != test_setNum(1))
+        goto end;
+    for(i = 0; i < TEST_SESSION_MAX_ROUNDS && FALSE == test_isErased(); i++)
+        test_sync(1);
+    if(1 != l_test_server.writes || FALSE == test_isErased() || \
+       TRUE == test_isAuthed() || 0 != l_test_setCalled)
+        goto end;
+    l_test_server.isDropAuth = FALSE;
+    if(FALSE == test_waitAuthed() || 1 != l_test_server.auths)
+        goto end;
+    for(i = 0; i < TEST_SESSION_MAX_ROUNDS && 0 == l_test_setCalled; i++)
+        test_sync(1);
+    if(2 != l_test_server.writes || 1 != l_test_setCalled || \
+       WILDDOG_HTTP_NO_CONTENT != l_test_setErr)
+        goto end;
+    if((int)strlen(TEST_SESSION_TOKEN) != l_test_server.auth_len || \
+       0 != memcmp(l_test_server.auth_data, TEST_SESSION_TOKEN, \
+                   l_test_server.auth_len))
+        goto end;
+    if(FALSE == test_isSaved())
+        goto end;
+    res = 0;
+end:
+    test_clientClose();
+    test_loopbackClose();
+    return res;
+}
+
+/*the writes time out, the saved session is erased.*/
+int test_sessionTimeout()
+{
+    int i, res = -1;
+
+    if(0 != test_serverOpen())
+        goto end;
+    if(FALSE == test_clientAuth() || FALSE == test_isSaved())
+        goto end;
+    test_clientClose();
+    l_test_server.auths = 0;
+    if(FALSE == test_clientResume())
+        goto end;
+    l_test_server.isDrop = TRUE;
+    for(i = 0; i < TEST_SESSION_TIMEOUTS; i++)
+    {
+        if(WILDDOG_ERR_NOERR != test_setNum(i))
+            goto end;
+    }
+    test_sync(2);
+    wilddog_increaseTime(WILDDOG_RETRANSMITE_TIME + 1);
+    test_sync(5);
+    if(TEST_SESSION_TIMEOUTS != l_test_setCalled || \
+       WILDDOG_ERR_RECVTIMEOUT != l_test_setErr || FALSE == test_isErased())
+        goto end;
+    res = 0;
+end:
+    test_clientClose();
+    test_loopbackClose();
+    return res;
+}
+
+/*going offline closes the session, it is erased.*/
+int test_sessionOffline()
+{
+    int res = -1;
+
+    if(0 != test_serverOpen())
+        goto end;
+    if(FALSE == test_clientAuth() || FALSE == test_isSaved())
+        goto end;
+    wilddog_goOffline();
+    if(FALSE == test_isErased())
+        goto end;
+    wilddog_goOnline();
+    res = 0;
+end:
+    test_clientClose();
+    test_loopbackClose();
+    return res;
+}
+
+struct test_reult_t test_results[] =
+{
+    {"session save after auth",     (Wilddog_Func_T)test_sessionSave,       0},
+    {"session resume in auth",      (Wilddog_Func_T)test_sessionResumeAuth, 0},
+    {"session resume at init",      (Wilddog_Func_T)test_sessionResumeInit, 0},
+    {"session erase on 4.01",       (Wilddog_Func_T)test_sessionReject,     0},
+    {"session erase on timeout",    (Wilddog_Func_T)test_sessionTimeout,    0},
+    {"session erase on offline",    (Wilddog_Func_T)test_sessionOffline,    0},
+    {NULL, NULL, -1},
+};
+
+int test_printResult()
+{
+    int i;
+    printf("\n\nTest results:\n\n");
+    for(i = 0; i < sizeof(test_results)/ sizeof(struct test_reult_t); i++)
+    {
+        if(test_results[i].name != NULL)
+            test_results[i].result = test_results[i].func();
+    }
+    wilddog_sessionSave(TEST_SESSION_HOST, NULL, 0);
+    for(i = 0; i < sizeof(test_results)/ sizeof(struct test_reult_t); i++)
+    {
+        if(test_results[i].name != NULL)
+        {
+            printf("%-32s\t%s\n", test_results[i].name, \
+                    test_results[i].result == 0? ("PASS"):("FAIL"));
+
+            if(test_results[i].result != 0)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+int main(void)
+{
+    return test_printResult();
+}
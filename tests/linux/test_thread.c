@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2014-2016 Wilddog Technologies. All Rights Reserved.
+ *
+ * FileName: test_thread.c
+ *
+ * Description: threaded mode test, many threads call api at the same time,
+ *              all callbacks must come from the sdk i/o thread.
+ *
+ * History:
+ * Version      Author          Date        Description
+ *
+ * 2.0.2                        2016-10-16  Create file.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "wilddog.h"
+#include "test_config.h"
+
+#define TEST_THREAD_NUM     4
+#define TEST_THREAD_REQ     8
+#define TEST_THREAD_TIMEOUT 60
+
+struct test_reult_t
+{
+    char* name;
+    Wilddog_Func_T func;
+    int result;
+};
+
+STATIC Wilddog_T l_test_ref = 0;
+STATIC int l_test_done = 0;
+STATIC int l_test_wrongThread = 0;
+STATIC int l_test_keyFail = 0;
+STATIC pthread_t l_test_workers[TEST_THREAD_NUM];
+
+STATIC void test_onSetFunc(void* arg, Wilddog_Return_T err)
+{
+    int i;
+    for(i = 0; i < TEST_THREAD_NUM; i++)
+    {
+        if(pthread_equal(pthread_self(), l_test_workers[i]))
+            __atomic_fetch_add(&l_test_wrongThread, 1, __ATOMIC_RELAXED);
+    }
+    __atomic_fetch_add(&l_test_done, 1, __ATOMIC_RELAXED);
+}
+
+STATIC void* test_worker(void* arg)
+{
+    int i;
+    Wilddog_Str_T *p_key;
+    Wilddog_Node_T *p_node;
+
+    for(i = 0; i < TEST_THREAD_REQ; i++)
+    {
+        /*the node is freed at once, sdk must keep its own copy.*/
+        p_node = wilddog_node_createNum((Wilddog_Str_T*)"count", i);
+        if(WILDDOG_ERR_NOERR != wilddog_setValue(l_test_ref, p_node, \
+                                                 test_onSetFunc, NULL))
+            __atomic_fetch_add(&l_test_done, 1, __ATOMIC_RELAXED);
+        wilddog_node_delete(p_node);
+        /*waits the i/o thread for the result*/
+        p_key = wilddog_getKey(l_test_ref);
+        if(NULL == p_key || strcmp((const char*)p_key, "threadtest"))
+            __atomic_fetch_add(&l_test_keyFail, 1, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+/*every queued request must get its callback, in the i/o thread.*/
+int test_threadSet()
+{
+    int i, wait = 0, res = -1;
+
+    if(WILDDOG_ERR_NOERR != wilddog_startThread())
+    {
+        wilddog_debug("start i/o thread fail");
+        return -1;
+    }
+    l_test_ref = wilddog_initWithUrl((Wilddog_Str_T*)TEST_URL"/threadtest");
+    if(0 == l_test_ref)
+        goto end;
+    for(i = 0; i < TEST_THREAD_NUM; i++)
+        pthread_create(&l_test_workers[i], NULL, test_worker, NULL);
+    for(i = 0; i < TEST_THREAD_NUM; i++)
+        pthread_join(l_test_workers[i], NULL);
+    while(__atomic_load_n(&l_test_done, __ATOMIC_RELAXED) < \
+          TEST_THREAD_NUM * TEST_THREAD_REQ && wait++ < TEST_THREAD_TIMEOUT)
+    {
+        sleep(1);
+    }
+    printf("callbacks %d/%d\n", l_test_done, TEST_THREAD_NUM * TEST_THREAD_REQ);
+    if(l_test_done == TEST_THREAD_NUM * TEST_THREAD_REQ && \
+       0 == l_test_wrongThread && 0 == l_test_keyFail)
+        res = 0;
+    wilddog_destroy(&l_test_ref);
+end:
+    wilddog_stopThread();
+    return res;
+}
+
+struct test_reult_t test_results[] =
+{
+    {"wilddog threaded mode",       (Wilddog_Func_T)test_threadSet,     0},
+    {NULL, NULL, -1},
+};
+
+int test_printResult()
+{
+    int i;
+    printf("\n\nTest results:\n\n");
+    for(i = 0; i < sizeof(test_results)/ sizeof(struct test_reult_t); i++)
+    {
+        if(test_results[i].name != NULL)
+            test_results[i].result = test_results[i].func();
+    }
+    for(i = 0; i < sizeof(test_results)/ sizeof(struct test_reult_t); i++)
+    {
+        if(test_results[i].name != NULL)
+        {
+            printf("%-32s\t%s\n", test_results[i].name, \
+                    test_results[i].result == 0? ("PASS"):("FAIL"));
+
+            if(test_results[i].result != 0)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+int main(void)
+{
+    return test_printResult();
+}
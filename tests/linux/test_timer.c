@@ -0,0 +1,327 @@
+/*
+ * Copyright (C) 2014-2016 Wilddog Technologies. All Rights Reserved.
+ *
+ * FileName: test_timer.c
+ *
+ * Description: connect layer timer heap tests, order, removal, due time
+ *              wraparound and class change, and the per tick cost compared
+ *              with walking the packet list, no server needed.
+ *
+ * History:
+ * Version      Author          Date        Description
+ *
+ * 2.0.2                        2016-10-17  Create file.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "wilddog.h"
+#include "wilddog_conn.h"
+#include "utlist.h"
+
+#define TEST_TIMER_NUM      1000
+#define TEST_TIMER_TICKS    1000
+/*the packets are due over one rto, each is sent again an rto after due*/
+#define TEST_TIMER_RTO      2000
+#define TEST_TIMER_BEFORE(a,b) ((s32)((u32)(a) - (u32)(b)) < 0)
+
+struct test_reult_t
+{
+    char* name;
+    Wilddog_Func_T func;
+    int result;
+};
+
+STATIC const u32 l_test_num[] = {10, 100, 1000, 10000, 100000};
+
+STATIC u32 test_usec(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (u32)(tv.tv_sec * 1000000 + tv.tv_usec);
+}
+
+/*no child is due before its parent, every packet knows where it is.*/
+STATIC BOOL test_isHeap(Wilddog_Conn_Timer_T *p_timer)
+{
+    u32 i;
+
+    for(i = 0; i < p_timer->d_num; i++)
+    {
+        if(p_timer->p_heap[i]->d_timer_index != i + 1)
+            return FALSE;
+        if(i > 0 && TEST_TIMER_BEFORE(p_timer->p_heap[i]->d_timer_due, \
+                            p_timer->p_heap[(i - 1) / 2]->d_timer_due))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+/*take all packets of the class out, they must come in due order.*/
+STATIC int test_drain(Wilddog_Conn_T *p_conn, u8 prio, u32 num)
+{
+    Wilddog_Conn_Timer_T *p_timer = &p_conn->d_timer[prio];
+    Wilddog_Conn_Pkt_T *pkt;
+    u32 last = 0, i;
+
+    if(p_timer->d_num != num || FALSE == test_isHeap(p_timer))
+        return -1;
+    for(i = 0; i < num; i++)
+    {
+        pkt = p_timer->p_heap[0];
+        if(i > 0 && TEST_TIMER_BEFORE(pkt->d_timer_due, last))
+        {
+            wilddog_debug("due %lu after %lu", \
+                          (unsigned long)pkt->d_timer_due, (unsigned long)last);
+            return -1;
+        }
+        last = pkt->d_timer_due;
+        _wilddog_conn_timer_remove(p_conn, pkt);
+        if(0 != pkt->d_timer_index)
+            return -1;
+    }
+    return (0 == p_timer->d_num) ? 0 : -1;
+}
+
+/*random due times come out in order.*/
+int test_timerOrder()
+{
+    Wilddog_Conn_T conn;
+    Wilddog_Conn_Pkt_T *pkts;
+    u32 i;
+    int res = -1;
+
+    memset(&conn, 0, sizeof(conn));
+    pkts = (Wilddog_Conn_Pkt_T*)calloc(TEST_TIMER_NUM, sizeof(Wilddog_Conn_Pkt_T));
+    if(NULL == pkts)
+        return -1;
+    for(i = 0; i < TEST_TIMER_NUM; i++)
+    {
+        if(WILDDOG_ERR_NOERR != \
+           _wilddog_conn_timer_schedule(&conn, &pkts[i], rand() & 0xffffff))
+            goto end;
+    }
+    res = test_drain(&conn, WILDDOG_CONN_PRIO_CONTROL, TEST_TIMER_NUM);
+end:
+    _wilddog_conn_timer_deinit(&conn);
+    free(pkts);
+    return res;
+}
+
+/*packets removed from the middle leave the others in order.*/
+int test_timerRemove()
+{
+    Wilddog_Conn_T conn;
+    Wilddog_Conn_Pkt_T *pkts;
+    u32 i, left = TEST_TIMER_NUM;
+    int res = -1;
+
+    memset(&conn, 0, sizeof(conn));
+    pkts = (Wilddog_Conn_Pkt_T*)calloc(TEST_TIMER_NUM, sizeof(Wilddog_Conn_Pkt_T));
+    if(NULL == pkts)
+        return -1;
+    for(i = 0; i < TEST_TIMER_NUM; i++)
+        _wilddog_conn_timer_schedule(&conn, &pkts[i], rand() & 0xffffff);
+    for(i = 0; i < TEST_TIMER_NUM; i += 3)
+    {
+        _wilddog_conn_timer_remove(&conn, &pkts[i]);
+        left--;
+        if(FALSE == test_isHeap(&conn.d_timer[WILDDOG_CONN_PRIO_CONTROL]))
+            goto end;
+    }
+    /*removing twice does nothing*/
+    _wilddog_conn_timer_remove(&conn, &pkts[0]);
+    res = test_drain(&conn, WILDDOG_CONN_PRIO_CONTROL, left);
+end:
+    _wilddog_conn_timer_deinit(&conn);
+    free(pkts);
+    return res;
+}
+
+/*due times across the u32 wrap are ordered as times, not as numbers.*/
+int test_timerWrap()
+{
+    Wilddog_Conn_T conn;
+    Wilddog_Conn_Pkt_T *pkts;
+    u32 i, base = 0xffffffff - TEST_TIMER_NUM / 2;
+    int res = -1;
+
+    memset(&conn, 0, sizeof(conn));
+    pkts = (Wilddog_Conn_Pkt_T*)calloc(TEST_TIMER_NUM, sizeof(Wilddog_Conn_Pkt_T));
+    if(NULL == pkts)
+        return -1;
+    for(i = 0; i < TEST_TIMER_NUM; i++)
+        _wilddog_conn_timer_schedule(&conn, &pkts[i], \
+                                     base + (i * 7919) % TEST_TIMER_NUM);
+    if(conn.d_timer[WILDDOG_CONN_PRIO_CONTROL].p_heap[0]->d_timer_due != base)
+        goto end;
+    res = test_drain(&conn, WILDDOG_CONN_PRIO_CONTROL, TEST_TIMER_NUM);
+end:
+    _wilddog_conn_timer_deinit(&conn);
+    free(pkts);
+    return res;
+}
+
+/*a new due time moves the packet, a new class moves it to that heap.*/
+int test_timerReschedule()
+{
+    Wilddog_Conn_T conn;
+    Wilddog_Conn_Pkt_T *pkts;
+    Wilddog_Conn_Timer_T *p_ctrl, *p_bulk;
+    u32 i, due;
+    int res = -1;
+
+    memset(&conn, 0, sizeof(conn));
+    p_ctrl = &conn.d_timer[WILDDOG_CONN_PRIO_CONTROL];
+    p_bulk = &conn.d_timer[WILDDOG_CONN_PRIO_BULK];
+    pkts = (Wilddog_Conn_Pkt_T*)calloc(TEST_TIMER_NUM, sizeof(Wilddog_Conn_Pkt_T));
+    if(NULL == pkts)
+        return -1;
+    for(i = 0; i < TEST_TIMER_NUM; i++)
+        _wilddog_conn_timer_schedule(&conn, &pkts[i], 1000 + i);
+    /*the first one is sent, it is due again later, the last one earlier*/
+    _wilddog_conn_timer_schedule(&conn, &pkts[0], 1000 + TEST_TIMER_NUM);
+    _wilddog_conn_timer_schedule(&conn, &pkts[TEST_TIMER_NUM - 1], 1);
+    if(p_ctrl->d_num != TEST_TIMER_NUM || FALSE == test_isHeap(p_ctrl) || \
+       p_ctrl->p_heap[0] != &pkts[TEST_TIMER_NUM - 1])
+        goto end;
+    /*the odd ones become bulk, keep their due time*/
+    for(i = 1; i < TEST_TIMER_NUM; i += 2)
+    {
+        due = pkts[i].d_timer_due;
+        _wilddog_conn_timer_setPrio(&conn, &pkts[i], WILDDOG_CONN_PRIO_BULK);
+        if(WILDDOG_CONN_PRIO_BULK != pkts[i].d_prio || \
+           due != pkts[i].d_timer_due || \
+           p_bulk->p_heap[pkts[i].d_timer_index - 1] != &pkts[i])
+            goto end;
+    }
+    if(FALSE == test_isHeap(p_ctrl) || FALSE == test_isHeap(p_bulk) || \
+       p_bulk->p_heap[0] != &pkts[TEST_TIMER_NUM - 1])
+        goto end;
+    /*the same class does nothing*/
+    _wilddog_conn_timer_setPrio(&conn, &pkts[1], WILDDOG_CONN_PRIO_BULK);
+    if(0 != test_drain(&conn, WILDDOG_CONN_PRIO_CONTROL, TEST_TIMER_NUM / 2) || \
+       0 != test_drain(&conn, WILDDOG_CONN_PRIO_BULK, TEST_TIMER_NUM / 2))
+        goto end;
+    res = 0;
+end:
+    _wilddog_conn_timer_deinit(&conn);
+    free(pkts);
+    return res;
+}
+
+/*
+ * cost of one tick from 10 to 100k packets in flight: find the due one and
+ * send it again later, by walking the list or from the top of the heap.
+*/
+int test_timerBench()
+{
+    Wilddog_Conn_T conn;
+    Wilddog_Conn_Pkt_T *pkts, *p_head, *curr, *pkt;
+    u32 n, i, num, now, start, listTime, heapTime, listDue, heapDue;
+    int res = 0;
+
+    printf("\n%-10s%-18s%-18s\n", "packets", "list(ns/tick)", "heap(ns/tick)");
+    for(n = 0; n < sizeof(l_test_num) / sizeof(u32); n++)
+    {
+        num = l_test_num[n];
+        memset(&conn, 0, sizeof(conn));
+        p_head = NULL;
+        pkts = (Wilddog_Conn_Pkt_T*)calloc(num, sizeof(Wilddog_Conn_Pkt_T));
+        if(NULL == pkts)
+            return -1;
+        for(i = 0; i < num; i++)
+        {
+            pkts[i].d_next_send_time = i * TEST_TIMER_RTO / num;
+            LL_PREPEND(p_head, &pkts[i]);
+        }
+        /*list: every tick checks every packet*/
+        listDue = 0;
+        start = test_usec();
+        for(now = 0; now < TEST_TIMER_TICKS; now++)
+        {
+            LL_FOREACH(p_head, curr)
+            {
+                if(!TEST_TIMER_BEFORE(now, curr->d_next_send_time))
+                {
+                    curr->d_next_send_time = now + TEST_TIMER_RTO;
+                    listDue++;
+                }
+            }
+        }
+        listTime = test_usec() - start;
+        for(i = 0; i < num; i++)
+            _wilddog_conn_timer_schedule(&conn, &pkts[i], \
+                                         i * TEST_TIMER_RTO / num);
+        /*heap: every tick looks at the top, only the due ones are touched*/
+        heapDue = 0;
+        start = test_usec();
+        for(now = 0; now < TEST_TIMER_TICKS; now++)
+        {
+            while(conn.d_timer[WILDDOG_CONN_PRIO_CONTROL].d_num > 0)
+            {
+                pkt = conn.d_timer[WILDDOG_CONN_PRIO_CONTROL].p_heap[0];
+                if(TEST_TIMER_BEFORE(now, pkt->d_timer_due))
+                    break;
+                _wilddog_conn_timer_schedule(&conn, pkt, now + TEST_TIMER_RTO);
+                heapDue++;
+            }
+        }
+        heapTime = test_usec() - start;
+        if(listDue != heapDue || \
+           FALSE == test_isHeap(&conn.d_timer[WILDDOG_CONN_PRIO_CONTROL]))
+        {
+            wilddog_debug("%lu packets, list due %lu, heap due %lu", \
+                          (unsigned long)num, (unsigned long)listDue, \
+                          (unsigned long)heapDue);
+            res = -1;
+        }
+        printf("%-10lu%-18lu%-18lu\n", (unsigned long)num, \
+               (unsigned long)listTime * 1000 / TEST_TIMER_TICKS, \
+               (unsigned long)heapTime * 1000 / TEST_TIMER_TICKS);
+        _wilddog_conn_timer_deinit(&conn);
+        free(pkts);
+    }
+    return res;
+}
+
+struct test_reult_t test_results[] =
+{
+    {"timer heap order",            (Wilddog_Func_T)test_timerOrder,      0},
+    {"timer heap remove",           (Wilddog_Func_T)test_timerRemove,     0},
+    {"timer heap wraparound",       (Wilddog_Func_T)test_timerWrap,       0},
+    {"timer heap reschedule",       (Wilddog_Func_T)test_timerReschedule, 0},
+    {"timer heap benchmark",        (Wilddog_Func_T)test_timerBench,      0},
+    {NULL, NULL, -1},
+};
+
+int test_printResult()
+{
+    int i;
+    printf("\n\nTest results:\n\n");
+    for(i = 0; i < sizeof(test_results)/ sizeof(struct test_reult_t); i++)
+    {
+        if(test_results[i].name != NULL)
+            test_results[i].result = test_results[i].func();
+    }
+    for(i = 0; i < sizeof(test_results)/ sizeof(struct test_reult_t); i++)
+    {
+        if(test_results[i].name != NULL)
+        {
+            printf("%-32s\t%s\n", test_results[i].name, \
+                    test_results[i].result == 0? ("PASS"):("FAIL"));
+
+            if(test_results[i].result != 0)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+int main(void)
+{
+    return test_printResult();
+}